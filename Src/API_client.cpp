@@ -22,6 +22,10 @@ std::string sizeToString(size_t value) {
 // Define static constants (C++11 compatible)
 const char* const APIClient::STAFF_API_BASE_URL =
     "https://api1.raildata.org.uk/1010-live-arrival-and-departure-boards---staff-version1_0/LDBSVWS/api/20220120/GetArrDepBoardWithDetails/";
+const char* const APIClient::STAFF_SUMMARY_URL =
+    "https://api1.raildata.org.uk/1010-live-arrival-and-departure-boards---staff-version1_0/LDBSVWS/api/20220120/GetArrivalDepartureBoardByCRS/";
+const char* const APIClient::STAFF_SERVICE_DETAILS_URL =
+    "https://api1.raildata.org.uk/1010-live-arrival-and-departure-boards---staff-version1_0/LDBSVWS/api/20220120/GetServiceDetailsByRID/";
 const char* const APIClient::REASON_CODE_URL =
     "https://api1.raildata.org.uk/1010-reference-data1_0/LDBSVWS/api/ref/20211101/GetReasonCodeList";
 const char* const APIClient::API_KEY_HEADER_PREFIX = "x-apikey:";
@@ -52,7 +56,7 @@ void APIClient::CurlHeaders::append(const std::string& header) {
 }
 
 // Main APIClient implementation
-APIClient::APIClient(const APIConfig& config) : APIConfig_(config), departure_data_version(0) {
+APIClient::APIClient(const APIConfig& config) : APIConfig_(config), departure_data_version(0), request_count(0), bytes_received(0) {
     if (APIConfig_.staff_api_key.empty()) {
         throw std::invalid_argument("Staff API key cannot be empty");
     }
@@ -73,6 +77,34 @@ std::string APIClient::fetchDepartures(const std::string& station_code) const {
     return makeApiCall(url, APIConfig_.staff_api_key, "departures");
 }
 
+// Summary board - the same services without calling points or formation. Used with fetchServiceDetails for the services shown.
+std::string APIClient::fetchDepartureSummary(const std::string& station_code) const {
+    if (station_code.empty()) {
+        throw std::invalid_argument("Station code cannot be empty");
+    }
+
+    const std::string url = std::string(STAFF_SUMMARY_URL) + station_code + "/" + getCurrentDateTime();
+    debugPrint("Fetching departure summary for station: " + station_code);
+    debugPrint("URL: " + url);
+
+    departure_data_version.fetch_add(1, std::memory_order_release);
+
+    return makeApiCall(url, APIConfig_.staff_api_key, "departures_summary");
+}
+
+// Service details (including all calling points) for a service on the board
+std::string APIClient::fetchServiceDetails(const std::string& rid) const {
+    if (rid.empty()) {
+        throw std::invalid_argument("Service RID cannot be empty");
+    }
+
+    const std::string url = std::string(STAFF_SERVICE_DETAILS_URL) + rid;
+    debugPrint("Fetching service details for RID: " + rid);
+    debugPrint("URL: " + url);
+
+    return makeApiCall(url, APIConfig_.staff_api_key, "service_details");
+}
+
 std::string APIClient::fetchReasonCodes() const {
     if (APIConfig_.reason_code_api_key.empty()) {
         throw std::invalid_argument("Reason code API key not configured");
@@ -137,6 +169,8 @@ std::string APIClient::makeApiCall(const std::string& url, const std::string& ap
     }
     
     debugPrint("Response received, length: " + sizeToString(response.length()));
+    request_count.fetch_add(1, std::memory_order_relaxed);
+    bytes_received.fetch_add(response.length(), std::memory_order_relaxed);
     
     // Write debug files if enabled
     if (APIConfig_.debug_mode && !log_prefix.empty()) {
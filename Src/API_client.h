@@ -33,6 +33,8 @@ public:
 
     // Main API methods
     std::string fetchDepartures(const std::string& station_code) const;
+    std::string fetchDepartureSummary(const std::string& station_code) const;   // Board without calling points (two-tier fetching)
+    std::string fetchServiceDetails(const std::string& rid) const;              // Details for one service (two-tier fetching)
     std::string fetchReasonCodes() const;
     
     // Departure Data version control
@@ -40,6 +42,10 @@ public:
         return departure_data_version.load(std::memory_order_acquire);
     }
 
+    // Transfer statistics - totals since the client was created
+    uint64_t getRequestCount() const { return request_count.load(std::memory_order_relaxed); }
+    uint64_t getBytesReceived() const { return bytes_received.load(std::memory_order_relaxed); }
+
     // Utility methods
     void setDebugMode(bool enabled) { APIConfig_.debug_mode = enabled; }
     bool isDebugMode() const { return APIConfig_.debug_mode; }
@@ -49,9 +55,13 @@ private:
     
     // Mutable allows modification in const methods (for version tracking)
     mutable std::atomic<uint64_t> departure_data_version;
+    mutable std::atomic<uint64_t> request_count;
+    mutable std::atomic<uint64_t> bytes_received;
     
     // Constants - using static const instead of constexpr
     static const char* const STAFF_API_BASE_URL;
+    static const char* const STAFF_SUMMARY_URL;
+    static const char* const STAFF_SERVICE_DETAILS_URL;
     static const char* const REASON_CODE_URL;
     static const char* const API_KEY_HEADER_PREFIX;
 
@@ -0,0 +1,1464 @@
+//
+//  benchmark.cpp
+//  Departure_Board
+//
+//  Replay harness and benchmark suite.
+//  Recorded API responses are replayed through the parser and frames are rendered headless (no matrix or GPIO needed).
+//  Used by 'make benchmark' and as the training run for the profile-guided build ('make pgo').
+//
+//  Scenario file - one command per line, '#' for comments. Paths are relative to the scenario file.
+//    reasons <file>      Load the delay/cancellation reason codes (traindisplay_reason_codes_response.json)
+//    refresh <file>      Apply a recorded departure response (traindisplay_departures_response.json)
+//    render <frames>     Render a number of frames
+//    ordering <services> <refreshes>
+//                        Order a synthetic, slowly changing board - incremental repair against a full sort
+//    departures <number> <refreshes>
+//                        Hydration cost for a board showing <number> departures - replays the scenario's responses in turn
+//    fetchmodel <refresh_seconds>
+//                        An hour of refreshes - bytes and parse time for the single GetArrDepBoardWithDetails call
+//                        against two-tier fetching (summary board + service details for the departures shown)
+//    timeslice <budget_us> <refreshes>
+//                        Refreshes spread over frames with a per-frame budget (refresh_step_budget_us) against the whole
+//                        refresh in one frame - reports and checks the longest gap between frames
+//    callingat <refreshes>
+//                        "Next train calling at" and "fastest to" for every station on the board - the parser's station index
+//                        against walking every service's calling points
+//    malformed <refreshes>
+//                        Refreshes with damaged responses (wrong types, short times, objects for arrays, the wrong shape, truncated JSON)
+//                        - the longest frame (refresh and render) and the errors counted by the parser
+//    executor <refreshes>
+//                        Refreshes done by the task executor's workers (multi-core boards) - a fetch on the FETCH lane, the parse on
+//                        DATA and the row layout on FRAME while frames are rendered - against the whole refresh in one frame.
+//                        Reports the longest frame and the executor's lane metrics
+//    palette <frames>
+//                        Pixels pushed from the palette framebuffer per frame against the whole matrix, the frames after a
+//                        theme swap, and a check that double-buffered pushes leave both canvases matching the framebuffer
+//    stream <frames>
+//                        Frames streamed to a receiver over loopback (stream_to / departureboard_receiver) - bytes a frame
+//                        against the raw frame, encode and decode time and the latency to the receiver's ack. The
+//                        receiver must end up with the same frame, and refuse a frame too big for any panels
+//    present <frames> [refresh_hz]
+//                        Frames shown on a simulated panel (default 120 Hz) - swapped in the render loop, then pipelined on
+//                        the presenter's thread (present_thread). Reports compose, push and the vsync wait for each
+//    mapper <frames> <led-pixel-mapper>
+//                        The board pushed to the panels as drawn, through the mapper table (PixelMapperLUT) and through the
+//                        mapper chain for each pixel - the table should cost the same as no mapper
+//    calibrate
+//                        The device calibration (--calibrate) on this machine - the NEON HTML threshold, the text width cache
+//                        size and the scroll timings rounded to the (headless) frame interval, as written to device_profile
+//    history <refreshes>
+//                        The departure history log (history_dir) - refreshes parsed with and without the log, then four
+//                        weeks of a synthetic board logged a refresh at a time and summarised as departureboard_history does.
+//                        The summary must match the delays logged, and a restarted log mustn't repeat unchanged services
+//    stress <refreshes>
+//                        The whole board through a parser sized for it (not max_services) - prefetchCache, hydration, the
+//                        calling points of every service and the HTML processor on the NRCC messages. For the large boards
+//                        written by the payload generator ('make stress')
+//
+
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <array>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <iomanip>
+#include <cstring>
+#include <random>
+#include <numeric>
+#include <cmath>
+#include <unordered_map>
+#include <unistd.h>
+#include "config.h"
+#include "matrix_driver.h"
+#include "train_service_parser.h"
+#include "departure_order.h"
+#include "service_details_cache.h"
+#include "station_index.h"
+#include "HTML_processor.h"
+#include "task_executor.h"
+#include "palette_framebuffer.h"
+#include "frame_stream.h"
+#include "device_calibration.h"
+#include "frame_presenter.h"
+#include "departure_history.h"
+
+bool debug_mode = false;                                                                // Global debug flag
+
+namespace {
+
+// Timing for one stage of the benchmark
+struct StageStats {
+    size_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+
+    void add(uint64_t ns) {
+        count++;
+        total_ns += ns;
+        if (ns > max_ns) max_ns = ns;
+    }
+};
+
+class BenchTimer {
+public:
+    template<typename F> uint64_t time(const std::string& stage, F&& work) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        stats[stage].add(static_cast<uint64_t>(elapsed));
+        return static_cast<uint64_t>(elapsed);
+    }
+
+    void add(const std::string& stage, uint64_t ns) {                                   // Time measured by the caller
+        stats[stage].add(ns);
+    }
+
+    void report() const {
+        uint64_t total = 0;
+        std::cout << std::setfill(' ') << std::dec;                                     // Debug output elsewhere may leave the stream with '0' fill / hex
+        std::cout << "[Bench] " << std::left << std::setw(24) << "Stage" << std::right << std::setw(10) << "Count"
+                  << std::setw(14) << "Mean (us)" << std::setw(14) << "Max (us)" << std::setw(14) << "Total (ms)" << std::endl;
+        for (const auto& stage : stats) {
+            const StageStats& s = stage.second;
+            std::cout << "[Bench] " << std::left << std::setw(24) << stage.first << std::right << std::setw(10) << s.count
+                      << std::setw(14) << std::fixed << std::setprecision(2) << (s.count ? s.total_ns / 1000.0 / s.count : 0.0)
+                      << std::setw(14) << s.max_ns / 1000.0
+                      << std::setw(14) << s.total_ns / 1.0e6 << std::endl;
+            total += s.total_ns;
+        }
+        std::cout << "BENCH_TOTAL_NS " << total << std::endl;                           // Machine-readable total (used by 'make pgo' to report the speedup)
+    }
+
+private:
+    std::map<std::string, StageStats> stats;
+};
+
+struct ScenarioStep {
+    std::string command;
+    std::string argument;
+    std::string extra;
+};
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("[Bench] Could not open " + path);
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+std::vector<ScenarioStep> loadScenario(const std::string& scenario_path) {
+    std::vector<ScenarioStep> steps;
+    std::ifstream file(scenario_path);
+    if (!file.is_open()) {
+        throw std::runtime_error("[Bench] Could not open scenario " + scenario_path);
+    }
+
+    std::string base_dir;
+    size_t slash = scenario_path.find_last_of('/');
+    if (slash != std::string::npos) {
+        base_dir = scenario_path.substr(0, slash + 1);
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream words(line);
+        ScenarioStep step;
+        words >> step.command >> step.argument >> step.extra;
+        if (step.command.empty()) continue;
+        if ((step.command == "reasons" || step.command == "refresh") && !step.argument.empty() && step.argument[0] != '/') {
+            step.argument = base_dir + step.argument;
+        }
+        steps.push_back(step);
+    }
+    return steps;
+}
+
+// A slowly changing board - each refresh a couple of services depart, new ones appear at the end
+// and a few estimated times move. Around 2% of services have no valid time.
+void benchOrdering(BenchTimer& timer, size_t services, int refreshes) {
+    struct SyntheticService {
+        std::string trainid;
+        time_t departure_time;
+    };
+    const time_t invalid_time = 0;
+    std::mt19937 random(76);
+    std::vector<SyntheticService> board;
+    size_t next_service = 0;
+    auto newService = [&]() {
+        time_t departure = 1700000000 + static_cast<time_t>(next_service) * 60;
+        board.push_back({"B" + std::to_string(next_service), (random() % 50 == 0) ? invalid_time : departure});
+        next_service++;
+    };
+    for (size_t i = 0; i < services; i++) newService();
+
+    std::unordered_map<std::string, size_t> index_of;
+    std::vector<time_t> time_list(services);
+    std::vector<size_t> full_sort_order(services);
+    std::vector<size_t> repaired_order(services);
+    std::vector<size_t> previous_to_new_index(services, DepartureOrder::NOT_FOUND);
+    DepartureOrder order;
+    const std::string stage = " (" + std::to_string(services) + ")";
+
+    for (int refresh = 0; refresh < refreshes; refresh++) {
+        size_t departed = std::min<size_t>(random() % 3, board.size());
+        board.erase(board.begin(), board.begin() + departed);
+        while (board.size() < services) newService();
+        for (size_t delays = 0; delays < services / 20; delays++) {
+            SyntheticService& service = board[random() % board.size()];
+            if (service.departure_time != invalid_time) service.departure_time += static_cast<time_t>(random() % 5) * 60;
+        }
+        std::fill(previous_to_new_index.begin(), previous_to_new_index.end(), DepartureOrder::NOT_FOUND);
+        for (size_t i = 0; i < board.size(); i++) {                                     // What the parser's pre-fetch does when it matches TrainIDs
+            auto it = index_of.find(board[i].trainid);
+            if (it != index_of.end()) previous_to_new_index[it->second] = i;
+        }
+        index_of.clear();
+        for (size_t i = 0; i < board.size(); i++) index_of[board[i].trainid] = i;
+
+        // What the parser used to do every refresh
+        timer.time("order: full sort" + stage, [&]() {
+            for (size_t i = 0; i < board.size(); i++) time_list[i] = board[i].departure_time;
+            std::iota(full_sort_order.begin(), full_sort_order.end(), 0);
+            std::sort(full_sort_order.begin(), full_sort_order.end(), [&time_list, invalid_time](size_t a, size_t b) {
+                if (time_list[a] == invalid_time && time_list[b] == invalid_time) return a < b;
+                if (time_list[a] == invalid_time) return false;
+                if (time_list[b] == invalid_time) return true;
+                return time_list[a] < time_list[b];
+            });
+        });
+
+        timer.time("order: repair" + stage, [&]() {
+            order.update(board.size(),
+                         [&previous_to_new_index](size_t previous_index) { return previous_to_new_index[previous_index]; },
+                         [&board](size_t i) { return board[i].departure_time; },
+                         invalid_time, repaired_order);
+        });
+
+        for (size_t i = 0; i < board.size(); i++) {                                     // Same times in the same positions (ties may differ)
+            if (board[full_sort_order[i]].departure_time != board[repaired_order[i]].departure_time) {
+                throw std::runtime_error("[Bench] Repaired departure order doesn't match the full sort");
+            }
+        }
+    }
+}
+
+// Hydration cost against the number of departures shown. Pre-fetch (parse and ordering) is timed separately so the
+// hydration of the selected departures can be compared on its own.
+void benchDepartures(BenchTimer& timer, const std::string& reason_codes, const std::vector<const std::string*>& departure_responses,
+                     size_t max_services, size_t departures, int refreshes) {
+    if (departure_responses.empty() || reason_codes.empty()) {
+        throw std::runtime_error("[Bench] 'departures' needs 'reasons' and 'refresh' responses in the scenario");
+    }
+    TrainServiceParser parser(max_services, departures);
+    parser.loadReasonCodes(reason_codes);
+
+    char stage[32];
+    std::snprintf(stage, sizeof(stage), "hydrate: %02zu departures", departures);
+    for (int refresh = 0; refresh < refreshes; refresh++) {
+        parser.prefetchCache(*departure_responses[refresh % departure_responses.size()], refresh + 1);
+        timer.time(stage, [&]() { parser.hydrateDepartureCache(); });
+    }
+}
+
+// An hour of refreshes with each fetching model. The summary boards and service details are made from the recorded
+// responses - calling points and formation are removed from the board and each service's locations become its details.
+void benchFetchModel(BenchTimer& timer, const std::string& reason_codes, const std::vector<const std::string*>& departure_responses,
+                     size_t max_services, size_t departures, int refresh_seconds) {
+    if (departure_responses.empty() || reason_codes.empty()) {
+        throw std::runtime_error("[Bench] 'fetchmodel' needs 'reasons' and 'refresh' responses in the scenario");
+    }
+
+    struct TwoTierResponses {
+        std::string summary;
+        std::unordered_map<std::string, std::string> details;                           // By RID
+    };
+    std::vector<TwoTierResponses> two_tier_responses;
+    std::string crs;
+    for (const std::string* response : departure_responses) {
+        json board = json::parse(*response);
+        TwoTierResponses responses;
+        crs = board.value("crs", "");
+        for (json& service : board["trainServices"]) {
+            json details = {{"rid", service.value("rid", "")}, {"locations", json::array()}};
+            for (const json& location : service.value("previousLocations", json::array())) details["locations"].push_back(location);
+            details["locations"].push_back({{"crs", crs}, {"locationName", board.value("locationName", "")}});
+            for (const json& location : service.value("subsequentLocations", json::array())) details["locations"].push_back(location);
+            if (service.contains("formation")) details["formation"] = service["formation"];
+            service.erase("previousLocations");
+            service.erase("subsequentLocations");
+            service.erase("formation");
+            responses.details[details["rid"].get<std::string>()] = details.dump();
+        }
+        responses.summary = board.dump();
+        two_tier_responses.push_back(std::move(responses));
+    }
+
+    TrainServiceParser single_call_parser(max_services, departures);
+    TrainServiceParser two_tier_parser(max_services, departures);
+    single_call_parser.loadReasonCodes(reason_codes);
+    two_tier_parser.loadReasonCodes(reason_codes);
+    ServiceDetailsCache details_cache(departures, 0);
+    details_cache.setLocation(crs);
+
+    const int refreshes = 3600 / std::max(1, refresh_seconds);
+    uint64_t single_call_bytes = 0;
+    uint64_t single_call_ns = 0;
+    uint64_t two_tier_ns = 0;
+    int stale_refreshes = 0;
+    for (int refresh = 0; refresh < refreshes; refresh++) {
+        const std::string& full_response = *departure_responses[refresh % departure_responses.size()];
+        const TwoTierResponses& responses = two_tier_responses[refresh % two_tier_responses.size()];
+
+        single_call_bytes += full_response.size();
+        single_call_ns += timer.time("fetch: single call", [&]() { single_call_parser.updateCache(full_response, refresh + 1); });
+        two_tier_ns += timer.time("fetch: two-tier", [&]() {
+            two_tier_parser.updateCache(details_cache.assemble(responses.summary, [&responses](const std::string& rid) { return responses.details.at(rid); }), refresh + 1);
+        });
+
+        size_t first = single_call_parser.getFirstDeparture();                          // Same departures shown
+        if (first != two_tier_parser.getFirstDeparture()) {
+            throw std::runtime_error("[Bench] Two-tier fetching doesn't show the same first departure as the single call");
+        }
+        if (single_call_parser.getCallingPoints(first, TrainServiceParser::SHOWETD) != two_tier_parser.getCallingPoints(first, TrainServiceParser::SHOWETD)) {
+            stale_refreshes++;                                                          // Details re-used because the summary hadn't changed
+        }
+    }
+
+    const ServiceDetailsCache::Stats& details = details_cache.getStats();
+    std::cout << std::setfill(' ') << std::dec << std::fixed << std::setprecision(1)
+              << "[Bench] Fetch model - " << refreshes << " refreshes per hour (every " << refresh_seconds << "s), " << departures << " departures with details" << std::endl
+              << "[Bench]   single call: " << single_call_bytes / 1024.0 << " KB/hour, " << single_call_ns / 1.0e6 << " ms/hour parsing" << std::endl
+              << "[Bench]   two-tier:    " << (details.summary_bytes + details.detail_bytes) / 1024.0 << " KB/hour, " << two_tier_ns / 1.0e6 << " ms/hour parsing"
+              << " (" << details.detail_requests << " detail requests, " << details.detail_cache_hits << " re-used)" << std::endl
+              << "[Bench]   refreshes where the first departure's calling points were older than the single call: " << stale_refreshes << std::endl;
+}
+
+// Calling points for the first three departures in one batch - written into reused display text
+void formatCallingPointLines(TrainServiceParser& parser, const MatrixDriver& matrix, TrainServiceParser::CallingPointETD show_etd,
+                             std::array<DisplayText, 3>& calling_points) {
+    std::array<TrainServiceParser::CallingPointLine, 3> lines = {{
+        {parser.getFirstDeparture(), &calling_points[0].text, 0},
+        {parser.getSecondDeparture(), &calling_points[1].text, 0},
+        {parser.getThirdDeparture(), &calling_points[2].text, 0}
+    }};
+    for (auto& line : calling_points) {
+        line.text.clear();                                                              // Keeps the buffer
+    }
+    parser.formatCallingPoints(lines.data(), lines.size(), show_etd, &matrix.getFontCache().getCharWidths());
+    for (size_t line = 0; line < lines.size(); line++) {
+        calling_points[line].width = lines[line].width;
+    }
+}
+
+// Lay out the rows the same way the departure board does for the first three departures
+void layoutRows(TrainServiceParser& parser, const MatrixDriver& matrix, TrainServiceParser::CallingPointETD show_etd, MatrixDriver::display_rows& rows) {
+
+    MatrixDriver::first_row_data& first = rows.first;
+    MatrixDriver::second_row_data& second = rows.second;
+    MatrixDriver::third_row_data& third = rows.third;
+    MatrixDriver::fourth_row_data& fourth = rows.fourth;
+
+    size_t index_1 = parser.getFirstDeparture();
+    size_t index_2 = parser.getSecondDeparture();
+    size_t index_3 = parser.getThirdDeparture();
+    TrainServiceParser::BasicServiceInfo departure_1 = parser.getBasicServiceInfo(index_1);
+    TrainServiceParser::BasicServiceInfo departure_2 = parser.getBasicServiceInfo(index_2);
+    TrainServiceParser::BasicServiceInfo departure_3 = parser.getBasicServiceInfo(index_3);
+
+    if (index_1 != 999) {
+        first.destination << "Plat " << parser.getPlatform(index_1) << " " << departure_1.scheduledDepartureTime << " " << departure_1.destination;
+        first.estimated_depature_time = departure_1.estimatedDepartureTime;
+        first.coach_info_available = !departure_1.coaches.empty();
+        first.coaches = departure_1.coaches;
+        second.has_calling_points = !departure_1.isCancelled;
+        second.service_message << "A " << departure_1.operator_name << " service. " << parser.getServiceLocation(index_1);
+        if (second.has_calling_points) {
+            TrainServiceParser::CallingPointLine line = {index_1, &second.calling_points.text, 0};
+            parser.formatCallingPoints(&line, 1, show_etd, &matrix.getFontCache().getCharWidths());
+            second.calling_points.width = line.width;
+            second.calling_points_measured = true;
+        }
+    } else {
+        first.destination << "No More Services";
+        first.coach_info_available = false;
+    }
+    if (index_2 != 999) {
+        third.second_departure << "2nd: " << departure_2.scheduledDepartureTime << " " << departure_2.destination;
+        third.second_departure_estimated_departure_time = departure_2.estimatedDepartureTime;
+    }
+    if (index_3 != 999) {
+        third.third_departure << "3rd: " << departure_3.scheduledDepartureTime << " " << departure_3.destination;
+        third.third_departure_estimated_departure_time = departure_3.estimatedDepartureTime;
+    }
+    fourth.message = parser.getNrccMessages();
+    fourth.location = parser.getLocationName();
+}
+
+// Refreshes spread over frames the way the departure board does it with refresh_step_budget_us (single-core boards).
+// The frame gap is the refresh work done before a frame can be rendered. The steps are driven one at a time (a deadline
+// which has already passed) so the longest single step is known - no frame should wait longer than the budget plus that.
+// The time-sliced parser must end up showing the same departures as the one updated in one go.
+void benchTimeSlice(BenchTimer& timer, const std::string& reason_codes, const std::vector<const std::string*>& departure_responses,
+                    MatrixDriver& matrix, TrainServiceParser::CallingPointETD show_etd, size_t max_services, size_t departures,
+                    int budget_us, int refreshes, int64_t& version) {
+    if (departure_responses.empty() || reason_codes.empty()) {
+        throw std::runtime_error("[Bench] 'timeslice' needs 'reasons' and 'refresh' responses in the scenario");
+    }
+    TrainServiceParser whole_parser(max_services, departures);
+    TrainServiceParser sliced_parser(max_services, departures);
+    whole_parser.loadReasonCodes(reason_codes);
+    sliced_parser.loadReasonCodes(reason_codes);
+
+    const std::chrono::microseconds budget(std::max(1, budget_us));
+    uint64_t whole_gap_ns = 0;
+    uint64_t sliced_gap_ns = 0;
+    uint64_t longest_step_ns = 0;
+    size_t frames = 0;
+
+    for (int refresh = 0; refresh < refreshes; refresh++) {
+        const std::string& response = *departure_responses[refresh % departure_responses.size()];
+
+        version++;
+        whole_gap_ns = std::max(whole_gap_ns, timer.time("timeslice: whole refresh", [&]() {
+            whole_parser.updateCache(response, version);
+            layoutRows(whole_parser, matrix, show_etd, matrix.beginUpdate());
+            matrix.commitUpdate(version);
+        }));
+        matrix.render();
+
+        version++;
+        enum { PARSE, LAYOUT, COMMIT, DONE } step = PARSE;
+        sliced_parser.beginUpdate(response, version);
+        while (step != DONE) {
+            auto frame_start = std::chrono::steady_clock::now();
+            auto deadline = frame_start + budget;
+            auto now = frame_start;
+            do {
+                auto step_start = now;
+                if (step == PARSE) {
+                    if (sliced_parser.continueUpdate(step_start) != TrainServiceParser::Status::IN_PROGRESS) step = LAYOUT;   // One step
+                } else if (step == LAYOUT) {
+                    layoutRows(sliced_parser, matrix, show_etd, matrix.beginUpdate());
+                    step = COMMIT;
+                } else {
+                    matrix.commitUpdate(version);
+                    step = DONE;
+                }
+                now = std::chrono::steady_clock::now();
+                longest_step_ns = std::max<uint64_t>(longest_step_ns, std::chrono::duration_cast<std::chrono::nanoseconds>(now - step_start).count());
+            } while (step != DONE && now < deadline);
+
+            uint64_t gap_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - frame_start).count());
+            timer.add("timeslice: frame gap", gap_ns);
+            sliced_gap_ns = std::max(sliced_gap_ns, gap_ns);
+            frames++;
+            matrix.render();
+        }
+
+        size_t first = whole_parser.getFirstDeparture();                                // Same result either way
+        if (first != sliced_parser.getFirstDeparture() ||
+            whole_parser.getSecondDeparture() != sliced_parser.getSecondDeparture() ||
+            whole_parser.getThirdDeparture() != sliced_parser.getThirdDeparture() ||
+            whole_parser.getNrccMessages() != sliced_parser.getNrccMessages() ||
+            whole_parser.getCallingPoints(first, TrainServiceParser::SHOWETD) != sliced_parser.getCallingPoints(first, TrainServiceParser::SHOWETD) ||
+            whole_parser.getServiceLocation(first) != sliced_parser.getServiceLocation(first)) {
+            throw std::runtime_error("[Bench] Time-sliced refresh doesn't show the same departures as the whole refresh");
+        }
+    }
+
+    std::cout << std::setfill(' ') << std::dec << std::fixed << std::setprecision(1)
+              << "[Bench] Time-sliced refresh - " << budget.count() << " us budget, " << refreshes << " refreshes" << std::endl
+              << "[Bench]   whole refresh: longest frame gap " << whole_gap_ns / 1000.0 << " us" << std::endl
+              << "[Bench]   time-sliced:   longest frame gap " << sliced_gap_ns / 1000.0 << " us, longest step " << longest_step_ns / 1000.0
+              << " us, " << static_cast<double>(frames) / std::max(1, refreshes) << " frames per refresh" << std::endl;
+
+    if (sliced_gap_ns > static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(budget).count()) + longest_step_ns) {
+        throw std::runtime_error("[Bench] A time-sliced frame waited longer than the budget plus the longest step");
+    }
+}
+
+// Calling-at queries for every station the services call at. The naive answer walks every service's subsequent calling points
+// (what a filter would do without the index) - the parser answers from its station index. Both must find the same times.
+void benchCallingAt(BenchTimer& timer, const std::string& reason_codes, const std::vector<const std::string*>& departure_responses,
+                    size_t max_services, size_t departures, int refreshes) {
+    if (departure_responses.empty() || reason_codes.empty()) {
+        throw std::runtime_error("[Bench] 'callingat' needs 'reasons' and 'refresh' responses in the scenario");
+    }
+    TrainServiceParser parser(max_services, departures);
+    parser.loadReasonCodes(reason_codes);
+
+    auto timeAt = [](const nlohmann::json& location) {                                  // As the parser indexes it
+        static const char* const keys[][2] = {{"atdSpecified", "atd"}, {"etdSpecified", "etd"}, {"stdSpecified", "std"},
+                                              {"ataSpecified", "ata"}, {"etaSpecified", "eta"}, {"staSpecified", "sta"}};
+        for (const auto& key : keys) {
+            if (location.value(key[0], false)) return StationIndex::timeKey(location.value(key[1], std::string()));
+        }
+        return StationIndex::NO_TIME;
+    };
+    auto departureKey = [](const nlohmann::json& service) {
+        return StationIndex::timeKey(service.value(service.value("etdSpecified", false) ? "etd" : "std", std::string()));
+    };
+    auto hhmm = [](int64_t key) {
+        char text[16];
+        std::snprintf(text, sizeof(text), "%02d:%02d", static_cast<int>(key % 1440 / 60), static_cast<int>(key % 60));
+        return std::string(text, 5);
+    };
+
+    size_t queries = 0;
+    size_t found = 0;
+    for (int refresh = 0; refresh < refreshes; refresh++) {
+        const std::string& response = *departure_responses[refresh % departure_responses.size()];
+        parser.updateCache(response, refresh + 1);
+        const nlohmann::json data = nlohmann::json::parse(response);
+        const nlohmann::json& services = data["trainServices"];
+        size_t number_of_services = std::min(services.size(), max_services);
+
+        std::vector<std::string> stations;
+        for (size_t s = 0; s < number_of_services; s++) {
+            for (const auto& location : services[s].value("subsequentLocations", nlohmann::json::array())) {
+                std::string crs = location.value("crs", std::string());
+                if (!crs.empty() && std::find(stations.begin(), stations.end(), crs) == stations.end()) stations.push_back(crs);
+            }
+        }
+
+        for (const std::string& crs : stations) {
+            int64_t naive_next_departure = StationIndex::NO_TIME;
+            int64_t naive_fastest = StationIndex::NO_TIME;
+            bool naive_found = false;
+            timer.time("callingat: scan services", [&]() {
+                for (size_t s = 0; s < number_of_services; s++) {
+                    if (!services[s].value("stdSpecified", false)) continue;
+                    auto locations = services[s].find("subsequentLocations");
+                    if (locations == services[s].end() || !locations->is_array()) continue;
+                    for (const auto& location : *locations) {
+                        auto location_crs = location.find("crs");
+                        if (location_crs == location.end() || *location_crs != crs) continue;
+                        if (location.value("isPass", false) || location.value("isCancelled", false)) continue;
+                        naive_found = true;
+                        naive_next_departure = std::min(naive_next_departure, departureKey(services[s]));
+                        naive_fastest = std::min(naive_fastest, timeAt(location));
+                    }
+                }
+            });
+
+            TrainServiceParser::CallingAtService next = {999, ""};
+            TrainServiceParser::CallingAtService fastest = {999, ""};
+            timer.time("callingat: station index", [&]() {
+                next = parser.getNextCallingAt(crs);
+                fastest = parser.getFastestTo(crs);
+            });
+
+            queries++;
+            if (next.service_index != 999) found++;
+            if (naive_found != (next.service_index != 999) ||
+                (naive_found && (departureKey(services[next.service_index]) != naive_next_departure ||
+                                 (naive_fastest != StationIndex::NO_TIME && fastest.time != hhmm(naive_fastest))))) {
+                throw std::runtime_error("[Bench] Station index doesn't agree with the calling points for " + crs);
+            }
+        }
+    }
+    std::cout << "[Bench] Calling-at queries - " << queries << " stations queried, " << found << " with a departure" << std::endl;
+}
+
+// Damage a recorded response the ways a bad feed might - each service gets one fault (or none), some responses have
+// the wrong shape (trainServices not an array, or not an object at all) and every fourth is cut short so it isn't
+// valid JSON at all.
+std::string malformedResponse(const std::string& response, size_t variant, std::mt19937& random) {
+    nlohmann::json data = nlohmann::json::parse(response);
+    if (data.contains("trainServices") && data["trainServices"].is_array()) {
+        for (auto& service : data["trainServices"]) {
+            switch (random() % 10) {
+                case 0: service["std"] = 1234; break;                                   // Number for a time
+                case 1: service["std"] = "2026-10-1"; break;                            // Time too short
+                case 2: service["etdSpecified"] = "yes"; service["etd"] = true; break;
+                case 3: service["platform"] = 7; break;
+                case 4: service["destination"] = {{"locationName", 5}}; break;          // Object for an array
+                case 5: service["subsequentLocations"] = nlohmann::json::object(); service["previousLocations"] = "none"; break;
+                case 6: service["cancelReason"] = "x"; service["isCancelled"] = "false"; break;
+                case 7: service["trainid"] = 42; break;
+                case 8: service = nullptr; break;                                       // No service at all
+                default: break;
+            }
+        }
+    }
+    if (variant % 3 == 1) {
+        data["nrccMessages"] = "Not an array";
+        data["locationName"] = 42;
+    }
+    switch (variant % 8) {                                                              // The wrong shape altogether - rejected like bad JSON
+        case 2: data["trainServices"] = {{"service", data["trainServices"]}}; break;    // Object for the array of services
+        case 5: data["trainServices"] = "oops"; break;
+        case 6: data = nlohmann::json::array({data}); break;                            // Array for the whole response
+        default: break;
+    }
+    std::string damaged = data.dump();
+    if (variant % 4 == 3) {
+        damaged.resize(damaged.size() / 2);
+    }
+    return damaged;
+}
+
+// Refreshes with damaged responses. A frame with a refresh is the whole refresh (parse, hydrate, layout, commit) and a
+// render - bad fields are counted and defaulted, and a response which isn't JSON leaves the previous departures showing.
+void benchMalformed(BenchTimer& timer, const std::string& reason_codes, const std::vector<const std::string*>& departure_responses,
+                    MatrixDriver& matrix, TrainServiceParser::CallingPointETD show_etd, size_t max_services, size_t departures,
+                    int refreshes, int64_t& version) {
+    if (departure_responses.empty() || reason_codes.empty()) {
+        throw std::runtime_error("[Bench] 'malformed' needs 'reasons' and 'refresh' responses in the scenario");
+    }
+    TrainServiceParser parser(max_services, departures);
+    parser.loadReasonCodes(reason_codes);
+
+    std::mt19937 random(83);
+    std::vector<std::string> damaged;
+    for (int refresh = 0; refresh < refreshes; refresh++) {
+        damaged.push_back(malformedResponse(*departure_responses[refresh % departure_responses.size()], refresh, random));
+    }
+
+    uint64_t longest_frame_ns = 0;
+    size_t rejected = 0;
+    for (int refresh = 0; refresh < refreshes; refresh++) {
+        version++;
+        longest_frame_ns = std::max(longest_frame_ns, timer.time("malformed: refresh frame", [&]() {
+            if (parser.updateCache(damaged[refresh], version) != TrainServiceParser::Status::OK) {
+                rejected++;
+                return;
+            }
+            layoutRows(parser, matrix, show_etd, matrix.beginUpdate());
+            matrix.commitUpdate(version);
+            matrix.render();
+        }));
+        for (int frame = 0; frame < 10; frame++) {
+            longest_frame_ns = std::max(longest_frame_ns, timer.time("malformed: frame", [&]() { matrix.render(); }));
+        }
+    }
+
+    const TrainServiceParser::ErrorCounters errors = parser.getErrorCounters();
+    size_t unreadable = 0;                                                              // Cut short or the wrong shape
+    for (int refresh = 0; refresh < refreshes; refresh++) {
+        if (refresh % 4 == 3 || refresh % 8 == 2 || refresh % 8 == 5 || refresh % 8 == 6) unreadable++;
+    }
+    if (rejected < unreadable || errors.parse_errors < unreadable) {
+        throw std::runtime_error("[Bench] Only " + std::to_string(rejected) + " of " + std::to_string(unreadable) + " unreadable responses were rejected");
+    }
+    std::cout << std::setfill(' ') << std::dec << std::fixed << std::setprecision(1)
+              << "[Bench] Malformed responses - " << refreshes << " refreshes, " << rejected << " rejected" << std::endl
+              << "[Bench]   longest frame " << longest_frame_ns / 1000.0 << " us" << std::endl
+              << "[Bench]   errors: " << errors.parse_errors << " parse, " << errors.index_out_of_range << " index out of range, "
+              << errors.service_mismatch << " service mismatch, " << errors.no_service << " missing service, "
+              << errors.field_type_errors << " field type, " << errors.bad_times << " bad times" << std::endl;
+}
+
+// Refreshes the way a multi-core departure board does them. The fetch is a FETCH task (a short sleep stands in for the
+// network), the parse a DATA task and the layout a FRAME task - the loop renders a frame each time round and commits the
+// rows when the layout is done. The frame is only the render and the checks, the commit and any waiting for a worker on a
+// single-core machine. Both parsers must end up showing the same departures. Then the tasks still queued when an executor
+// shuts down must be dropped - their futures broken, not left waiting.
+void benchExecutor(BenchTimer& timer, const std::string& reason_codes, const std::vector<const std::string*>& departure_responses,
+                   MatrixDriver& matrix, TrainServiceParser::CallingPointETD show_etd, size_t max_services, size_t departures,
+                   int refreshes, int64_t& version) {
+    if (departure_responses.empty() || reason_codes.empty()) {
+        throw std::runtime_error("[Bench] 'executor' needs 'reasons' and 'refresh' responses in the scenario");
+    }
+    TrainServiceParser whole_parser(max_services, departures);
+    TrainServiceParser worker_parser(max_services, departures);
+    whole_parser.loadReasonCodes(reason_codes);
+    worker_parser.loadReasonCodes(reason_codes);
+    TaskExecutor executor(0, -1);
+
+    uint64_t whole_frame_ns = 0;
+    uint64_t worker_frame_ns = 0;
+    size_t frames = 0;
+
+    for (int refresh = 0; refresh < refreshes; refresh++) {
+        const std::string& response = *departure_responses[refresh % departure_responses.size()];
+
+        version++;
+        whole_frame_ns = std::max(whole_frame_ns, timer.time("executor: whole refresh", [&]() {
+            whole_parser.updateCache(response, version);
+            layoutRows(whole_parser, matrix, show_etd, matrix.beginUpdate());
+            matrix.commitUpdate(version);
+            matrix.render();
+        }));
+
+        version++;
+        std::string fetched;
+        std::future<void> fetch = executor.submit(TaskExecutor::Lane::FETCH, [&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            fetched = response;
+        });
+        std::future<TrainServiceParser::Status> parse;
+        std::future<void> layout;
+        enum { FETCH, PARSE, LAYOUT, DONE } step = FETCH;
+        while (step != DONE) {
+            worker_frame_ns = std::max(worker_frame_ns, timer.time("executor: frame", [&]() {
+                if (step == FETCH && fetch.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                    fetch.get();
+                    if (worker_parser.beginUpdate(fetched, version) != TrainServiceParser::Status::IN_PROGRESS) {
+                        throw std::runtime_error("[Bench] The executor's refresh couldn't start");
+                    }
+                    parse = executor.submit(TaskExecutor::Lane::DATA, [&]() { return worker_parser.continueUpdate(std::chrono::steady_clock::time_point::max()); });
+                    step = PARSE;
+                } else if (step == PARSE && parse.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                    if (parse.get() != TrainServiceParser::Status::OK) {
+                        throw std::runtime_error("[Bench] The executor's parse failed");
+                    }
+                    layout = executor.submit(TaskExecutor::Lane::FRAME, [&]() { layoutRows(worker_parser, matrix, show_etd, matrix.beginUpdate()); });
+                    step = LAYOUT;
+                } else if (step == LAYOUT && layout.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                    layout.get();
+                    matrix.commitUpdate(version);
+                    step = DONE;
+                }
+                matrix.render();
+            }));
+            frames++;
+        }
+
+        size_t first = whole_parser.getFirstDeparture();                                // Same result either way
+        if (first != worker_parser.getFirstDeparture() ||
+            whole_parser.getSecondDeparture() != worker_parser.getSecondDeparture() ||
+            whole_parser.getThirdDeparture() != worker_parser.getThirdDeparture() ||
+            whole_parser.getNrccMessages() != worker_parser.getNrccMessages() ||
+            whole_parser.getCallingPoints(first, TrainServiceParser::SHOWETD) != worker_parser.getCallingPoints(first, TrainServiceParser::SHOWETD)) {
+            throw std::runtime_error("[Bench] The executor's refresh doesn't show the same departures as the whole refresh");
+        }
+    }
+
+    std::cout << std::setfill(' ') << std::dec << std::fixed << std::setprecision(1)
+              << "[Bench] Task executor - " << executor.size() << " workers on " << TaskExecutor::coreCount() << " cores, " << refreshes << " refreshes" << std::endl
+              << "[Bench]   whole refresh: longest frame " << whole_frame_ns / 1000.0 << " us" << std::endl
+              << "[Bench]   executor:      longest frame " << worker_frame_ns / 1000.0 << " us, "
+              << static_cast<double>(frames) / std::max(1, refreshes) << " frames per refresh" << std::endl;
+    const TaskExecutor::Metrics metrics = executor.getMetrics();
+    for (size_t lane = 0; lane < TaskExecutor::LANES; lane++) {
+        const TaskExecutor::LaneMetrics& m = metrics[lane];
+        std::cout << "[Bench]   " << std::left << std::setw(6) << TaskExecutor::laneName(static_cast<TaskExecutor::Lane>(lane)) << std::right
+                  << m.completed << " tasks (" << m.stolen << " stolen), max queue " << m.max_queue_depth << ", waited "
+                  << m.total_wait_ns / 1000.0 / std::max<uint64_t>(m.completed, 1) << " us mean / " << m.max_wait_ns / 1000.0 << " us max, ran "
+                  << m.total_run_ns / 1000.0 / std::max<uint64_t>(m.completed, 1) << " us mean" << std::endl;
+    }
+
+    TaskExecutor stopping(1, -1);                                                       // Tasks still queued at shutdown, or posted after it, are dropped
+    std::promise<void> started;
+    std::future<void> running = stopping.submit(TaskExecutor::Lane::DATA, [&]() {
+        started.set_value();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    started.get_future().wait();
+    std::vector<std::future<void>> queued;
+    for (int task = 0; task < 3; task++) {
+        queued.push_back(stopping.submit(TaskExecutor::Lane::DATA, []() {}));
+    }
+    stopping.shutdown();
+    queued.push_back(stopping.submit(TaskExecutor::Lane::DATA, []() {}));
+    running.get();
+    size_t dropped = 0;
+    for (std::future<void>& task : queued) {
+        if (task.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            throw std::runtime_error("[Bench] A task queued at shutdown was left without a result");
+        }
+        try {
+            task.get();
+        } catch (const std::future_error& e) {
+            if (e.code() == std::future_errc::broken_promise) dropped++;
+        }
+    }
+    if (dropped != queued.size()) {
+        throw std::runtime_error("[Bench] Only " + std::to_string(dropped) + " of " + std::to_string(queued.size()) + " tasks queued at shutdown were dropped");
+    }
+    std::cout << "[Bench]   shutdown: " << dropped << " queued tasks dropped" << std::endl;
+}
+
+// A canvas which records what was pushed to it - to check it against the framebuffer
+class CheckCanvas : public Canvas {
+public:
+    CheckCanvas(int width, int height) : canvas_width(width), colours(static_cast<size_t>(width) * height, Color(0, 0, 0)) {}
+    int width() const override { return canvas_width; }
+    int height() const override { return static_cast<int>(colours.size()) / canvas_width; }
+    void SetPixel(int x, int y, uint8_t red, uint8_t green, uint8_t blue) override { colours[static_cast<size_t>(y) * canvas_width + x] = Color(red, green, blue); }
+    void Clear() override {}
+    void Fill(uint8_t, uint8_t, uint8_t) override {}
+    const Color& at(int x, int y) const { return colours[static_cast<size_t>(y) * canvas_width + x]; }
+private:
+    int canvas_width;
+    std::vector<Color> colours;
+};
+
+// The first pixel where the canvas doesn't show the framebuffer through its palette - false if it matches
+bool staleCanvasPixel(const PaletteFramebuffer& framebuffer, const CheckCanvas& canvas, int& stale_x, int& stale_y) {
+    for (int y = 0; y < canvas.height(); y++) {
+        for (int x = 0; x < canvas.width(); x++) {
+            const Color& expected = framebuffer.getPalette()[framebuffer.getIndex(x, y)];
+            const Color& shown = canvas.at(x, y);
+            if (shown.r != expected.r || shown.g != expected.g || shown.b != expected.b) {
+                stale_x = x;
+                stale_y = y;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// The display as rendered - pixels pushed per frame (the text that moved) against the whole matrix, and the two frames
+// after a theme swap which push every pixel. Then random drawing into a framebuffer pushed to two canvases in turn (as
+// SwapOnVSync does) - each canvas must match the framebuffer through the palette after every push.
+void benchPalette(BenchTimer& timer, MatrixDriver& matrix, const std::string& theme, int width, int height, int frames) {
+    size_t pushed = matrix.getPixelsPushed();
+    for (int frame = 0; frame < frames; frame++) {
+        timer.time("palette: frame", [&]() { matrix.render(); });
+    }
+    size_t frame_pixels = matrix.getPixelsPushed() - pushed;
+
+    matrix.setTheme(theme == "amber" ? "white" : "amber");
+    pushed = matrix.getPixelsPushed();
+    for (int frame = 0; frame < 2; frame++) {
+        timer.time("palette: theme swap frame", [&]() { matrix.render(); });
+    }
+    size_t swap_pixels = matrix.getPixelsPushed() - pushed;
+    matrix.setTheme(theme);
+    matrix.render();
+    matrix.render();
+
+    PaletteFramebuffer framebuffer(width, height);
+    std::array<CheckCanvas, 2> canvases = {CheckCanvas(width, height), CheckCanvas(width, height)};
+    std::mt19937 random(87);
+    const std::array<const char*, 3> themes = {"white", "amber", "mono"};
+    for (int frame = 0; frame < 200; frame++) {
+        for (int shape = 0; shape < 8; shape++) {
+            int x = static_cast<int>(random() % static_cast<unsigned>(width + 16)) - 8;
+            int y = static_cast<int>(random() % static_cast<unsigned>(height + 16)) - 8;
+            uint8_t index = static_cast<uint8_t>(random() % 5);
+            if (random() % 2) {
+                framebuffer.fill(x, y, x + static_cast<int>(random() % 40), y + static_cast<int>(random() % 12), index);
+            } else {
+                framebuffer.SetPixel(x, y, index, 0, 0);
+            }
+        }
+        if (frame % 50 == 49) {
+            PaletteFramebuffer::Palette palette;
+            PaletteFramebuffer::themePalette(themes[static_cast<size_t>(frame / 50) % themes.size()], palette);
+            framebuffer.setPalette(palette);
+        }
+        CheckCanvas& canvas = canvases[static_cast<size_t>(frame) % 2];
+        timer.time("palette: push (random drawing)", [&]() { framebuffer.push(&canvas); });
+        int x, y;
+        if (staleCanvasPixel(framebuffer, canvas, x, y)) {
+            throw std::runtime_error("[Bench] Palette push left pixel (" + std::to_string(x) + "," + std::to_string(y) + ") stale on frame " + std::to_string(frame));
+        }
+    }
+
+    double matrix_pixels = static_cast<double>(width) * height;
+    std::cout << std::setfill(' ') << std::dec << std::fixed << std::setprecision(1)
+              << "[Bench] Palette framebuffer - " << width << "x" << height << ", theme " << theme << std::endl
+              << "[Bench]   " << frames << " frames: " << static_cast<double>(frame_pixels) / std::max(1, frames) << " pixels pushed per frame ("
+              << 100.0 * static_cast<double>(frame_pixels) / std::max(1, frames) / matrix_pixels << "% of the matrix)" << std::endl
+              << "[Bench]   theme swap: " << static_cast<double>(swap_pixels) / 2 << " pixels pushed per frame for 2 frames" << std::endl
+              << "[Bench]   200 frames of random drawing pushed to two canvases in turn - both match the framebuffer" << std::endl;
+}
+
+// Frames shown on a simulated panel refreshing at refresh_hz - the swap returns at the next refresh, as SwapOnVSync does.
+// Swapped in the render loop and then on the presenter's thread (present_thread), where the next frame is composed while
+// the last waits - compose, push and the vsync wait the render loop sees are reported for each. The canvas handed back at
+// the end must match the framebuffer once pushed.
+void benchPresent(BenchTimer& timer, MatrixDriver& matrix, int width, int height, int frames, int refresh_hz) {
+    const std::chrono::nanoseconds refresh_period(1000000000LL / std::max(1, refresh_hz));
+
+    for (bool pipelined : {false, true}) {
+        const std::string mode = pipelined ? "pipelined" : "in render loop";
+        PaletteFramebuffer framebuffer(width, height);
+        std::array<CheckCanvas, 2> canvases = {CheckCanvas(width, height), CheckCanvas(width, height)};
+        const auto epoch = std::chrono::steady_clock::now();
+        FramePresenter presenter(&canvases[0], [&](Canvas* shown) -> Canvas* {
+            auto refreshes = (std::chrono::steady_clock::now() - epoch) / refresh_period + 1;  // The next refresh
+            std::this_thread::sleep_until(epoch + refreshes * refresh_period);
+            return shown == &canvases[0] ? &canvases[1] : &canvases[0];
+        }, pipelined);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++) {
+            auto compose_start = std::chrono::steady_clock::now();
+            timer.time("present: compose (" + mode + ")", [&]() {
+                matrix.render();
+                framebuffer.setPacked(matrix.getFramebuffer().getPacked());
+            });
+            presenter.countCompose(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - compose_start).count()));
+            timer.time("present: push + swap (" + mode + ")", [&]() { presenter.present(framebuffer); });
+        }
+        presenter.finish();
+        double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        CheckCanvas* returned = static_cast<CheckCanvas*>(presenter.getCanvas());
+        framebuffer.push(returned);
+        int x, y;
+        if (staleCanvasPixel(framebuffer, *returned, x, y)) {
+            throw std::runtime_error("[Bench] Presented canvas left pixel (" + std::to_string(x) + "," + std::to_string(y) + ") stale (" + mode + ")");
+        }
+
+        const FramePresenter::Metrics m = presenter.getMetrics();
+        uint64_t shown = std::max<uint64_t>(m.frames, 1);
+        std::cout << std::setfill(' ') << std::dec << std::fixed << std::setprecision(1)
+                  << "[Bench] Frames presented " << mode << " - " << width << "x" << height << ", " << m.frames << " frames on a " << refresh_hz << " Hz panel, "
+                  << elapsed_ms / std::max(1, frames) << " ms a frame" << std::endl
+                  << "[Bench]   compose " << m.total_compose_ns / 1000.0 / shown << " us, push " << m.total_push_ns / 1000.0 / shown << " us ("
+                  << m.pixels_pushed / shown << " pixels), vsync wait " << m.total_wait_ns / 1000.0 / shown << " us of a "
+                  << m.total_swap_ns / 1000.0 / shown << " us swap - the render loop busy or waiting "
+                  << (m.total_compose_ns + m.total_push_ns + m.total_wait_ns) / 1000.0 / shown << " us a frame" << std::endl;
+    }
+}
+
+// The board pushed to chained panels through a led-pixel-mapper chain - as drawn (no mapper), through the table built once
+// (PixelMapperLUT, as the driver does) and through the mapper chain for every pixel. The table and the chain must leave
+// the panels the same.
+void benchMapper(BenchTimer& timer, MatrixDriver& matrix, const Config& config, const std::string& mapper_config, int frames) {
+    const int chain = config.getIntWithDefault("matrixchain_length", 3);
+    const int parallel = config.getIntWithDefault("matrixparallel", 1);
+    const int panel_width = config.getIntWithDefault("matrixcols", 128) * chain;
+    const int panel_height = config.getIntWithDefault("matrixrows", 64) * parallel;
+
+    PixelMapperLUT lut;
+    bool built = false;
+    timer.time("mapper: build table", [&]() { built = lut.build(mapper_config, panel_width, panel_height, chain, parallel); });
+    if (!built) {
+        std::cout << "[Bench] led-pixel-mapper '" << mapper_config << "' can't be mapped by table for " << chain << " x " << parallel << " panels - skipped" << std::endl;
+        return;
+    }
+
+    class ChainCanvas : public Canvas {                                                 // Each pixel through the mapper chain as it's set
+    public:
+        ChainCanvas(const PixelMapperLUT& lut, Canvas& panels) : lut(lut), panels(panels) {}
+        int width() const override { return lut.width(); }
+        int height() const override { return lut.height(); }
+        void SetPixel(int x, int y, uint8_t red, uint8_t green, uint8_t blue) override {
+            int panel_x, panel_y;
+            lut.map(x, y, panel_x, panel_y);
+            panels.SetPixel(panel_x, panel_y, red, green, blue);
+        }
+        void Clear() override {}
+    private:
+        const PixelMapperLUT& lut;
+        Canvas& panels;
+    };
+
+    const int width = lut.width();
+    const int height = lut.height();
+    PaletteFramebuffer plain(width, height), tabled(width, height), chained(width, height);
+    CheckCanvas plain_canvas(width, height), table_panels(panel_width, panel_height), chain_panels(panel_width, panel_height);
+    ChainCanvas chain_canvas(lut, chain_panels);
+    const PaletteFramebuffer& board = matrix.getFramebuffer();
+    size_t pixels = 0;
+
+    for (int frame = 0; frame < frames; frame++) {
+        matrix.render();
+        for (int y = 0; y < std::min(height, board.height()); y++) {                   // The board as far as it fits the mapped shape
+            for (int x = 0; x < std::min(width, board.width()); x++) {
+                uint8_t index = board.getIndex(x, y);
+                plain.SetPixel(x, y, index, 0, 0);
+                tabled.SetPixel(x, y, index, 0, 0);
+                chained.SetPixel(x, y, index, 0, 0);
+            }
+        }
+        timer.time("mapper: push as drawn", [&]() { pixels += plain.push(&plain_canvas); });
+        timer.time("mapper: push through table", [&]() { tabled.push(&table_panels, &lut); });
+        timer.time("mapper: push through chain", [&]() { chained.push(&chain_canvas); });
+    }
+
+    for (int y = 0; y < panel_height; y++) {
+        for (int x = 0; x < panel_width; x++) {
+            const Color& table = table_panels.at(x, y);
+            const Color& chain_pixel = chain_panels.at(x, y);
+            if (table.r != chain_pixel.r || table.g != chain_pixel.g || table.b != chain_pixel.b) {
+                throw std::runtime_error("[Bench] Mapper table and chain differ at panel pixel (" + std::to_string(x) + "," + std::to_string(y) + ")");
+            }
+        }
+    }
+    std::cout << std::setfill(' ') << std::dec << std::fixed << std::setprecision(1)
+              << "[Bench] led-pixel-mapper '" << mapper_config << "' - " << width << "x" << height << " onto " << panel_width << "x" << panel_height << " panels, "
+              << static_cast<double>(pixels) / std::max(1, frames) << " pixels pushed per frame - the table and the chain leave the panels the same" << std::endl;
+}
+
+// The device calibration as --calibrate runs it - reports what it measured and the profile it would write, then checks
+// the result applies under the settings config.txt gives
+void benchCalibrate(BenchTimer& timer, const Config& config, MatrixDriver& matrix) {
+    DeviceCalibration::Result result;
+    timer.time("calibrate: whole calibration", [&]() { result = DeviceCalibration::calibrate(config, &matrix); });
+
+    std::cout << "[Bench] Device calibration" << std::endl;
+    for (const std::string& note : result.notes) {
+        std::cout << "[Bench]   " << note << std::endl;
+    }
+    std::cout << "[Bench]   html_neon_threshold=" << result.html_neon_threshold
+              << " text_width_cache_entries=" << result.text_width_cache_entries
+              << " gpio_slowdown=" << result.gpio_slowdown
+              << " calling_point_slowdown=" << result.calling_point_slowdown
+              << " nrcc_message_slowdown=" << result.nrcc_message_slowdown << std::endl;
+
+    Config tuned = config;                                                              // Applied as a board does if the profile can't be written
+    tuned.set("gpio_slowdown", "3");                                                    // As if config.txt set it - that wins
+    for (const auto& setting : DeviceCalibration::profileSettings(result)) {
+        tuned.setFromDeviceProfile(setting.first, setting.second);
+    }
+    if (tuned.getInt("gpio_slowdown") != 3 || tuned.get("text_width_cache_entries") != std::to_string(result.text_width_cache_entries)) {
+        throw std::runtime_error("[Bench] The calibration wasn't applied under config.txt's settings");
+    }
+}
+
+// A board's frames streamed to a receiver on another thread over loopback, as departureboard_receiver shows them.
+// Frames are sent as fast as they render (no vsync) - a receiver which falls behind has frames dropped.
+void benchStream(BenchTimer& timer, MatrixDriver& matrix, int frames) {
+    FrameStream::FrameHeader oversized;                                                 // A key frame header too big for any panels - the receiver mustn't allocate it
+    oversized.type = FrameStream::KEY_FRAME;
+    oversized.width = 65535;
+    oversized.height = 65535;
+    uint8_t header_bytes[FrameStream::HEADER_BYTES];
+    FrameStream::writeHeader(oversized, header_bytes);
+    if (FrameStream::readHeader(header_bytes, oversized)) {
+        throw std::runtime_error("[Bench] The receiver accepted a 65535 x 65535 frame");
+    }
+
+    FrameStream::FrameReceiver receiver(0, -1);
+    FrameStream::FrameSender sender("127.0.0.1:" + std::to_string(receiver.port()), 0, 300);
+
+    std::atomic<bool> sending(true);
+    OffscreenCanvas display(matrix.getFramebuffer().width(), matrix.getFramebuffer().height());
+    std::thread receiving([&]() {
+        while (true) {
+            if (receiver.receive(std::chrono::milliseconds(50))) {
+                receiver.getFramebuffer().push(&display);
+                receiver.acknowledge();
+            } else if (!sending.load()) {
+                break;                                                                  // Nothing more is coming
+            }
+        }
+    });
+
+    auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (sender.connected() == 0 && std::chrono::steady_clock::now() < give_up) {
+        sender.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (sender.connected() == 0) {
+        sending = false;
+        receiving.join();
+        throw std::runtime_error("[Bench] The frame sender couldn't connect over loopback");
+    }
+
+    for (int frame = 0; frame < frames; frame++) {
+        timer.time("stream: render + send", [&]() {
+            matrix.render();
+            sender.send(matrix.getFramebuffer());
+        });
+    }
+    give_up = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (sender.queued() > 0 && std::chrono::steady_clock::now() < give_up) {       // Let the receiver catch up, then a last frame (a key frame if any were dropped)
+        sender.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    matrix.render();
+    sender.send(matrix.getFramebuffer());
+    give_up = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (sender.queued() > 0 && std::chrono::steady_clock::now() < give_up) {
+        sender.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    sending = false;
+    receiving.join();
+    sender.poll();                                                                      // The last acks
+
+    if (!receiver.hasFrame() || receiver.getFramebuffer().getPacked() != matrix.getFramebuffer().getPacked()) {
+        throw std::runtime_error("[Bench] The receiver's frame doesn't match the board's");
+    }
+
+    const FrameStream::FrameSender::Metrics sent = sender.getMetrics();
+    const FrameStream::FrameReceiver::Metrics& received = receiver.getMetrics();
+    size_t packed_bytes = matrix.getFramebuffer().getPacked().size();
+    std::cout << std::setfill(' ') << std::dec << std::fixed << std::setprecision(1)
+              << "[Bench] Frame streaming over loopback - " << sent.frames << " frames, " << sent.key_frames << " key frames, " << sent.dropped << " dropped" << std::endl
+              << "[Bench]   " << static_cast<double>(sent.bytes) / std::max<uint64_t>(sent.sent, 1) << " bytes a frame (max " << sent.max_frame_bytes << ") against "
+              << packed_bytes << " packed / " << static_cast<size_t>(matrix.getFramebuffer().width()) * matrix.getFramebuffer().height() * 3 << " RGB" << std::endl
+              << "[Bench]   encoding " << sent.total_encode_ns / 1000.0 / std::max<uint64_t>(sent.frames, 1) << " us mean, decoding "
+              << received.total_decode_ns / 1000.0 / std::max<uint64_t>(received.frames, 1) << " us mean (" << received.frames << " frames applied)" << std::endl
+              << "[Bench]   latency to the receiver's ack " << sent.total_latency_ns / 1000.0 / std::max<uint64_t>(sent.acks, 1) << " us mean / "
+              << sent.max_latency_ns / 1000.0 << " us max (" << sent.acks << " acks)" << std::endl;
+}
+
+// The departure history log. Refreshes parsed with and without the log - the log should cost the parser next to
+// nothing - then four weeks of a synthetic board logged a refresh every two minutes and summarised. The summary is
+// checked against the delays logged, and a log reopened on the same day mustn't append services which haven't changed.
+void benchHistory(BenchTimer& timer, const std::string& reason_codes, const std::vector<const std::string*>& departure_responses,
+                  size_t max_services, size_t departures, int refreshes, int64_t& version) {
+    if (departure_responses.empty() || reason_codes.empty()) {
+        throw std::runtime_error("[Bench] 'history' needs 'reasons' and 'refresh' responses in the scenario");
+    }
+    char directory_template[] = "/tmp/departure_history_XXXXXX";
+    if (mkdtemp(directory_template) == nullptr) {
+        throw std::runtime_error("[Bench] Couldn't create a directory for the history logs");
+    }
+    const std::string directory = directory_template;
+    const std::time_t now = std::time(nullptr);
+
+    {
+        DepartureHistory history(directory, "PARSE");
+        TrainServiceParser plain_parser(max_services, departures);
+        TrainServiceParser logged_parser(max_services, departures);
+        plain_parser.loadReasonCodes(reason_codes);
+        logged_parser.loadReasonCodes(reason_codes);
+        logged_parser.setHistory(&history);
+        for (int refresh = 0; refresh < refreshes; refresh++) {
+            const std::string& response = *departure_responses[refresh % departure_responses.size()];
+            version++;
+            timer.time("history: parse (no log)", [&]() { plain_parser.updateCache(response, version); });
+            timer.time("history: parse (logged)", [&]() { logged_parser.updateCache(response, version); });
+        }
+        timer.time("history: flush", [&]() { history.flush(); });
+        const DepartureHistory::Metrics m = history.getMetrics();
+        std::cout << std::setfill(' ') << std::dec << std::fixed << std::setprecision(1)
+                  << "[Bench] History of " << refreshes << " refreshes - " << m.records << " records of " << m.observations << " services seen, writing "
+                  << m.total_write_ns / 1000.0 / std::max<uint64_t>(m.refreshes, 1) << " us a refresh on the writer thread" << std::endl;
+        unlink(DepartureHistory::logName(directory, "PARSE", now).c_str());
+    }
+
+    // Four weeks of 150 departures (06:00 to 20:54, every 6 minutes). Estimates from half an hour before; some are cancelled
+    const int days = 28;
+    const int services = 150;
+    auto finalDelay = [](int day, int service) { return (service * 7 + day * 3) % 11 + (service % 13 == 0 ? 25 : 0); };
+    auto isCancelled = [](int day, int service) { return (service + day) % 37 == 0; };
+    const std::time_t noon = DepartureHistory::dayStart(now) + 12 * 3600;
+    std::vector<std::time_t> day_starts;
+    {
+        DepartureHistory history(directory, "BENCH");
+        for (int day = 0; day < days; day++) {
+            const std::time_t day_start = DepartureHistory::dayStart(noon - static_cast<std::time_t>(days - 1 - day) * 86400);
+            day_starts.push_back(day_start);
+            for (std::time_t observed = day_start + 5 * 3600; observed < day_start + 22 * 3600; observed += 120) {
+                std::vector<DepartureHistory::Observation> observations;
+                for (int service = 0; service < services; service++) {
+                    const std::time_t scheduled = day_start + 6 * 3600 + service * 360;
+                    const int delay = finalDelay(day, service);
+                    if (observed > scheduled + delay * 60 || observed < scheduled - 2 * 3600) continue;     // Gone, or not on the board yet
+                    DepartureHistory::Observation observation;
+                    observation.rid = std::to_string(202600000000000LL + day * 1000 + service);
+                    observation.trainid = "1A" + std::to_string(10 + service % 90);
+                    observation.destination = service % 3 == 0 ? "London Kings Cross" : (service % 3 == 1 ? "Cambridge" : "Peterborough");
+                    observation.platform = std::to_string(1 + service % 4);
+                    observation.std = scheduled;
+                    observation.cancelled = isCancelled(day, service) && observed >= scheduled - 1800;
+                    observation.etd = observed >= scheduled - 1800 && !observation.cancelled ? scheduled + delay * 60 : 0;
+                    observation.reason = observation.cancelled ? 100 : (delay > 0 ? 101 : 0);
+                    observations.push_back(std::move(observation));
+                }
+                history.record(observed, std::move(observations));
+            }
+            timer.time("history: day written", [&]() { history.flush(); });
+        }
+    }
+
+    // Reopened today - every service is unchanged, so nothing is appended
+    {
+        DepartureHistory history(directory, "BENCH");
+        std::vector<DepartureHistory::Observation> observations;
+        for (int service = 0; service < services; service++) {
+            DepartureHistory::Observation observation;
+            observation.rid = std::to_string(202600000000000LL + (days - 1) * 1000 + service);
+            observation.trainid = "1A" + std::to_string(10 + service % 90);
+            observation.platform = std::to_string(1 + service % 4);
+            observation.std = day_starts.back() + 6 * 3600 + service * 360;
+            observation.cancelled = isCancelled(days - 1, service);
+            observation.etd = observation.cancelled ? 0 : observation.std + finalDelay(days - 1, service) * 60;
+            observation.reason = observation.cancelled ? 100 : (finalDelay(days - 1, service) > 0 ? 101 : 0);
+            observations.push_back(std::move(observation));
+        }
+        history.record(day_starts.back() + 23 * 3600, std::move(observations));
+        history.flush();
+        if (history.getMetrics().records != 0) {
+            throw std::runtime_error("[Bench] The reopened history log appended " + std::to_string(history.getMetrics().records) + " unchanged services");
+        }
+    }
+
+    // A rid longer than the log keeps must still match after a restart, and a second board mustn't write to an open log
+    {
+        DepartureHistory::Observation observation;
+        observation.rid = std::string(40, '7');
+        observation.trainid = "1Z99";
+        observation.std = now;
+        observation.etd = now + 120;
+        for (int restart = 0; restart < 2; restart++) {
+            DepartureHistory history(directory, "LONG");
+            history.record(now, {observation});
+            history.flush();
+            if (history.getMetrics().records != (restart == 0 ? 1u : 0u)) {
+                throw std::runtime_error("[Bench] The history log didn't match a long rid after a restart");
+            }
+            if (restart == 1) {
+                DepartureHistory second(directory, "LONG");
+                second.record(now, {observation});
+                second.flush();
+                if (second.getMetrics().dropped != 1) {
+                    throw std::runtime_error("[Bench] Two boards wrote the same history log");
+                }
+            }
+        }
+        unlink(DepartureHistory::logName(directory, "LONG", now).c_str());
+    }
+
+    std::vector<std::string> logs;
+    std::vector<DepartureHistory::ServiceStatistics> statistics;
+    uint64_t records = 0;
+    uint64_t query_ns = timer.time("history: query 28 days", [&]() {
+        logs = DepartureHistory::findLogs(directory, "BENCH", now, days);
+        records = DepartureHistory::summarise(logs, statistics);
+    });
+    if (logs.size() != static_cast<size_t>(days) || statistics.size() != static_cast<size_t>(services)) {
+        throw std::runtime_error("[Bench] The history summary found " + std::to_string(statistics.size()) + " services in " + std::to_string(logs.size()) + " logs");
+    }
+    for (int service = 0; service < services; service++) {
+        const DepartureHistory::ServiceStatistics& summary = statistics[static_cast<size_t>(service)];
+        uint32_t cancelled = 0;
+        double total = 0;
+        size_t ran = 0;
+        for (int day = 0; day < days; day++) {
+            if (isCancelled(day, service)) {
+                cancelled++;
+            } else {
+                total += finalDelay(day, service);
+                ran++;
+            }
+        }
+        if (summary.scheduled_minute != 360 + service * 6 || summary.days != static_cast<uint32_t>(days) || summary.cancelled != cancelled ||
+            summary.delays.size() != ran || std::abs(summary.meanDelay() - total / static_cast<double>(ran)) > 1e-9) {
+            throw std::runtime_error("[Bench] The history summary of the " + std::to_string(summary.scheduled_minute) + " minute departure doesn't match the delays logged");
+        }
+    }
+    std::cout << "[Bench] History query - " << records << " records of " << statistics.size() << " services in " << logs.size() << " daily logs summarised in "
+              << query_ns / 1.0e6 << " ms" << std::endl;
+
+    for (const std::string& log : logs) {
+        unlink(log.c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+// Large boards - every service in the responses is parsed and its calling points built, so the cost grows with the
+// board rather than stopping at max_services. The NRCC messages go through the HTML processor as the parser uses it.
+void benchStress(BenchTimer& timer, const std::string& reason_codes, const std::vector<const std::string*>& departure_responses,
+                 size_t departures, int refreshes) {
+    if (departure_responses.empty() || reason_codes.empty()) {
+        throw std::runtime_error("[Bench] 'stress' needs 'reasons' and 'refresh' responses in the scenario");
+    }
+
+    size_t max_services = 1;                                                            // Sized for the largest board
+    size_t response_bytes = 0;
+    std::vector<std::vector<std::string>> messages;                                     // Each response's NRCC messages (extracted outside the timing)
+    for (const std::string* response : departure_responses) {
+        const nlohmann::json data = nlohmann::json::parse(*response, nullptr, false);
+        std::vector<std::string> response_messages;
+        if (data.is_object()) {
+            auto services = data.find("trainServices");
+            if (services != data.end() && services->is_array()) max_services = std::max(max_services, services->size());
+            auto nrcc = data.find("nrccMessages");
+            if (nrcc != data.end() && nrcc->is_array()) {
+                for (const auto& message : *nrcc) {
+                    auto text = message.find("xhtmlMessage");
+                    if (text != message.end() && text->is_string()) response_messages.push_back(text->get<std::string>());
+                }
+            }
+        }
+        messages.push_back(std::move(response_messages));
+        response_bytes += response->size();
+    }
+
+    TrainServiceParser parser(max_services, departures);
+    parser.loadReasonCodes(reason_codes);
+    HTMLProcessor html_processor;
+
+    size_t calling_point_bytes = 0;
+    size_t message_bytes = 0;
+    for (int refresh = 0; refresh < refreshes; refresh++) {
+        size_t response = static_cast<size_t>(refresh) % departure_responses.size();
+        timer.time("stress: prefetch", [&]() { parser.prefetchCache(*departure_responses[response], refresh + 1); });
+        timer.time("stress: hydrate", [&]() { parser.hydrateDepartureCache(); });
+        timer.time("stress: calling points", [&]() {
+            for (size_t service = 0; service < parser.getNumberOfServices(); service++) {
+                calling_point_bytes += parser.getCallingPoints(service, TrainServiceParser::SHOWETD).size();
+            }
+        });
+        timer.time("stress: nrcc html", [&]() {
+            for (const std::string& message : messages[response]) {
+                message_bytes += html_processor.processHtmlTags(message).size();
+            }
+        });
+    }
+
+    std::cout << std::setfill(' ') << std::dec << std::fixed << std::setprecision(1)
+              << "[Bench] Stress - " << refreshes << " refreshes of up to " << max_services << " services ("
+              << response_bytes / departure_responses.size() / 1024.0 << " KB responses)" << std::endl
+              << "[Bench]   calling points " << calling_point_bytes / std::max(1, refreshes) / 1024.0 << " KB and NRCC text "
+              << message_bytes / std::max(1, refreshes) << " bytes per refresh" << std::endl;
+}
+
+void showUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [OPTIONS] --scenario FILE\n"
+              << "Options:\n"
+              << "  -f, --config FILE         Configuration file (font, matrix size and layout)\n"
+              << "  -s, --scenario FILE       Scenario of recorded responses and frames to replay\n"
+              << "  -i, --iterations N        Number of times to replay the scenario (default 1)\n"
+              << "  -d, --debug               Enable debug output\n"
+              << "  -h, --help                Show this help message\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string config_file = "./config.txt";
+    std::string scenario_file;
+    int iterations = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "-f" || arg == "--config") && i + 1 < argc) {
+            config_file = argv[++i];
+        } else if ((arg == "-s" || arg == "--scenario") && i + 1 < argc) {
+            scenario_file = argv[++i];
+        } else if ((arg == "-i" || arg == "--iterations") && i + 1 < argc) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-d" || arg == "--debug") {
+            debug_mode = true;
+        } else {
+            showUsage(argv[0]);
+            return (arg == "-h" || arg == "--help") ? 0 : 1;
+        }
+    }
+
+    if (scenario_file.empty()) {
+        showUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        Config config;
+        config.loadFromFile(config_file);
+        config.set("headless", "true");                                                 // Never touch the GPIO from the benchmark
+        if (!debug_mode) {
+            config.set("debug_mode", "false");
+        }
+
+        std::vector<ScenarioStep> steps = loadScenario(scenario_file);
+
+        TrainServiceParser parser(config.getIntWithDefault("max_services", 10), config.getIntWithDefault("max_departures", 3));
+        MatrixDriver matrix(config);
+        TrainServiceParser::CallingPointETD show_etd = config.getBool("ShowCallingPointETD") ? TrainServiceParser::SHOWETD : TrainServiceParser::NOETD;
+
+        std::array<DisplayText, 3> calling_point_lines;
+
+        std::map<std::string, std::string> responses;                                   // Responses are read once so file I/O isn't measured
+        for (const auto& step : steps) {
+            if ((step.command == "reasons" || step.command == "refresh") && responses.find(step.argument) == responses.end()) {
+                responses[step.argument] = readFile(step.argument);
+            }
+        }
+
+        std::string reason_codes;                                                       // Most recent 'reasons' and all the 'refresh' responses - for the 'departures' benchmark
+        std::vector<const std::string*> departure_responses;
+        for (const auto& step : steps) {
+            if (step.command == "reasons") reason_codes = responses[step.argument];
+            if (step.command == "refresh") departure_responses.push_back(&responses[step.argument]);
+        }
+
+        BenchTimer timer;
+        int64_t version = 0;
+
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            for (const auto& step : steps) {
+                if (step.command == "reasons") {
+                    timer.time("reason codes", [&]() { parser.loadReasonCodes(responses[step.argument]); });
+
+                } else if (step.command == "refresh") {
+                    version++;
+                    timer.time("parse + hydrate", [&]() { parser.updateCache(responses[step.argument], version); });
+                    timer.time("calling points (3)", [&]() { formatCallingPointLines(parser, matrix, show_etd, calling_point_lines); });
+                    timer.time("layout", [&]() { layoutRows(parser, matrix, show_etd, matrix.beginUpdate()); });
+                    timer.time("row commit", [&]() { matrix.commitUpdate(version); });
+
+                } else if (step.command == "render") {
+                    int frames = std::atoi(step.argument.c_str());
+                    for (int frame = 0; frame < frames; frame++) {
+                        timer.time("render frame", [&]() { matrix.render(); });
+                    }
+
+                } else if (step.command == "ordering") {
+                    benchOrdering(timer, std::max(1, std::atoi(step.argument.c_str())), std::atoi(step.extra.c_str()));
+
+                } else if (step.command == "fetchmodel") {
+                    benchFetchModel(timer, reason_codes, departure_responses, config.getIntWithDefault("max_services", 10),
+                                    config.getIntWithDefault("max_departures", 3), std::atoi(step.argument.c_str()));
+
+                } else if (step.command == "timeslice") {
+                    benchTimeSlice(timer, reason_codes, departure_responses, matrix, show_etd, config.getIntWithDefault("max_services", 10),
+                                   config.getIntWithDefault("max_departures", 3), std::atoi(step.argument.c_str()), std::atoi(step.extra.c_str()), version);
+
+                } else if (step.command == "callingat") {
+                    benchCallingAt(timer, reason_codes, departure_responses, config.getIntWithDefault("max_services", 10),
+                                   config.getIntWithDefault("max_departures", 3), std::atoi(step.argument.c_str()));
+
+                } else if (step.command == "malformed") {
+                    benchMalformed(timer, reason_codes, departure_responses, matrix, show_etd, config.getIntWithDefault("max_services", 10),
+                                   config.getIntWithDefault("max_departures", 3), std::atoi(step.argument.c_str()), version);
+
+                } else if (step.command == "executor") {
+                    benchExecutor(timer, reason_codes, departure_responses, matrix, show_etd, config.getIntWithDefault("max_services", 10),
+                                  config.getIntWithDefault("max_departures", 3), std::atoi(step.argument.c_str()), version);
+
+                } else if (step.command == "palette") {
+                    benchPalette(timer, matrix, config.get("colour_theme"),
+                                 config.getIntWithDefault("matrixcols", 128) * config.getIntWithDefault("matrixchain_length", 3),
+                                 config.getIntWithDefault("matrixrows", 64) * config.getIntWithDefault("matrixparallel", 1),
+                                 std::atoi(step.argument.c_str()));
+
+                } else if (step.command == "stream") {
+                    benchStream(timer, matrix, std::atoi(step.argument.c_str()));
+
+                } else if (step.command == "present") {
+                    benchPresent(timer, matrix, config.getIntWithDefault("matrixcols", 128) * config.getIntWithDefault("matrixchain_length", 3),
+                                 config.getIntWithDefault("matrixrows", 64) * config.getIntWithDefault("matrixparallel", 1),
+                                 std::atoi(step.argument.c_str()), step.extra.empty() ? 120 : std::atoi(step.extra.c_str()));
+
+                } else if (step.command == "mapper") {
+                    benchMapper(timer, matrix, config, step.extra, std::atoi(step.argument.c_str()));
+
+                } else if (step.command == "calibrate") {
+                    benchCalibrate(timer, config, matrix);
+
+                } else if (step.command == "history") {
+                    benchHistory(timer, reason_codes, departure_responses, config.getIntWithDefault("max_services", 10),
+                                 config.getIntWithDefault("max_departures", 3), std::atoi(step.argument.c_str()), version);
+
+                } else if (step.command == "stress") {
+                    benchStress(timer, reason_codes, departure_responses, config.getIntWithDefault("max_departures", 3),
+                                std::atoi(step.argument.c_str()));
+
+                } else if (step.command == "departures") {
+                    benchDepartures(timer, reason_codes, departure_responses, config.getIntWithDefault("max_services", 10),
+                                    std::max(1, std::atoi(step.argument.c_str())), std::atoi(step.extra.c_str()));
+
+                } else {
+                    std::cerr << "[Bench] Unknown scenario command: " << step.command << std::endl;
+                }
+            }
+        }
+
+        timer.report();
+
+    } catch (const std::exception& e) {
+        std::cerr << "[Bench] Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -36,16 +36,65 @@ void Config::loadFromFile(const std::string& filename) {
         if (!key.empty()) {
             // Set the value, even if it's empty - we'll handle fallbacks in get()
             settings[key] = value;
+            if (!value.empty()) {
+                overridden.insert(key);
+            }
             DEBUG_PRINT("Config: Loaded config: " << key << " = " << (value.empty() ? "<empty>" : value));
         }
     }
     
+    size_t slash = filename.find_last_of('/');
+    config_directory = slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+    
     // Clear cache after loading new configuration
     clearCache();
     
     DEBUG_PRINT("[Config: Configuration loaded successfully] from " << filename);
 }
 
+// Relative paths in a config file are from its directory, not wherever the board was started from
+std::string Config::resolvePath(const std::string& path) const {
+    if (path.empty() || path[0] == '/' || config_directory.empty()) {
+        return path;
+    }
+    return config_directory + path;
+}
+
+// A device profile (see DeviceCalibration) has the same format as config.txt. Its values are used for the keys
+// config.txt leaves out (or leaves empty) - config.txt and the command line always win.
+bool Config::loadDeviceProfile(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        DEBUG_PRINT("[Config] No device profile at " << filename);
+        return false;
+    }
+    
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        
+        size_t pos = line.find('=');
+        if (pos == std::string::npos) continue;
+        
+        std::string key = trim(line.substr(0, pos));
+        std::string value = trim(line.substr(pos + 1));
+        setFromDeviceProfile(key, value);
+    }
+    return true;
+}
+
+void Config::setFromDeviceProfile(const std::string& key, const std::string& value) {
+    if (key.empty() || value.empty() || defaults.find(key) == defaults.end()) return;
+    
+    if (overridden.count(key)) {
+        DEBUG_PRINT("[Config] Device profile " << key << " = " << value << " - using config.txt's " << settings[key]);
+    } else {
+        settings[key] = value;
+        value_cache.erase(key);
+        DEBUG_PRINT("[Config] Device profile " << key << " = " << value);
+    }
+}
+
 std::string Config::get(const std::string& key) const {
     // First check the cache
     auto cache_it = value_cache.find(key);
@@ -67,7 +116,7 @@ std::string Config::get(const std::string& key) const {
                 result = default_it->second;
             } else {
                 // Both settings and defaults have empty values
-                if (key == "platform" || key == "led-pixel-mapper" || key == "led-panel-type") {
+                if (key == "platform" || key == "calling_at" || key == "stream_to" || key == "history_dir" || key == "led-pixel-mapper" || key == "led-panel-type") {
                     // These keys are allowed to be empty
                     result = "";
                 } else {
@@ -157,6 +206,9 @@ bool Config::getBoolWithDefault(const std::string& key, bool defaultValue) const
 
 void Config::set(const std::string& key, const std::string& value) {
     settings[key] = value;
+    if (!value.empty()) {
+        overridden.insert(key);
+    }
     // Clear cache entry if it exists
     value_cache.erase(key);
     DEBUG_PRINT("[Config] Set config: " << key << " = " << value);
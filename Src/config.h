@@ -11,6 +11,7 @@
 
 #include <led-matrix.h>
 #include <map>
+#include <set>
 #include <string>
 #include <fstream>
 #include <stdexcept>
@@ -32,6 +33,8 @@ using namespace rgb_matrix;
 class Config {
 private:
     std::map<std::string, std::string> settings;
+    std::set<std::string> overridden;                   // Keys given a value in a config file or by set() - a device profile doesn't change them
+    std::string config_directory;                       // Of the last config file loaded - relative paths in it are from here
     
     const std::map<std::string, std::string> defaults = {
         {"location", ""},
@@ -42,13 +45,23 @@ private:
         {"calling_point_slowdown", "8000"},
         {"nrcc_message_slowdown", "10000"},
         {"refresh_interval_seconds", "60"},
+        {"two_tier_fetch", "false"},
+        {"detail_departures", "3"},
+        {"detail_max_age_seconds", "300"},
+        {"device_profile", "device_profile.txt"},   // Tuned values for this Pi - written by 'departureboard --calibrate' (settings in config.txt win). Relative to the config file
+        {"auto_calibrate", "true"},             // Calibrate at startup if there's no device profile yet
+        {"html_neon_threshold", "64"},          // NRCC messages at least this long use the NEON HTML processor
+        {"text_width_cache_entries", "256"},    // Text widths cached by the font cache
+        {"refresh_step_budget_us", "2000"},     // Time per frame for a data refresh (parse, hydration, layout) - 0 does the whole refresh in one frame
+        {"worker_threads", "0"},                // Background workers (fetch, parse, layout) - 0 sizes them from the cores
+        {"render_core", "-1"},                  // Core the workers keep off - -1 the last core of a 4-core Pi (the matrix refresh thread), -2 none
         {"Message_Refresh_interval", "20"},
         {"matrixcols", "128"},
         {"matrixrows", "64"},
         {"matrixchain_length", "3"},
         {"matrixparallel", "1"},
         {"matrixhardware_mapping", ""},         // WARNING - setting adafruit-hat-pwm here is not over-ridden with a blank in the config file (important if you're using multiple adapters).
-        {"gpio_slowdown", "4"},
+        {"gpio_slowdown", "2"},                 // What config.txt used to set - the device profile sets it from the model of Pi
         {"first_line_y", "18"},
         {"second_line_y", "38"},
         {"third_line_y", "58"},
@@ -59,7 +72,18 @@ private:
         {"ShowCallingPointETD", "Yes"},
         {"ShowMessages", "Yes"},
         {"ShowPlatforms", "Yes"},
+        {"present_thread", "true"},             // Swap frames on vsync on their own thread - the next frame is drawn while the last waits
+        {"colour_theme", "white"},              // white, amber or mono - on time green, delayed amber, cancelled red (mono - all white)
         {"platform", ""},
+        {"calling_at", ""},                    // Show only departures calling at this station (CRS code)
+        {"headless", "false"},
+        {"stream_to", ""},                      // Send the frames to departureboard_receiver nodes - host:port[,host:port]
+        {"stream_board", "0"},                  // Board number in the streamed frames
+        {"stream_key_frame_interval", "300"},   // A whole frame every this many frames (the rest are changes)
+        {"stream_frame_rate", "60"},            // Frames a second for a headless board - streamed or not (no vsync to keep time)
+        {"stream_port", "7878"},                // Port departureboard_receiver listens on
+        {"receiver_board", "-1"},               // Board departureboard_receiver shows - -1 any
+        {"history_dir", ""},                    // Log how each departure ran here (departureboard_history reads it) - empty for no log
         
         // Debug
         {"debug_mode", "true"},
@@ -119,6 +143,9 @@ public:
     Config();
 
     void loadFromFile(const std::string& filename);
+    bool loadDeviceProfile(const std::string& filename);  // Tuned values for this device, under anything set in config.txt - false if there's no profile
+    void setFromDeviceProfile(const std::string& key, const std::string& value);  // One tuned value - ignored if config.txt sets it
+    std::string resolvePath(const std::string& path) const;  // A relative path from the config file's directory (device_profile)
     
     // Define matrix_options struct here to avoid circular dependency
     struct matrix_options {
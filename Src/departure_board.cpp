@@ -19,8 +19,10 @@ api_config{
     cfg.getStringWithDefault("debug_log_dir", "/tmp")                                               // debug_log_dir
 },
 api_client(api_config),                                                                             // Pass config to APIClient
+details_cache(cfg.getIntWithDefault("detail_departures", 3), cfg.getIntWithDefault("detail_max_age_seconds", 300)),
 parser(10, 3),                                                                                      // max_services=10, max_departures=3
-matrix(cfg)                                                                                         // Pass config to MatrixDriver
+matrix(cfg),                                                                                        // Pass config to MatrixDriver
+executor(cfg.getIntWithDefault("worker_threads", 0), cfg.getIntWithDefault("render_core", -1))      // Background workers
 {
     debug_mode = board_config.getBoolWithDefault("debug_mode", false);
     DEBUG_PRINT("[Departure_Board] constructor: Initializing components");
@@ -37,8 +39,10 @@ api_config{
     cfg.getStringWithDefault("debug_log_dir", "/tmp")
 },
 api_client(api_config),
+details_cache(cfg.getIntWithDefault("detail_departures", 3), cfg.getIntWithDefault("detail_max_age_seconds", 300)),
 parser(cfg.getIntWithDefault("max_services", 10), cfg.getIntWithDefault("max_departures", 3)),
-matrix(cfg)
+matrix(cfg),
+executor(cfg.getIntWithDefault("worker_threads", 0), cfg.getIntWithDefault("render_core", -1))
 {
     debug_mode = board_config.getBoolWithDefault("debug_mode", false);
     DEBUG_PRINT("[Departure_Board] constructor: Initializing with explicit API keys");
@@ -49,14 +53,8 @@ DepartureBoard::~DepartureBoard() {
     if (is_running) {
         stop();
     }
-  
-    if (api_thread.joinable()) {                                                                    // Clean up the API thread if it's still running
-        try {
-            api_thread.join();
-        } catch (const std::exception& e) {
-            std::cerr << "Error joining API thread in destructor: " << e.what() << std::endl;
-        }
-    }
+    
+    executor.shutdown();                                                                            // Wait for a fetch still running
     
     DEBUG_PRINT("[DepartureBoard destructor] Cleanup complete");
 }
@@ -82,7 +80,16 @@ void DepartureBoard::initialiseAPI(){
         
         refdata = api_client.fetchReasonCodes();
         location_code = board_config.get("location");
-        departures = api_client.fetchDepartures(location_code);
+        
+        two_tier_fetch = board_config.getBoolWithDefault("two_tier_fetch", false);
+        details_cache.setLocation(location_code);
+        details_cache.setPlatform(board_config.get("platform"));
+        last_fetch_report = std::chrono::steady_clock::now();
+        report_start_requests = api_client.getRequestCount();
+        report_start_bytes = api_client.getBytesReceived();
+        DEBUG_PRINT("   [Departure_Board] Two-tier fetching (summary board + service details): " << two_tier_fetch);
+        
+        departures = fetchDepartureData();
         api_data_version = api_client.getCurrentAPIVersion();
         
         data_refresh_interval = board_config.getInt("refresh_interval_seconds");
@@ -109,7 +116,26 @@ void DepartureBoard::initialiseParser(){
             DEBUG_PRINT("   [Departure_Board] Parser initialisation: Platform set to " << selected_platform);
         }
         
-        parser.createFromJSON(departures, refdata, api_data_version);
+        parser.setHtmlNeonThreshold(static_cast<size_t>(std::max(0, board_config.getIntWithDefault("html_neon_threshold", 64))));   // Tuned per device (device profile)
+        
+        if(!board_config.get("calling_at").empty()){
+            parser.setCallingAt(board_config.get("calling_at"));
+            DEBUG_PRINT("   [Departure_Board] Parser initialisation: Showing departures calling at " << board_config.get("calling_at"));
+            if (two_tier_fetch) {
+                std::cerr << "[Departure_Board] calling_at needs every service's calling points - with two_tier_fetch only the departures with details are found" << std::endl;
+            }
+        }
+        
+        if(!board_config.get("history_dir").empty()){
+            std::string board_name = location_code + (selected_platform.empty() ? "" : "_" + selected_platform);
+            history = std::make_unique<DepartureHistory>(board_config.get("history_dir"), board_name);
+            parser.setHistory(history.get());
+            DEBUG_PRINT("   [Departure_Board] Parser initialisation: Logging departures in " << board_config.get("history_dir"));
+        }
+        
+        if (parser.createFromJSON(departures, refdata, api_data_version) != TrainServiceParser::Status::OK) {
+            std::cerr << "[Departure_Board] Error configuring Parser - the initial departure data couldn't be read" << std::endl;
+        }
         DEBUG_PRINT("[Departure_Board] Parser initialised with Delay/Cancel data and initial Departure information");
 
     } catch(const std::exception& e) {
@@ -122,6 +148,10 @@ void DepartureBoard::initialiseDisplay(){
         DEBUG_PRINT("[Departure_Board] Initialising Display");
         
         is_running = false;
+        refresh_step = RefreshStep::IDLE;
+        refresh_step_budget = std::chrono::microseconds(std::max(0, board_config.getIntWithDefault("refresh_step_budget_us", 2000)));
+        background_refresh = TaskExecutor::coreCount() > 1;                                             // A single core would share the time with the display anyway
+        DEBUG_PRINT("   [Departure_Board] " << executor.size() << " background workers. Refreshes parsed " << (background_refresh ? "by the workers" : "between frames"));
         show_platforms = board_config.getBool("ShowPlatforms");
         location = parser.getLocationName();
         if(board_config.getBool("ShowCallingPointETD")) {
@@ -140,116 +170,227 @@ void DepartureBoard::initialiseDisplay(){
 
 void DepartureBoard::updateDisplay(){
     
-    try {
-        DEBUG_PRINT("[Departure_Board] Updating display");
+    DEBUG_PRINT("[Departure_Board] Updating display");
+    buildRows();
+    
+    matrix.commitUpdate(api_data_version);                                                              // Measured and swapped in - all rows together
+    
+    /*matrix.debugPrintFirstRowData();
+    matrix.debugPrintSecondRowData();
+    matrix.debugPrintThirdRowData();
+    matrix.debugPrintFourthRowData();*/
+    
+    DEBUG_PRINT("[Departure_Board] Pushing data to the Matrix Driver complete");
+}
+
+// Build the rows from the extracted departures. Only the back buffer is touched - this can run on a worker while
+// the current rows are rendered. commitUpdate() must be called from the render loop.
+void DepartureBoard::buildRows(){
+    
+    MatrixDriver::display_rows& rows = matrix.beginUpdate();                                            // Build straight into the driver's back buffer (cleared)
+    MatrixDriver::first_row_data& first_row_data = rows.first;
+    MatrixDriver::second_row_data& second_row_data = rows.second;
+    MatrixDriver::third_row_data& third_row_data = rows.third;
+    MatrixDriver::fourth_row_data& fourth_row_data = rows.fourth;
+    
+    if (departure_1_index != 999) {                                                                     // If there's a first departure, there may be others.
         
-        first_row_data.destination.reset();
-        first_row_data.coaches.reset();
-        second_row_data.calling_points.reset();
-        second_row_data.has_calling_points = true;
-        second_row_data.service_message.reset();
-        third_row_data.second_departure.reset();
-        third_row_data.third_departure.reset();
+        if(show_platforms) {
+            first_row_data.destination << "Plat " << parser.getPlatform(departure_1_index) << " ";
+        }
         
-        if (departure_1_index != 999) {                                                                     // If there's a first departure, there may be others.
-            
-            if(show_platforms) {
-                first_row_data.destination << "Plat " << parser.getPlatform(departure_1_index) << " ";
-            }
+        if(departure_1.coaches.empty()) {
+            first_row_data.coach_info_available = false;
+        } else {
+            first_row_data.coach_info_available = true;
+            first_row_data.coaches = departure_1.coaches;
+        }
+        
+        if(departure_1.isCancelled){
+            first_row_data.destination << departure_1.scheduledDepartureTime << " " << departure_1.destination;
+            first_row_data.estimated_depature_time = "Cancelled";
+            first_row_data.coach_info_available = false;
+            second_row_data.has_calling_points = false;
+            second_row_data.service_message = departure_1.cancelReason;
+        } else {
             
-            if(departure_1.coaches.empty()) {
-                first_row_data.coach_info_available = false;
-            } else {
-                first_row_data.coach_info_available = true;
-                first_row_data.coaches = departure_1.coaches;
-            }
+            first_row_data.destination << departure_1.scheduledDepartureTime << " " << departure_1.destination;
+            first_row_data.estimated_depature_time = departure_1.estimatedDepartureTime;
             
-            if(departure_1.isCancelled){
-                first_row_data.destination << departure_1.scheduledDepartureTime << " " << departure_1.destination;
-                first_row_data.estimated_depature_time = "Cancelled";
-                first_row_data.coach_info_available = false;
-                second_row_data.has_calling_points = false;
-                second_row_data.service_message = departure_1.cancelReason;
-            } else {
-                
-                first_row_data.destination << departure_1.scheduledDepartureTime << " " << departure_1.destination;
-                first_row_data.estimated_depature_time = departure_1.estimatedDepartureTime;
-                
-                if (!departure_1.coaches.empty()) {
-                    if (!departure_1.operator_name.empty()) {
-                        second_row_data.service_message << "A " << departure_1.operator_name << " service formed of " << departure_1.coaches << " coaches. " << departure_1.delayReason;
-                    } else {
-                        second_row_data.service_message << "A " << departure_1.coaches << " coach service. ";
-                    }
+            if (!departure_1.coaches.empty()) {
+                if (!departure_1.operator_name.empty()) {
+                    second_row_data.service_message << "A " << departure_1.operator_name << " service formed of " << departure_1.coaches << " coaches. " << departure_1.delayReason;
                 } else {
-                    if (!departure_1.operator_name.empty()) {
-                        second_row_data.service_message << "A " << departure_1.operator_name << " service. ";
-                    } 
+                    second_row_data.service_message << "A " << departure_1.coaches << " coach service. ";
                 }
-                
-                second_row_data.service_message << "  " << parser.getServiceLocation(departure_1_index);
-                second_row_data.calling_points << parser.getCallingPoints(departure_1_index, show_calling_point_etd);
+            } else {
+                if (!departure_1.operator_name.empty()) {
+                    second_row_data.service_message << "A " << departure_1.operator_name << " service. ";
+                } 
             }
             
-            DEBUG_PRINT("   [Departure_Board] Service Message: " << second_row_data.service_message);
-            DEBUG_PRINT("   [Departure_Board] Has calling points: " << second_row_data.has_calling_points << ". Calling points: " << second_row_data.calling_points);
+            second_row_data.service_message << "  " << parser.getServiceLocation(departure_1_index);
             
-            if(departure_2_index != 999) {
-                third_row_data.second_departure << "2nd: ";
-                if(show_platforms) {
-                    third_row_data.second_departure << "Plat " << parser.getPlatform(departure_2_index) << " ";
-                }
-                third_row_data.second_departure << departure_2.scheduledDepartureTime << " " << departure_2.destination;
-                third_row_data.second_departure_estimated_departure_time = departure_2.estimatedDepartureTime;
-            }
-            
-            if(departure_3_index != 999) {
-                third_row_data.third_departure << "3rd: ";
-                if(show_platforms) {
-                    third_row_data.third_departure << "Plat " << parser.getPlatform(departure_3_index) << " ";
-                }
-                third_row_data.third_departure << departure_3.scheduledDepartureTime << " " << departure_3.destination;
-                third_row_data.third_departure_estimated_departure_time = departure_3.estimatedDepartureTime;
-            } else {
-                if(departure_2_index != 999) {
-                    third_row_data.third_departure = third_row_data.second_departure;
-                    third_row_data.third_departure_estimated_departure_time = third_row_data.second_departure_estimated_departure_time;
-                }
-            }
-        } else {
-            first_row_data.destination << "No More Services";
-            first_row_data.coach_info_available = false;
+            // Calling points are written straight into the display text and measured as they're built
+            TrainServiceParser::CallingPointLine calling_point_line = {departure_1_index, &second_row_data.calling_points.text, 0};
+            parser.formatCallingPoints(&calling_point_line, 1, show_calling_point_etd, &matrix.getFontCache().getCharWidths());
+            second_row_data.calling_points.width = calling_point_line.width;
+            second_row_data.calling_points_measured = true;
         }
-        DEBUG_PRINT("  [Departure_Board] Pushing data to the Matrix Driver");
-        fourth_row_data.message = parser.getNrccMessages();
-        fourth_row_data.location = location;
-        
-        first_row_data.api_version = api_data_version;
-        second_row_data.api_version = api_data_version;
-        third_row_data.api_version = api_data_version;
-        fourth_row_data.api_version = api_data_version;
         
-        matrix.updateFirstRow(first_row_data);
-        matrix.updateSecondRow(second_row_data);
-        matrix.updateThirdRow(third_row_data);
-        matrix.updateFourthRow(fourth_row_data);
+        DEBUG_PRINT("   [Departure_Board] Service Message: " << second_row_data.service_message);
+        DEBUG_PRINT("   [Departure_Board] Has calling points: " << second_row_data.has_calling_points << ". Calling points: " << second_row_data.calling_points);
         
-        /*matrix.debugPrintFirstRowData();
-        matrix.debugPrintSecondRowData();
-        matrix.debugPrintThirdRowData();
-        matrix.debugPrintFourthRowData();*/
+        if(departure_2_index != 999) {
+            third_row_data.second_departure << "2nd: ";
+            if(show_platforms) {
+                third_row_data.second_departure << "Plat " << parser.getPlatform(departure_2_index) << " ";
+            }
+            third_row_data.second_departure << departure_2.scheduledDepartureTime << " " << departure_2.destination;
+            third_row_data.second_departure_estimated_departure_time = departure_2.estimatedDepartureTime;
+        }
         
-        DEBUG_PRINT("[Departure_Board] Pushing data to the Matrix Driver complete");
-    } catch(const std::exception& e) {
-        std::cerr << "[Departure_Board] Error updating Display" << e.what() << std::endl;
+        if(departure_3_index != 999) {
+            third_row_data.third_departure << "3rd: ";
+            if(show_platforms) {
+                third_row_data.third_departure << "Plat " << parser.getPlatform(departure_3_index) << " ";
+            }
+            third_row_data.third_departure << departure_3.scheduledDepartureTime << " " << departure_3.destination;
+            third_row_data.third_departure_estimated_departure_time = departure_3.estimatedDepartureTime;
+        } else {
+            if(departure_2_index != 999) {
+                third_row_data.third_departure = third_row_data.second_departure;
+                third_row_data.third_departure_estimated_departure_time = third_row_data.second_departure_estimated_departure_time;
+            }
+        }
+    } else {
+        first_row_data.destination << "No More Services";
+        first_row_data.coach_info_available = false;
     }
+    DEBUG_PRINT("  [Departure_Board] Pushing data to the Matrix Driver");
+    fourth_row_data.message = parser.getNrccMessages();
+    fourth_row_data.location = location;
 }
 
+// The whole refresh in one go - parse, hydrate and lay out the display
 void DepartureBoard::refreshData() {
     
     DEBUG_PRINT("[Departure_board] Initialising parser cache refresh");
+    beginRefresh();
+    continueRefresh(std::chrono::steady_clock::time_point::max());
+}
+
+// Start a refresh with the latest departures. The work is done by continueRefresh - a step at a time between frames.
+// The display keeps showing the previous data until the new rows are committed in the last step.
+void DepartureBoard::beginRefresh() {
     
-    parser.updateCache(departures, api_data_version);
+    if (parser.beginUpdate(departures, api_data_version) != TrainServiceParser::Status::IN_PROGRESS) {
+        return;
+    }
+    if (background_refresh) {                                                                           // The whole parse on a worker - nothing else uses the parser until it's done
+        background_parse = executor.submit(TaskExecutor::Lane::DATA, [this]() {
+            auto parse_start = std::chrono::steady_clock::now();
+            TrainServiceParser::Status status = parser.continueUpdate(std::chrono::steady_clock::time_point::max());
+            parse_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - parse_start).count();
+            return status;
+        });
+        refresh_step = RefreshStep::BACKGROUND_PARSE;
+    } else {
+        refresh_step = RefreshStep::PARSE;
+    }
+}
+
+// Work on the refresh until the deadline (at least one step)
+// PARSE   - the parser's update (JSON, pre-fetch, commit and hydration - each in small steps)
+// EXTRACT - the next departures from the parser
+// LAYOUT  - build the rows and swap them onto the display
+// On multi-core boards the parse (BACKGROUND_PARSE) and the extract and row layout (BACKGROUND_LAYOUT) are done by the
+// workers - the frames carry on until they're finished and then the rows are committed.
+bool DepartureBoard::continueRefresh(std::chrono::steady_clock::time_point deadline) {
+    
+    do {
+        switch (refresh_step) {
+            case RefreshStep::PARSE: {
+                auto parse_start = std::chrono::steady_clock::now();
+                TrainServiceParser::Status status = parser.continueUpdate(deadline);
+                parse_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - parse_start).count();
+                if (status == TrainServiceParser::Status::OK) {
+                    refresh_step = RefreshStep::EXTRACT;
+                } else if (status != TrainServiceParser::Status::IN_PROGRESS) {                                     // Bad data - keep showing the previous departures
+                    std::cerr << "[Departure_board] Departure data couldn't be read - keeping the previous departures" << std::endl;
+                    refresh_step = RefreshStep::IDLE;
+                }
+                break;
+            }
+            case RefreshStep::EXTRACT:
+                extractDepartures();
+                refresh_step = RefreshStep::LAYOUT;
+                break;
+            case RefreshStep::LAYOUT:
+                updateDisplay();
+                reportDataErrors();
+                refresh_step = RefreshStep::IDLE;
+                break;
+            case RefreshStep::BACKGROUND_PARSE: {
+                if (!backgroundTaskDone(background_parse, deadline)) {
+                    return false;                                                                                   // Render - check again next frame
+                }
+                refresh_step = RefreshStep::IDLE;                                                                   // Until the result is known (get() may throw)
+                if (background_parse.get() == TrainServiceParser::Status::OK) {
+                    background_layout = executor.submit(TaskExecutor::Lane::FRAME, [this]() {
+                        extractDepartures();
+                        buildRows();
+                    });
+                    refresh_step = RefreshStep::BACKGROUND_LAYOUT;
+                } else {
+                    std::cerr << "[Departure_board] Departure data couldn't be read - keeping the previous departures" << std::endl;
+                }
+                break;
+            }
+            case RefreshStep::BACKGROUND_LAYOUT:
+                if (!backgroundTaskDone(background_layout, deadline)) {
+                    return false;
+                }
+                refresh_step = RefreshStep::IDLE;
+                background_layout.get();
+                matrix.commitUpdate(api_data_version);                                                              // Measured and swapped in - all rows together
+                reportDataErrors();
+                break;
+            case RefreshStep::IDLE:
+                break;
+        }
+    } while (refresh_step != RefreshStep::IDLE && std::chrono::steady_clock::now() < deadline);
+    
+    return refresh_step == RefreshStep::IDLE;
+}
+
+// A background step is done - waits for it if the whole refresh is being done at once (no deadline),
+// giving up if the board is shutting down (the task may never run)
+template<typename T> bool DepartureBoard::backgroundTaskDone(std::future<T>& task, std::chrono::steady_clock::time_point deadline) {
+    if (deadline != std::chrono::steady_clock::time_point::max()) {
+        return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+    while (task.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready) {
+        if (shutdown_requested.load()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Errors found in the data since the last refresh (debug_mode) - bad services and fields are shown with defaults
+void DepartureBoard::reportDataErrors() {
+    
+    const TrainServiceParser::ErrorCounters errors = parser.getErrorCounters();
+    if (errors.total() > 0) {
+        DEBUG_PRINT("[Departure_Board] Errors in the departure data: " << errors.parse_errors << " parse, "
+                    << errors.index_out_of_range << " index out of range, " << errors.service_mismatch << " service mismatch, "
+                    << errors.no_service << " missing service, " << errors.field_type_errors << " field type, " << errors.bad_times << " bad times");
+        parser.resetErrorCounters();
+    }
+}
+
+void DepartureBoard::extractDepartures() {
     
     DEBUG_PRINT("   [Departure_board] Cache refresh: getting next 3 departure indices");
     departure_1_index = parser.getFirstDeparture();
@@ -277,15 +418,11 @@ void DepartureBoard::getDataFromAPI(){
     
     data_refresh_pending.store(true);                                                                               // Set flag to indicate a refresh is pending
     
-    if (api_thread.joinable()) {                                                                                    // Start a new thread for the API call
-        api_thread.join();                                                                                          // Clean up previous thread if any
-    }
-    
-    api_thread = std::thread([this]() {
+    executor.post(TaskExecutor::Lane::FETCH, [this]() {                                                            // Fetch on a worker - the display keeps running
         try {
             if (shutdown_requested.load()) return;                                                                  // Early exit
             
-            raw_api_data = api_client.fetchDepartures(location_code);                                               // Fetch data from API
+            raw_api_data = fetchDepartureData();                                                                    // Fetch data from API
             
             if (shutdown_requested.load()) return;                                                                  // Check again after network call
             
@@ -304,18 +441,121 @@ void DepartureBoard::getDataFromAPI(){
             data_refresh_pending.store(false);
         }
     });
+}
+
+// Fetch the departures
+// Single call - the full board with calling points for every service.
+// Two-tier - the summary board, plus service details for the next departures when their summary has changed (see ServiceDetailsCache).
+std::string DepartureBoard::fetchDepartureData() {
+    std::string board_data;
+    
+    if (two_tier_fetch) {
+        board_data = details_cache.assemble(api_client.fetchDepartureSummary(location_code),
+                                            [this](const std::string& rid) { return api_client.fetchServiceDetails(rid); });
+    } else {
+        board_data = api_client.fetchDepartures(location_code);
+    }
+    
+    reportFetchStatistics();
+    return board_data;
+}
+
+// Hourly report of the data fetched and the time spent parsing it. Called from the thread doing the fetching.
+void DepartureBoard::reportFetchStatistics() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_fetch_report < std::chrono::hours(1)) {
+        return;
+    }
+    
+    uint64_t requests = api_client.getRequestCount() - report_start_requests;
+    uint64_t bytes = api_client.getBytesReceived() - report_start_bytes;
+    const ServiceDetailsCache::Stats& details = details_cache.getStats();
+    uint64_t total_parse_ns = parse_ns.exchange(0) + details.parse_ns;
+    auto minutes = std::chrono::duration_cast<std::chrono::minutes>(now - last_fetch_report).count();
+    
+    DEBUG_PRINT("[Departure_Board] Fetch statistics for the last " << minutes << " minutes (" << (two_tier_fetch ? "two-tier" : "single call") << "): "
+                << requests << " requests, " << bytes / 1024 << " KB received, " << total_parse_ns / 1000000 << " ms parsing.");
+    if (two_tier_fetch) {
+        DEBUG_PRINT("   [Departure_Board] Summary boards: " << details.summaries << " (" << details.summary_bytes / 1024 << " KB). "
+                    << "Service details: " << details.detail_requests << " requests (" << details.detail_bytes / 1024 << " KB), "
+                    << details.detail_cache_hits << " re-used from the cache, " << details.detail_failures << " failed.");
+    }
     
-    api_thread.detach();                                                                                            // Detach the thread so it runs independently
+    details_cache.resetStats();
+    reportExecutorMetrics();
+    reportStreamMetrics();
+    reportFrameMetrics();
+    reportHistoryMetrics();
+    report_start_requests += requests;
+    report_start_bytes += bytes;
+    last_fetch_report = now;
+}
+
+// Hourly report of the background work - tasks, queue depth and the time they waited and ran for, by lane
+void DepartureBoard::reportExecutorMetrics() {
+    const TaskExecutor::Metrics metrics = executor.getMetrics();
+    for (size_t lane = 0; lane < TaskExecutor::LANES; lane++) {
+        const TaskExecutor::LaneMetrics& m = metrics[lane];
+        if (m.submitted == 0) continue;
+        DEBUG_PRINT("   [Departure_Board] Worker " << TaskExecutor::laneName(static_cast<TaskExecutor::Lane>(lane)) << " tasks: " << m.completed << " of " << m.submitted
+                    << " run (" << m.stolen << " stolen), queue depth " << m.queue_depth << " (max " << m.max_queue_depth << "), waited "
+                    << m.total_wait_ns / std::max<uint64_t>(m.completed, 1) / 1000 << " us mean / " << m.max_wait_ns / 1000 << " us max, ran "
+                    << m.total_run_ns / std::max<uint64_t>(m.completed, 1) / 1000 << " us mean / " << m.max_run_ns / 1000 << " us max.");
+    }
+    executor.resetMetrics();
+}
+
+// Hourly report of the frames streamed to remote display nodes - size, encoding time and latency to the receivers' acks
+void DepartureBoard::reportStreamMetrics() {
+    FrameStream::FrameSender* sender = matrix.getFrameSender();
+    if (sender == nullptr) {
+        return;
+    }
+    const FrameStream::FrameSender::Metrics m = sender->getMetrics();
+    DEBUG_PRINT("   [Departure_Board] Streamed " << m.frames << " frames to " << sender->connected() << " receiver(s) (" << m.connects << " connects): "
+                << m.bytes / 1024 << " KB, " << m.bytes / std::max<uint64_t>(m.sent, 1) << " bytes a frame (max " << m.max_frame_bytes << "), "
+                << m.key_frames << " key frames, " << m.dropped << " dropped. Encoding " << m.total_encode_ns / std::max<uint64_t>(m.frames, 1) / 1000
+                << " us mean, latency " << m.total_latency_ns / std::max<uint64_t>(m.acks, 1) / 1000 << " us mean / " << m.max_latency_ns / 1000 << " us max.");
+    sender->resetMetrics();
+}
+
+// Hourly report of the frames shown - drawing them, pushing the changes to the matrix and waiting for vsync. With
+// present_thread the wait is what's left of the swap once the next frame has been drawn alongside it.
+void DepartureBoard::reportFrameMetrics() {
+    const FramePresenter::Metrics m = matrix.getFrameMetrics();
+    if (m.frames == 0) {
+        return;
+    }
+    DEBUG_PRINT("   [Departure_Board] Frames: " << m.frames << ", compose " << m.total_compose_ns / m.frames / 1000 << " us mean / " << m.max_compose_ns / 1000
+                << " us max, push " << m.total_push_ns / m.frames / 1000 << " us mean / " << m.max_push_ns / 1000 << " us max ("
+                << m.pixels_pushed / m.frames << " pixels), vsync wait " << m.total_wait_ns / m.frames / 1000 << " us mean / " << m.max_wait_ns / 1000
+                << " us max of a " << m.total_swap_ns / m.frames / 1000 << " us swap.");
+    matrix.resetFrameMetrics();
+}
+
+// Hourly report of the departure history log - records appended of the services seen and the writer's time
+void DepartureBoard::reportHistoryMetrics() {
+    if (!history) {
+        return;
+    }
+    const DepartureHistory::Metrics m = history->getMetrics();
+    DEBUG_PRINT("   [Departure_Board] History: " << m.records << " records of " << m.observations << " services seen in " << m.refreshes << " refreshes, "
+                << m.dropped << " dropped. Writing " << m.total_write_ns / std::max<uint64_t>(m.refreshes, 1) / 1000 << " us mean / "
+                << m.max_write_ns / 1000 << " us max a refresh.");
+    history->resetMetrics();
 }
 
 void DepartureBoard::run() {
     DEBUG_PRINT("[Departure_board] Attemping to Start the Departure board");
     is_running = true;
     refreshData();
-    updateDisplay();
     DEBUG_PRINT("   [Departure_board] Departure board Running!");
     
-    while (is_running) {
+    const bool paced = matrix.isHeadless() && matrix.getFrameSender() == nullptr;                                       // No vsync or stream to keep time - a frame every stream_frame_rate
+    const std::chrono::microseconds frame_interval(1000000 / std::max(1, board_config.getIntWithDefault("stream_frame_rate", 60)));
+    auto next_frame = std::chrono::steady_clock::now();
+    
+    while (is_running && !shutdown_requested.load()) {                                                                  // Stopped before it started running too
         try {
             auto now = std::chrono::steady_clock::now();
             
@@ -324,38 +564,57 @@ void DepartureBoard::run() {
                 last_data_refresh = std::chrono::steady_clock::now();
             }
             
-            if (data_refresh_completed.load()) {                                                                                // Apply the new data to the parser and update display
+            if (refresh_step == RefreshStep::IDLE && data_refresh_completed.load()) {                                           // Apply the new data to the parser and update display
                 DEBUG_PRINT("   [Departure_board] API refresh complete - attempting cache/display refresh ");
                 {
                     std::lock_guard<std::mutex> lock(api_data_mutex);
                     departures = new_api_data;
                     api_data_version = api_client.getCurrentAPIVersion();
                 }
-                refreshData();
-                updateDisplay();
+                beginRefresh();
                 
                 // Reset the completion flag
                 data_refresh_completed.store(false);
-                 
-                DEBUG_PRINT("   [Departure_board] Cache refresh and display update completed. New Data verion: " << api_data_version);
+            }
+            
+            if (refresh_step != RefreshStep::IDLE) {                                                                            // A slice of the refresh each frame
+                auto deadline = (refresh_step_budget.count() > 0) ? now + refresh_step_budget : std::chrono::steady_clock::time_point::max();
+                if (continueRefresh(deadline)) {
+                    DEBUG_PRINT("   [Departure_board] Cache refresh and display update completed. New Data verion: " << api_data_version);
+                }
             }
             
             matrix.render();
             
+            if (paced) {
+                next_frame += frame_interval;
+                auto frame_end = std::chrono::steady_clock::now();
+                if (next_frame < frame_end) {
+                    next_frame = frame_end;                                                                                     // Fallen behind - don't try to catch up
+                } else {
+                    std::this_thread::sleep_until(next_frame);
+                }
+            }
             
         } catch (const std::exception& e) {
             std::cerr << "[Departure_board] Display error: " << e.what() << std::endl;
+            if (refresh_step != RefreshStep::BACKGROUND_PARSE && refresh_step != RefreshStep::BACKGROUND_LAYOUT) {
+                refresh_step = RefreshStep::IDLE;                                                                               // Abandon a refresh which failed (a worker's is left to finish)
+            }
             std::this_thread::sleep_for(std::chrono::seconds(data_refresh_interval));
         }
     }
-    if (api_thread.joinable()) {                                                                                             // Clean up the API thread if we're shutting down
-        api_thread.join();
+    DEBUG_PRINT("[Departure_board] Stopping the departure board");
+    if (!executor.shutdown(std::chrono::seconds(5))) {                                                                          // Wait for a fetch in progress with timeout
+        DEBUG_PRINT("[Departure_board] API fetch didn't respond to shutdown, leaving it to finish...");
+    } else {
+        DEBUG_PRINT("[Departure_board] Background workers shut down gracefully");
     }
     DEBUG_PRINT("[Departure_board] Terminated Running Departure board");
 }
 
+// Only sets the flags - it's called from the signal handler. run() stops the workers when it returns.
 void DepartureBoard::stop() {
-    DEBUG_PRINT("[Departure_board] Stopping the departure board");
     /*is_running = false;
      
      if (api_thread.joinable()) {                                                                                            // Clean up the API thread if it's still running
@@ -365,20 +624,6 @@ void DepartureBoard::stop() {
     is_running = false;                                                                                                     // Signal all components to stop
     shutdown_requested.store(true);
     data_refresh_pending.store(false);
-    
-    if (api_thread.joinable()) {                                                                                            // Wait for API thread with timeout
-        auto future = std::async(std::launch::async, [this]() {
-            api_thread.join();
-        });
-        
-        if (future.wait_for(std::chrono::seconds(5)) == std::future_status::timeout) {
-            DEBUG_PRINT("[Departure_board] API thread didn't respond to shutdown, detaching...");
-            api_thread.detach();
-        } else {
-            DEBUG_PRINT("[Departure_board] API thread shut down gracefully");
-        }
-    }
-    
 }
 
 
@@ -12,9 +12,12 @@
 #include <future>
 #include <nlohmann/json.hpp>
 #include "API_client.h"
+#include "service_details_cache.h"
 #include "config.h"
 #include "matrix_driver.h"
 #include "train_service_parser.h"
+#include "task_executor.h"
+#include "departure_history.h"
 
 using json = nlohmann::json;
 
@@ -42,11 +45,13 @@ private:
     // Key components
     APIClient::APIConfig api_config;
     APIClient api_client;
+    ServiceDetailsCache details_cache;                                                                              // Service details by RID (two-tier fetching)
+    std::unique_ptr<DepartureHistory> history;                                                                      // How each departure ran (history_dir) - declared before the parser which writes to it
     TrainServiceParser parser;
     MatrixDriver matrix;
     
     // Internal state
-    bool is_running;
+    std::atomic<bool> is_running;                                                                                   // Cleared by stop() - from another board's thread or the signal handler
     
     // Raw Data
     std::string location_code;                                                                                           // Location of the departure board
@@ -55,6 +60,22 @@ private:
     std::atomic<uint64_t> api_data_version;                                                                         // Version control of api data
     size_t data_refresh_interval;
     std::chrono::steady_clock::time_point last_data_refresh;
+    bool two_tier_fetch;                                                                                            // Poll the summary board and fetch details only for the services shown
+    
+    // Time-sliced refresh - the refresh is done a step at a time between frames so the display keeps scrolling
+    // With more than one core the parse and layout are done by the workers instead and only the commit is done between frames
+    enum class RefreshStep { IDLE, PARSE, EXTRACT, LAYOUT, BACKGROUND_PARSE, BACKGROUND_LAYOUT };
+    RefreshStep refresh_step;                                                                                       // Next step of the refresh in progress
+    std::chrono::microseconds refresh_step_budget;                                                                  // Time per frame for refresh steps (0 - the whole refresh at once)
+    bool background_refresh;                                                                                        // Parse and lay out on the workers (multi-core boards)
+    std::future<TrainServiceParser::Status> background_parse;
+    std::future<void> background_layout;
+    
+    // Fetch statistics - reported hourly (debug_mode)
+    std::chrono::steady_clock::time_point last_fetch_report;
+    uint64_t report_start_requests;                                                                                 // API client totals at the start of the reporting period
+    uint64_t report_start_bytes;
+    std::atomic<uint64_t> parse_ns{0};                                                                              // Time parsing departure data in the reporting period
     
     
     // Parsed Data
@@ -72,16 +93,11 @@ private:
     TrainServiceParser::CallingPointETD  show_calling_point_etd;
     std::string selected_platform;
     
-    // Display data;
+    // Display data (row content is built in the Matrix Driver's back buffer)
     DisplayText location;                                                                                           // Location of the departure board
-    MatrixDriver::first_row_data first_row_data;
-    MatrixDriver::second_row_data second_row_data;
-    MatrixDriver::third_row_data third_row_data;
-    MatrixDriver::fourth_row_data fourth_row_data;
     
     
     // API background-refresh configuration
-    std::thread api_thread;                        // Thread for API calls
     std::atomic<bool> shutdown_requested{false};   // Shutdown Request
     std::atomic<bool> data_refresh_pending;        // Flag to indicate data refresh is in progress
     std::atomic<bool> data_refresh_completed;      // Flag to indicate new data is available
@@ -99,9 +115,25 @@ private:
     void initialiseDisplay();
     
     // Update methods
-    void updateDisplay();
-    void refreshData();
+    void updateDisplay();                                                                                           // buildRows() and commit them
+    void buildRows();                                                                                               // Lay out the rows in the Matrix Driver's back buffer
+    void refreshData();                                                                                             // The whole refresh in one go
+    void beginRefresh();                                                                                            // Start a time-sliced refresh with the latest departures
+    bool continueRefresh(std::chrono::steady_clock::time_point deadline);                                           // Refresh steps until the deadline - true when the new data is on the display
+    template<typename T> bool backgroundTaskDone(std::future<T>& task, std::chrono::steady_clock::time_point deadline);   // A worker's refresh step is finished
+    void extractDepartures();                                                                                       // Next departures from the parser
+    void reportDataErrors();                                                                                        // Parser error counters since the last refresh (debug_mode)
     void getDataFromAPI();
+    std::string fetchDepartureData();                                                                               // Fetch the departures - single call or two-tier
+    void reportFetchStatistics();                                                                                   // Hourly bytes/requests/parse-time report
+    void reportExecutorMetrics();                                                                                   // Hourly worker queue depth and latency report
+    void reportStreamMetrics();                                                                                     // Hourly frame streaming report (stream_to)
+    void reportFrameMetrics();                                                                                      // Hourly compose / push / vsync wait report
+    void reportHistoryMetrics();                                                                                    // Hourly departure history log report (history_dir)
+    
+    // Background work - fetching, and the parse and layout of a refresh on multi-core boards.
+    // Declared last so the workers are stopped before anything their tasks use is destroyed.
+    TaskExecutor executor;
 };
 
 #endif
@@ -0,0 +1,476 @@
+//
+//  departure_history.cpp
+//  Departure_Board
+//
+//  The departure history log - see departure_history.h
+//
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <chrono>
+#include <iostream>
+#include "departure_history.h"
+
+extern bool debug_mode;
+#define DEBUG_PRINT(x) if(debug_mode) { std::cerr << x << std::endl; }
+
+namespace {
+
+constexpr char MAGIC[4] = {'D', 'B', 'H', 'L'};
+constexpr uint16_t VERSION = 2;                                                    // 2 - room for a whole rid
+constexpr uint8_t CANCELLED = 0x01;                                                 // flags
+
+struct LogHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size;
+    int64_t day_start;                                                              // Local midnight - the times are deltas from it
+    uint32_t capacity;                                                              // Records
+    uint32_t service_capacity;
+    uint32_t count;                                                                 // Records written - raised once a record's columns are written
+    uint32_t service_count;
+    uint8_t reserved[32];
+};
+static_assert(sizeof(LogHeader) == 64, "The log header is 64 bytes");
+
+struct ServiceEntry {                                                               // The log's service table - a record's service column indexes it
+    char rid[32];                                                                   // RTTI rids are 15 digits - longer keys are cut (serviceKey)
+    char trainid[8];
+    char destination[56];
+};
+static_assert(sizeof(ServiceEntry) == 96, "A service entry is 96 bytes");
+
+// Where each column starts - from the capacities, so a log is read with the capacities in its header
+struct Layout {
+    size_t observed = 0;                                                            // uint32_t - seconds from the start of the day
+    size_t service = 0;                                                             // uint32_t - service table entry
+    size_t scheduled = 0;                                                           // int16_t  - minutes from the start of the day
+    size_t delay = 0;                                                               // int16_t  - minutes late (NO_ESTIMATE)
+    size_t reason = 0;                                                              // uint16_t - reason code
+    size_t flags = 0;                                                               // uint8_t
+    size_t platform = 0;                                                            // char[4]
+    size_t services = 0;                                                            // ServiceEntry[service_capacity]
+    size_t size = 0;
+
+    Layout(uint32_t capacity, uint32_t service_capacity) {
+        size_t at = sizeof(LogHeader);
+        auto column = [&](size_t bytes) {
+            size_t offset = at;
+            at = (at + bytes * capacity + 7) & ~static_cast<size_t>(7);
+            return offset;
+        };
+        observed = column(sizeof(uint32_t));
+        service = column(sizeof(uint32_t));
+        scheduled = column(sizeof(int16_t));
+        delay = column(sizeof(int16_t));
+        reason = column(sizeof(uint16_t));
+        flags = column(sizeof(uint8_t));
+        platform = column(4);
+        services = at;
+        size = at + sizeof(ServiceEntry) * service_capacity;
+    }
+};
+
+void copyField(char* field, size_t size, const std::string& text, bool terminated = true) {
+    std::memset(field, 0, size);
+    std::memcpy(field, text.data(), std::min(terminated ? size - 1 : size, text.size()));
+}
+
+std::string readField(const char* field, size_t size) {
+    return std::string(field, strnlen(field, size));
+}
+
+// A service as it's kept in the log - what's read back after a restart must match what's compared against
+std::string serviceKey(const DepartureHistory::Observation& observation) {
+    const std::string& key = observation.rid.empty() ? observation.trainid : observation.rid;
+    return key.substr(0, sizeof(ServiceEntry::rid) - 1);
+}
+
+int16_t clampMinutes(double minutes) {
+    return static_cast<int16_t>(std::max(-32767.0, std::min(32767.0, std::round(minutes))));
+}
+
+} // namespace
+
+// A day's log, memory-mapped
+class DepartureHistory::Log {
+public:
+    static std::unique_ptr<Log> open(const std::string& path, std::time_t day, uint32_t capacity, bool writable) {
+        int fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+        if (fd < 0) {
+            return nullptr;
+        }
+        if (writable && flock(fd, LOCK_EX | LOCK_NB) != 0) {                        // One writer a log - two boards with the same name would interleave
+            std::cerr << "[History] " << path << " is being written by another board - give each board its own location, platform or history_dir" << std::endl;
+            ::close(fd);
+            return nullptr;
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0) {
+            ::close(fd);
+            return nullptr;
+        }
+        size_t file_size = static_cast<size_t>(file_stat.st_size);
+        bool created = false;
+        if (file_size == 0 && writable) {                                           // A new day
+            file_size = Layout(capacity, SERVICE_CAPACITY).size;
+            if (ftruncate(fd, static_cast<off_t>(file_size)) != 0) {
+                ::close(fd);
+                return nullptr;
+            }
+            created = true;
+        }
+        if (file_size < sizeof(LogHeader)) {
+            ::close(fd);
+            return nullptr;
+        }
+        void* mapped = mmap(nullptr, file_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            return nullptr;
+        }
+        if (!writable) {
+            ::close(fd);                                                            // The mapping keeps the file - a writer keeps it open for the lock
+            fd = -1;
+        }
+
+        std::unique_ptr<Log> log(new Log(static_cast<uint8_t*>(mapped), file_size, fd));
+        LogHeader& header = log->header();
+        if (created) {
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.header_size = sizeof(LogHeader);
+            header.day_start = static_cast<int64_t>(day);
+            header.capacity = capacity;
+            header.service_capacity = SERVICE_CAPACITY;
+        }
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+            Layout(header.capacity, header.service_capacity).size > file_size || header.count > header.capacity ||
+            header.service_count > header.service_capacity) {
+            std::cerr << "[History] " << path << " isn't a departure history log (or is damaged)" << std::endl;
+            return nullptr;
+        }
+        log->layout = Layout(header.capacity, header.service_capacity);
+        return log;
+    }
+
+    ~Log() {
+        if (fd >= 0) msync(base, size, MS_ASYNC);
+        munmap(base, size);
+        if (fd >= 0) ::close(fd);                                                   // Releases the lock
+    }
+
+    LogHeader& header() { return *reinterpret_cast<LogHeader*>(base); }
+    template<typename T> T* column(size_t offset) { return reinterpret_cast<T*>(base + offset); }
+    ServiceEntry* services() { return column<ServiceEntry>(layout.services); }
+
+    Layout layout;
+
+private:
+    Log(uint8_t* base, size_t size, int fd) : layout(0, 0), base(base), size(size), fd(fd) {}
+    uint8_t* base;
+    size_t size;
+    int fd;                                                                         // Writer only (locked) - -1 when reading
+};
+
+DepartureHistory::DepartureHistory(const std::string& directory, const std::string& board, uint32_t capacity) :
+directory(directory),
+board(board),
+capacity(std::max<uint32_t>(capacity, 1)),
+writing(false),
+stopping(false) {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "[History] Couldn't create " << directory << ": " << std::strerror(errno) << std::endl;
+    }
+    writer = std::thread(&DepartureHistory::writerLoop, this);
+    DEBUG_PRINT("[History] Logging departures to " << logName(directory, board, std::time(nullptr)));
+}
+
+DepartureHistory::~DepartureHistory() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_one();
+    writer.join();                                                                  // Writes what's queued first
+}
+
+void DepartureHistory::record(std::time_t observed, std::vector<Observation>&& observations) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(Refresh{observed, std::move(observations)});
+    }
+    queued.notify_one();
+}
+
+void DepartureHistory::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    written.wait(lock, [this]() { return queue.empty() && !writing; });
+}
+
+DepartureHistory::Metrics DepartureHistory::getMetrics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return metrics;
+}
+
+void DepartureHistory::resetMetrics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    metrics = Metrics();
+}
+
+void DepartureHistory::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queued.wait(lock, [this]() { return !queue.empty() || stopping; });
+        if (queue.empty()) {
+            break;                                                                  // Stopping with nothing left to write
+        }
+        Refresh refresh = std::move(queue.front());
+        queue.pop_front();
+        writing = true;
+        lock.unlock();
+
+        write(refresh);
+
+        lock.lock();
+        writing = false;
+        written.notify_all();
+    }
+    log.reset();
+}
+
+// Append a record for each service which changed since its last record
+void DepartureHistory::write(const Refresh& refresh) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t records = 0;
+    uint64_t dropped = 0;
+
+    std::time_t day = dayStart(refresh.observed);
+    if (!openDay(day)) {
+        dropped = refresh.observations.size();
+    } else {
+        LogHeader& header = log->header();
+        const Layout& layout = log->layout;
+        for (const Observation& observation : refresh.observations) {
+            const std::string key = serviceKey(observation);
+            if (key.empty() || observation.std == 0) {
+                continue;
+            }
+            LastState state;
+            state.scheduled = clampMinutes(static_cast<double>(observation.std - day) / 60.0);
+            state.delay = observation.etd == 0 ? NO_ESTIMATE : clampMinutes(static_cast<double>(observation.etd - observation.std) / 60.0);
+            state.reason = observation.reason;
+            state.flags = observation.cancelled ? CANCELLED : 0;
+            copyField(state.platform, sizeof(state.platform), observation.platform, false);
+
+            auto last = last_state.find(key);
+            if (last != last_state.end() && last->second.scheduled == state.scheduled && last->second.delay == state.delay &&
+                last->second.reason == state.reason && last->second.flags == state.flags &&
+                std::memcmp(last->second.platform, state.platform, sizeof(state.platform)) == 0) {
+                continue;                                                           // Unchanged
+            }
+
+            auto service = service_index.find(key);
+            if (service == service_index.end()) {
+                if (header.service_count >= header.service_capacity) {
+                    dropped++;
+                    continue;
+                }
+                ServiceEntry& entry = log->services()[header.service_count];
+                copyField(entry.rid, sizeof(entry.rid), key);
+                copyField(entry.trainid, sizeof(entry.trainid), observation.trainid);
+                copyField(entry.destination, sizeof(entry.destination), observation.destination);
+                service = service_index.emplace(key, header.service_count).first;
+                header.service_count++;
+            }
+            if (header.count >= header.capacity) {
+                dropped++;
+                continue;
+            }
+
+            uint32_t record = header.count;
+            log->column<uint32_t>(layout.observed)[record] = static_cast<uint32_t>(std::max<std::time_t>(0, refresh.observed - day));
+            log->column<uint32_t>(layout.service)[record] = service->second;
+            log->column<int16_t>(layout.scheduled)[record] = state.scheduled;
+            log->column<int16_t>(layout.delay)[record] = state.delay;
+            log->column<uint16_t>(layout.reason)[record] = state.reason;
+            log->column<uint8_t>(layout.flags)[record] = state.flags;
+            std::memcpy(log->column<char>(layout.platform) + static_cast<size_t>(record) * 4, state.platform, 4);
+            std::atomic_thread_fence(std::memory_order_release);                    // A reader sees the record's columns before the count
+            header.count = record + 1;
+
+            last_state[key] = state;
+            records++;
+        }
+    }
+
+    uint64_t write_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    std::lock_guard<std::mutex> lock(mutex);
+    metrics.refreshes++;
+    metrics.observations += refresh.observations.size();
+    metrics.records += records;
+    metrics.dropped += dropped;
+    metrics.total_write_ns += write_ns;
+    metrics.max_write_ns = std::max(metrics.max_write_ns, write_ns);
+}
+
+// Open the day's log (a new day starts a new log) and pick up the services already in it
+bool DepartureHistory::openDay(std::time_t day) {
+    if (log && log->header().day_start == static_cast<int64_t>(day)) {
+        return true;
+    }
+    if (day == failed_day) {
+        return false;                                                               // Not again until tomorrow
+    }
+    log.reset();
+    service_index.clear();
+    last_state.clear();
+
+    std::string path = logName(directory, board, day);
+    log = Log::open(path, day, capacity, true);
+    if (!log) {
+        std::cerr << "[History] Couldn't open " << path << " - departures aren't being logged today" << std::endl;
+        failed_day = day;
+        return false;
+    }
+
+    LogHeader& header = log->header();                                              // Restarted during the day - carry on from the last records
+    const Layout& layout = log->layout;
+    const ServiceEntry* services = log->services();
+    for (uint32_t service = 0; service < header.service_count; service++) {
+        service_index.emplace(readField(services[service].rid, sizeof(services[service].rid)), service);
+    }
+    std::vector<uint32_t> last(header.service_count, UINT32_MAX);
+    const uint32_t* service_column = log->column<uint32_t>(layout.service);
+    for (uint32_t record = 0; record < header.count; record++) {
+        if (service_column[record] < header.service_count) last[service_column[record]] = record;
+    }
+    for (uint32_t service = 0; service < header.service_count; service++) {
+        if (last[service] == UINT32_MAX) continue;
+        uint32_t record = last[service];
+        LastState state;
+        state.scheduled = log->column<int16_t>(layout.scheduled)[record];
+        state.delay = log->column<int16_t>(layout.delay)[record];
+        state.reason = log->column<uint16_t>(layout.reason)[record];
+        state.flags = log->column<uint8_t>(layout.flags)[record];
+        std::memcpy(state.platform, log->column<char>(layout.platform) + static_cast<size_t>(record) * 4, 4);
+        last_state[readField(services[service].rid, sizeof(services[service].rid))] = state;
+    }
+    DEBUG_PRINT("[History] " << path << " - " << header.count << " records of " << header.service_count << " services so far");
+    return true;
+}
+
+std::time_t DepartureHistory::dayStart(std::time_t time) {
+    std::tm local;
+    localtime_r(&time, &local);
+    local.tm_hour = 0;
+    local.tm_min = 0;
+    local.tm_sec = 0;
+    local.tm_isdst = -1;
+    return std::mktime(&local);
+}
+
+std::string DepartureHistory::logName(const std::string& directory, const std::string& board, std::time_t day) {
+    std::tm local;
+    localtime_r(&day, &local);
+    char date[16];
+    std::strftime(date, sizeof(date), "%Y-%m-%d", &local);
+    return directory + "/" + board + "-" + date + ".dbh";
+}
+
+std::vector<std::string> DepartureHistory::findLogs(const std::string& directory, const std::string& board, std::time_t today, int days) {
+    std::vector<std::string> logs;
+    std::time_t noon = dayStart(today) + 12 * 3600;                                 // Stepping back from noon is a day back whatever the clocks did
+    for (int day = days - 1; day >= 0; day--) {
+        std::string path = logName(directory, board, noon - static_cast<std::time_t>(day) * 86400);
+        struct stat file_stat;
+        if (stat(path.c_str(), &file_stat) == 0) {
+            logs.push_back(path);
+        }
+    }
+    return logs;
+}
+
+// The last record of each service on each day is how it ran - grouped by scheduled time and destination across the days
+uint64_t DepartureHistory::summarise(const std::vector<std::string>& logs, std::vector<ServiceStatistics>& statistics) {
+    statistics.clear();
+    std::map<std::pair<int, std::string>, size_t> by_service;
+    std::vector<uint32_t> last;
+    uint64_t records = 0;
+
+    for (const std::string& path : logs) {
+        std::unique_ptr<Log> log = Log::open(path, 0, 0, false);
+        if (!log) {
+            continue;
+        }
+        const LogHeader& header = log->header();
+        uint32_t count = header.count;
+        std::atomic_thread_fence(std::memory_order_acquire);                        // Still being written - the columns up to count are complete
+        const Layout& layout = log->layout;
+        const uint32_t* service_column = log->column<uint32_t>(layout.service);
+        last.assign(header.service_count, UINT32_MAX);
+        for (uint32_t record = 0; record < count; record++) {
+            if (service_column[record] < last.size()) last[service_column[record]] = record;
+        }
+        records += count;
+
+        const int16_t* scheduled = log->column<int16_t>(layout.scheduled);
+        const int16_t* delay = log->column<int16_t>(layout.delay);
+        const uint8_t* flags = log->column<uint8_t>(layout.flags);
+        const ServiceEntry* services = log->services();
+        for (uint32_t service = 0; service < last.size(); service++) {
+            uint32_t record = last[service];
+            if (record == UINT32_MAX) continue;
+            int minute = ((scheduled[record] % 1440) + 1440) % 1440;
+            std::string destination = readField(services[service].destination, sizeof(services[service].destination));
+            auto found = by_service.emplace(std::make_pair(minute, destination), statistics.size());
+            if (found.second) {
+                statistics.emplace_back();
+                statistics.back().scheduled_minute = minute;
+                statistics.back().destination = destination;
+            }
+            ServiceStatistics& service_statistics = statistics[found.first->second];
+            service_statistics.trainid = readField(services[service].trainid, sizeof(services[service].trainid));
+            service_statistics.days++;
+            if (flags[record] & CANCELLED) {
+                service_statistics.cancelled++;
+            } else if (delay[record] != NO_ESTIMATE) {
+                service_statistics.delays.push_back(delay[record]);
+            }
+        }
+    }
+
+    for (ServiceStatistics& service_statistics : statistics) {
+        std::sort(service_statistics.delays.begin(), service_statistics.delays.end());
+    }
+    std::sort(statistics.begin(), statistics.end(), [](const ServiceStatistics& a, const ServiceStatistics& b) {
+        return a.scheduled_minute != b.scheduled_minute ? a.scheduled_minute < b.scheduled_minute : a.destination < b.destination;
+    });
+    return records;
+}
+
+double DepartureHistory::ServiceStatistics::meanDelay() const {
+    if (delays.empty()) return 0;
+    double total = 0;
+    for (int16_t delay : delays) total += delay;
+    return total / static_cast<double>(delays.size());
+}
+
+int DepartureHistory::ServiceStatistics::percentileDelay(double percentile) const {
+    if (delays.empty()) return 0;
+    size_t index = static_cast<size_t>(std::ceil(percentile / 100.0 * static_cast<double>(delays.size()))) ;
+    return delays[std::min(delays.size() - 1, index == 0 ? 0 : index - 1)];
+}
+
+uint32_t DepartureHistory::ServiceStatistics::within(int minutes) const {
+    return static_cast<uint32_t>(std::upper_bound(delays.begin(), delays.end(), static_cast<int16_t>(minutes)) - delays.begin());
+}
@@ -0,0 +1,130 @@
+//
+//  departure_history.h
+//  Departure_Board
+//
+//  A log of how each departure ran - kept across refreshes so delays can be looked at later ("how late does the 07:42
+//  usually run?") without polling the API again.
+//
+//  The parser notes each service as it reads a refresh (rid, headcode, destination, std, etd, platform, cancelled and the
+//  reason code) and hands the lot over when the refresh commits - that's all the refresh pays for. A writer thread keeps
+//  the last state of every service and appends a record only for those which changed.
+//
+//  Records go to a log a day for each board (history_dir/<board>-YYYY-MM-DD.dbh), memory-mapped and append-only. The log
+//  is columnar - the times of every record together, then the services, and so on - so a query reads only the columns
+//  it needs. Times are kept as small deltas: observed in seconds from the start of the day, scheduled in minutes from
+//  the start of the day and the estimate as minutes late against the schedule. About 20 bytes a record. One board writes a log - it's locked while open.
+//
+//  departureboard_history (history_query.cpp) summarises the delays of each service over weeks of logs (summarise).
+//
+
+#ifndef DEPARTURE_HISTORY_H
+#define DEPARTURE_HISTORY_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ctime>
+#include <cstdint>
+#include <memory>
+
+class DepartureHistory {
+public:
+    static constexpr uint32_t DEFAULT_CAPACITY = 1 << 17;                           // Records a day - the log's pages are only used as they're written
+    static constexpr uint32_t SERVICE_CAPACITY = 1 << 13;                           // Services a day
+    static constexpr int16_t NO_ESTIMATE = INT16_MIN;                               // Delay when there's no estimated time
+
+    // A service as read from a refresh
+    struct Observation {
+        std::string rid;                                                            // Unique to the service on the day
+        std::string trainid;                                                        // Headcode
+        std::string destination;
+        std::string platform;
+        std::time_t std = 0;
+        std::time_t etd = 0;                                                        // 0 - no estimate
+        bool cancelled = false;
+        uint16_t reason = 0;                                                        // Cancellation reason if cancelled, otherwise the delay reason (0 - none)
+    };
+
+    struct Metrics {
+        uint64_t refreshes = 0;
+        uint64_t observations = 0;
+        uint64_t records = 0;                                                       // Appended - the services which changed
+        uint64_t dropped = 0;                                                       // The day's log was full (or couldn't be opened)
+        uint64_t total_write_ns = 0;                                                // Comparing and appending a refresh (writer thread)
+        uint64_t max_write_ns = 0;
+    };
+
+    // Delays of a service (the same scheduled time and destination) over the days of the logs - the last record of each day
+    struct ServiceStatistics {
+        int scheduled_minute = 0;                                                   // Minutes after midnight
+        std::string destination;
+        std::string trainid;                                                        // Headcode last seen
+        uint32_t days = 0;
+        uint32_t cancelled = 0;
+        std::vector<int16_t> delays;                                                // Minutes late each day it ran with an estimate - sorted
+        double meanDelay() const;
+        int percentileDelay(double percentile) const;
+        uint32_t within(int minutes) const;                                         // Days no more than this late
+    };
+
+    /**
+     * @param directory Where the logs go (history_dir) - created if it isn't there
+     * @param board Name for this board's logs - the location, and platform if one is selected
+     */
+    DepartureHistory(const std::string& directory, const std::string& board, uint32_t capacity = DEFAULT_CAPACITY);
+    ~DepartureHistory();                                                            // Writes what's queued and closes the log
+
+    DepartureHistory(const DepartureHistory&) = delete;
+    DepartureHistory& operator=(const DepartureHistory&) = delete;
+
+    void record(std::time_t observed, std::vector<Observation>&& observations);     // A refresh for the writer thread
+    void flush();                                                                   // Wait until everything queued is written
+    Metrics getMetrics() const;
+    void resetMetrics();
+
+    // Reading the logs
+    static std::string logName(const std::string& directory, const std::string& board, std::time_t day);
+    static std::vector<std::string> findLogs(const std::string& directory, const std::string& board, std::time_t today, int days);
+    static uint64_t summarise(const std::vector<std::string>& logs, std::vector<ServiceStatistics>& statistics);     // Records read
+    static std::time_t dayStart(std::time_t time);                                  // Local midnight
+
+private:
+    class Log;                                                                      // A day's memory-mapped log
+    struct LastState {                                                              // What the last record for a service said
+        int16_t scheduled;
+        int16_t delay;
+        uint16_t reason;
+        uint8_t flags;
+        char platform[4];
+    };
+    struct Refresh {
+        std::time_t observed;
+        std::vector<Observation> observations;
+    };
+
+    void writerLoop();
+    void write(const Refresh& refresh);
+    bool openDay(std::time_t day);
+
+    std::string directory;
+    std::string board;
+    uint32_t capacity;
+    std::unique_ptr<Log> log;                                                       // Today's log - writer thread only
+    std::time_t failed_day = 0;                                                     // The day's log couldn't be opened - writer thread only
+    std::unordered_map<std::string, uint32_t> service_index;                        // Rid to the log's service table - writer thread only
+    std::unordered_map<std::string, LastState> last_state;                          // By rid - writer thread only
+    std::deque<Refresh> queue;
+    bool writing;                                                                   // The writer has a refresh out of the queue
+    bool stopping;
+    Metrics metrics;
+    mutable std::mutex mutex;
+    std::condition_variable queued;
+    std::condition_variable written;
+    std::thread writer;
+};
+
+#endif // DEPARTURE_HISTORY_H
@@ -0,0 +1,119 @@
+//
+//  departure_order.h
+//  Departure_Board
+//
+//  Keeps the order of departures between refreshes.
+//
+//  Between API polls the order of departures hardly changes - a few estimated times move and
+//  services drop off the top or appear at the bottom. Rather than sorting every refresh the
+//  previous order is carried forward and repaired with an insertion sort, which is close to O(n)
+//  for an almost-sorted list. If the repair turns out to be expensive (big changes) it falls back
+//  to a full sort.
+//
+//  The previous order is held as service indices from the last update. The caller maps these to the
+//  new indices by trainid (the parser already does this when it re-uses cached services).
+//
+//  Services with an invalid time are kept in a separate tail (in the order they appear in the JSON)
+//  so the comparison is a plain time comparison.
+//
+
+#ifndef DEPARTURE_ORDER_H
+#define DEPARTURE_ORDER_H
+
+#include <vector>
+#include <ctime>
+#include <cstdint>
+#include <algorithm>
+
+class DepartureOrder {
+public:
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    struct Stats {
+        size_t carried_forward = 0;                                                 // Services kept from the previous order
+        size_t added = 0;                                                           // New services (or ones which now have a valid time)
+        size_t invalid = 0;                                                         // Services in the invalid-time tail
+        size_t shifts = 0;                                                          // Insertion-sort moves needed to repair the order
+        bool full_sort = false;                                                     // True if the repair was abandoned for a full sort
+    };
+
+    /**
+     * Repair the order for a new set of services
+     * @param number_of_services Number of services in the new data
+     * @param new_index_of Function - new index of a service from the last update (NOT_FOUND if it's gone)
+     * @param departure_time Function - departure time for (new) service index i
+     * @param invalid_time The 'no valid time' flag value
+     * @param ordered Output - the first number_of_services entries are set to the service indices in departure order
+     */
+    template<typename IndexFn, typename TimeFn>
+    void update(size_t number_of_services, IndexFn new_index_of, TimeFn departure_time, time_t invalid_time, std::vector<size_t>& ordered) {
+
+        stats = Stats();
+        valid.clear();
+        invalid.clear();
+        placed.assign(number_of_services, 0);
+
+        // Carry forward the previous order for services which are still there
+        for (size_t previous_index : previous_order) {
+            size_t index = new_index_of(previous_index);
+            if (index == NOT_FOUND || index >= number_of_services || placed[index]) continue;
+            if (departure_time(index) == invalid_time) continue;                    // Goes in the tail below
+            valid.push_back(index);
+            placed[index] = 1;
+        }
+        stats.carried_forward = valid.size();
+
+        // New services go on the end (they're usually the latest departures) - invalid times in the tail
+        for (size_t i = 0; i < number_of_services; i++) {
+            if (placed[i]) continue;
+            if (departure_time(i) == invalid_time) {
+                invalid.push_back(i);
+            } else {
+                valid.push_back(i);
+            }
+        }
+        stats.added = valid.size() - stats.carried_forward;
+        stats.invalid = invalid.size();
+
+        // Repair - stable insertion sort, giving up if it's doing too much work
+        const size_t max_shifts = REPAIR_BUDGET * valid.size() + REPAIR_BUDGET;
+        for (size_t i = 1; i < valid.size() && !stats.full_sort; i++) {
+            size_t index = valid[i];
+            time_t time = departure_time(index);
+            size_t j = i;
+            while (j > 0 && time < departure_time(valid[j - 1])) {
+                valid[j] = valid[j - 1];
+                j--;
+                if (++stats.shifts > max_shifts) {
+                    stats.full_sort = true;
+                    break;
+                }
+            }
+            valid[j] = index;
+        }
+        if (stats.full_sort) {
+            std::stable_sort(valid.begin(), valid.end(), [&departure_time](size_t a, size_t b) {
+                return departure_time(a) < departure_time(b);
+            });
+        }
+
+        // Output the order and remember it for next time
+        std::copy(valid.begin(), valid.end(), ordered.begin());
+        std::copy(invalid.begin(), invalid.end(), ordered.begin() + valid.size());
+        previous_order.assign(valid.begin(), valid.end());
+    }
+
+    void clear() { previous_order.clear(); }                                        // Forget the previous order
+    const Stats& getStats() const { return stats; }                                 // Statistics for the last update
+
+private:
+    static constexpr size_t REPAIR_BUDGET = 8;                                      // Average moves per service before falling back to a full sort
+
+    std::vector<size_t> previous_order;                                             // Service indices (valid times only) in departure order from the last update
+    std::vector<size_t> valid;                                                      // Working lists - kept to re-use the memory
+    std::vector<size_t> invalid;
+    std::vector<uint8_t> placed;
+    Stats stats;
+};
+
+#endif // DEPARTURE_ORDER_H
@@ -6,16 +6,21 @@
 //
 
 #include <signal.h>
+#include <thread>
+#include <atomic>
+#include <set>
+#include <memory>
 #include "departureboard.h"
+#include "device_calibration.h"
 
 bool debug_mode = false;                                                                // Global debug flag
 
-DepartureBoard* display_ptr = nullptr;                                                  // Pointer to departure board for signal handling
+std::vector<DepartureBoard*> display_ptrs;                                              // Departure boards for signal handling
 
 void signalHandler(int signum) {                                                        // Signal handler for graceful shutdown
     std::cout << "\nReceived signal " << signum << ". Shutting down..." << std::endl;
-    if (display_ptr) {
-        display_ptr->stop();
+    for (DepartureBoard* board : display_ptrs) {
+        board->stop();
     }
 }
 
@@ -24,16 +29,18 @@ void showUsage(const char* programName) {
     std::cout << "Usage: " << programName << " [OPTIONS] [LOCATION]\n"
               << "Options:\n"
               << "  -d, --debug               Enable debug output\n"
-              << "  -f, --config FILE         Specify configuration file\n"
+              << "  -f, --config FILE         Specify configuration file - repeat for more boards in one process\n"
+              << "                            (only one can drive the matrix - the others set headless=true and stream_to)\n"
               << "  -h, --help                Show this help message\n"
+              << "  --calibrate               Tune the performance settings for this Pi, write them to device_profile and exit\n"
               << "\nExample:\n"
               << "  " << programName << " KGX\n"
               << "    Shows trains from London Kings Cross\n";
 }
 
-// Helper function to process command line arguments
-void processCommandLineArgs(int argc, char* argv[], Config& config) {
-    std::string config_file;
+// Helper function to process command line arguments - a configuration for each board
+void processCommandLineArgs(int argc, char* argv[], std::vector<std::unique_ptr<Config>>& configs, bool& calibrate) {
+    std::vector<std::string> config_files;
     std::string location;
     std::vector<std::string> station_args;
     
@@ -45,16 +52,18 @@ void processCommandLineArgs(int argc, char* argv[], Config& config) {
         } else if (arg == "-h" || arg == "--help") {
             showUsage(argv[0]);
             exit(0);
+        } else if (arg == "--calibrate") {
+            calibrate = true;
         } else if (arg == "-f" || arg == "--config") {
             if (i + 1 < argc) {
-                config_file = argv[++i];
+                config_files.push_back(argv[++i]);
             } else {
                 std::cerr << "Error: Config file path not provided after " << arg << std::endl;
                 showUsage(argv[0]);
                 exit(1);
             }
         } else if (arg.substr(0, 9) == "--config=") {
-            config_file = arg.substr(9);
+            config_files.push_back(arg.substr(9));
         } else if (arg[0] != '-') {
             // Store non-option arguments for second pass
             station_args.push_back(arg);
@@ -65,29 +74,99 @@ void processCommandLineArgs(int argc, char* argv[], Config& config) {
         }
     }
     
-    // Load configuration file
-    if (config_file.empty()) {
-        config_file = "./config.txt";
+    // Load configuration files
+    if (config_files.empty()) {
+        config_files.push_back("./config.txt");
     }
-    try {
-        config.loadFromFile(config_file);
-    } catch (const std::exception& e) {
-        std::cerr << "Error loading config file: " << e.what() << std::endl;
+    for (const std::string& config_file : config_files) {
+        std::unique_ptr<Config> config(new Config());
+        try {
+            config->loadFromFile(config_file);
+        } catch (const std::exception& e) {
+            std::cerr << "Error loading config file: " << e.what() << std::endl;
+            exit(1);
+        }
+        
+        // Process location arguments
+        if (station_args.size() > 0) {
+            config->set("location", station_args[0]);
+            DEBUG_PRINT("Overriding 'location' with command line value: " << station_args[0]);
+        }
+        
+        // If debug_mode is set, update the configuration
+        if(debug_mode){
+            config->set("debug_mode", "true");
+            DEBUG_PRINT("Overriding 'debug_mode' with command line value: " << debug_mode);
+        }
+        configs.push_back(std::move(config));
+    }
+    
+    size_t matrix_boards = 0;
+    for (const auto& config : configs) {
+        if (!config->getBoolWithDefault("headless", false)) matrix_boards++;
+    }
+    if (matrix_boards > 1) {
+        std::cerr << "Error: only one board can drive the matrix - set headless=true (and stream_to) for the others" << std::endl;
         exit(1);
     }
     
-    // Process location arguments
-    if (station_args.size() > 0) {
-        config.set("location", station_args[0]);
-        DEBUG_PRINT("Overriding 'location' with command line value: " << station_args[0]);
+    std::set<std::string> history_logs;                                                 // Each board's departure history log is its own
+    for (const auto& config : configs) {
+        if (config->get("history_dir").empty()) continue;
+        std::string log = config->get("history_dir") + "/" + config->get("location") + "_" + config->get("platform");
+        if (!history_logs.insert(log).second) {
+            std::cerr << "Error: two boards log the departures from " << config->get("location")
+                      << (config->get("platform").empty() ? std::string() : " platform " + config->get("platform"))
+                      << " to the same history_dir - give one a different history_dir" << std::endl;
+            exit(1);
+        }
+    }
+}
+
+// Load the device profile - calibrating the kernels first if there isn't one yet
+void loadDeviceProfile(Config& config) {
+    std::string profile = config.resolvePath(config.get("device_profile"));
+    if (profile.empty() || config.loadDeviceProfile(profile) || !config.getBoolWithDefault("auto_calibrate", true)) return;
+    
+    std::cout << "No device profile - calibrating for this device (" << profile << ")" << std::endl;
+    DeviceCalibration::Result result = DeviceCalibration::calibrate(config, nullptr);
+    DeviceCalibration::writeProfile(profile, result);                                   // For next time - this run uses the result even if it can't be written
+    for (const auto& setting : DeviceCalibration::profileSettings(result)) {
+        config.setFromDeviceProfile(setting.first, setting.second);
+    }
+}
+
+// --calibrate - the full calibration, the frame interval on the matrix if it can be driven
+int runCalibration(Config& config) {
+    std::unique_ptr<MatrixDriver> matrix;
+    if (config.getBoolWithDefault("headless", false)) {
+        std::cout << "Headless - the scroll timings won't be calibrated" << std::endl;
+    } else {
+        try {
+            matrix.reset(new MatrixDriver(config));
+        } catch (const std::exception& e) {
+            std::cerr << "No matrix (" << e.what() << ") - the scroll timings won't be calibrated" << std::endl;
+        }
     }
     
-    // If debug_mode is set, update the configuration
-    if(debug_mode){
-        config.set("debug_mode", "true");
-        DEBUG_PRINT("Overriding 'debug_mode' with command line value: " << debug_mode);
+    std::cout << "Calibrating..." << std::endl;
+    DeviceCalibration::Result result = DeviceCalibration::calibrate(config, matrix.get());
+    for (const std::string& note : result.notes) {
+        std::cout << "  " << note << std::endl;
     }
+    std::string profile = config.resolvePath(config.get("device_profile"));
+    if (!DeviceCalibration::writeProfile(profile, result)) return 1;
     
+    std::cout << "Device profile written to " << profile << ":\n"
+              << "  html_neon_threshold=" << result.html_neon_threshold << "\n"
+              << "  text_width_cache_entries=" << result.text_width_cache_entries << std::endl;
+    if (result.gpio_slowdown >= 0) std::cout << "  gpio_slowdown=" << result.gpio_slowdown << std::endl;
+    if (result.frame_interval_us > 0) {
+        std::cout << "  calling_point_slowdown=" << result.calling_point_slowdown << "\n"
+                  << "  nrcc_message_slowdown=" << result.nrcc_message_slowdown << std::endl;
+    }
+    std::cout << "Settings in config.txt still win - comment them out of config.txt to use these" << std::endl;
+    return 0;
 }
 
 int main(int argc, char* argv[]){
@@ -95,17 +174,50 @@ int main(int argc, char* argv[]){
     signal(SIGTERM, signalHandler);
     
     try {
-        Config config;
+        std::vector<std::unique_ptr<Config>> configs;
+        bool calibrate = false;
         
-        processCommandLineArgs(argc, argv, config);
+        processCommandLineArgs(argc, argv, configs, calibrate);
+        if (calibrate) {
+            return runCalibration(*configs[0]);
+        }
+        for (const auto& config : configs) {
+            loadDeviceProfile(*config);
+        }
         
         //config.loadFromFile("/home/display/Matrix_Driver/config.txt");
         
-        DepartureBoard departure_board(config);
-        display_ptr = &departure_board;                                                     // Set global pointer for signal handler
+        std::vector<std::unique_ptr<DepartureBoard>> departure_boards;
+        for (const auto& config : configs) {
+            departure_boards.emplace_back(new DepartureBoard(*config));
+            display_ptrs.push_back(departure_boards.back().get());                          // Set global pointers for signal handler
+        }
         
-        std::cout << "Departureboard running. Press Ctrl+C to exit." << std::endl;
-        departure_board.run();
+        std::cout << "Departureboard running" << (departure_boards.size() > 1 ? " " + std::to_string(departure_boards.size()) + " boards" : std::string()) << ". Press Ctrl+C to exit." << std::endl;
+        std::atomic<bool> board_failed(false);
+        auto runBoard = [&departure_boards, &board_failed](size_t board) {                  // A board which fails stops them all
+            try {
+                departure_boards[board]->run();
+            } catch (const std::exception& e) {
+                std::cerr << "Fatal error" << (departure_boards.size() > 1 ? " (board " + std::to_string(board) + ")" : std::string()) << ": " << e.what() << std::endl;
+                board_failed = true;
+                for (const auto& departure_board : departure_boards) {
+                    departure_board->stop();
+                }
+            }
+        };
+        std::vector<std::thread> board_threads;                                             // The first board runs on this thread, the others on their own
+        for (size_t board = 1; board < departure_boards.size(); board++) {
+            board_threads.emplace_back(runBoard, board);
+        }
+        runBoard(0);
+        for (std::thread& thread : board_threads) {
+            thread.join();
+        }
+        display_ptrs.clear();
+        if (board_failed) {
+            return 1;
+        }
         
     } catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << std::endl;
@@ -0,0 +1,235 @@
+//
+//  device_calibration.cpp
+//  Departure_Board
+//
+//  Tunes the per-device performance settings - see device_calibration.h
+//
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <array>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include "device_calibration.h"
+#include "HTML_processor.h"
+#include "display_text.h"
+#include "matrix_driver.h"
+
+namespace {
+
+constexpr size_t NEON_NEVER = 1 << 20;                                              // Threshold when NEON is never faster
+
+// Fastest of a few rounds, nanoseconds a call
+template<typename Work> double fastestNs(Work work, int repetitions) {
+    double best = 0;
+    for (int round = 0; round < 5; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repetitions; i++) {
+            work();
+        }
+        double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()) / repetitions;
+        if (round == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+#if NEON_AVAILABLE
+// An NRCC message of about the given length - tags, links and entities as the feed sends them
+std::string nrccMessage(size_t length) {
+    static const std::string sample = "<p>Disruption between <a href=\"https://www.nationalrail.co.uk/\">Kettering</a> &amp; Bedford "
+                                      "&quot;until the end of the day&quot;. Tickets will be accepted on <b>buses</b> &#39;and&#39; other routes.</p>";
+    std::string message;
+    while (message.size() < length) message += sample;
+    message.resize(length);
+    return message;
+}
+#endif
+
+} // namespace
+
+std::string DeviceCalibration::deviceModel() {
+    std::ifstream file("/proc/device-tree/model");
+    std::string model;
+    std::getline(file, model, '\0');
+    return model;
+}
+
+// hzeller's guidance for --led-slowdown-gpio: a Pi 1/Zero needs none, a Pi 2 one, a Pi 3 (and Zero 2, the same SoC)
+// one or two and a Pi 4 at least four. The matrix library doesn't drive a Pi 5's GPIO the same way - left to config.txt.
+int DeviceCalibration::gpioSlowdownForModel(const std::string& model) {
+    if (model.find("Raspberry Pi 5") != std::string::npos) return -1;
+    if (model.find("Raspberry Pi 4") != std::string::npos || model.find("Raspberry Pi 400") != std::string::npos ||
+        model.find("Compute Module 4") != std::string::npos) return 4;
+    if (model.find("Raspberry Pi 3") != std::string::npos || model.find("Zero 2") != std::string::npos ||
+        model.find("Compute Module 3") != std::string::npos) return 2;
+    if (model.find("Raspberry Pi 2") != std::string::npos) return 1;
+    if (model.find("Raspberry Pi Zero") != std::string::npos || model.find("Raspberry Pi Model") != std::string::npos ||
+        model.find("Compute Module Rev") != std::string::npos) return 0;
+    return -1;
+}
+
+// The shortest message length from which NEON is faster than the plain loop - and stays faster for longer messages
+size_t DeviceCalibration::calibrateNeonThreshold(std::vector<std::string>& notes) {
+#if NEON_AVAILABLE
+    HTMLProcessor processor;
+    const std::array<size_t, 10> lengths = {{16, 32, 48, 64, 96, 128, 192, 256, 512, 1024}};
+    std::array<bool, 10> neon_faster;
+    volatile size_t sink = 0;
+
+    for (size_t i = 0; i < lengths.size(); i++) {
+        std::string message = nrccMessage(lengths[i]);
+        int repetitions = static_cast<int>(std::max<size_t>(50, 100000 / lengths[i]));
+        double regular = fastestNs([&]() { sink = sink + processor.processHtmlTagsRegularForced(message).size(); }, repetitions);
+        double neon = fastestNs([&]() { sink = sink + processor.processHtmlTagsNEONForced(message).size(); }, repetitions);
+        neon_faster[i] = neon < regular;
+        std::ostringstream note;
+        note << std::fixed << std::setprecision(0) << "HTML " << lengths[i] << " bytes: plain " << regular << " ns, NEON " << neon << " ns";
+        notes.push_back(note.str());
+    }
+
+    size_t threshold = NEON_NEVER;
+    for (size_t i = lengths.size(); i-- > 0; ) {
+        if (!neon_faster[i]) break;
+        threshold = lengths[i];
+    }
+    return threshold;
+#else
+    notes.push_back("HTML: no NEON in this build - the plain loop is always used");
+    return 64;
+#endif
+}
+
+// Text widths as a board asks for them - the rows on show asked for again and again, calling points and messages now
+// and then. A bigger cache misses less but a miss (a probe and the least recently used search) costs more.
+size_t DeviceCalibration::calibrateTextWidthCache(std::vector<std::string>& notes) {
+    static const std::array<const char*, 8> places = {{"London St Pancras", "Bedford", "Kettering", "Corby", "Nottingham",
+                                                       "Sheffield", "Leicester", "Luton Airport Parkway"}};
+    std::vector<std::string> strings;
+    for (int i = 0; i < 600; i++) {
+        std::ostringstream text;
+        switch (i % 3) {
+            case 0: text << std::setfill('0') << std::setw(2) << (i / 3) % 24 << ":" << std::setw(2) << (i * 7) % 60 << " " << places[i % places.size()]; break;
+            case 1: text << places[i % places.size()] << " (" << (i % 24) << ":" << (i % 50 + 10) << "), " << places[(i + 3) % places.size()]; break;
+            default: text << "Platform " << i % 20 << " " << i; break;
+        }
+        strings.push_back(text.str());
+    }
+    std::mt19937 random(89);
+    std::vector<size_t> asks(50000);
+    for (size_t& ask : asks) {
+        ask = (random() % 100 < 85) ? random() % 48 : random() % strings.size();      // 85% from the rows on show
+    }
+    std::array<int, 256> widths;
+    widths.fill(6);
+
+    const std::array<size_t, 5> capacities = {{64, 128, 256, 512, 1024}};
+    std::array<double, 5> times;
+    for (size_t c = 0; c < capacities.size(); c++) {
+        FixedLRUCache cache(capacities[c]);
+        volatile int sink = 0;
+        times[c] = fastestNs([&]() {
+            cache.clear();
+            for (size_t ask : asks) {
+                const std::string& text = strings[ask];
+                int width = cache.get(text);
+                if (width < 0) {
+                    width = 0;
+                    for (char ch : text) width += widths[static_cast<unsigned char>(ch)];
+                    cache.put(text, width);
+                }
+                sink = sink + width;
+            }
+        }, 1) / static_cast<double>(asks.size());
+        std::ostringstream note;
+        note << std::fixed << std::setprecision(1) << "Text width cache " << capacities[c] << " entries: " << times[c] << " ns a lookup";
+        notes.push_back(note.str());
+    }
+
+    double best = *std::min_element(times.begin(), times.end());
+    for (size_t c = 0; c < capacities.size(); c++) {
+        if (times[c] <= best * 1.05) return capacities[c];                         // The smallest within 5% of the fastest
+    }
+    return FixedLRUCache::DEFAULT_CAPACITY;
+}
+
+double DeviceCalibration::measureFrameInterval(MatrixDriver& matrix, int frames) {
+    std::vector<double> intervals;
+    matrix.render();
+    auto last = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        matrix.render();
+        auto now = std::chrono::steady_clock::now();
+        intervals.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count()) / 1000.0);
+        last = now;
+    }
+    if (intervals.empty()) return 0;
+    std::nth_element(intervals.begin(), intervals.begin() + static_cast<std::ptrdiff_t>(intervals.size() / 2), intervals.end());
+    return intervals[intervals.size() / 2];
+}
+
+int DeviceCalibration::roundToFrames(int slowdown_us, double frame_interval_us) {
+    if (frame_interval_us <= 0) return slowdown_us;
+    double frames = std::max(1.0, std::round(slowdown_us / frame_interval_us));
+    return static_cast<int>(std::lround(frames * frame_interval_us));
+}
+
+DeviceCalibration::Result DeviceCalibration::calibrate(const Config& config, MatrixDriver* matrix) {
+    Result result;
+    result.model = deviceModel();
+    result.notes.push_back("Device: " + (result.model.empty() ? std::string("unknown (not a Raspberry Pi?)") : result.model));
+
+    result.html_neon_threshold = calibrateNeonThreshold(result.notes);
+    result.text_width_cache_entries = calibrateTextWidthCache(result.notes);
+    result.gpio_slowdown = gpioSlowdownForModel(result.model);
+
+    if (matrix != nullptr) {
+        result.frame_interval_us = measureFrameInterval(*matrix, 300);
+        result.calling_point_slowdown = roundToFrames(config.getIntWithDefault("calling_point_slowdown", 8000), result.frame_interval_us);
+        result.nrcc_message_slowdown = roundToFrames(config.getIntWithDefault("nrcc_message_slowdown", 10000), result.frame_interval_us);
+        std::ostringstream note;
+        note << std::fixed << std::setprecision(0) << "Frame interval: " << result.frame_interval_us << " us (median of 300 frames)";
+        result.notes.push_back(note.str());
+    }
+    return result;
+}
+
+bool DeviceCalibration::writeProfile(const std::string& filename, const Result& result) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "[Calibration] Couldn't write the device profile " << filename << std::endl;
+        return false;
+    }
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M", std::localtime(&now));
+
+    file << "# Device profile - written by departureboard (calibration) on " << date << "\n"
+         << "# Settings in config.txt win over these - leave them out of config.txt to use the tuned values\n"
+         << "# Delete this file (or run 'departureboard --calibrate') to calibrate again\n";
+    for (const std::string& note : result.notes) {
+        file << "#   " << note << "\n";
+    }
+    for (const auto& setting : profileSettings(result)) {
+        file << setting.first << "=" << setting.second << "\n";
+    }
+    return file.good();
+}
+
+std::vector<std::pair<std::string, std::string>> DeviceCalibration::profileSettings(const Result& result) {
+    std::vector<std::pair<std::string, std::string>> settings = {
+        {"html_neon_threshold", std::to_string(result.html_neon_threshold)},
+        {"text_width_cache_entries", std::to_string(result.text_width_cache_entries)}
+    };
+    if (result.gpio_slowdown >= 0) {
+        settings.emplace_back("gpio_slowdown", std::to_string(result.gpio_slowdown));
+    }
+    if (result.frame_interval_us > 0) {
+        settings.emplace_back("calling_point_slowdown", std::to_string(result.calling_point_slowdown));
+        settings.emplace_back("nrcc_message_slowdown", std::to_string(result.nrcc_message_slowdown));
+    }
+    return settings;
+}
@@ -0,0 +1,55 @@
+//
+//  device_calibration.h
+//  Departure_Board
+//
+//  Tunes the performance settings whose best values depend on the Pi - measured on the device and written to a
+//  device profile (device_profile) which Config loads under config.txt (config.txt always wins).
+//
+//    html_neon_threshold       Shortest NRCC message the NEON HTML processor is faster for (timed against the plain loop)
+//    text_width_cache_entries  Size of the font cache's text width LRU - timed on a board-like mix of strings
+//    calling_point_slowdown    The scroll timings rounded to a whole number of frames, so every scroll step lands on
+//    nrcc_message_slowdown     a frame at the configured speed - from the measured frame interval (--calibrate only)
+//    gpio_slowdown             From the Pi model - a GPIO too fast for the panel shows as noise, which can't be timed
+//
+//  'departureboard --calibrate' runs the lot, the frame interval on the matrix. Without a profile a board calibrates
+//  the kernels at startup (auto_calibrate) - a second or so.
+//
+
+#ifndef DEVICE_CALIBRATION_H
+#define DEVICE_CALIBRATION_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include "config.h"
+
+class MatrixDriver;
+
+class DeviceCalibration {
+public:
+    struct Result {
+        std::string model;                                                          // From the device tree - empty if it isn't a Pi
+        size_t html_neon_threshold = 64;
+        size_t text_width_cache_entries = 256;
+        int gpio_slowdown = -1;                                                     // -1 - not a known Pi, left out of the profile
+        double frame_interval_us = 0;                                               // 0 - not measured, the scroll timings are left out
+        int calling_point_slowdown = 0;
+        int nrcc_message_slowdown = 0;
+        std::vector<std::string> notes;                                             // What was measured - written to the profile as comments
+    };
+
+    // Measure the kernels (and the frame interval if there's a matrix) - the scroll timings start from the configured ones
+    static Result calibrate(const Config& config, MatrixDriver* matrix);
+    static bool writeProfile(const std::string& filename, const Result& result);
+    static std::vector<std::pair<std::string, std::string>> profileSettings(const Result& result);   // The profile's key=value lines
+
+    static std::string deviceModel();                                               // "Raspberry Pi 4 Model B Rev 1.4" etc.
+    static int gpioSlowdownForModel(const std::string& model);                      // -1 if it isn't a model we know
+    static size_t calibrateNeonThreshold(std::vector<std::string>& notes);
+    static size_t calibrateTextWidthCache(std::vector<std::string>& notes);
+    static double measureFrameInterval(MatrixDriver& matrix, int frames);           // Median microseconds between frames
+    static int roundToFrames(int slowdown_us, double frame_interval_us);             // Nearest whole number of frames (at least one)
+};
+
+#endif // DEVICE_CALIBRATION_H
@@ -108,6 +108,12 @@ FixedLRUCache::Stats FixedLRUCache::getStats() const {
     return stats;
 }
 
+// Resize - the entries are dropped
+void FixedLRUCache::setCapacity(size_t capacity) {
+    cache_.assign(std::max<size_t>(capacity, 1), Entry());
+    counter_ = 0;
+}
+
 // Clear
 void FixedLRUCache::clear() {
     for (auto& entry : cache_) {
@@ -187,6 +193,10 @@ int FontCache::getTextWidth(const std::string& text) const {
     }
 }
 
+const std::array<int, 256>& FontCache::getCharWidths() const {
+    return char_widths;
+}
+
 int FontCache::getBaseline(){
     return baseline;
 }
@@ -199,6 +209,10 @@ bool FontCache::isloaded(){
     return font_loaded;
 }
 
+void FontCache::setCacheCapacity(size_t entries) {
+    string_width_cache_.setCapacity(entries);
+}
+
 void FontCache::printCacheStats() const {
     auto stats = string_width_cache_.getStats();
     DEBUG_PRINT("Font cache: " << stats.used_entries << "/"
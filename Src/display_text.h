@@ -29,6 +29,8 @@
 #include <stdexcept>
 #include <led-matrix.h>
 #include <unordered_map>
+#include <vector>
+#include <algorithm>
 
 using namespace rgb_matrix;
 
@@ -50,13 +52,19 @@ private:
         bool valid = false;                             // Is this entry in use?
     };
     
-    std::array<Entry, 256> cache_;                      // Fixed-size array (no malloc!)
+    std::vector<Entry> cache_;                          // Sized once (setCapacity) - no malloc while running
     uint64_t counter_ = 0;                              // Monotonic timestamp counter
     
     size_t hash(const std::string& key) const;          // Hash function for string to array index
     size_t findLRU() const;
     
 public:
+    static constexpr size_t DEFAULT_CAPACITY = 256;
+    
+    explicit FixedLRUCache(size_t capacity = DEFAULT_CAPACITY) : cache_(std::max<size_t>(capacity, 1)) {}
+    void setCapacity(size_t capacity);                  // Resize (and clear) - text_width_cache_entries, tuned per device
+    size_t capacity() const { return cache_.size(); }
+    
     struct Stats {                                      // Cache statistics
             size_t used_entries = 0;
             size_t total_entries = 0;
@@ -110,6 +118,13 @@ public:
      */
     int getTextWidth(const std::string& text) const;
     
+    /**
+     * Return the table of character widths (indexed by unsigned char)
+     * For measuring text as it is built, without the string cache
+     * @return The character widths
+     */
+    const std::array<int, 256>& getCharWidths() const;
+    
     /**
      * Return the font basline (x size)
      * @return The font baseline
@@ -128,6 +143,12 @@ public:
      */
     bool isloaded();
     
+    /**
+     * Set the number of text widths cached (clears the cache)
+     * @param entries The number of entries
+     */
+    void setCacheCapacity(size_t entries);
+    
     /**
      * Print the caching stats
      */
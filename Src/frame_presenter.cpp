@@ -0,0 +1,131 @@
+//
+//  frame_presenter.cpp
+//  Departure_Board
+//
+//  Pushes frames to the matrix and swaps them on vsync - on its own thread when pipelined. See frame_presenter.h
+//
+
+#include <chrono>
+#include <algorithm>
+#include "frame_presenter.h"
+
+namespace {
+
+uint64_t nanosecondsSince(const std::chrono::steady_clock::time_point& start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+} // namespace
+
+FramePresenter::FramePresenter(rgb_matrix::Canvas* canvas, Swap swap, bool pipelined) :
+swap(std::move(swap)),
+mapper(nullptr),
+canvas(canvas),
+swapping(false),
+stopping(false) {
+    if (pipelined && this->swap) {
+        present_thread = std::thread(&FramePresenter::presentLoop, this);
+    }
+}
+
+FramePresenter::~FramePresenter() {
+    if (present_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        swap_requested.notify_one();
+        present_thread.join();                                                      // The swap in progress is finished first
+    }
+}
+
+size_t FramePresenter::present(PaletteFramebuffer& framebuffer) {
+    uint64_t wait_ns = waitForSwap();                                               // The canvas the last swap handed back
+
+    auto push_start = std::chrono::steady_clock::now();
+    size_t pixels = framebuffer.push(canvas, mapper);                               // Only the pixels changed since this canvas was last shown
+    uint64_t push_ns = nanosecondsSince(push_start);
+
+    uint64_t swap_ns = 0;
+    if (swap && !present_thread.joinable()) {                                       // Not pipelined - all of the swap is waited for here
+        auto swap_start = std::chrono::steady_clock::now();
+        canvas = swap(canvas);
+        swap_ns = nanosecondsSince(swap_start);
+        wait_ns = swap_ns;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        metrics.frames++;
+        metrics.total_push_ns += push_ns;
+        metrics.max_push_ns = std::max(metrics.max_push_ns, push_ns);
+        metrics.total_wait_ns += wait_ns;
+        metrics.max_wait_ns = std::max(metrics.max_wait_ns, wait_ns);
+        metrics.total_swap_ns += swap_ns;
+        metrics.pixels_pushed += pixels;
+        if (present_thread.joinable()) {
+            swapping = true;                                                        // Over to the presenter's thread
+        }
+    }
+    if (present_thread.joinable()) {
+        swap_requested.notify_one();
+    }
+    return pixels;
+}
+
+void FramePresenter::countCompose(uint64_t compose_ns) {
+    std::lock_guard<std::mutex> lock(mutex);
+    metrics.total_compose_ns += compose_ns;
+    metrics.max_compose_ns = std::max(metrics.max_compose_ns, compose_ns);
+}
+
+void FramePresenter::finish() {
+    waitForSwap();
+}
+
+rgb_matrix::Canvas* FramePresenter::getCanvas() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return canvas;
+}
+
+FramePresenter::Metrics FramePresenter::getMetrics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return metrics;
+}
+
+void FramePresenter::resetMetrics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    metrics = Metrics();
+}
+
+uint64_t FramePresenter::waitForSwap() {
+    if (!present_thread.joinable()) {
+        return 0;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    swap_done.wait(lock, [this]() { return !swapping; });
+    return nanosecondsSince(start);
+}
+
+void FramePresenter::presentLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        swap_requested.wait(lock, [this]() { return swapping || stopping; });
+        if (!swapping) {
+            break;                                                                  // Stopping with nothing left to show
+        }
+        rgb_matrix::Canvas* shown = canvas;
+        lock.unlock();
+
+        auto swap_start = std::chrono::steady_clock::now();
+        rgb_matrix::Canvas* next = swap(shown);                                     // Blocks until the panel shows it
+        uint64_t swap_ns = nanosecondsSince(swap_start);
+
+        lock.lock();
+        canvas = next;
+        swapping = false;
+        metrics.total_swap_ns += swap_ns;
+        swap_done.notify_all();
+    }
+}
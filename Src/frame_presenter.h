@@ -0,0 +1,81 @@
+//
+//  frame_presenter.h
+//  Departure_Board
+//
+//  Shows the frames drawn in the palette framebuffer on the matrix. SwapOnVSync blocks until the panel has shown
+//  the frame - time the render loop could spend composing the next one. Pipelined, the swap is done on the
+//  presenter's own thread: frame N waits for vsync while frame N+1 is composed (scroll positions moved, rows
+//  drawn and the changed pixels found) in the framebuffer. present() then waits for the canvas the swap hands
+//  back and pushes the changed spans into it - a short copy - before passing it to the thread to swap.
+//
+//  The framebuffer is only touched on the render loop's thread - the presenter's thread only ever holds a canvas.
+//
+//  Compose (counted by the caller), push, the wait for the swap and the swap itself are timed separately
+//  (getMetrics) - pipelined, the wait is the swap less the compose that overlapped it.
+//
+
+#ifndef FRAME_PRESENTER_H
+#define FRAME_PRESENTER_H
+
+#include <led-matrix.h>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "palette_framebuffer.h"
+
+class FramePresenter {
+public:
+    using Swap = std::function<rgb_matrix::Canvas*(rgb_matrix::Canvas*)>;          // Shows a canvas, returns the one to draw into next
+
+    struct Metrics {
+        uint64_t frames = 0;
+        uint64_t total_compose_ns = 0;                                              // Drawing the frame into the framebuffer (countCompose)
+        uint64_t max_compose_ns = 0;
+        uint64_t total_push_ns = 0;                                                 // Changed spans from the framebuffer to the canvas
+        uint64_t max_push_ns = 0;
+        uint64_t total_wait_ns = 0;                                                 // Render loop blocked on the swap - the vsync wait not overlapped
+        uint64_t max_wait_ns = 0;
+        uint64_t total_swap_ns = 0;                                                 // In SwapOnVSync
+        uint64_t pixels_pushed = 0;
+    };
+
+    /**
+     * @param canvas First canvas to draw into
+     * @param swap Shows a canvas and returns the next (SwapOnVSync) - empty when there's nothing to swap (headless)
+     * @param pipelined Swap on the presenter's thread, overlapping the next compose
+     */
+    FramePresenter(rgb_matrix::Canvas* canvas, Swap swap, bool pipelined);
+    ~FramePresenter();                                                              // Waits for the swap in progress
+
+    FramePresenter(const FramePresenter&) = delete;
+    FramePresenter& operator=(const FramePresenter&) = delete;
+
+    size_t present(PaletteFramebuffer& framebuffer);                                // Push the changes and show the frame - pixels pushed
+    void countCompose(uint64_t compose_ns);                                         // Time the caller took to draw the frame
+    void finish();                                                                  // Wait for the frame being swapped - the canvas is free to use
+    void setMapper(const PixelMapperLUT* lut) { mapper = lut; }                     // Push through the led-pixel-mapper table (nullptr - as drawn)
+
+    bool isPipelined() const { return present_thread.joinable(); }
+    rgb_matrix::Canvas* getCanvas();                                                // Canvas the next frame is pushed to (after finish())
+    Metrics getMetrics() const;
+    void resetMetrics();
+
+private:
+    void presentLoop();
+    uint64_t waitForSwap();                                                         // Nanoseconds blocked
+
+    Swap swap;
+    const PixelMapperLUT* mapper;
+    rgb_matrix::Canvas* canvas;                                                     // Owned by the render loop unless swapping
+    bool swapping;                                                                  // Canvas handed to the presenter's thread
+    bool stopping;
+    Metrics metrics;                                                                // Swap times are added by the presenter's thread
+    mutable std::mutex mutex;
+    std::condition_variable swap_requested;
+    std::condition_variable swap_done;
+    std::thread present_thread;
+};
+
+#endif // FRAME_PRESENTER_H
@@ -0,0 +1,138 @@
+//
+//  frame_receiver.cpp
+//  Departure_Board
+//
+//  departureboard_receiver - a remote display node. Shows the frames streamed by a departure board (stream_to) on
+//  its own matrix. Needs only the matrix settings from config.txt - no API keys, parser or font.
+//
+//  The departure board connects to the receiver - run one receiver per Pi and list them in the board's stream_to.
+//
+
+#include <signal.h>
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <memory>
+#include "config.h"
+#include "matrix_driver.h"
+#include "frame_stream.h"
+#include "frame_presenter.h"
+
+bool debug_mode = false;                                                                // Global debug flag
+
+namespace {
+
+std::atomic<bool> running(true);
+
+void signalHandler(int signum) {
+    std::cout << "\nReceived signal " << signum << ". Shutting down..." << std::endl;
+    running = false;
+}
+
+void showUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [OPTIONS]\n"
+              << "Shows the frames a departure board streams to it (stream_to in the board's config.txt)\n"
+              << "Options:\n"
+              << "  -f, --config FILE   Configuration file - the matrix settings, stream_port and receiver_board (default ./config.txt)\n"
+              << "  -p, --port PORT     Port to listen on (default stream_port)\n"
+              << "  -b, --board N       Show only board N (default receiver_board - -1 for any)\n"
+              << "  --headless          No matrix - receive, decode and report only (testing over loopback)\n"
+              << "  -d, --debug         Enable debug output - statistics every minute\n"
+              << "  -h, --help          Show this help message\n";
+}
+
+void report(const FrameStream::FrameReceiver::Metrics& m, size_t pixels_pushed) {
+    std::cout << std::fixed << std::setprecision(1)
+              << "[Receiver] " << m.frames << " frames (" << m.key_frames << " key, " << m.skipped << " skipped, " << m.rejected << " rejected), "
+              << m.bytes / 1024 << " KB, " << static_cast<double>(m.bytes) / std::max<uint64_t>(m.frames, 1) << " bytes a frame, decoding "
+              << m.total_decode_ns / 1000.0 / std::max<uint64_t>(m.frames, 1) << " us mean / " << m.max_decode_ns / 1000.0 << " us max, "
+              << pixels_pushed << " pixels pushed" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    std::string config_file = "./config.txt";
+    int port = -1;
+    int board = -2;
+    bool headless = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "-f" || arg == "--config") && i + 1 < argc) {
+            config_file = argv[++i];
+        } else if ((arg == "-p" || arg == "--port") && i + 1 < argc) {
+            port = std::atoi(argv[++i]);
+        } else if ((arg == "-b" || arg == "--board") && i + 1 < argc) {
+            board = std::atoi(argv[++i]);
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "-d" || arg == "--debug") {
+            debug_mode = true;
+        } else {
+            showUsage(argv[0]);
+            return (arg == "-h" || arg == "--help") ? 0 : 1;
+        }
+    }
+
+    try {
+        Config config;
+        config.loadFromFile(config_file);
+        if (port < 0) port = config.getIntWithDefault("stream_port", FrameStream::DEFAULT_PORT);
+        if (board < -1) board = config.getIntWithDefault("receiver_board", -1);
+        headless = headless || config.getBoolWithDefault("headless", false);
+
+        RGBMatrix* matrix = nullptr;
+        std::unique_ptr<OffscreenCanvas> offscreen_canvas;
+        std::unique_ptr<FramePresenter> presenter;
+        Config::matrix_options matrix_parameters = config.getMatrixOptions();          // Kept - the options point into its strings
+        if (headless) {
+            offscreen_canvas.reset(new OffscreenCanvas(matrix_parameters.matrixcols * matrix_parameters.matrixchain_length,
+                                                       matrix_parameters.matrixrows * matrix_parameters.matrixparallel));
+            presenter.reset(new FramePresenter(offscreen_canvas.get(), nullptr, false));
+        } else {
+            RGBMatrix::Options matrix_options;
+            RuntimeOptions runtime_opt;
+            MatrixDriver::configureMatrixOptions(matrix_parameters, matrix_options);
+            MatrixDriver::configureRuntimeOptions(matrix_parameters, runtime_opt);
+            matrix = RGBMatrix::CreateFromOptions(matrix_options, runtime_opt);
+            if (matrix == nullptr) {
+                throw std::runtime_error("Could not create matrix");
+            }
+            presenter.reset(new FramePresenter(matrix->CreateFrameCanvas(), [matrix](Canvas* shown) -> Canvas* {
+                return matrix->SwapOnVSync(static_cast<FrameCanvas*>(shown));
+            }, config.getBoolWithDefault("present_thread", true)));                     // The next frame is decoded while the last waits for vsync
+        }
+
+        FrameStream::FrameReceiver receiver(port, board);
+        std::cout << "Departureboard receiver listening on port " << receiver.port()
+                  << (board >= 0 ? " for board " + std::to_string(board) : std::string()) << ". Press Ctrl+C to exit." << std::endl;
+
+        size_t pixels_pushed = 0;
+        auto last_report = std::chrono::steady_clock::now();
+        while (running) {
+            if (receiver.receive(std::chrono::milliseconds(100))) {
+                pixels_pushed += presenter->present(receiver.getFramebuffer());         // Only the pixels changed since the canvas was last shown
+                receiver.acknowledge();
+            }
+            if (debug_mode && std::chrono::steady_clock::now() - last_report >= std::chrono::minutes(1)) {
+                report(receiver.getMetrics(), pixels_pushed);
+                receiver.resetMetrics();
+                pixels_pushed = 0;
+                last_report = std::chrono::steady_clock::now();
+            }
+        }
+
+        report(receiver.getMetrics(), pixels_pushed);
+        presenter.reset();                                                              // Finishes the swap in progress
+        delete matrix;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
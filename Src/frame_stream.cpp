@@ -0,0 +1,628 @@
+//
+//  frame_stream.cpp
+//  Departure_Board
+//
+//  Frame streaming to remote display nodes - see frame_stream.h
+//
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "frame_stream.h"
+
+// Forward declaration for the debug printing macro
+extern bool debug_mode;
+#define DEBUG_PRINT(x) if(debug_mode) { std::cerr << x << std::endl; }
+
+namespace FrameStream {
+
+namespace {
+
+constexpr size_t MAX_BACKLOG = 256 * 1024;                                          // Bytes queued to a receiver before its frames are dropped
+constexpr std::chrono::seconds RECONNECT_INTERVAL(2);
+constexpr size_t READ_CHUNK = 64 * 1024;
+constexpr uint32_t MAX_PAYLOAD = 4 * 1024 * 1024;                                   // Anything bigger is damage, not a frame
+constexpr uint32_t MAX_FRAME_PIXELS = 1024 * 1024;                                  // More than any chain of panels - a bigger frame is damage (or hostile)
+
+void putVarint(uint64_t value, std::vector<uint8_t>& out) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool getVarint(const uint8_t* in, size_t size, size_t& position, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && position < size; shift += 7) {
+        uint8_t byte = in[position++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+void put16(uint16_t value, uint8_t* out) {
+    out[0] = static_cast<uint8_t>(value >> 8);
+    out[1] = static_cast<uint8_t>(value);
+}
+
+void put32(uint32_t value, uint8_t* out) {
+    for (int i = 0; i < 4; i++) out[i] = static_cast<uint8_t>(value >> (24 - 8 * i));
+}
+
+void put64(uint64_t value, uint8_t* out) {
+    for (int i = 0; i < 8; i++) out[i] = static_cast<uint8_t>(value >> (56 - 8 * i));
+}
+
+uint16_t get16(const uint8_t* in) {
+    return static_cast<uint16_t>((in[0] << 8) | in[1]);
+}
+
+uint32_t get32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value = (value << 8) | in[i];
+    return value;
+}
+
+uint64_t get64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value = (value << 8) | in[i];
+    return value;
+}
+
+bool samePalette(const PaletteFramebuffer::Palette& a, const PaletteFramebuffer::Palette& b) {
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].r != b[i].r || a[i].g != b[i].g || a[i].b != b[i].b) return false;
+    }
+    return true;
+}
+
+bool wouldBlock() {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+} // namespace
+
+size_t encodeDelta(const uint8_t* frame, const uint8_t* previous, size_t size, std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    size_t i = 0;
+    while (i < size) {
+        size_t run_start = i;
+        while (i < size && frame[i] == previous[i]) i++;
+        size_t literal_start = i;
+        while (i < size) {
+            if (frame[i] != previous[i]) {
+                i++;
+                continue;
+            }
+            size_t same = i;                                                        // A short gap stays in the literals - cheaper than two more varints
+            while (same < size && frame[same] == previous[same] && same - i < 3) same++;
+            if (same - i >= 3 || same == size) break;
+            i = same;
+        }
+        putVarint(literal_start - run_start, out);
+        putVarint(i - literal_start, out);
+        for (size_t k = literal_start; k < i; k++) {
+            out.push_back(frame[k] ^ previous[k]);
+        }
+    }
+    return out.size() - start;
+}
+
+bool applyDelta(const uint8_t* payload, size_t payload_bytes, uint8_t* frame, size_t size) {
+    size_t position = 0;
+    size_t p = 0;
+    while (p < payload_bytes) {
+        uint64_t run;
+        uint64_t count;
+        if (!getVarint(payload, payload_bytes, p, run) || !getVarint(payload, payload_bytes, p, count)) return false;
+        if (run > size - position) return false;
+        position += run;
+        if (count > size - position || count > payload_bytes - p) return false;
+        for (uint64_t k = 0; k < count; k++) {
+            frame[position++] ^= payload[p++];
+        }
+    }
+    return true;
+}
+
+void writeHeader(const FrameHeader& header, uint8_t* out) {
+    std::memcpy(out, "DBFS", 4);
+    out[4] = VERSION;
+    out[5] = header.type;
+    out[6] = header.board;
+    out[7] = header.flags;
+    put32(header.sequence, out + 8);
+    put16(header.width, out + 12);
+    put16(header.height, out + 14);
+    put64(header.sent_ns, out + 16);
+    put32(header.payload_bytes, out + 24);
+}
+
+bool readHeader(const uint8_t* in, FrameHeader& header) {
+    if (std::memcmp(in, "DBFS", 4) != 0 || in[4] != VERSION || (in[5] != KEY_FRAME && in[5] != DELTA_FRAME)) {
+        return false;
+    }
+    header.type = in[5];
+    header.board = in[6];
+    header.flags = in[7];
+    header.sequence = get32(in + 8);
+    header.width = get16(in + 12);
+    header.height = get16(in + 14);
+    header.sent_ns = get64(in + 16);
+    header.payload_bytes = get32(in + 24);
+    return header.payload_bytes <= MAX_PAYLOAD && header.width > 0 && header.height > 0 &&
+           static_cast<uint32_t>(header.width) * header.height <= MAX_FRAME_PIXELS;     // The receiver allocates a framebuffer this size
+}
+
+uint64_t nowNanoseconds() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+
+// Sender
+
+struct FrameSender::Connection {
+    std::string host;
+    std::string port;
+    sockaddr_storage address;
+    socklen_t address_length = 0;                                                   // 0 until the host is resolved
+    int socket = -1;
+    bool connecting = false;                                                        // Non-blocking connect in progress
+    bool needs_key_frame = true;
+    std::vector<uint8_t> pending;                                                   // Queued and not yet written
+    size_t pending_start = 0;
+    std::vector<uint8_t> acks;                                                      // Partial acks read
+    std::chrono::steady_clock::time_point next_attempt;
+
+    bool ready() const { return socket >= 0 && !connecting; }
+    size_t backlog() const { return pending.size() - pending_start; }
+};
+
+FrameSender::FrameSender(const std::string& receivers, uint8_t board_number, int key_frames) : board(board_number), key_frame_interval(key_frames) {
+    size_t start = 0;
+    while (start <= receivers.size()) {
+        size_t end = receivers.find(',', start);
+        if (end == std::string::npos) end = receivers.size();
+        std::string receiver = receivers.substr(start, end - start);
+        receiver.erase(0, receiver.find_first_not_of(" \t"));
+        receiver.erase(receiver.find_last_not_of(" \t") + 1);
+        if (!receiver.empty()) {
+            std::unique_ptr<Connection> connection(new Connection());
+            size_t colon = receiver.rfind(':');
+            connection->host = receiver.substr(0, colon);
+            connection->port = (colon == std::string::npos) ? std::to_string(DEFAULT_PORT) : receiver.substr(colon + 1);
+            connection->next_attempt = std::chrono::steady_clock::now();
+            connections.push_back(std::move(connection));
+        }
+        start = end + 1;
+    }
+    if (connections.empty()) {
+        throw std::runtime_error("[Frame_Stream] No receivers in '" + receivers + "'");
+    }
+    previous_palette.fill(rgb_matrix::Color(0, 0, 0));
+    DEBUG_PRINT("[Frame_Stream] Board " << static_cast<int>(board) << " streaming to " << connections.size() << " receiver(s)");
+}
+
+FrameSender::~FrameSender() {
+    for (auto& connection : connections) {
+        if (connection->socket >= 0) ::close(connection->socket);
+    }
+}
+
+void FrameSender::disconnect(Connection& connection, const char* reason) {
+    DEBUG_PRINT("[Frame_Stream] Receiver " << connection.host << ":" << connection.port << " " << reason);
+    ::close(connection.socket);
+    connection.socket = -1;
+    connection.connecting = false;
+    connection.pending.clear();
+    connection.pending_start = 0;
+    connection.acks.clear();
+    connection.needs_key_frame = true;
+    connection.next_attempt = std::chrono::steady_clock::now() + RECONNECT_INTERVAL;
+}
+
+void FrameSender::connect(Connection& connection) {
+    auto now = std::chrono::steady_clock::now();
+    if (connection.socket < 0) {
+        if (now < connection.next_attempt) return;
+        connection.next_attempt = now + RECONNECT_INTERVAL;
+
+        if (connection.address_length == 0) {                                       // Resolved once - a numeric address doesn't wait on DNS
+            addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* result = nullptr;
+            if (getaddrinfo(connection.host.c_str(), connection.port.c_str(), &hints, &result) != 0 || result == nullptr) {
+                DEBUG_PRINT("[Frame_Stream] Can't resolve receiver " << connection.host << ":" << connection.port);
+                return;
+            }
+            std::memcpy(&connection.address, result->ai_addr, result->ai_addrlen);
+            connection.address_length = result->ai_addrlen;
+            freeaddrinfo(result);
+        }
+
+        connection.socket = ::socket(connection.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (connection.socket < 0) return;
+        int on = 1;
+        setsockopt(connection.socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));  // Frames are small and latency matters
+
+        if (::connect(connection.socket, reinterpret_cast<sockaddr*>(&connection.address), connection.address_length) == 0) {
+            connection.connecting = false;
+        } else if (errno == EINPROGRESS) {
+            connection.connecting = true;
+        } else {
+            ::close(connection.socket);
+            connection.socket = -1;
+            return;
+        }
+        if (!connection.connecting) {
+            connection.needs_key_frame = true;
+            std::lock_guard<std::mutex> lock(metrics_mutex);
+            metrics.connects++;
+            DEBUG_PRINT("[Frame_Stream] Connected to receiver " << connection.host << ":" << connection.port);
+        }
+    }
+
+    if (connection.connecting) {
+        pollfd fd = {connection.socket, POLLOUT, 0};
+        if (::poll(&fd, 1, 0) <= 0) return;
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(connection.socket, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+            ::close(connection.socket);                                             // Nobody listening yet - quietly try again later
+            connection.socket = -1;
+            connection.connecting = false;
+            return;
+        }
+        connection.connecting = false;
+        connection.needs_key_frame = true;
+        std::lock_guard<std::mutex> lock(metrics_mutex);
+        metrics.connects++;
+        DEBUG_PRINT("[Frame_Stream] Connected to receiver " << connection.host << ":" << connection.port);
+    }
+}
+
+void FrameSender::flush(Connection& connection) {
+    while (connection.backlog() > 0) {
+        ssize_t written = ::send(connection.socket, connection.pending.data() + connection.pending_start, connection.backlog(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (written > 0) {
+            connection.pending_start += static_cast<size_t>(written);
+        } else if (written < 0 && wouldBlock()) {
+            return;
+        } else {
+            disconnect(connection, "disconnected");
+            return;
+        }
+    }
+    connection.pending.clear();
+    connection.pending_start = 0;
+}
+
+void FrameSender::readAcks(Connection& connection) {
+    uint8_t chunk[512];
+    while (true) {
+        ssize_t bytes = ::recv(connection.socket, chunk, sizeof(chunk), MSG_DONTWAIT);
+        if (bytes > 0) {
+            connection.acks.insert(connection.acks.end(), chunk, chunk + bytes);
+        } else if (bytes < 0 && wouldBlock()) {
+            break;
+        } else {
+            disconnect(connection, "closed the connection");
+            return;
+        }
+    }
+
+    size_t position = 0;
+    uint64_t now = nowNanoseconds();
+    for (; connection.acks.size() - position >= ACK_BYTES; position += ACK_BYTES) {
+        const uint8_t* ack = connection.acks.data() + position;
+        if (std::memcmp(ack, "DBFA", 4) != 0) {
+            disconnect(connection, "sent something which isn't an ack");
+            return;
+        }
+        if (ack[4] != board) continue;
+        uint64_t sent_ns = get64(ack + 12);
+        uint64_t latency = now > sent_ns ? now - sent_ns : 0;
+        std::lock_guard<std::mutex> lock(metrics_mutex);
+        metrics.acks++;
+        metrics.total_latency_ns += latency;
+        metrics.max_latency_ns = std::max(metrics.max_latency_ns, latency);
+    }
+    connection.acks.erase(connection.acks.begin(), connection.acks.begin() + static_cast<std::ptrdiff_t>(position));
+}
+
+void FrameSender::poll() {
+    for (auto& connection : connections) {
+        connect(*connection);
+        if (!connection->ready()) continue;
+        flush(*connection);
+        if (connection->ready()) readAcks(*connection);
+    }
+    countConnected();
+}
+
+void FrameSender::countConnected() {
+    connected_count = static_cast<size_t>(std::count_if(connections.begin(), connections.end(), [](const std::unique_ptr<Connection>& connection) { return connection->ready(); }));
+}
+
+FrameSender::Metrics FrameSender::getMetrics() const {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    return metrics;
+}
+
+void FrameSender::resetMetrics() {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    metrics = Metrics();
+}
+
+size_t FrameSender::queued() const {
+    size_t bytes = 0;
+    for (const auto& connection : connections) bytes += connection->backlog();
+    return bytes;
+}
+
+void FrameSender::buildMessage(uint8_t type, bool with_palette, const PaletteFramebuffer& frame, const uint8_t* against, uint64_t sent_ns, std::vector<uint8_t>& message) {
+    const std::vector<uint8_t>& packed = frame.getPacked();
+    message.resize(HEADER_BYTES);
+    if (with_palette) {
+        for (const rgb_matrix::Color& colour : frame.getPalette()) {
+            message.push_back(colour.r);
+            message.push_back(colour.g);
+            message.push_back(colour.b);
+        }
+    }
+    size_t payload = encodeDelta(packed.data(), against, packed.size(), message);
+
+    FrameHeader header;
+    header.type = type;
+    header.board = board;
+    header.flags = with_palette ? FLAG_PALETTE : 0;
+    header.sequence = sequence;
+    header.width = static_cast<uint16_t>(frame.width());
+    header.height = static_cast<uint16_t>(frame.height());
+    header.sent_ns = sent_ns;
+    header.payload_bytes = static_cast<uint32_t>(payload);
+    writeHeader(header, message.data());
+}
+
+void FrameSender::send(const PaletteFramebuffer& frame) {
+    auto start = std::chrono::steady_clock::now();
+    poll();
+
+    const std::vector<uint8_t>& packed = frame.getPacked();
+    if (frame.width() != previous_width || frame.height() != previous_height || previous.size() != packed.size()) {
+        previous.assign(packed.size(), 0);
+        empty.assign(packed.size(), 0);
+        previous_width = frame.width();
+        previous_height = frame.height();
+        for (auto& connection : connections) connection->needs_key_frame = true;
+    }
+    bool palette_changed = !samePalette(frame.getPalette(), previous_palette);
+    if (key_frame_interval > 0 && ++frames_since_key >= key_frame_interval) {
+        frames_since_key = 0;
+        for (auto& connection : connections) connection->needs_key_frame = true;
+    }
+    sequence++;
+
+    bool want_delta = false;
+    bool want_key = false;
+    uint64_t key_frames = 0;
+    uint64_t dropped = 0;
+    uint64_t sent = 0;
+    uint64_t bytes = 0;
+    uint64_t max_frame_bytes = 0;
+    for (auto& connection : connections) {
+        if (!connection->ready()) continue;
+        (connection->needs_key_frame ? want_key : want_delta) = true;
+    }
+
+    if (want_delta || want_key) {
+        uint64_t sent_ns = nowNanoseconds();
+        if (want_delta) buildMessage(DELTA_FRAME, palette_changed, frame, previous.data(), sent_ns, delta_message);
+        if (want_key) {
+            buildMessage(KEY_FRAME, true, frame, empty.data(), sent_ns, key_message);
+            key_frames++;
+        }
+
+        for (auto& connection : connections) {
+            if (!connection->ready()) continue;
+            if (connection->backlog() > MAX_BACKLOG) {                              // Too far behind - skip frames until it catches up, then start again from a key frame
+                dropped++;
+                connection->needs_key_frame = true;
+                continue;
+            }
+            const std::vector<uint8_t>& message = connection->needs_key_frame ? key_message : delta_message;
+            connection->pending.insert(connection->pending.end(), message.begin(), message.end());
+            connection->needs_key_frame = false;
+            sent++;
+            bytes += message.size();
+            max_frame_bytes = std::max<uint64_t>(max_frame_bytes, message.size());
+            flush(*connection);
+        }
+    }
+
+    previous = packed;
+    previous_palette = frame.getPalette();
+    countConnected();
+    uint64_t encode_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    std::lock_guard<std::mutex> lock(metrics_mutex);                                // Counted here in one go - the report may be reading them
+    metrics.frames++;
+    metrics.key_frames += key_frames;
+    metrics.dropped += dropped;
+    metrics.sent += sent;
+    metrics.bytes += bytes;
+    metrics.max_frame_bytes = std::max(metrics.max_frame_bytes, max_frame_bytes);
+    metrics.total_encode_ns += encode_ns;
+    metrics.max_encode_ns = std::max(metrics.max_encode_ns, encode_ns);
+}
+
+
+// Receiver
+
+FrameReceiver::FrameReceiver(int port, int board_number) : board(board_number) {
+    listen_socket = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_socket < 0) {
+        throw std::runtime_error("[Frame_Stream] Couldn't create the receiver's socket");
+    }
+    int on = 1;
+    setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (::bind(listen_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listen_socket, 1) != 0) {
+        ::close(listen_socket);
+        throw std::runtime_error("[Frame_Stream] Couldn't listen on port " + std::to_string(port) + ": " + std::strerror(errno));
+    }
+    socklen_t length = sizeof(address);
+    getsockname(listen_socket, reinterpret_cast<sockaddr*>(&address), &length);
+    listen_port = ntohs(address.sin_port);
+    DEBUG_PRINT("[Frame_Stream] Receiver listening on port " << listen_port);
+}
+
+FrameReceiver::~FrameReceiver() {
+    if (client_socket >= 0) ::close(client_socket);
+    if (listen_socket >= 0) ::close(listen_socket);
+}
+
+void FrameReceiver::closeClient(const char* reason) {
+    DEBUG_PRINT("[Frame_Stream] Sender " << reason);
+    if (client_socket >= 0) ::close(client_socket);
+    client_socket = -1;
+    buffer.clear();
+    buffer_start = 0;
+    have_key_frame = false;
+    ack_due = false;
+}
+
+bool FrameReceiver::applyNextMessage() {
+    while (buffer.size() - buffer_start >= HEADER_BYTES) {
+        const uint8_t* message = buffer.data() + buffer_start;
+        FrameHeader header;
+        if (!readHeader(message, header)) {
+            metrics.rejected++;
+            closeClient("sent a damaged frame");
+            return false;
+        }
+        size_t palette_bytes = (header.flags & FLAG_PALETTE) ? PALETTE_BYTES : 0;
+        size_t length = HEADER_BYTES + palette_bytes + header.payload_bytes;
+        if (buffer.size() - buffer_start < length) return false;                   // Wait for the rest
+        buffer_start += length;
+        metrics.bytes += length;
+
+        if (board >= 0 && header.board != board) {
+            metrics.skipped++;
+            continue;
+        }
+        if (header.type == DELTA_FRAME && (!have_key_frame || header.width != framebuffer->width() || header.height != framebuffer->height())) {
+            metrics.skipped++;                                                      // Nothing to apply it to - wait for a key frame
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (header.type == KEY_FRAME) {
+            if (!framebuffer || header.width != framebuffer->width() || header.height != framebuffer->height()) {
+                DEBUG_PRINT("[Frame_Stream] Frames are " << header.width << " x " << header.height);
+                framebuffer.reset(new PaletteFramebuffer(header.width, header.height));
+            }
+            frame.assign(framebuffer->getPacked().size(), 0);
+        }
+        if (!applyDelta(message + HEADER_BYTES + palette_bytes, header.payload_bytes, frame.data(), frame.size())) {
+            metrics.rejected++;
+            closeClient("sent a frame which doesn't fit");
+            return false;
+        }
+        if (palette_bytes > 0) {
+            PaletteFramebuffer::Palette palette;
+            const uint8_t* colours = message + HEADER_BYTES;
+            for (size_t i = 0; i < palette.size(); i++) {
+                palette[i] = rgb_matrix::Color(colours[i * 3], colours[i * 3 + 1], colours[i * 3 + 2]);
+            }
+            if (!samePalette(palette, framebuffer->getPalette())) framebuffer->setPalette(palette);
+        }
+        framebuffer->setPacked(frame);
+
+        have_key_frame = true;
+        metrics.frames++;
+        if (header.type == KEY_FRAME) metrics.key_frames++;
+        uint64_t decode_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        metrics.total_decode_ns += decode_ns;
+        metrics.max_decode_ns = std::max(metrics.max_decode_ns, decode_ns);
+        last_applied = header;
+        ack_due = true;
+        return true;
+    }
+    return false;
+}
+
+bool FrameReceiver::receive(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        bool applied = false;
+        while (applyNextMessage()) applied = true;                                  // Catch up - only the newest frame is shown
+        if (buffer_start > 0 && buffer_start * 2 >= buffer.size()) {
+            buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(buffer_start));
+            buffer_start = 0;
+        }
+        if (applied) return true;
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() < 0) return false;
+
+        pollfd fds[2] = {{listen_socket, POLLIN, 0}, {client_socket, POLLIN, 0}};
+        int ready = ::poll(fds, client_socket >= 0 ? 2 : 1, static_cast<int>(remaining.count()));
+        if (ready <= 0) {
+            if (ready == 0 || !wouldBlock()) return false;
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int accepted = ::accept4(listen_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (accepted >= 0) {
+                if (client_socket >= 0) closeClient("replaced by a new connection");
+                client_socket = accepted;
+                int on = 1;
+                setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                metrics.connections++;
+                DEBUG_PRINT("[Frame_Stream] Sender connected");
+            }
+        }
+        if (client_socket >= 0 && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            size_t used = buffer.size();
+            buffer.resize(used + READ_CHUNK);
+            ssize_t bytes = ::recv(client_socket, buffer.data() + used, READ_CHUNK, MSG_DONTWAIT);
+            buffer.resize(used + static_cast<size_t>(std::max<ssize_t>(bytes, 0)));
+            if (bytes == 0 || (bytes < 0 && !wouldBlock())) {
+                closeClient("disconnected");
+            }
+        }
+    }
+}
+
+void FrameReceiver::acknowledge() {
+    if (!ack_due || client_socket < 0) return;
+    uint8_t ack[ACK_BYTES] = {0};
+    std::memcpy(ack, "DBFA", 4);
+    ack[4] = last_applied.board;
+    put32(last_applied.sequence, ack + 8);
+    put64(last_applied.sent_ns, ack + 12);
+    ::send(client_socket, ack, sizeof(ack), MSG_NOSIGNAL | MSG_DONTWAIT);            // Best effort - a missing ack only loses a latency sample
+    ack_due = false;
+}
+
+} // namespace FrameStream
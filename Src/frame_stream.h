@@ -0,0 +1,189 @@
+//
+//  frame_stream.h
+//  Departure_Board
+//
+//  Frame streaming to remote display nodes. One process fetches, parses and renders the boards and sends the
+//  frames to receivers (departureboard_receiver) which only push pixels to their matrix - no API key, parser or font.
+//
+//  Frames are the palette framebuffer (4 bits a pixel) sent over TCP as the XOR against the previous frame,
+//  run-length coded - a frame where only the scrolling text moved is a few hundred bytes. A key frame (XOR against
+//  an empty frame) starts every connection, follows a dropped frame and is sent every key_frame_interval frames.
+//  The palette is sent with key frames and whenever it changes.
+//
+//  Message (integers big-endian):
+//    "DBFS" | version | type (KEY_FRAME, DELTA_FRAME) | board | flags (PALETTE) | sequence (4) | width (2) | height (2)
+//    | sent_ns (8) | payload bytes (4) | [palette - 16 x RGB] | payload
+//  The payload is pairs of varints - a run of unchanged bytes and a count of literal (XOR) bytes - followed by the literals.
+//  A frame is at most a million pixels (more than any chain of panels) - the receiver drops a sender which claims more.
+//
+//  The receiver answers each frame it shows with an ack - "DBFA" | board | 0 0 0 | sequence (4) | sent_ns (8) - the
+//  sender's time echoed back, so the latency (render to shown, plus the ack's way back) needs no shared clock.
+//
+
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "palette_framebuffer.h"
+
+namespace FrameStream {
+
+constexpr uint8_t VERSION = 1;
+constexpr uint8_t KEY_FRAME = 1;
+constexpr uint8_t DELTA_FRAME = 2;
+constexpr uint8_t FLAG_PALETTE = 1;
+constexpr size_t HEADER_BYTES = 28;
+constexpr size_t PALETTE_BYTES = PaletteFramebuffer::PALETTE_SIZE * 3;
+constexpr size_t ACK_BYTES = 20;
+constexpr int DEFAULT_PORT = 7878;
+
+struct FrameHeader {
+    uint8_t type = DELTA_FRAME;
+    uint8_t board = 0;
+    uint8_t flags = 0;
+    uint32_t sequence = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint64_t sent_ns = 0;                                                           // Sender's steady clock
+    uint32_t payload_bytes = 0;
+};
+
+// Run-length code the XOR of frame against previous (the same size) and append it to out. Returns the payload bytes.
+size_t encodeDelta(const uint8_t* frame, const uint8_t* previous, size_t size, std::vector<uint8_t>& out);
+
+// XOR a payload into frame. False if the payload is damaged or runs past the end of the frame.
+bool applyDelta(const uint8_t* payload, size_t payload_bytes, uint8_t* frame, size_t size);
+
+void writeHeader(const FrameHeader& header, uint8_t* out);                         // HEADER_BYTES
+bool readHeader(const uint8_t* in, FrameHeader& header);                           // False if it isn't a frame header
+
+uint64_t nowNanoseconds();                                                          // Steady clock - for sent_ns
+
+// Renders frames to any number of receivers. send() never blocks - a receiver which can't keep up has frames
+// dropped (and a key frame when it catches up), one which isn't there is retried every few seconds.
+// send() and poll() are for the render thread - getMetrics(), resetMetrics() and connected() may be called from any.
+class FrameSender {
+public:
+    struct Metrics {
+        uint64_t frames = 0;                                                        // Frames encoded
+        uint64_t key_frames = 0;
+        uint64_t sent = 0;                                                          // Frames queued to a receiver
+        uint64_t dropped = 0;                                                       // Frames a receiver was too far behind for
+        uint64_t bytes = 0;                                                         // Bytes queued to receivers
+        uint64_t max_frame_bytes = 0;
+        uint64_t total_encode_ns = 0;
+        uint64_t max_encode_ns = 0;
+        uint64_t acks = 0;                                                          // Frames the receivers said they showed
+        uint64_t total_latency_ns = 0;                                              // Sent to the ack coming back
+        uint64_t max_latency_ns = 0;
+        uint64_t connects = 0;
+    };
+
+    /**
+     * @param receivers host:port[,host:port...] (port defaults to DEFAULT_PORT)
+     * @param board Board number in the frames - receivers may show only one board
+     * @param key_frame_interval A key frame every this many frames (0 - only when needed)
+     */
+    FrameSender(const std::string& receivers, uint8_t board, int key_frame_interval);
+    ~FrameSender();
+
+    FrameSender(const FrameSender&) = delete;
+    FrameSender& operator=(const FrameSender&) = delete;
+
+    void send(const PaletteFramebuffer& frame);                                    // Encode the frame and queue it for every connected receiver
+    void poll();                                                                    // Connect, write what's queued and read acks (send() does this too)
+    size_t connected() const { return connected_count.load(); }                    // Receivers connected at the last send() or poll()
+    size_t queued() const;                                                          // Bytes waiting to be written to the receivers
+
+    Metrics getMetrics() const;
+    void resetMetrics();
+
+private:
+    struct Connection;
+    std::vector<std::unique_ptr<Connection>> connections;
+    uint8_t board;
+    int key_frame_interval;
+    uint32_t sequence = 0;
+    int frames_since_key = 0;
+    std::vector<uint8_t> previous;                                                  // Last frame encoded (packed palette indices)
+    PaletteFramebuffer::Palette previous_palette;
+    int previous_width = 0;
+    int previous_height = 0;
+    std::vector<uint8_t> delta_message;                                             // Encoded each frame - key frames only if a receiver needs one
+    std::vector<uint8_t> key_message;
+    std::vector<uint8_t> empty;                                                     // All background - what a key frame is XORed against
+    Metrics metrics;
+    mutable std::mutex metrics_mutex;                                               // Metrics are read and reset by the hourly report (another thread)
+    std::atomic<size_t> connected_count{0};
+
+    void countConnected();
+    void buildMessage(uint8_t type, bool with_palette, const PaletteFramebuffer& frame, const uint8_t* against, uint64_t sent_ns, std::vector<uint8_t>& message);
+    void connect(Connection& connection);
+    void flush(Connection& connection);
+    void readAcks(Connection& connection);
+    void disconnect(Connection& connection, const char* reason);
+};
+
+// Accepts a sender and applies its frames to a palette framebuffer - the caller pushes it to the matrix and acknowledges.
+class FrameReceiver {
+public:
+    struct Metrics {
+        uint64_t frames = 0;                                                        // Frames applied
+        uint64_t key_frames = 0;
+        uint64_t skipped = 0;                                                       // Deltas before a key frame, other boards
+        uint64_t rejected = 0;                                                      // Damaged messages (the connection is dropped)
+        uint64_t bytes = 0;
+        uint64_t total_decode_ns = 0;
+        uint64_t max_decode_ns = 0;
+        uint64_t connections = 0;
+    };
+
+    /**
+     * @param port Port to listen on (0 - any free port, see port())
+     * @param board Board to show (-1 - any)
+     */
+    FrameReceiver(int port, int board);
+    ~FrameReceiver();
+
+    FrameReceiver(const FrameReceiver&) = delete;
+    FrameReceiver& operator=(const FrameReceiver&) = delete;
+
+    int port() const { return listen_port; }
+
+    // Wait up to the timeout for the next frame and apply it. True if the framebuffer changed.
+    bool receive(std::chrono::milliseconds timeout);
+    void acknowledge();                                                             // The last frame applied is on the display
+    PaletteFramebuffer& getFramebuffer() { return *framebuffer; }                  // Once hasFrame() - sized by the first key frame
+    bool hasFrame() const { return have_key_frame; }
+
+    const Metrics& getMetrics() const { return metrics; }
+    void resetMetrics() { metrics = Metrics(); }
+
+private:
+    int listen_socket = -1;
+    int client_socket = -1;
+    int listen_port = 0;
+    int board;
+    std::vector<uint8_t> buffer;                                                    // Bytes read but not yet a whole message
+    size_t buffer_start = 0;
+    std::vector<uint8_t> frame;                                                     // Packed palette indices as sent
+    std::unique_ptr<PaletteFramebuffer> framebuffer;
+    bool have_key_frame = false;
+    FrameHeader last_applied;
+    bool ack_due = false;
+    Metrics metrics;
+
+    bool applyNextMessage();                                                        // One whole message from the buffer - true if a frame was applied
+    void closeClient(const char* reason);
+};
+
+} // namespace FrameStream
+
+#endif // FRAME_STREAM_H
@@ -0,0 +1,124 @@
+//
+//  history_query.cpp
+//  Departure_Board
+//
+//  departureboard_history - how late each departure usually runs, from the logs a departure board writes to
+//  history_dir. Reads the board's logs for the last few weeks - no API keys or matrix.
+//
+//  A service is the departure at the same scheduled time to the same destination - its last record each day is how
+//  it ran that day.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include "config.h"
+#include "departure_history.h"
+
+bool debug_mode = false;                                                                // Global debug flag
+
+namespace {
+
+void showUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [OPTIONS]\n"
+              << "Delays of each departure over the departure history logs (history_dir in config.txt)\n"
+              << "Options:\n"
+              << "  -f, --config FILE        Configuration file - history_dir, location and platform (default ./config.txt)\n"
+              << "  --dir DIRECTORY          Where the logs are (default history_dir)\n"
+              << "  --board NAME             The board's logs - location, _platform if one is selected (default from the config)\n"
+              << "  --days N                 Days of logs to read, up to today (default 28)\n"
+              << "  -t, --time HH:MM         Only the departure at this scheduled time\n"
+              << "  --destination TEXT       Only departures to destinations containing this\n"
+              << "  -d, --debug              Enable debug output\n"
+              << "  -h, --help               Show this help message\n";
+}
+
+std::string minuteText(int minute) {
+    std::ostringstream text;
+    text << std::setfill('0') << std::setw(2) << minute / 60 << ":" << std::setw(2) << minute % 60;
+    return text.str();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string config_file = "./config.txt";
+    std::string directory;
+    std::string board;
+    int days = 28;
+    int time_minute = -1;
+    std::string destination;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "-f" || arg == "--config") && i + 1 < argc) {
+            config_file = argv[++i];
+        } else if (arg == "--dir" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (arg == "--board" && i + 1 < argc) {
+            board = argv[++i];
+        } else if (arg == "--days" && i + 1 < argc) {
+            days = std::max(1, std::atoi(argv[++i]));
+        } else if ((arg == "-t" || arg == "--time") && i + 1 < argc) {
+            std::string time = argv[++i];
+            size_t colon = time.find(':');
+            if (colon == std::string::npos) {
+                showUsage(argv[0]);
+                return 1;
+            }
+            time_minute = std::atoi(time.substr(0, colon).c_str()) * 60 + std::atoi(time.substr(colon + 1).c_str());
+        } else if (arg == "--destination" && i + 1 < argc) {
+            destination = argv[++i];
+        } else if (arg == "-d" || arg == "--debug") {
+            debug_mode = true;
+        } else {
+            showUsage(argv[0]);
+            return (arg == "-h" || arg == "--help") ? 0 : 1;
+        }
+    }
+
+    try {
+        if (directory.empty() || board.empty()) {
+            Config config;
+            config.loadFromFile(config_file);
+            if (directory.empty()) directory = config.get("history_dir");
+            if (board.empty()) board = config.get("location") + (config.get("platform").empty() ? "" : "_" + config.get("platform"));
+        }
+        if (directory.empty()) {
+            std::cerr << "No history_dir in " << config_file << " - set it (or --dir) to where the board logs departures" << std::endl;
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> logs = DepartureHistory::findLogs(directory, board, std::time(nullptr), days);
+        std::vector<DepartureHistory::ServiceStatistics> statistics;
+        uint64_t records = DepartureHistory::summarise(logs, statistics);
+        double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Departures from " << board << " over " << logs.size() << " of the last " << days << " days\n\n"
+                  << "Time   Destination                         Train  Days  Canc   Mean  Median   P90   Max  Within 5\n";
+        std::cout << std::fixed;
+        for (const DepartureHistory::ServiceStatistics& service : statistics) {
+            if (time_minute >= 0 && service.scheduled_minute != time_minute) continue;
+            if (!destination.empty() && service.destination.find(destination) == std::string::npos) continue;
+            std::cout << minuteText(service.scheduled_minute) << "  " << std::left << std::setw(34) << service.destination.substr(0, 34)
+                      << "  " << std::setw(5) << service.trainid << std::right << std::setw(6) << service.days << std::setw(6) << service.cancelled;
+            if (service.delays.empty()) {
+                std::cout << "      -       -     -     -         -\n";
+                continue;
+            }
+            std::cout << std::setprecision(1) << std::setw(7) << service.meanDelay() << std::setw(8) << service.percentileDelay(50)
+                      << std::setw(6) << service.percentileDelay(90) << std::setw(6) << service.delays.back()
+                      << std::setw(9) << std::setprecision(0) << 100.0 * service.within(5) / static_cast<double>(service.delays.size()) << "%\n";
+        }
+        std::cout << "\nDelays in minutes. " << records << " records in " << logs.size() << " logs read in "
+                  << std::setprecision(1) << elapsed_ms << " ms" << std::endl;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+//
+//  incremental_json.h
+//  Departure_Board
+//
+//  Parses a JSON document a piece at a time so the work can be spread over several frames.
+//
+//  json::parse does the whole document in one go - on a single-core board a large departure board takes
+//  the core away from the display for the length of the parse. The API responses are JSON objects, so here
+//  each member is parsed separately and members which are arrays (trainServices, nrccMessages...) are parsed
+//  an element at a time. step() parses one piece and returns - the caller decides when to stop.
+//
+//  The pieces are found with a simple scan (strings, escapes and nesting) and handed to json::parse, so the
+//  result is the same as parsing the whole document. If the scan finds anything it doesn't expect (or the
+//  document isn't an object) the next step parses the whole document. Parsing doesn't throw - an invalid
+//  document finishes with failed() set.
+//
+
+#ifndef INCREMENTAL_JSON_H
+#define INCREMENTAL_JSON_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+
+class IncrementalJSON {
+public:
+    using json = nlohmann::json;
+
+    // Start parsing a document (the parser keeps its own copy)
+    void begin(std::string document) {
+        text = std::move(document);
+        result = json::object();
+        array = nullptr;
+        pos = 0;
+        skipSpace();
+        if (pos < text.size() && text[pos] == '{') {
+            pos++;
+            skipSpace();
+            if (pos < text.size() && text[pos] == '}') {
+                pos++;
+                endOfDocument();
+            } else {
+                state = MEMBER;
+            }
+        } else {
+            state = WHOLE;
+        }
+    }
+
+    // Parse the next piece. Returns true when the parse is finished - complete, or failed() if the document is invalid.
+    bool step() {
+        switch (state) {
+            case MEMBER:
+                parseMember();
+                break;
+            case ELEMENT:
+                parseElement();
+                break;
+            case WHOLE:
+                result = json::parse(text, nullptr, false);
+                state = result.is_discarded() ? FAILED : DONE;
+                break;
+            case DONE:
+            case FAILED:
+                break;
+        }
+        return state == DONE || state == FAILED;
+    }
+
+    bool complete() const { return state == DONE; }
+    bool failed() const { return state == FAILED; }
+    json& document() { return result; }                                             // The parsed document (once complete)
+    void clear() { text.clear(); text.shrink_to_fit(); result = json(); array = nullptr; state = DONE; }
+
+private:
+    enum State { MEMBER, ELEMENT, WHOLE, DONE, FAILED };
+
+    std::string text;
+    size_t pos = 0;
+    State state = DONE;
+    json result;
+    json* array = nullptr;                                                          // Array member being parsed an element at a time
+
+    void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\n' || text[pos] == '\r' || text[pos] == '\t')) pos++;
+    }
+
+    // Move p past the string starting at p. False if it isn't terminated.
+    bool scanString(size_t& p) const {
+        for (p++; p < text.size(); p++) {
+            if (text[p] == '\\') {
+                p++;
+            } else if (text[p] == '"') {
+                p++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Move p past the value starting at p (json::parse checks what's inside). False if it isn't terminated.
+    bool scanValue(size_t& p) const {
+        if (p >= text.size()) return false;
+        if (text[p] == '"') return scanString(p);
+        if (text[p] == '{' || text[p] == '[') {
+            size_t depth = 0;
+            while (p < text.size()) {
+                char c = text[p];
+                if (c == '"') {
+                    if (!scanString(p)) return false;
+                    continue;
+                }
+                if (c == '{' || c == '[') {
+                    depth++;
+                } else if (c == '}' || c == ']') {
+                    if (--depth == 0) {
+                        p++;
+                        return true;
+                    }
+                }
+                p++;
+            }
+            return false;
+        }
+        while (p < text.size() && text[p] != ',' && text[p] != '}' && text[p] != ']' &&                 // Number, true, false or null
+               text[p] != ' ' && text[p] != '\n' && text[p] != '\r' && text[p] != '\t') {
+            p++;
+        }
+        return true;
+    }
+
+    json parsePiece(size_t start, size_t end) const {                                // Discarded if the piece isn't valid JSON
+        return json::parse(text.begin() + static_cast<std::ptrdiff_t>(start), text.begin() + static_cast<std::ptrdiff_t>(end), nullptr, false);
+    }
+
+    void parseMember() {
+        skipSpace();
+        size_t start = pos;
+        if (pos >= text.size() || text[pos] != '"' || !scanString(pos)) return unexpected();
+        json key_string = parsePiece(start, pos);
+        if (!key_string.is_string()) return unexpected();
+        const std::string& key = key_string.get_ref<const std::string&>();
+
+        skipSpace();
+        if (pos >= text.size() || text[pos] != ':') return unexpected();
+        pos++;
+        skipSpace();
+
+        if (pos < text.size() && text[pos] == '[') {                                // Arrays are parsed an element at a time
+            pos++;
+            result[key] = json::array();
+            array = &result[key];
+            skipSpace();
+            if (pos < text.size() && text[pos] == ']') {
+                pos++;
+                endOfMember();
+            } else {
+                state = ELEMENT;
+            }
+            return;
+        }
+
+        start = pos;
+        if (!scanValue(pos)) return unexpected();
+        json value = parsePiece(start, pos);
+        if (value.is_discarded()) return unexpected();
+        result[key] = std::move(value);
+        endOfMember();
+    }
+
+    void parseElement() {
+        skipSpace();
+        size_t start = pos;
+        if (!scanValue(pos)) return unexpected();
+        json element = parsePiece(start, pos);
+        if (element.is_discarded()) return unexpected();
+        array->push_back(std::move(element));
+
+        skipSpace();
+        if (pos < text.size() && text[pos] == ',') {
+            pos++;
+        } else if (pos < text.size() && text[pos] == ']') {
+            pos++;
+            array = nullptr;
+            endOfMember();
+        } else {
+            unexpected();
+        }
+    }
+
+    void endOfMember() {
+        skipSpace();
+        if (pos < text.size() && text[pos] == ',') {
+            pos++;
+            state = MEMBER;
+        } else if (pos < text.size() && text[pos] == '}') {
+            pos++;
+            endOfDocument();
+        } else {
+            unexpected();
+        }
+    }
+
+    void endOfDocument() {
+        skipSpace();
+        if (pos == text.size()) {
+            state = DONE;
+        } else {
+            unexpected();
+        }
+    }
+
+    void unexpected() {                                                             // Leave it to json::parse
+        array = nullptr;
+        state = WHOLE;
+    }
+};
+
+#endif // INCREMENTAL_JSON_H
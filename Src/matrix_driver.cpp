@@ -10,11 +10,15 @@
 MatrixDriver::MatrixDriver(const Config& configuration):
 
 // Configuration
+the_matrix(nullptr),
+canvas(nullptr),
+pixels_pushed(0),
+stream_frame_interval(0),
+headless(configuration.getBoolWithDefault("headless", false)),
 config(configuration),
 
-// Set white and black
-white(255, 255, 255),
-black(0, 0, 0),
+// Text colour
+text_ink(PaletteFramebuffer::ink(PaletteFramebuffer::TEXT)),
 matrix_configured(false)
 {
     // Load and cache the font
@@ -22,6 +26,7 @@ matrix_configured(false)
         throw std::runtime_error("Font loading failed for: " + config.get("fontPath"));
     }
     font_cache.setFont(font);
+    font_cache.setCacheCapacity(static_cast<size_t>(std::max(1, config.getIntWithDefault("text_width_cache_entries", 256))));   // Tuned per device (device profile)
     font_baseline = font_cache.getBaseline();
     font_height = font_cache.getheight();
     
@@ -34,6 +39,7 @@ matrix_configured(false)
 }
 
 MatrixDriver::~MatrixDriver(){
+    presenter.reset();                                                                  // Finishes the swap in progress before the matrix goes
     delete the_matrix;
     DEBUG_PRINT("[Matrix_Driver] Display matrix destroyed");
 }
@@ -47,18 +53,20 @@ void MatrixDriver::initialiseMatrix() {
     
     try {
         DEBUG_PRINT("[Matrix_Driver] Configuring matrix options...");
-        configureMatrixOptions(matrix_options);
+        configureMatrixOptions(matrix_parameters, matrix_options);
         
         DEBUG_PRINT("[Matrix_Driver] Configuring runtime options...");
-        configureRuntimeOptions(runtime_opt);
+        configureRuntimeOptions(matrix_parameters, runtime_opt);
         
         debugPrintMatrixOptions(matrix_options, runtime_opt);
         
-        the_matrix = RGBMatrix::CreateFromOptions(matrix_options, runtime_opt);
-        
-        if (the_matrix == nullptr) {
-            DEBUG_PRINT("[Matrix_Driver] Matrix creation returned nullptr");
-            throw std::runtime_error("Could not create matrix");
+        if (pixel_mapper.build(matrix_parameters.led_pixel_mapper, matrix_parameters.matrixcols * matrix_parameters.matrixchain_length,
+                               matrix_parameters.matrixrows * matrix_parameters.matrixparallel, matrix_parameters.matrixchain_length, matrix_parameters.matrixparallel)) {
+            matrix_options.pixel_mapper_config = nullptr;                               // Pushed through the table - the library drives the panels unmapped
+            DEBUG_PRINT("[Matrix_Driver] led-pixel-mapper '" << matrix_parameters.led_pixel_mapper << "' mapped by table - " << pixel_mapper.width() << " x "
+                        << pixel_mapper.height() << " onto " << pixel_mapper.panelWidth() << " x " << pixel_mapper.panelHeight() << " panels");
+        } else if (!matrix_parameters.led_pixel_mapper.empty()) {
+            DEBUG_PRINT("[Matrix_Driver] led-pixel-mapper '" << matrix_parameters.led_pixel_mapper << "' left to the matrix library");
         }
         
         if (!font_cache.isloaded()){
@@ -66,10 +74,45 @@ void MatrixDriver::initialiseMatrix() {
             throw std::runtime_error("Matrix not useable without a font!");
         }
         
-        // Cache matrix parameters
-        matrix_width = the_matrix->width();
-        matrix_height = the_matrix->height();
-        canvas = the_matrix->CreateFrameCanvas();
+        if (headless) {                                                                 // No hardware - render into an off-screen canvas of the configured size
+            DEBUG_PRINT("[Matrix_Driver] Headless - rendering to an off-screen canvas");
+            offscreen_canvas.reset(new OffscreenCanvas(matrix_parameters.matrixcols * matrix_parameters.matrixchain_length,
+                                                       matrix_parameters.matrixrows * matrix_parameters.matrixparallel));
+            matrix_width = pixel_mapper.width();                                        // The panels' size unless mapped
+            matrix_height = pixel_mapper.height();
+            presenter.reset(new FramePresenter(offscreen_canvas.get(), nullptr, false));
+        } else {
+            the_matrix = RGBMatrix::CreateFromOptions(matrix_options, runtime_opt);
+            
+            if (the_matrix == nullptr) {
+                DEBUG_PRINT("[Matrix_Driver] Matrix creation returned nullptr");
+                throw std::runtime_error("Could not create matrix");
+            }
+            
+            // Cache matrix parameters
+            matrix_width = pixel_mapper.isMapped() ? pixel_mapper.width() : the_matrix->width();
+            matrix_height = pixel_mapper.isMapped() ? pixel_mapper.height() : the_matrix->height();
+            presenter.reset(new FramePresenter(the_matrix->CreateFrameCanvas(), [this](Canvas* shown) -> Canvas* {
+                return the_matrix->SwapOnVSync(static_cast<FrameCanvas*>(shown));
+            }, config.getBoolWithDefault("present_thread", true)));
+            DEBUG_PRINT("[Matrix_Driver] Frames swapped on vsync " << (presenter->isPipelined() ? "on their own thread" : "in the render loop"));
+        }
+        
+        framebuffer.reset(new PaletteFramebuffer(matrix_width, matrix_height));          // Everything is drawn here and pushed to the matrix canvas
+        if (pixel_mapper.isMapped()) {
+            presenter->setMapper(&pixel_mapper);
+        }
+        canvas = framebuffer.get();
+        if (!setTheme(config.get("colour_theme"))) {
+            std::cerr << "[Matrix_Driver] Unknown colour_theme '" << config.get("colour_theme") << "' - using white" << std::endl;
+        }
+        
+        if (!config.get("stream_to").empty()) {                                         // Frames also go to remote display nodes
+            frame_sender.reset(new FrameStream::FrameSender(config.get("stream_to"), static_cast<uint8_t>(config.getIntWithDefault("stream_board", 0)),
+                                                            config.getIntWithDefault("stream_key_frame_interval", 300)));
+            stream_frame_interval = std::chrono::microseconds(1000000 / std::max(1, config.getIntWithDefault("stream_frame_rate", 60)));
+            next_stream_frame = std::chrono::steady_clock::now();
+        }
         
         // matrix configured
         matrix_configured = true;
@@ -93,116 +136,151 @@ void MatrixDriver::initialiseMatrix() {
     }
 }
     
-void MatrixDriver::configureMatrixOptions(RGBMatrix::Options& options ) const {
+void MatrixDriver::configureMatrixOptions(const Config::matrix_options& parameters, RGBMatrix::Options& options) {
     // Basic matrix configuration
-    options.rows = matrix_parameters.matrixrows;
-    options.cols = matrix_parameters.matrixcols;
-    options.chain_length = matrix_parameters.matrixchain_length;
-    options.parallel = matrix_parameters.matrixparallel;
+    options.rows = parameters.matrixrows;
+    options.cols = parameters.matrixcols;
+    options.chain_length = parameters.matrixchain_length;
+    options.parallel = parameters.matrixparallel;
     
     // Hardware mapping - convert std::string to const char*
-    options.hardware_mapping = matrix_parameters.matrixhardware_mapping.c_str();
+    options.hardware_mapping = parameters.matrixhardware_mapping.c_str();
     
     // Set multiplexing
-    options.multiplexing = matrix_parameters.led_multiplexing;
+    options.multiplexing = parameters.led_multiplexing;
     
     // Handle pixel mapper if set
-    if (!matrix_parameters.led_pixel_mapper.empty()) {
-        options.pixel_mapper_config = matrix_parameters.led_pixel_mapper.c_str();
+    if (!parameters.led_pixel_mapper.empty()) {
+        options.pixel_mapper_config = parameters.led_pixel_mapper.c_str();
     } else {
         options.pixel_mapper_config = nullptr;
     }
     
     // Display quality settings
-    options.pwm_bits = matrix_parameters.led_pwm_bits;
-    options.brightness = matrix_parameters.led_brightness;
-    options.scan_mode = matrix_parameters.led_scan_mode;
-    options.row_address_type = matrix_parameters.led_row_addr_type;
+    options.pwm_bits = parameters.led_pwm_bits;
+    options.brightness = parameters.led_brightness;
+    options.scan_mode = parameters.led_scan_mode;
+    options.row_address_type = parameters.led_row_addr_type;
     
     // Display behavior settings
-    options.show_refresh_rate = matrix_parameters.led_show_refresh;
-    options.limit_refresh_rate_hz = matrix_parameters.led_limit_refresh;
+    options.show_refresh_rate = parameters.led_show_refresh;
+    options.limit_refresh_rate_hz = parameters.led_limit_refresh;
     
     // Color settings
-    options.inverse_colors = matrix_parameters.led_inverse;
+    options.inverse_colors = parameters.led_inverse;
     
     // RGB sequence
-    if (matrix_parameters.led_rgb_sequence.length() == 3) {
-        options.led_rgb_sequence = matrix_parameters.led_rgb_sequence.c_str();
+    if (parameters.led_rgb_sequence.length() == 3) {
+        options.led_rgb_sequence = parameters.led_rgb_sequence.c_str();
     } else {
         DEBUG_PRINT("[Matrix_Driver] Warning: led-rgb-sequence must be exactly 3 characters. Using default 'RGB'.");
         options.led_rgb_sequence = "RGB";
     }
     
     // Advanced PWM settings
-    options.pwm_lsb_nanoseconds = matrix_parameters.led_pwm_lsb_nanoseconds;
-    options.pwm_dither_bits = matrix_parameters.led_pwm_dither_bits;
-    options.disable_hardware_pulsing = matrix_parameters.led_no_hardware_pulse;
+    options.pwm_lsb_nanoseconds = parameters.led_pwm_lsb_nanoseconds;
+    options.pwm_dither_bits = parameters.led_pwm_dither_bits;
+    options.disable_hardware_pulsing = parameters.led_no_hardware_pulse;
     
     // Handle panel type if set
-    if (!matrix_parameters.led_panel_type.empty()) {
-        options.panel_type = matrix_parameters.led_panel_type.c_str();
+    if (!parameters.led_panel_type.empty()) {
+        options.panel_type = parameters.led_panel_type.c_str();
     } else {
         options.panel_type = nullptr;
     }
 }
 
-void MatrixDriver::configureRuntimeOptions(RuntimeOptions& runtime_opt) const {
-    runtime_opt.gpio_slowdown = matrix_parameters.gpio_slowdown;
-    runtime_opt.daemon = matrix_parameters.led_daemon;
+void MatrixDriver::configureRuntimeOptions(const Config::matrix_options& parameters, RuntimeOptions& runtime_opt) {
+    runtime_opt.gpio_slowdown = parameters.gpio_slowdown;
+    runtime_opt.daemon = parameters.led_daemon;
 }
 
 void MatrixDriver::clearArea(int x_origin, int y_origin, int x_size, int y_size) {
-    int x,y;
-    
     //DEBUG_PRINT("clearing a " << x_size << " x " << y_size << " area with origin at (" << x_origin <<"," << y_origin <<")");
     
-    for (x = x_origin; x < x_size; x++) {
-        for ( y = y_origin; y < y_size; y++) {
-            if (y >= 0 && y < matrix_height && x >= 0 && x < matrix_width) {
-                canvas->SetPixel(x, y, black.r, black.g, black.b);
-            }
-        }
+    framebuffer->fill(x_origin, y_origin, x_size, y_size, PaletteFramebuffer::BACKGROUND);     // Clipped to the matrix
+}
+
+bool MatrixDriver::setTheme(const std::string& theme) {
+    PaletteFramebuffer::Palette palette;
+    if (!PaletteFramebuffer::themePalette(theme, palette)) {
+        return false;
+    }
+    if (framebuffer) {
+        framebuffer->setPalette(palette);                                                     // Nothing redrawn - the next frames push every pixel in the new colours
     }
+    DEBUG_PRINT("[Matrix_Driver] Colour theme: " << theme);
+    return true;
+}
+
+PaletteFramebuffer::Ink MatrixDriver::statusInk(const std::string& estimated_departure_time) {
+    if (estimated_departure_time.empty()) return PaletteFramebuffer::TEXT;
+    if (estimated_departure_time == "On Time") return PaletteFramebuffer::ON_TIME;
+    if (estimated_departure_time == "Cancelled") return PaletteFramebuffer::CANCELLED;
+    return PaletteFramebuffer::DELAYED;                                                         // "Delayed" or an expected time
 }
 
 void MatrixDriver::render(){
-    try {
-        auto current_time = std::chrono::steady_clock::now();
+    auto current_time = std::chrono::steady_clock::now();
+    
+    if (whole_display_refresh.needsRender()) {
         
-        if (whole_display_refresh.needsRender()) {
-            
-            first_row_config.refresh_state.triggerRefresh();                                                               // trigger first-row refresh
-            third_row_config.refresh_state.triggerRefresh();
-            debugPrintRefreshState("[Matrix_Driver] Whole display refresh", whole_display_refresh.render_state);
-            if (!matrix_configured){
-                throw std::runtime_error("[Matrix_Driver] Matrix not configured! No rendering possible. ");
+        first_row_config.refresh_state.triggerRefresh();                                                               // trigger first-row refresh
+        third_row_config.refresh_state.triggerRefresh();
+        debugPrintRefreshState("[Matrix_Driver] Whole display refresh", whole_display_refresh.render_state);
+        if (!matrix_configured){                                                                                            // Counted rather than thrown - render is called every frame
+            if (error_counters.not_configured++ == 0) {
+                std::cerr << "[Matrix_Driver] Matrix not configured! No rendering possible." << std::endl;
             }
-            
-            canvas->Clear();
-            
-            whole_display_refresh.completePass();
+            return;
         }
         
-        renderFirstRow();
-        checkFirstRowStateTransition(current_time);
-        
-        renderSecondRow();
-        updateScrollPositions(current_time);
-        
-        renderThirdRow();
-        checkThirdRowStateTransition(current_time);
-        
-        renderFourthRow();
-        checkFourthRowStateTransition(current_time);
-        
-        updateClockDisplay(current_time);
-        
-        canvas = the_matrix->SwapOnVSync(canvas);
+        canvas->Clear();
         
-    } catch(const std::exception& e) {
-        std::cerr << "[Matrix_Driver] Error rendering the matrix" << e.what() << std::endl;
+        whole_display_refresh.completePass();
     }
+    
+    renderFirstRow();
+    checkFirstRowStateTransition(current_time);
+    
+    renderSecondRow();
+    updateScrollPositions(current_time);
+    
+    renderThirdRow();
+    checkThirdRowStateTransition(current_time);
+    
+    renderFourthRow();
+    checkFourthRowStateTransition(current_time);
+    
+    updateClockDisplay(current_time);
+    
+    if (frame_sender) {
+        frame_sender->send(*framebuffer);
+    }
+    
+    presenter->countCompose(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - current_time).count()));
+    pixels_pushed += presenter->present(*framebuffer);                                         // Pipelined - waits for the last frame's swap, pushes and hands this one over
+    
+    if (headless) {
+        if (frame_sender) {                                                                     // Nothing to wait on for vsync - keep to the stream's frame rate
+            next_stream_frame += stream_frame_interval;
+            auto now = std::chrono::steady_clock::now();
+            if (next_stream_frame < now) {
+                next_stream_frame = now;                                                        // Fallen behind - don't try to catch up
+            } else {
+                std::this_thread::sleep_until(next_stream_frame);
+            }
+        }
+    }
+    
+}
+
+FramePresenter::Metrics MatrixDriver::getFrameMetrics() const {
+    return presenter ? presenter->getMetrics() : FramePresenter::Metrics();
+}
+
+void MatrixDriver::resetFrameMetrics() {
+    if (presenter) presenter->resetMetrics();
 }
 
 void MatrixDriver::stop(){
@@ -210,6 +288,101 @@ void MatrixDriver::stop(){
 }
 
 
+// Updating the display content
+// The next content for all the rows is built in the back buffer (beginUpdate), then measured and swapped in together (commitUpdate).
+// Strings are moved rather than copied and the display never shows a mix of old and new rows.
+
+MatrixDriver::display_rows& MatrixDriver::beginUpdate(){
+    back_rows.first.platform.reset();                                                               // reset() keeps the string buffers
+    back_rows.first.destination.reset();
+    back_rows.first.scheduled_departure_time.reset();
+    back_rows.first.estimated_depature_time.reset();
+    back_rows.first.coaches.reset();
+    back_rows.first.coach_info_available = false;
+    
+    back_rows.second.calling_points.reset();
+    back_rows.second.calling_points_measured = false;
+    back_rows.second.service_message.reset();
+    back_rows.second.has_calling_points = true;
+    
+    back_rows.third.second_departure.reset();
+    back_rows.third.second_departure_estimated_departure_time.reset();
+    back_rows.third.third_departure.reset();
+    back_rows.third.third_departure_estimated_departure_time.reset();
+    
+    back_rows.fourth.location.reset();
+    back_rows.fourth.message.reset();
+    back_rows.fourth.has_message = false;
+    
+    return back_rows;
+}
+
+void MatrixDriver::commitUpdate(int64_t api_version){
+    if(api_version < first_row_content.api_version) {
+        DEBUG_PRINT("[Matrix_Driver] New row data has an API version less than the last update - ignored");
+        error_counters.stale_updates++;
+        return;
+    }
+    if(api_version == first_row_content.api_version){
+        return;
+    }
+    
+    // Measure everything first - so a failure leaves the current rows untouched
+    measureFirstRow();
+    measureSecondRow();
+    measureThirdRow();
+    measureFourthRow();
+    
+    // Swap the new rows in. The old content goes to the back buffer to be re-used
+    std::swap(first_row_content, back_rows.first);
+    std::swap(second_row_content, back_rows.second);
+    std::swap(third_row_content, back_rows.third);
+    std::swap(fourth_row_content, back_rows.fourth);
+    
+    first_row_content.api_version = api_version;
+    second_row_content.api_version = api_version;
+    third_row_content.api_version = api_version;
+    fourth_row_content.api_version = api_version;
+    
+    second_row_config.scroll_calling_points = (second_row_content.calling_points.width >= (matrix_width - second_row_config.space_for_calling_points));
+    
+    first_row_config.refresh_state.triggerRefresh();
+    third_row_config.refresh_state.triggerRefresh();
+    fourth_row_config.refresh_state.triggerRefresh();
+    
+    if(debug_mode){
+        std::cerr << "   [Matrix_Driver] ==> First Row content post-update" <<std::endl;
+        std::cerr << "   [Matrix_Driver] y_position: " << first_row_config.y_position <<std::endl;
+        std::cerr << "   [Matrix_Driver] coach_info_available: " << first_row_content.coach_info_available <<std::endl;
+        first_row_content.destination.fulldump("[Matrix_Driver] Destination");
+        first_row_content.estimated_depature_time.fulldump("[Matrix_Driver] ETD Display");
+        first_row_content.coaches.fulldump("[Matrix_Driver] Coaches Display");
+        
+        std::cerr << "   [Matrix_Driver] ==> Second Row content post-update" <<std::endl;
+        std::cerr << "   [Matrix_Driver] y position: " << second_row_config.y_position << std::endl;
+        std::cerr << "   [Matrix_Driver] scroll calling points: " << second_row_config.scroll_calling_points << std::endl;
+        std::cerr << "   [Matrix Driver] has calling points: " << second_row_content.has_calling_points << std::endl;
+        second_row_content.calling_points.fulldump("[Matrix_Driver] Calling Points");
+        second_row_content.service_message.fulldump("[Matrix Driver] Service Message");
+        
+        std::cerr << "   [Matrix_Driver] ==> Third Row content post-update" <<std::endl;
+        std::cerr << "   [Matrix_Driver] y_position: " << third_row_config.y_position <<std::endl;
+        third_row_content.second_departure.fulldump("[Matrix_Driver] 2nd Departure");
+        third_row_content.second_departure_estimated_departure_time.fulldump("[Matrix_Driver] 2nd Departure ETD");
+        third_row_content.third_departure.fulldump("[Matrix_Driver] 3rd Departure");
+        third_row_content.third_departure_estimated_departure_time.fulldump("[Matrix_Driver] 3rd Departure ETD");
+        
+        std::cerr << "   [Matrix_Driver] ==> Fourth Row content post-update" <<std::endl;
+        std::cerr << "   [Matrix_Driver] y_position: " << fourth_row_config.y_position <<std::endl;
+        fourth_row_content.location.fulldump("[Matrix_Driver] Location");
+        std::cerr << "   [Matrix_Driver] Has message: " << fourth_row_content.has_message << std::endl;
+        fourth_row_content.message.fulldump("[Matrix_Driver] Message");
+        std::cerr << "   [Matrix_Driver] api version: " << api_version <<std::endl;
+    }
+}
+
+
+
 // First Row configuration, update and display
 
 void MatrixDriver::configureFirstRow(){
@@ -233,71 +406,38 @@ void MatrixDriver::configureFirstRow(){
                 " ETD|Coach interval: " << first_row_config.ETD_coach_refresh_seconds << " (s).");
 }
 
-void MatrixDriver::updateFirstRow(const first_row_data &new_first_row){
-    try {
-        if(new_first_row.api_version < first_row_content.api_version) {
-            throw std::runtime_error("New first row data has an API version less than the last update! ");
-        }
-        if(new_first_row.api_version == first_row_content.api_version){
-            return;
-        } else {
-            first_row_content.platform = new_first_row.platform;
-            first_row_content.destination = new_first_row.destination;
-            
-            first_row_content.scheduled_departure_time = new_first_row.scheduled_departure_time;
-            
-            first_row_content.estimated_depature_time = new_first_row.estimated_depature_time;
-            first_row_content.estimated_depature_time.setWidth(font_cache);
-            first_row_content.estimated_depature_time.x_position = matrix_width - first_row_content.estimated_depature_time.width;
-            
-            
-            first_row_content.coach_info_available = new_first_row.coach_info_available;
-            if (first_row_content.coach_info_available){
-                first_row_content.coaches = new_first_row.coaches.text + " Coaches";
-            } else {
-                first_row_content.coaches = "";
-            }
-            first_row_content.coaches.setWidth(font_cache);
-            first_row_content.coaches.x_position = matrix_width - first_row_content.coaches.width;
-            first_row_content.api_version = new_first_row.api_version;
-            if(debug_mode){
-                std::cerr << "   [Matrix_Driver] ==> First Row content post-update" <<std::endl;
-                std::cerr << "   [Matrix_Driver] y_position: " << first_row_config.y_position <<std::endl;
-                std::cerr << "   [Matrix_Driver] coach_info_available: " << first_row_content.coach_info_available <<std::endl;
-                first_row_content.destination.fulldump("[Matrix_Driver] Destination");
-                first_row_content.estimated_depature_time.fulldump("[Matrix_Driver] ETD Display");
-                first_row_content.coaches.fulldump("[Matrix_Driver] Coaches Display");
-                std::cerr << "   [Matrix_Driver] api version: " << first_row_content.api_version <<std::endl;
-            }
-            
-            first_row_config.refresh_state.triggerRefresh();
-            
-            first_row_content.api_version = new_first_row.api_version;
-        }
-    } catch(const std::exception& e) {
-        std::cerr << "[Matrix_Driver] Error updating the first row" << e.what() << std::endl;
+// Measure the new first row in the back buffer
+void MatrixDriver::measureFirstRow(){
+    first_row_data& new_first_row = back_rows.first;
+    
+    new_first_row.estimated_depature_time.setWidth(font_cache);
+    new_first_row.estimated_depature_time.x_position = matrix_width - new_first_row.estimated_depature_time.width;
+    new_first_row.estimated_departure_ink = statusInk(new_first_row.estimated_depature_time.text);
+    
+    if (new_first_row.coach_info_available){
+        new_first_row.coaches << " Coaches";
+    } else {
+        new_first_row.coaches.text.clear();
     }
+    new_first_row.coaches.setWidth(font_cache);
+    new_first_row.coaches.x_position = matrix_width - new_first_row.coaches.width;
 }
 
 void MatrixDriver::renderFirstRow(){
-    try {
-        
-        if(first_row_config.refresh_state.needsRender()) {                                                                                          // if a render is required
-            // DEBUG_PRINT("Refreshing 1st row");
+    
+    if(first_row_config.refresh_state.needsRender()) {                                                                                          // if a render is required
+        // DEBUG_PRINT("Refreshing 1st row");
 
-            clearArea(0, first_row_config.y_position - font_baseline, matrix_width, first_row_config.y_position + font_height - font_baseline);     // clear the row
-            rgb_matrix::DrawText(canvas, font, first_row_content.destination.x_position, first_row_config.y_position, white, first_row_content.destination.text.c_str());
-            
-            if (first_row_config.ETDCoach_state == ETD) {
-                rgb_matrix::DrawText(canvas, font, first_row_content.estimated_depature_time.x_position, first_row_config.y_position, white, first_row_content.estimated_depature_time.text.c_str());
-            } else {
-                rgb_matrix::DrawText(canvas, font, first_row_content.coaches.x_position, first_row_config.y_position, white, first_row_content.coaches.text.c_str());
-            }
-            
-            first_row_config.refresh_state.completePass();                                                                                          // mark the render as complete
+        clearArea(0, first_row_config.y_position - font_baseline, matrix_width, first_row_config.y_position + font_height - font_baseline);     // clear the row
+        rgb_matrix::DrawText(canvas, font, first_row_content.destination.x_position, first_row_config.y_position, text_ink, first_row_content.destination.text.c_str());
+        
+        if (first_row_config.ETDCoach_state == ETD) {
+            rgb_matrix::DrawText(canvas, font, first_row_content.estimated_depature_time.x_position, first_row_config.y_position, PaletteFramebuffer::ink(first_row_content.estimated_departure_ink), first_row_content.estimated_depature_time.text.c_str());
+        } else {
+            rgb_matrix::DrawText(canvas, font, first_row_content.coaches.x_position, first_row_config.y_position, text_ink, first_row_content.coaches.text.c_str());
         }
-    } catch(const std::exception& e) {
-        std::cerr << "[Matrix_Driver] Error rendering the first row" << e.what() << std::endl;
+        
+        first_row_config.refresh_state.completePass();                                                                                          // mark the render as complete
     }
 }
 
@@ -346,58 +486,31 @@ void MatrixDriver::configureSecondRow(){
                 ". space_for_calling_points: " << second_row_config.space_for_calling_points << ". scroll_calling_points (bool): " << second_row_config.scroll_calling_points);
 }
 
-void MatrixDriver::updateSecondRow(const second_row_data &new_second_row){
-    try {
-        if(new_second_row.api_version < second_row_content.api_version) {
-            throw std::runtime_error("New second row data has an API version less than the last update! ");
-        }
-        if(new_second_row.api_version == second_row_content.api_version){
-            return;
-        } else {
-            //second_row_content.calling_points.text = new_second_row.calling_points.text;                               // Copy the text, not the entire structure as the latter resets the x position of the scroll
-            second_row_content.calling_points.text = new_second_row.calling_points.text;
-            second_row_content.has_calling_points = new_second_row.has_calling_points;
-            second_row_content.service_message.text = new_second_row.service_message.text;
-            second_row_content.calling_points.setWidth(font_cache);
-            second_row_content.service_message.setWidth(font_cache);
-            if (second_row_content.calling_points.width < (matrix_width - second_row_config.space_for_calling_points)) {
-                second_row_config.scroll_calling_points = false;
-            } else {
-                second_row_config.scroll_calling_points = true;
-            }
-            second_row_content.api_version = new_second_row.api_version;
-            
-            if(debug_mode){
-                std::cerr << "   [Matrix_Driver] ==> Second Row content post-update" <<std::endl;
-                std::cerr << "   [Matrix_Driver] y position: " << second_row_config.y_position << std::endl;
-                std::cerr << "   [Matrix_Driver] scroll calling points: " << second_row_config.scroll_calling_points << std::endl;
-                std::cerr << "   [Matrix Driver] has calling points: " << second_row_content.has_calling_points << std::endl;
-                second_row_content.calling_points.fulldump("[Matrix_Driver] Calling Points");
-                second_row_content.service_message.fulldump("[Matrix Driver] Service Message");
-                std::cerr << "   [Matrix_Driver] api version: " << second_row_content.api_version <<std::endl;
-            }
-        }
-    } catch(const std::exception& e) {
-        std::cerr << "[Matrix_Driver] Error updating the second row" << e.what() << std::endl;
+// Measure the new second row in the back buffer
+void MatrixDriver::measureSecondRow(){
+    second_row_data& new_second_row = back_rows.second;
+    
+    if (!new_second_row.calling_points_measured) {                                                                          // Calling points may have been measured as they were built
+        new_second_row.calling_points.setWidth(font_cache);
     }
+    new_second_row.service_message.setWidth(font_cache);
+    
+    new_second_row.calling_points.x_position = second_row_content.calling_points.x_position;                                // Carry on scrolling from where we are
+    new_second_row.service_message.x_position = second_row_content.service_message.x_position;
 }
 
 void MatrixDriver::renderSecondRow(){
-    try {
-       
-        clearArea(0, second_row_config.y_position - font_baseline, matrix_width, second_row_config.y_position + font_height - font_baseline);                                               // Clear row
-        if (second_row_config.second_row_state == CALLING_POINTS && second_row_content.has_calling_points) {
-            rgb_matrix::DrawText(canvas, font, second_row_content.calling_points.x_position, second_row_config.y_position, white, second_row_content.calling_points.text.c_str());          // Write the calling points
+   
+    clearArea(0, second_row_config.y_position - font_baseline, matrix_width, second_row_config.y_position + font_height - font_baseline);                                               // Clear row
+    if (second_row_config.second_row_state == CALLING_POINTS && second_row_content.has_calling_points) {
+        rgb_matrix::DrawText(canvas, font, second_row_content.calling_points.x_position, second_row_config.y_position, text_ink, second_row_content.calling_points.text.c_str());          // Write the calling points
 
-            clearArea(0, second_row_config.y_position - font_baseline, second_row_config.calling_at_text.width, second_row_config.y_position + font_height - font_baseline);                // Clear area for "Calling at:" text
-            rgb_matrix::DrawText(canvas, font, 0, second_row_config.y_position, white, second_row_config.calling_at_text.text.c_str());                                                     // Write "Calling at:" text
-        } else {
-            rgb_matrix::DrawText(canvas, font, second_row_content.service_message.x_position, second_row_config.y_position, white, second_row_content.service_message.text.c_str());        // Write the service message
-        }
-        
-    } catch(const std::exception& e) {
-        std::cerr << "[Matrix_Driver] Error rendering the second row" << e.what() << std::endl;
+        clearArea(0, second_row_config.y_position - font_baseline, second_row_config.calling_at_text.width, second_row_config.y_position + font_height - font_baseline);                // Clear area for "Calling at:" text
+        rgb_matrix::DrawText(canvas, font, 0, second_row_config.y_position, text_ink, second_row_config.calling_at_text.text.c_str());                                                     // Write "Calling at:" text
+    } else {
+        rgb_matrix::DrawText(canvas, font, second_row_content.service_message.x_position, second_row_config.y_position, text_ink, second_row_content.service_message.text.c_str());        // Write the service message
     }
+    
 }
 
 void MatrixDriver::updateScrollPositions(const std::chrono::steady_clock::time_point& now){
@@ -466,45 +579,19 @@ void MatrixDriver::configureThirdRow(){
                 "Scroll-in transition flag: " << third_row_config.scroll_in);
 }
 
-void MatrixDriver::updateThirdRow(const third_row_data &new_third_row){
-    try {
-        if(new_third_row.api_version < third_row_content.api_version) {
-            throw std::runtime_error("New third row data has an API version less than the last update! ");
-        }
-        if(new_third_row.api_version == third_row_content.api_version){
-            return;
-        } else {
-            third_row_content.second_departure = new_third_row.second_departure;
-            third_row_content.second_departure.setWidth(font_cache);
-            
-            third_row_content.second_departure_estimated_departure_time = new_third_row.second_departure_estimated_departure_time;
-            third_row_content.second_departure_estimated_departure_time.setWidth(font_cache);
-            third_row_content.second_departure_estimated_departure_time.x_position = matrix_width - third_row_content.second_departure_estimated_departure_time.width;
-            
-            third_row_content.third_departure = new_third_row.third_departure;
-            third_row_content.third_departure.setWidth(font_cache);
-            
-            third_row_content.third_departure_estimated_departure_time = new_third_row.third_departure_estimated_departure_time;
-            third_row_content.third_departure_estimated_departure_time.setWidth(font_cache);
-            third_row_content.third_departure_estimated_departure_time.x_position = matrix_width - third_row_content.third_departure_estimated_departure_time.width;
-            
-            third_row_content.api_version = new_third_row.api_version;
-            
-            third_row_config.refresh_state.triggerRefresh();
-            
-            if(debug_mode){
-                std::cerr << "   [Matrix_Driver] ==> Third Row content post-update" <<std::endl;
-                std::cerr << "   [Matrix_Driver] y_position: " << third_row_config.y_position <<std::endl;
-                third_row_content.second_departure.fulldump("[Matrix_Driver] 2nd Departure");
-                third_row_content.second_departure_estimated_departure_time.fulldump("[Matrix_Driver] 2nd Departure ETD");
-                third_row_content.third_departure.fulldump("[Matrix_Driver] 3rd Departure");
-                third_row_content.third_departure_estimated_departure_time.fulldump("[Matrix_Driver] 3rd Departure ETD");
-                std::cerr << "   [Matrix_Driver] api version: " << third_row_content.api_version <<std::endl;
-            }
-        }
-    } catch(const std::exception& e) {
-        std::cerr << "[Matrix_Driver] Error updating the third row" << e.what() << std::endl;
-    }
+// Measure the new third row in the back buffer
+void MatrixDriver::measureThirdRow(){
+    third_row_data& new_third_row = back_rows.third;
+    
+    new_third_row.second_departure.setWidth(font_cache);
+    new_third_row.second_departure_estimated_departure_time.setWidth(font_cache);
+    new_third_row.second_departure_estimated_departure_time.x_position = matrix_width - new_third_row.second_departure_estimated_departure_time.width;
+    new_third_row.second_departure_ink = statusInk(new_third_row.second_departure_estimated_departure_time.text);
+    
+    new_third_row.third_departure.setWidth(font_cache);
+    new_third_row.third_departure_estimated_departure_time.setWidth(font_cache);
+    new_third_row.third_departure_estimated_departure_time.x_position = matrix_width - new_third_row.third_departure_estimated_departure_time.width;
+    new_third_row.third_departure_ink = statusInk(new_third_row.third_departure_estimated_departure_time.text);
 }
 
 
@@ -513,40 +600,36 @@ void MatrixDriver::updateThirdRow(const third_row_data &new_third_row){
 // ===> Begin section
 
 void MatrixDriver::renderThirdRow(){
-    try {
-        
-        if(third_row_config.refresh_state.needsRender()) {                                                                                              // if a render is required....
-            if (third_row_content.second_departure.x_position > 0){                                                                                     // if we're scrolling a transition
-                
-                clearArea(0, third_row_config.y_position - font_baseline, matrix_width, third_row_config.y_position + font_height - font_baseline);     // clear the row
-                
-                if (third_row_config.third_row_state == SECOND_TRAIN) {
-                    //2nd departure scrolling
-                    rgb_matrix::DrawText(canvas, font, third_row_content.second_departure.x_position, third_row_config.y_position, white, third_row_content.second_departure.text.c_str());
-                } else {
-                    //3rd departure scrolling
-                    rgb_matrix::DrawText(canvas, font, third_row_content.third_departure.x_position, third_row_config.y_position, white, third_row_content.third_departure.text.c_str());
-                }
-                third_row_content.second_departure.x_position--;
-                third_row_content.third_departure.x_position--;
+    
+    if(third_row_config.refresh_state.needsRender()) {                                                                                              // if a render is required....
+        if (third_row_content.second_departure.x_position > 0){                                                                                     // if we're scrolling a transition
+            
+            clearArea(0, third_row_config.y_position - font_baseline, matrix_width, third_row_config.y_position + font_height - font_baseline);     // clear the row
+            
+            if (third_row_config.third_row_state == SECOND_TRAIN) {
+                //2nd departure scrolling
+                rgb_matrix::DrawText(canvas, font, third_row_content.second_departure.x_position, third_row_config.y_position, text_ink, third_row_content.second_departure.text.c_str());
             } else {
-                clearArea(0, third_row_config.y_position - font_baseline, matrix_width, third_row_config.y_position + font_height - font_baseline);     // clear the row
-                
-                if (third_row_config.third_row_state == SECOND_TRAIN) {
-                    //2nd departure left justified - ETD right justified
-                    rgb_matrix::DrawText(canvas, font, third_row_content.second_departure.x_position, third_row_config.y_position, white, third_row_content.second_departure.text.c_str());
-                    rgb_matrix::DrawText(canvas, font, third_row_content.second_departure_estimated_departure_time.x_position, third_row_config.y_position, white, third_row_content.second_departure_estimated_departure_time.text.c_str());
-                } else {
-                    //3rd departure left justified - ETD right justified
-                    rgb_matrix::DrawText(canvas, font, third_row_content.third_departure.x_position, third_row_config.y_position, white, third_row_content.third_departure.text.c_str());
-                    rgb_matrix::DrawText(canvas, font, third_row_content.third_departure_estimated_departure_time.x_position, third_row_config.y_position, white, third_row_content.third_departure_estimated_departure_time.text.c_str());
-                }
-                
-                third_row_config.refresh_state.completePass();                                                                                          // complete the render
+                //3rd departure scrolling
+                rgb_matrix::DrawText(canvas, font, third_row_content.third_departure.x_position, third_row_config.y_position, text_ink, third_row_content.third_departure.text.c_str());
             }
+            third_row_content.second_departure.x_position--;
+            third_row_content.third_departure.x_position--;
+        } else {
+            clearArea(0, third_row_config.y_position - font_baseline, matrix_width, third_row_config.y_position + font_height - font_baseline);     // clear the row
+            
+            if (third_row_config.third_row_state == SECOND_TRAIN) {
+                //2nd departure left justified - ETD right justified
+                rgb_matrix::DrawText(canvas, font, third_row_content.second_departure.x_position, third_row_config.y_position, text_ink, third_row_content.second_departure.text.c_str());
+                rgb_matrix::DrawText(canvas, font, third_row_content.second_departure_estimated_departure_time.x_position, third_row_config.y_position, PaletteFramebuffer::ink(third_row_content.second_departure_ink), third_row_content.second_departure_estimated_departure_time.text.c_str());
+            } else {
+                //3rd departure left justified - ETD right justified
+                rgb_matrix::DrawText(canvas, font, third_row_content.third_departure.x_position, third_row_config.y_position, text_ink, third_row_content.third_departure.text.c_str());
+                rgb_matrix::DrawText(canvas, font, third_row_content.third_departure_estimated_departure_time.x_position, third_row_config.y_position, PaletteFramebuffer::ink(third_row_content.third_departure_ink), third_row_content.third_departure_estimated_departure_time.text.c_str());
+            }
+            
+            third_row_config.refresh_state.completePass();                                                                                          // complete the render
         }
-    } catch(const std::exception& e) {
-        std::cerr << "[Matrix_Driver] Error rendering the third row" << e.what() << std::endl;
     }
 }
 
@@ -583,12 +666,12 @@ void MatrixDriver::renderThirdRow(){
             
             if (third_row_config.third_row_state == SECOND_TRAIN) {
                 //2nd departure left justified - ETD right justified
-                rgb_matrix::DrawText(canvas, font, third_row_content.second_departure.x_position, third_row_config.y_position, white, third_row_content.second_departure.text.c_str());
-                rgb_matrix::DrawText(canvas, font, third_row_content.second_departure_estimated_departure_time.x_position, third_row_config.y_position, white, third_row_content.second_departure_estimated_departure_time.text.c_str());
+                rgb_matrix::DrawText(canvas, font, third_row_content.second_departure.x_position, third_row_config.y_position, text_ink, third_row_content.second_departure.text.c_str());
+                rgb_matrix::DrawText(canvas, font, third_row_content.second_departure_estimated_departure_time.x_position, third_row_config.y_position, PaletteFramebuffer::ink(third_row_content.second_departure_ink), third_row_content.second_departure_estimated_departure_time.text.c_str());
             } else {
                 //3rd departure left justified - ETD right justified
-                rgb_matrix::DrawText(canvas, font, third_row_content.third_departure.x_position, third_row_config.y_position, white, third_row_content.third_departure.text.c_str());
-                rgb_matrix::DrawText(canvas, font, third_row_content.third_departure_estimated_departure_time.x_position, third_row_config.y_position, white, third_row_content.third_departure_estimated_departure_time.text.c_str());
+                rgb_matrix::DrawText(canvas, font, third_row_content.third_departure.x_position, third_row_config.y_position, text_ink, third_row_content.third_departure.text.c_str());
+                rgb_matrix::DrawText(canvas, font, third_row_content.third_departure_estimated_departure_time.x_position, third_row_config.y_position, PaletteFramebuffer::ink(third_row_content.third_departure_ink), third_row_content.third_departure_estimated_departure_time.text.c_str());
             }
             third_row_config.refresh_state.completePass();                                                                                          // complete the render
         }
@@ -637,65 +720,34 @@ void MatrixDriver::configureFourthRow(){
                 ". Message refresh interval: " << fourth_row_config.fourth_line_refresh_seconds << " (s)");
 }
 
-void MatrixDriver::updateFourthRow(const fourth_row_data &new_forth_row){
+// Measure the new fourth row in the back buffer
+void MatrixDriver::measureFourthRow(){
+    fourth_row_data& new_fourth_row = back_rows.fourth;
     
-    try {
-        if(new_forth_row.api_version < fourth_row_content.api_version) {
-            throw std::runtime_error("New fourth row data has an API version less than the last update! ");
-        }
-        if(new_forth_row.api_version == fourth_row_content.api_version){
-            return;
-        } else {
-            fourth_row_content.location = new_forth_row.location;
-            fourth_row_content.location.setWidth(font_cache);
-            fourth_row_content.location.x_position = (matrix_width - fourth_row_content.location.width)/2;
-            
-            fourth_row_content.message = new_forth_row.message;
-            fourth_row_content.message.setWidth(font_cache);
-            if(fourth_row_content.message.text.empty()) {
-                fourth_row_content.has_message = false;
-            } else {
-                fourth_row_content.has_message = true;
-            }
-            fourth_row_content.api_version = new_forth_row.api_version;
-            
-            fourth_row_config.refresh_state.triggerRefresh();
-            
-            if(debug_mode){
-                std::cerr << "   [Matrix_Driver] ==> Fourth Row content post-update" <<std::endl;
-                std::cerr << "   [Matrix_Driver] y_position: " << fourth_row_config.y_position <<std::endl;
-                fourth_row_content.location.fulldump("[Matrix_Driver] Location");
-                std::cerr << "   [Matrix_Driver] Has message: " << fourth_row_content.has_message << std::endl;
-                fourth_row_content.message.fulldump("[Matrix_Driver] Message");
-                std::cerr << "   [Matrix_Driver] api version: " << fourth_row_content.api_version <<std::endl;
-            }
-        }
-    } catch(const std::exception& e) {
-        std::cerr << "[Matrix_Driver] Error updating the fourth row" << e.what() << std::endl;
-    }
+    new_fourth_row.location.setWidth(font_cache);
+    new_fourth_row.location.x_position = (matrix_width - new_fourth_row.location.width)/2;
+    
+    new_fourth_row.message.setWidth(font_cache);
+    new_fourth_row.has_message = !new_fourth_row.message.text.empty();
 }
 
 void MatrixDriver::renderFourthRow(){
-    try {
-        if (fourth_row_config.fourth_row_state == LOCATION){                                                                                            // Display the Location on the 4th row
-            if(fourth_row_config.refresh_state.needsRender()) {                                                                                         // If a render is required....
-                // DEBUG_PRINT("Refreshing 4th row (location)");
-                clearArea(0, fourth_row_config.y_position - font_baseline, matrix_width, fourth_row_config.y_position + font_height - font_baseline);   // clear the row
-                rgb_matrix::DrawText(canvas, font, fourth_row_content.location.x_position, fourth_row_config.y_position, white, fourth_row_content.location.text.c_str());
-                
-                fourth_row_config.refresh_state.completePass();                                                                                         // flag the pass as complete.
-            }
-        } else {                                                                                                                                        // Scroll the message
-            clearArea(0, fourth_row_config.y_position - font_baseline, matrix_width, fourth_row_config.y_position + font_height - font_baseline);       // Clear the row
-            
-            rgb_matrix::DrawText(canvas, font, fourth_row_content.message.x_position, fourth_row_config.y_position, white, fourth_row_content.message.text.c_str());
-            if (fourth_row_content.message.x_position < 0) {
-                rgb_matrix::DrawText(canvas, font, fourth_row_content.message.x_position + matrix_width + fourth_row_content.message.width, fourth_row_config.y_position, white, fourth_row_content.message.text.c_str());
-            }
+    if (fourth_row_config.fourth_row_state == LOCATION){                                                                                            // Display the Location on the 4th row
+        if(fourth_row_config.refresh_state.needsRender()) {                                                                                         // If a render is required....
+            // DEBUG_PRINT("Refreshing 4th row (location)");
+            clearArea(0, fourth_row_config.y_position - font_baseline, matrix_width, fourth_row_config.y_position + font_height - font_baseline);   // clear the row
+            rgb_matrix::DrawText(canvas, font, fourth_row_content.location.x_position, fourth_row_config.y_position, text_ink, fourth_row_content.location.text.c_str());
             
+            fourth_row_config.refresh_state.completePass();                                                                                         // flag the pass as complete.
         }
-    } catch(const std::exception& e) {
-        std::cerr << "[Matrix_Driver] Error rendering the first row" << e.what() << std::endl;
+    } else {                                                                                                                                        // Scroll the message
+        clearArea(0, fourth_row_config.y_position - font_baseline, matrix_width, fourth_row_config.y_position + font_height - font_baseline);       // Clear the row
+        
+        rgb_matrix::DrawText(canvas, font, fourth_row_content.message.x_position, fourth_row_config.y_position, text_ink, fourth_row_content.message.text.c_str());
+        if (fourth_row_content.message.x_position < 0) {
+            rgb_matrix::DrawText(canvas, font, fourth_row_content.message.x_position + matrix_width + fourth_row_content.message.width, fourth_row_config.y_position, text_ink, fourth_row_content.message.text.c_str());
+        }
+        
     }
 }
 
@@ -762,7 +814,7 @@ void MatrixDriver::updateClockDisplay(const std::chrono::steady_clock::time_poin
     }
     
     clearArea(the_clock.x_position - 2, fourth_row_config.y_position - font_baseline, matrix_width, fourth_row_config.y_position + font_height - font_baseline);
-    rgb_matrix::DrawText(canvas, font, the_clock.x_position, fourth_row_config.y_position, white, time_buffer);      // Always draw (very fast operation)
+    rgb_matrix::DrawText(canvas, font, the_clock.x_position, fourth_row_config.y_position, text_ink, time_buffer);      // Always draw (very fast operation)
 }
 
 // Debugging methods to display data-structures
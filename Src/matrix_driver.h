@@ -18,7 +18,14 @@
 #include <ctime>
 #include <iomanip>
 #include <tuple>
+#include <vector>
+#include <memory>
+#include <algorithm>
 #include "display_text.h"
+#include "palette_framebuffer.h"
+#include "frame_presenter.h"
+#include "pixel_mapper_lut.h"
+#include "frame_stream.h"
 #include "config.h"
 
 using namespace rgb_matrix;
@@ -27,6 +34,27 @@ using namespace rgb_matrix;
 extern bool debug_mode;
 #define DEBUG_PRINT(x) if(debug_mode) { std::cerr << x << std::endl; }
 
+// Off-screen canvas - used when the driver runs headless (benchmarks and profile training) so no GPIO access is needed
+class OffscreenCanvas : public Canvas {
+public:
+    OffscreenCanvas(int width, int height) : canvas_width(width), canvas_height(height), pixels(static_cast<size_t>(width) * height * 3, 0) {}
+    int width() const override { return canvas_width; }
+    int height() const override { return canvas_height; }
+    void SetPixel(int x, int y, uint8_t red, uint8_t green, uint8_t blue) override {
+        if (x < 0 || y < 0 || x >= canvas_width || y >= canvas_height) return;
+        uint8_t* p = &pixels[(static_cast<size_t>(y) * canvas_width + x) * 3];
+        p[0] = red; p[1] = green; p[2] = blue;
+    }
+    void Clear() override { std::fill(pixels.begin(), pixels.end(), 0); }
+    void Fill(uint8_t red, uint8_t green, uint8_t blue) override {
+        for (size_t i = 0; i < pixels.size(); i += 3) { pixels[i] = red; pixels[i + 1] = green; pixels[i + 2] = blue; }
+    }
+private:
+    int canvas_width;
+    int canvas_height;
+    std::vector<uint8_t> pixels;
+};
+
 class MatrixDriver {
 public:
     
@@ -35,6 +63,7 @@ public:
         DisplayText destination;
         DisplayText scheduled_departure_time;
         DisplayText estimated_depature_time;
+        PaletteFramebuffer::Ink estimated_departure_ink = PaletteFramebuffer::TEXT; // Status colour - set when measured
         bool coach_info_available;
         DisplayText coaches;
         int64_t api_version;
@@ -42,6 +71,7 @@ public:
     
     struct second_row_data {                                                        // Second row data-structure
         DisplayText calling_points;
+        bool calling_points_measured = false;                                       // calling_points.width is already set (TrainServiceParser::formatCallingPoints)
         DisplayText service_message;
         bool has_calling_points;
         int64_t api_version;
@@ -52,6 +82,8 @@ public:
         DisplayText second_departure_estimated_departure_time;
         DisplayText third_departure;
         DisplayText third_departure_estimated_departure_time;
+        PaletteFramebuffer::Ink second_departure_ink = PaletteFramebuffer::TEXT;    // Status colours - set when measured
+        PaletteFramebuffer::Ink third_departure_ink = PaletteFramebuffer::TEXT;
         int64_t api_version;
     };
     
@@ -61,6 +93,13 @@ public:
         bool has_message;
         int64_t api_version;
     };
+    
+    struct display_rows {                                                           // A complete set of rows - built in the back buffer and swapped in together
+        first_row_data first;
+        second_row_data second;
+        third_row_data third;
+        fourth_row_data fourth;
+    };
 
     
     MatrixDriver(const Config& configuration);
@@ -69,11 +108,29 @@ public:
     void initialiseMatrix();                                                        // Initialise the RGB Matrix
     void render();                                                                  // Render the data into the matrix display
     void stop();                                                                    // Stop the matrix
+    bool isHeadless() const { return headless; }                                    // True if rendering to an off-screen canvas
+    const FontCache& getFontCache() const { return font_cache; }                    // Character widths - for measuring text as it's built
+    bool setTheme(const std::string& theme);                                        // Swap the palette (white, amber or mono) - false if there's no such theme
+    size_t getPixelsPushed() const { return pixels_pushed; }                        // Pixels written to the matrix canvas since the start
+    const PaletteFramebuffer& getFramebuffer() const { return *framebuffer; }       // The frame as drawn (palette indices)
+    const PixelMapperLUT& getPixelMapper() const { return pixel_mapper; }           // Not mapped unless led-pixel-mapper is one the driver maps itself
+    FrameStream::FrameSender* getFrameSender() { return frame_sender.get(); }       // nullptr unless the frames are streamed (stream_to)
+    FramePresenter::Metrics getFrameMetrics() const;                                // Compose, push and vsync wait times of the frames shown
+    void resetFrameMetrics();
+    
+    // RGBMatrix options from the configuration - shared with the frame receiver, which drives a matrix without the rest of the driver
+    static void configureMatrixOptions(const Config::matrix_options& parameters, RGBMatrix::Options& options);
+    static void configureRuntimeOptions(const Config::matrix_options& parameters, RuntimeOptions& runtime_opt);
     
-    void updateFirstRow(const first_row_data& new_first_row);                       // Update the first row content
-    void updateSecondRow(const second_row_data& new_second_row);                    // Udate the second row content
-    void updateThirdRow(const third_row_data& new_third_row);                       // Update the third row content
-    void updateFourthRow(const fourth_row_data& new_forth_row);                     // Update the fourth row content
+    display_rows& beginUpdate();                                                    // Clear the back buffer and return it to be filled with the next content
+    void commitUpdate(int64_t api_version);                                         // Measure the back buffer and swap it in - the display only ever sees a complete set of rows
+    
+    // Errors while rendering - counted rather than thrown (render is called every frame)
+    struct ErrorCounters {
+        uint64_t not_configured = 0;                                                // Frames skipped - matrix not configured
+        uint64_t stale_updates = 0;                                                 // Updates ignored - older API version than the rows shown
+    };
+    const ErrorCounters& getErrorCounters() const { return error_counters; }
     
     void debugPrintFirstRowData();                                                  // Data-dumps for debugging
     void debugPrintFirstRowConfig();
@@ -92,8 +149,17 @@ private:
 
     // Display components
     Config::matrix_options matrix_parameters;                                       // Matrix parameters
-    RGBMatrix* the_matrix;                                                          // Matrix
-    FrameCanvas* canvas;                                                            // Matrix canvas for creating content to display
+    RGBMatrix* the_matrix;                                                          // Matrix (nullptr when headless)
+    std::unique_ptr<OffscreenCanvas> offscreen_canvas;                              // Off-screen canvas used when headless
+    std::unique_ptr<PaletteFramebuffer> framebuffer;                                // Palette-indexed frame - changed pixels are pushed to the matrix's frame canvas or offscreen_canvas
+    std::unique_ptr<FramePresenter> presenter;                                      // Pushes and swaps the frames on vsync - on its own thread if present_thread
+    PixelMapperLUT pixel_mapper;                                                    // led-pixel-mapper resolved to a table - the matrix is created without it
+    Canvas* canvas;                                                                 // Canvas for creating content to display (the framebuffer)
+    size_t pixels_pushed;                                                           // Pixels written from the framebuffer to the matrix canvas
+    std::unique_ptr<FrameStream::FrameSender> frame_sender;                         // Frames sent to remote display nodes (stream_to)
+    std::chrono::microseconds stream_frame_interval;                                // Frame pacing when headless and streaming (no vsync to wait on)
+    std::chrono::steady_clock::time_point next_stream_frame;
+    bool headless;                                                                  // Render without a physical matrix (benchmarks, profile training)
     Font font;                                                                      // Font
     FontCache font_cache;                                                           // Cache of font sizes
     int font_baseline;                                                              // Baseline size of the font
@@ -103,9 +169,9 @@ private:
     std::atomic<bool> matrix_configured;                                            // Flag to indicate whether the display is running
     const Config& config;                                                           // Configuration object
     
-    // Colors
-    Color white;
-    Color black;
+    // Colors - palette indices, see PaletteFramebuffer::ink()
+    Color text_ink;
+    static PaletteFramebuffer::Ink statusInk(const std::string& estimated_departure_time);  // On time, delayed or cancelled
 
     // Display state
     enum FirstRowState { ETD, COACHES };                                            // Toggle to show the Estimated Time of Departure or Coaches on the 1st line
@@ -196,6 +262,8 @@ private:
     third_row_data third_row_content;                                               // Third row content
     fourth_row_configuration fourth_row_config;                                     // Fourth row configuration - location, states, toggles.
     fourth_row_data fourth_row_content;                                             // Fourth row content
+    display_rows back_rows;                                                         // Back buffer - the next content for all rows (see beginUpdate/commitUpdate)
+    ErrorCounters error_counters;
     
     //Helper functions
     
@@ -204,9 +272,13 @@ private:
     void configureThirdRow();
     void configureFourthRow();
     
+    // Measuring the new content in the back buffer (before it's swapped in)
+    void measureFirstRow();
+    void measureSecondRow();
+    void measureThirdRow();
+    void measureFourthRow();
+    
     // Matrix Configuration
-    void configureMatrixOptions(RGBMatrix::Options& options) const;
-    void configureRuntimeOptions(RuntimeOptions& runtime_opt) const;
     
     // Matrix Rendering
     void clearArea(int x_origin, int y_origin, int x_size, int y_size);             // Clear an area on the matrix
@@ -0,0 +1,215 @@
+//
+//  palette_framebuffer.h
+//  Departure_Board
+//
+//  The display is drawn into a 4-bit palette-indexed framebuffer and only the pixels which changed are pushed to the
+//  matrix's canvas - expanded to RGB from the palette on the way.
+//
+//  Text is drawn with rgb_matrix::DrawText as before, with an ink (a palette index) as the colour - the red channel
+//  carries the index (see ink()). Redrawing something that hasn't changed costs a compare, not a write to the panel's
+//  canvas. Changing the palette (a theme) changes the colours without drawing anything again.
+//
+//  Each pixel row keeps the span of pixels changed since the last push. The matrix canvases are double buffered
+//  (SwapOnVSync) - the canvas being pushed to was last pushed two frames ago, so a push writes the span changed this
+//  frame and the one changed the frame before.
+//
+
+#ifndef PALETTE_FRAMEBUFFER_H
+#define PALETTE_FRAMEBUFFER_H
+
+#include <led-matrix.h>
+#include <graphics.h>
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include "pixel_mapper_lut.h"
+
+class PaletteFramebuffer : public rgb_matrix::Canvas {
+public:
+    enum Ink : uint8_t { BACKGROUND, TEXT, ON_TIME, DELAYED, CANCELLED };           // Palette indices (up to 16)
+    static constexpr size_t PALETTE_SIZE = 16;
+    using Palette = std::array<rgb_matrix::Color, PALETTE_SIZE>;
+
+    static rgb_matrix::Color ink(Ink index) { return rgb_matrix::Color(index, 0, 0); }  // Colour to draw with - the red channel is the palette index
+
+    PaletteFramebuffer(int width, int height) :
+        fb_width(width), fb_height(height), stride((static_cast<size_t>(width) + 1) / 2),
+        pixels(stride * static_cast<size_t>(height), 0), dirty(static_cast<size_t>(height)), previous_dirty(static_cast<size_t>(height)) {
+        themePalette("white", palette);
+        full_pushes = 2;                                                            // The canvases start black - push everything once to each
+    }
+
+    int width() const override { return fb_width; }
+    int height() const override { return fb_height; }
+
+    void SetPixel(int x, int y, uint8_t red, uint8_t, uint8_t) override {
+        if (x < 0 || y < 0 || x >= fb_width || y >= fb_height) return;
+        uint8_t& pair = pixels[static_cast<size_t>(y) * stride + static_cast<size_t>(x) / 2];
+        uint8_t index = red & 0x0F;
+        uint8_t updated = (x & 1) ? static_cast<uint8_t>((pair & 0x0F) | (index << 4)) : static_cast<uint8_t>((pair & 0xF0) | index);
+        if (updated == pair) return;
+        pair = updated;
+        dirty[static_cast<size_t>(y)].add(x, x);
+    }
+
+    uint8_t getIndex(int x, int y) const {                                           // Palette index of a pixel (BACKGROUND off the framebuffer)
+        if (x < 0 || y < 0 || x >= fb_width || y >= fb_height) return BACKGROUND;
+        uint8_t pair = pixels[static_cast<size_t>(y) * stride + static_cast<size_t>(x) / 2];
+        return (x & 1) ? (pair >> 4) : (pair & 0x0F);
+    }
+
+    // Packed pixels - two a byte, even x in the low nibble, rows of (width + 1) / 2 bytes. For frame streaming.
+    const std::vector<uint8_t>& getPacked() const { return pixels; }
+
+    // Replace the pixels with packed ones (the same size) - only the bytes which differ are marked changed
+    void setPacked(const std::vector<uint8_t>& packed) {
+        if (packed.size() != pixels.size()) return;
+        for (int y = 0; y < fb_height; y++) {
+            size_t row = static_cast<size_t>(y) * stride;
+            for (size_t byte = 0; byte < stride; byte++) {
+                if (pixels[row + byte] == packed[row + byte]) continue;
+                pixels[row + byte] = packed[row + byte];
+                int x = static_cast<int>(byte * 2);
+                dirty[static_cast<size_t>(y)].add(x, std::min(x + 1, fb_width - 1));
+            }
+        }
+    }
+
+    void Clear() override { fill(0, 0, fb_width, fb_height, BACKGROUND); }
+    void Fill(uint8_t red, uint8_t, uint8_t) override { fill(0, 0, fb_width, fb_height, red & 0x0F); }
+
+    // Fill x_origin <= x < x_end, y_origin <= y < y_end (clipped to the framebuffer)
+    void fill(int x_origin, int y_origin, int x_end, int y_end, uint8_t index) {
+        x_origin = std::max(x_origin, 0);
+        y_origin = std::max(y_origin, 0);
+        x_end = std::min(x_end, fb_width);
+        y_end = std::min(y_end, fb_height);
+        index &= 0x0F;
+        const uint8_t both = static_cast<uint8_t>(index | (index << 4));
+        for (int y = y_origin; y < y_end; y++) {
+            uint8_t* row = &pixels[static_cast<size_t>(y) * stride];
+            int first_changed = x_end;
+            int last_changed = -1;
+            for (int x = x_origin; x < x_end; ) {
+                uint8_t& pair = row[x / 2];
+                if (!(x & 1) && x + 1 < x_end) {                                    // Both pixels of the byte
+                    if (pair != both) {
+                        first_changed = std::min(first_changed, (pair & 0x0F) != index ? x : x + 1);
+                        last_changed = (pair >> 4) != index ? x + 1 : x;
+                        pair = both;
+                    }
+                    x += 2;
+                    continue;
+                }
+                uint8_t updated = (x & 1) ? static_cast<uint8_t>((pair & 0x0F) | (index << 4)) : static_cast<uint8_t>((pair & 0xF0) | index);
+                if (updated != pair) {
+                    pair = updated;
+                    first_changed = std::min(first_changed, x);
+                    last_changed = x;
+                }
+                x++;
+            }
+            if (last_changed >= 0) dirty[static_cast<size_t>(y)].add(first_changed, last_changed);
+        }
+    }
+
+    // Write the changed pixels to the target canvas as RGB - through the mapper's table to the panels' positions if there
+    // is one (the same size as the framebuffer). Returns the number of pixels written.
+    size_t push(rgb_matrix::Canvas* target, const PixelMapperLUT* mapper = nullptr) {
+        size_t written = 0;
+        for (int y = 0; y < fb_height; y++) {
+            Span span = dirty[static_cast<size_t>(y)];
+            span.add(previous_dirty[static_cast<size_t>(y)]);
+            if (full_pushes > 0) span.add(0, fb_width - 1);
+            previous_dirty[static_cast<size_t>(y)] = dirty[static_cast<size_t>(y)];
+            dirty[static_cast<size_t>(y)] = Span();
+            if (span.empty()) continue;
+
+            const uint8_t* row = &pixels[static_cast<size_t>(y) * stride];
+            if (mapper != nullptr) {
+                const uint32_t* panel = mapper->row(y);
+                for (int x = span.first; x <= span.last; x++) {
+                    uint8_t index = (x & 1) ? (row[x / 2] >> 4) : (row[x / 2] & 0x0F);
+                    const rgb_matrix::Color& colour = palette[index];
+                    target->SetPixel(static_cast<int>(panel[x] & 0xFFFF), static_cast<int>(panel[x] >> 16), colour.r, colour.g, colour.b);
+                }
+            } else {
+                for (int x = span.first; x <= span.last; x++) {
+                    uint8_t index = (x & 1) ? (row[x / 2] >> 4) : (row[x / 2] & 0x0F);
+                    const rgb_matrix::Color& colour = palette[index];
+                    target->SetPixel(x, y, colour.r, colour.g, colour.b);
+                }
+            }
+            written += static_cast<size_t>(span.last - span.first + 1);
+        }
+        if (full_pushes > 0) full_pushes--;
+        return written;
+    }
+
+    // New colours for every pixel - nothing is drawn again, the next two pushes write the whole frame
+    void setPalette(const Palette& new_palette) {
+        palette = new_palette;
+        full_pushes = 2;
+    }
+    const Palette& getPalette() const { return palette; }
+
+    // Built-in themes: white (white text), amber (amber text) and mono (white text and status - no colour).
+    // On time is green, delayed amber and cancelled red. False if the name isn't a theme (the palette is unchanged).
+    static bool themePalette(const std::string& name, Palette& theme) {
+        const rgb_matrix::Color black(0, 0, 0);
+        const rgb_matrix::Color white(255, 255, 255);
+        const rgb_matrix::Color amber(255, 160, 0);
+        const rgb_matrix::Color green(0, 255, 0);
+        const rgb_matrix::Color red(255, 0, 0);
+        Palette palette;
+        palette.fill(white);
+        palette[BACKGROUND] = black;
+        if (name == "white") {
+            palette[TEXT] = white;
+            palette[ON_TIME] = green;
+            palette[DELAYED] = amber;
+            palette[CANCELLED] = red;
+        } else if (name == "amber") {
+            palette[TEXT] = amber;
+            palette[ON_TIME] = green;
+            palette[DELAYED] = amber;
+            palette[CANCELLED] = red;
+        } else if (name != "mono") {
+            return false;
+        }
+        theme = palette;
+        return true;
+    }
+
+private:
+    struct Span {                                                                   // Changed pixels first..last in a row (empty if last < first)
+        int first = 1;
+        int last = 0;
+        bool empty() const { return last < first; }
+        void add(int from, int to) {
+            if (empty()) {
+                first = from;
+                last = to;
+            } else {
+                first = std::min(first, from);
+                last = std::max(last, to);
+            }
+        }
+        void add(const Span& other) {
+            if (!other.empty()) add(other.first, other.last);
+        }
+    };
+
+    int fb_width;
+    int fb_height;
+    size_t stride;                                                                  // Bytes per row - two pixels per byte (even x in the low nibble)
+    std::vector<uint8_t> pixels;
+    std::vector<Span> dirty;                                                        // Changed since the last push
+    std::vector<Span> previous_dirty;                                               // Changed in the frame before - not yet on the other canvas
+    Palette palette;
+    int full_pushes = 0;                                                            // Pushes left which write every pixel (after a palette change)
+};
+
+#endif // PALETTE_FRAMEBUFFER_H
@@ -0,0 +1,460 @@
+//
+//  payload_generator.cpp
+//  Departure_Board
+//
+//  Synthetic GetArrDepBoardWithDetails responses for the replay harness ('make generator', 'make stress').
+//  The recorded responses only cover the boards our stations have - this writes boards of any size so
+//  prefetchCache, the calling points and the HTML processor can be benchmarked beyond them.
+//
+//  The responses follow the LDBSVWS JSON the departure board receives (member order included): services with
+//  destination/origin, subsequent and previous calling points, delay/cancel reasons and formation, plus the
+//  NRCC messages. Every refresh moves the board on - services depart, new ones join the end, estimated times,
+//  platforms and cancellations change (the churn).
+//
+//  Writes to the output directory:
+//    generated_reason_codes_response.json        Reason codes for the delay/cancel reasons used
+//    generated_departures_N_response.json        One response per refresh
+//    scenario.txt                                Replays the refreshes and runs the 'stress' stages
+//
+//  The same seed always gives the same responses.
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <sys/stat.h>
+#include <nlohmann/json.hpp>
+
+using ordered_json = nlohmann::ordered_json;
+
+namespace {
+
+struct GeneratorOptions {
+    std::string output_dir = "Replay/Generated";
+    int refreshes = 10;
+    int services = 200;
+    int min_calling_points = 4;                                                         // Subsequent calling points per service
+    int max_calling_points = 40;
+    int previous_points = 3;                                                            // Previous calling points per service
+    int coaches = 0;                                                                    // Coaches in the formation - 0 for loading only (as most of our stations)
+    int messages = 1;                                                                   // NRCC messages
+    int message_bytes = 300;                                                            // Approximate size of each NRCC message
+    double entity_density = 0.1;                                                        // Fraction of words in a message with an HTML entity or tag
+    double churn = 0.05;                                                                // Fraction of services changed (and departing) each refresh
+    unsigned seed = 1;
+    int indent = -1;                                                                    // -1 for compact JSON (as the API sends it)
+};
+
+constexpr int REASON_CODE_BASE = 100;
+constexpr int REASON_CODES = 24;
+constexpr int MINUTES_PER_REFRESH = 1;                                                  // Board time moved on by each refresh
+
+struct Station {
+    std::string name;
+    std::string crs;
+};
+
+struct CallingPoint {
+    size_t station;
+    int minutes;                                                                        // Scheduled time - minutes after the board date's midnight
+    bool is_pass;
+};
+
+struct Service {
+    int number;                                                                         // Gives the train ID and RID
+    int departure;                                                                      // Scheduled departure (minutes)
+    int delay = 0;                                                                      // Minutes late
+    bool cancelled = false;
+    bool estimate_known = true;                                                         // etdSpecified - false shows "Delayed"
+    int platform;
+    size_t operator_index;
+    int length;
+    int loading;
+    int delay_reason;
+    int cancel_reason;
+    size_t origin;
+    std::vector<CallingPoint> subsequent;
+    std::vector<CallingPoint> previous;
+};
+
+// Station names built from parts - a few hundred distinct stations with unique CRS codes
+std::vector<Station> makeStations() {
+    static const char* const prefixes[] = {"", "North ", "South ", "East ", "West ", "Upper ", "Great "};
+    static const char* const towns[] = {"Ashford", "Barton", "Calder", "Dunmore", "Elmbridge", "Fairhaven", "Glenford",
+                                        "Harwick", "Ivybridge", "Kingsmoor", "Langley", "Marston", "Newbury", "Oakham",
+                                        "Penrith", "Redhill", "Stamford", "Thornbury", "Wickham", "Yarwell"};
+    static const char* const suffixes[] = {"", " Central", " Parkway", " Junction", " Road"};
+    std::vector<Station> stations;
+    for (const char* prefix : prefixes) {
+        for (const char* town : towns) {
+            for (const char* suffix : suffixes) {
+                size_t n = stations.size();
+                std::string crs = {static_cast<char>('A' + n / 676 % 26), static_cast<char>('A' + n / 26 % 26), static_cast<char>('A' + n % 26)};
+                stations.push_back({std::string(prefix) + town + suffix, crs});
+            }
+        }
+    }
+    return stations;
+}
+
+std::string timeString(int minutes) {                                                   // yyyy-mm-ddThh:mm:ss - minutes from midnight on 2026-10-18, as many days on as a large board runs to
+    std::tm start = {};
+    start.tm_year = 2026 - 1900;
+    start.tm_mon = 9;
+    start.tm_mday = 18;
+    std::time_t time = timegm(&start) + static_cast<std::time_t>(minutes) * 60;
+    std::tm date;
+    gmtime_r(&time, &date);
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &date);
+    return text;
+}
+
+class PayloadGenerator {
+public:
+    explicit PayloadGenerator(const GeneratorOptions& options) : options(options), random(options.seed), stations(makeStations()) {
+        board_station = 0;
+        next_departure = 5 * 60;                                                        // First service at 05:00
+        for (int i = 0; i < options.services; i++) {
+            board.push_back(newService());
+        }
+    }
+
+    // Move the board on by one refresh
+    void churn() {
+        now += MINUTES_PER_REFRESH;
+        size_t changes = static_cast<size_t>(options.churn * board.size() + 0.5);
+        size_t departed = std::min(board.size(), (changes + 1) / 2);
+        board.erase(board.begin(), board.begin() + static_cast<std::ptrdiff_t>(departed));
+        while (board.size() < static_cast<size_t>(options.services)) {
+            board.push_back(newService());
+        }
+        for (size_t i = 0; i < changes && !board.empty(); i++) {
+            Service& service = board[pick(board.size())];
+            switch (pick(6)) {
+                case 0:
+                    service.cancelled = !service.cancelled;
+                    break;
+                case 1:
+                    service.estimate_known = !service.estimate_known;
+                    break;
+                case 2:
+                    service.platform = 1 + static_cast<int>(pick(platforms));
+                    break;
+                default:
+                    service.delay = std::max(0, service.delay + static_cast<int>(pick(7)) - 2);
+                    service.delay_reason = REASON_CODE_BASE + static_cast<int>(pick(REASON_CODES));
+                    break;
+            }
+        }
+        message_serial++;
+    }
+
+    std::string departures() {
+        ordered_json response;
+        response["locationName"] = stations[board_station].name;
+        response["crs"] = stations[board_station].crs;
+        if (options.messages > 0) {
+            response["nrccMessages"] = ordered_json::array();
+            for (int i = 0; i < options.messages; i++) {
+                response["nrccMessages"].push_back({{"xhtmlMessage", nrccMessage(i)}});
+            }
+        }
+        response["trainServices"] = ordered_json::array();
+        for (const Service& service : board) {
+            response["trainServices"].push_back(serviceJSON(service));
+        }
+        return response.dump(options.indent);
+    }
+
+    static std::string reasonCodes(int indent) {
+        static const char* const reasons[] = {"a fault on this train", "a signalling fault", "congestion", "a points failure",
+                                              "a shortage of train crew", "an earlier broken down train", "overhead line problems",
+                                              "a trespass incident", "flooding", "a fault with the level crossing", "slippery rails",
+                                              "a speed restriction", "late running freight", "an animal on the line",
+                                              "a landslip", "engineering works overrunning", "a lineside fire", "high winds",
+                                              "a passenger taken ill", "a fault on the platform doors", "the train being late from the depot",
+                                              "an obstruction on the line", "a power cut", "a broken rail"};
+        ordered_json codes = ordered_json::array();
+        for (int i = 0; i < REASON_CODES; i++) {
+            const char* reason = reasons[i % (sizeof(reasons) / sizeof(reasons[0]))];
+            codes.push_back({{"code", REASON_CODE_BASE + i}, {"lateReason", reason}, {"cancReason", reason}});
+        }
+        return codes.dump(indent);
+    }
+
+private:
+    const GeneratorOptions options;
+    std::mt19937 random;
+    std::vector<Station> stations;
+    std::vector<Service> board;
+    size_t board_station;
+    int now = 0;
+    int next_departure;
+    int next_number = 0;
+    int message_serial = 0;
+    static constexpr size_t platforms = 6;
+
+    size_t pick(size_t n) {                                                             // 0 to n-1
+        return std::uniform_int_distribution<size_t>(0, n - 1)(random);
+    }
+
+    bool chance(double p) {
+        return std::uniform_real_distribution<double>(0.0, 1.0)(random) < p;
+    }
+
+    size_t otherStation() {
+        return 1 + pick(stations.size() - 1);                                           // Never the board's own station
+    }
+
+    Service newService() {
+        static const size_t operators = 8;
+        Service service;
+        service.number = next_number++;
+        next_departure += 1 + static_cast<int>(pick(4));
+        service.departure = next_departure;
+        service.delay = chance(0.3) ? static_cast<int>(pick(15)) : 0;
+        service.cancelled = chance(0.03);
+        service.estimate_known = !chance(0.05);
+        service.platform = 1 + static_cast<int>(pick(platforms));
+        service.operator_index = pick(operators);
+        service.length = 2 + 2 * static_cast<int>(pick(6));
+        service.loading = static_cast<int>(pick(101));
+        service.delay_reason = REASON_CODE_BASE + static_cast<int>(pick(REASON_CODES));
+        service.cancel_reason = REASON_CODE_BASE + static_cast<int>(pick(REASON_CODES));
+        service.origin = otherStation();
+
+        int calling_points = options.min_calling_points +
+                             static_cast<int>(pick(static_cast<size_t>(options.max_calling_points - options.min_calling_points + 1)));
+        int minutes = service.departure;
+        for (int i = 0; i < calling_points; i++) {
+            minutes += 2 + static_cast<int>(pick(9));
+            service.subsequent.push_back({otherStation(), minutes, chance(0.1)});
+        }
+        if (!service.subsequent.empty()) service.subsequent.back().is_pass = false;     // A train doesn't pass its destination
+        minutes = service.departure;
+        for (int i = 0; i < options.previous_points; i++) {
+            minutes -= 2 + static_cast<int>(pick(9));
+            service.previous.insert(service.previous.begin(), {otherStation(), minutes, false});
+        }
+        return service;
+    }
+
+    ordered_json serviceJSON(const Service& service) {
+        static const char* const operators[] = {"East Midlands Railway", "Thameslink", "Great Western Railway", "Northern",
+                                                "CrossCountry", "Southern", "London North Eastern Railway", "TransPennine Express"};
+        char trainid[8];
+        std::snprintf(trainid, sizeof(trainid), "%d%c%02d", 1 + service.number / 2600 % 9, 'A' + service.number / 100 % 26, service.number % 100);
+        const Station& destination = stations[service.subsequent.empty() ? service.origin : service.subsequent.back().station];
+
+        ordered_json json;
+        json["trainid"] = trainid;
+        json["rid"] = std::to_string(202500000000LL + service.number);
+        json["std"] = timeString(service.departure);
+        json["stdSpecified"] = true;
+        json["etdSpecified"] = service.estimate_known && !service.cancelled;
+        json["etd"] = timeString(service.departure + service.delay);
+        json["platform"] = std::to_string(service.platform);
+        json["operator"] = operators[service.operator_index];
+        json["length"] = service.length;
+        json["destination"] = ordered_json::array({{{"locationName", destination.name}, {"crs", destination.crs}}});
+        json["origin"] = ordered_json::array({{{"locationName", stations[service.origin].name}}});
+        json["isCancelled"] = service.cancelled;
+        json["departureType"] = service.estimate_known ? "Forecast" : "Delayed";
+        json["cancelReason"] = {{"Value", service.cancel_reason}};
+        json["delayReason"] = {{"Value", service.delay_reason}};
+
+        ordered_json subsequent = ordered_json::array();
+        for (const CallingPoint& point : service.subsequent) {
+            ordered_json location;
+            location["locationName"] = stations[point.station].name;
+            location["crs"] = stations[point.station].crs;
+            location["isPass"] = point.is_pass;
+            location["isCancelled"] = service.cancelled;
+            location["stdSpecified"] = true;
+            location["std"] = timeString(point.minutes);
+            location["etdSpecified"] = true;
+            location["etd"] = timeString(point.minutes + service.delay);
+            subsequent.push_back(std::move(location));
+        }
+        json["subsequentLocations"] = std::move(subsequent);
+
+        ordered_json previous = ordered_json::array();
+        for (const CallingPoint& point : service.previous) {
+            ordered_json location;
+            location["locationName"] = stations[point.station].name;
+            location["crs"] = stations[point.station].crs;
+            location["isPass"] = false;
+            location["arrivalType"] = point.minutes + 2 < now + 5 * 60 ? "Actual" : "Forecast";
+            location["staSpecified"] = true;
+            location["sta"] = timeString(point.minutes);
+            previous.push_back(std::move(location));
+        }
+        json["previousLocations"] = std::move(previous);
+
+        ordered_json formation;
+        formation["serviceLoading"] = {{"loadingPercentage", {{"type", "Typical"}, {"value", service.loading}}}};
+        if (options.coaches > 0) {
+            static const char* const toilets[] = {"None", "Standard", "Accessible"};
+            ordered_json coaches = ordered_json::array();
+            for (int i = 0; i < options.coaches; i++) {
+                ordered_json coach;
+                coach["coachClass"] = i == 0 ? "First" : "Standard";
+                coach["toilet"] = {{"status", "InService"}, {"Value", toilets[(service.number + i) % 3]}};
+                coach["loadingSpecified"] = true;
+                coach["loading"] = (service.loading + 17 * i) % 101;
+                coach["number"] = std::string(1, static_cast<char>('A' + i % 26));
+                coaches.push_back(std::move(coach));
+            }
+            formation["coaches"] = std::move(coaches);
+        }
+        json["formation"] = std::move(formation);
+        return json;
+    }
+
+    // A message of roughly message_bytes - a paragraph of words with entities and links at entity_density
+    std::string nrccMessage(int message) {
+        static const char* const words[] = {"disruption", "between", "and", "trains", "may", "be", "cancelled", "delayed",
+                                            "by", "up", "to", "minutes", "due", "to", "a", "fault", "tickets", "will",
+                                            "accepted", "on", "alternative", "routes", "services", "are", "running"};
+        static const char* const marked[] = {"&amp;", "&quot;%s&quot;", "<a href=\"https://www.nationalrail.co.uk/\">%s</a>",
+                                             "&lt;%s&gt;", "%s&#39;s", "%s&nbsp;", "<strong>%s</strong>"};
+        const size_t word_count = sizeof(words) / sizeof(words[0]);
+        const size_t marked_count = sizeof(marked) / sizeof(marked[0]);
+
+        std::string text = "<p>";
+        text += stations[(message_serial + message) % stations.size()].name;
+        while (text.size() < static_cast<size_t>(options.message_bytes)) {
+            text += ' ';
+            const char* word = words[pick(word_count)];
+            if (chance(options.entity_density)) {
+                char buffer[128];
+                std::snprintf(buffer, sizeof(buffer), marked[pick(marked_count)], word);
+                text += buffer;
+            } else {
+                text += word;
+            }
+        }
+        text += ".</p>";
+        return text;
+    }
+};
+
+void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("[Generator] Could not write " + path);
+    }
+    file << contents;
+}
+
+void showUsage(const char* programName) {
+    GeneratorOptions defaults;
+    std::cout << "Usage: " << programName << " [OPTIONS]\n"
+              << "Writes synthetic departure board responses and a replay scenario for the benchmark.\n"
+              << "Options:\n"
+              << "  -o, --output DIR          Output directory (default " << defaults.output_dir << ")\n"
+              << "  -n, --refreshes N         Number of refreshes (default " << defaults.refreshes << ")\n"
+              << "      --services N          Services on the board (default " << defaults.services << ")\n"
+              << "      --calling-points N[-M]\n"
+              << "                            Subsequent calling points per service (default " << defaults.min_calling_points << "-" << defaults.max_calling_points << ")\n"
+              << "      --previous-points N   Previous calling points per service (default " << defaults.previous_points << ")\n"
+              << "      --coaches N           Coaches in each formation - 0 for loading only (default " << defaults.coaches << ")\n"
+              << "      --messages N          NRCC messages (default " << defaults.messages << ")\n"
+              << "      --message-bytes N     Approximate size of each NRCC message (default " << defaults.message_bytes << ")\n"
+              << "      --entity-density F    Fraction of message words with an HTML entity or tag, 0-1 (default " << defaults.entity_density << ")\n"
+              << "      --churn F             Fraction of services changed each refresh, 0-1 (default " << defaults.churn << ")\n"
+              << "      --seed N              Random seed (default " << defaults.seed << ")\n"
+              << "      --indent N            Indent the JSON (default compact, as the API sends it)\n"
+              << "  -h, --help                Show this help message\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    GeneratorOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if ((arg == "-o" || arg == "--output") && has_value) {
+            options.output_dir = argv[++i];
+        } else if ((arg == "-n" || arg == "--refreshes") && has_value) {
+            options.refreshes = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--services" && has_value) {
+            options.services = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--calling-points" && has_value) {
+            std::string range = argv[++i];
+            size_t dash = range.find('-');
+            options.min_calling_points = std::max(1, std::atoi(range.c_str()));
+            options.max_calling_points = dash == std::string::npos ? options.min_calling_points
+                                                                   : std::max(options.min_calling_points, std::atoi(range.c_str() + dash + 1));
+        } else if (arg == "--previous-points" && has_value) {
+            options.previous_points = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--coaches" && has_value) {
+            options.coaches = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--messages" && has_value) {
+            options.messages = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--message-bytes" && has_value) {
+            options.message_bytes = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--entity-density" && has_value) {
+            options.entity_density = std::min(1.0, std::max(0.0, std::atof(argv[++i])));
+        } else if (arg == "--churn" && has_value) {
+            options.churn = std::min(1.0, std::max(0.0, std::atof(argv[++i])));
+        } else if (arg == "--seed" && has_value) {
+            options.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--indent" && has_value) {
+            options.indent = std::max(0, std::atoi(argv[++i]));
+        } else {
+            showUsage(argv[0]);
+            return (arg == "-h" || arg == "--help") ? 0 : 1;
+        }
+    }
+
+    try {
+        mkdir(options.output_dir.c_str(), 0755);                                        // Fails harmlessly if it's already there
+        const std::string dir = options.output_dir + "/";
+
+        writeFile(dir + "generated_reason_codes_response.json", PayloadGenerator::reasonCodes(options.indent));
+
+        PayloadGenerator generator(options);
+        size_t bytes = 0;
+        std::ostringstream refreshes;
+        for (int refresh = 1; refresh <= options.refreshes; refresh++) {
+            if (refresh > 1) generator.churn();
+            std::string name = "generated_departures_" + std::to_string(refresh) + "_response.json";
+            std::string response = generator.departures();
+            bytes += response.size();
+            writeFile(dir + name, response);
+            refreshes << "refresh " << name << "\nrender 60\n";
+        }
+
+        std::ostringstream scenario;
+        scenario << "# Generated by payload_generator - " << options.services << " services, " << options.min_calling_points << "-"
+                 << options.max_calling_points << " calling points, " << options.coaches << " coaches, " << options.messages << " x "
+                 << options.message_bytes << " byte NRCC messages, entity density " << options.entity_density << ", churn "
+                 << options.churn << ", seed " << options.seed << "\n"
+                 << "#\n"
+                 << "# The refreshes are shown on the board as configured (max_services) - 'stress' runs them through a parser sized\n"
+                 << "# for the whole board.\n\n"
+                 << "reasons generated_reason_codes_response.json\n\n"
+                 << refreshes.str() << "\n"
+                 << "stress " << options.refreshes << "\n";
+        writeFile(dir + "scenario.txt", scenario.str());
+
+        std::cout << "[Generator] " << options.refreshes << " responses of " << options.services << " services (" << bytes / options.refreshes / 1024
+                  << " KB each) and " << dir << "scenario.txt" << std::endl;
+
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,176 @@
+//
+//  pixel_mapper_lut.h
+//  Departure_Board
+//
+//  The led-pixel-mapper chain (U-mapper, Rotate, Mirror) resolved once into a table from each logical pixel - as the
+//  board is drawn - to its position on the chained panels.
+//
+//  With a mapper the matrix library moves every SetPixel through the mapper chain. When every mapper in the chain is
+//  one of these the driver creates the matrix without a mapper and pushes the framebuffer through the table instead
+//  (PaletteFramebuffer::push), so a mapped board costs the same per frame as an unmapped one. Any other mapper
+//  (V-mapper, Remap...) is left to the library.
+//
+//  The mappers work as the library's do: each maps its visible canvas onto the one before it, the first onto the
+//  panels (matrixcols * matrixchain_length by matrixrows * matrixparallel).
+//
+
+#ifndef PIXEL_MAPPER_LUT_H
+#define PIXEL_MAPPER_LUT_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+class PixelMapperLUT {
+public:
+    /**
+     * Resolve a led-pixel-mapper setting ("U-mapper;Rotate:90") for the panels - false (and not mapped) if the chain is
+     * empty or has a mapper this doesn't know, or the panels don't suit it (the U-mapper needs an even chain)
+     */
+    bool build(const std::string& mapper_config, int panel_width, int panel_height, int chain, int parallel) {
+        mappers.clear();
+        table.clear();
+        physical_width = panel_width;
+        physical_height = panel_height;
+        logical_width = panel_width;
+        logical_height = panel_height;
+
+        std::istringstream chain_config(mapper_config);
+        std::string entry;
+        while (std::getline(chain_config, entry, ';')) {
+            entry = trim(entry);
+            if (entry.empty()) continue;
+            size_t colon = entry.find(':');
+            std::string name = lower(trim(entry.substr(0, colon)));
+            std::string parameter = colon == std::string::npos ? std::string() : trim(entry.substr(colon + 1));
+
+            Mapper mapper;
+            mapper.input_width = logical_width;                                     // This mapper maps onto the canvas the one before made
+            mapper.input_height = logical_height;
+            if (name == "u-mapper") {
+                if (chain < 2 || chain % 2 != 0 || parallel < 1 || logical_height % parallel != 0) return fail();
+                mapper.kind = U_MAPPER;
+                mapper.parallel = parallel;
+                logical_width = (mapper.input_width / 64) * 32;                     // Folded at a 32 pixel boundary, as the library does
+                logical_height = 2 * mapper.input_height;
+            } else if (name == "rotate") {
+                int angle = parameter.empty() ? 0 : std::atoi(parameter.c_str());
+                if (angle % 90 != 0) return fail();
+                mapper.kind = ROTATE;
+                mapper.angle = (angle % 360 + 360) % 360;
+                if (mapper.angle % 180 != 0) std::swap(logical_width, logical_height);
+            } else if (name == "mirror") {
+                std::string direction = lower(parameter);
+                if (!direction.empty() && direction != "h" && direction != "v") return fail();
+                mapper.kind = MIRROR;
+                mapper.horizontal = direction != "v";
+            } else {
+                return fail();                                                      // Left to the library
+            }
+            mappers.push_back(mapper);
+        }
+        if (mappers.empty() || logical_width <= 0 || logical_height <= 0) return fail();
+
+        table.resize(static_cast<size_t>(logical_width) * static_cast<size_t>(logical_height));
+        for (int y = 0; y < logical_height; y++) {
+            for (int x = 0; x < logical_width; x++) {
+                int panel_x, panel_y;
+                map(x, y, panel_x, panel_y);
+                table[static_cast<size_t>(y) * static_cast<size_t>(logical_width) + static_cast<size_t>(x)] =
+                    static_cast<uint32_t>(panel_x) | (static_cast<uint32_t>(panel_y) << 16);
+            }
+        }
+        return true;
+    }
+
+    // Through the mappers, last to first - what the table holds for each pixel
+    void map(int x, int y, int& panel_x, int& panel_y) const {
+        for (size_t m = mappers.size(); m-- > 0; ) {
+            mappers[m].map(x, y);
+        }
+        panel_x = x;
+        panel_y = y;
+    }
+
+    bool isMapped() const { return !table.empty(); }
+    int width() const { return logical_width; }                                     // The board as drawn
+    int height() const { return logical_height; }
+    int panelWidth() const { return physical_width; }                               // The chained panels
+    int panelHeight() const { return physical_height; }
+    const uint32_t* row(int y) const { return &table[static_cast<size_t>(y) * static_cast<size_t>(logical_width)]; }  // Panel x | y << 16
+
+private:
+    enum Kind { U_MAPPER, ROTATE, MIRROR };
+
+    struct Mapper {
+        Kind kind = ROTATE;
+        int input_width = 0;                                                        // The canvas it maps onto
+        int input_height = 0;
+        int parallel = 1;
+        int angle = 0;
+        bool horizontal = true;
+
+        void map(int& x, int& y) const {
+            switch (kind) {
+                case U_MAPPER: {
+                    const int panel_height = input_height / parallel;
+                    const int visible_width = (input_width / 64) * 32;
+                    const int slab_height = 2 * panel_height;                       // One fold of the U
+                    const int base_y = (y / slab_height) * panel_height;
+                    y %= slab_height;
+                    if (y < panel_height) {
+                        x += input_width / 2;
+                    } else {
+                        x = visible_width - x - 1;
+                        y = slab_height - y - 1;
+                    }
+                    y += base_y;
+                    break;
+                }
+                case ROTATE: {
+                    const int from_x = x;
+                    switch (angle) {
+                        case 90:  x = input_width - y - 1;      y = from_x; break;
+                        case 180: x = input_width - x - 1;      y = input_height - y - 1; break;
+                        case 270: x = y;                        y = input_height - from_x - 1; break;
+                        default: break;
+                    }
+                    break;
+                }
+                case MIRROR:
+                    if (horizontal) x = input_width - 1 - x; else y = input_height - 1 - y;
+                    break;
+            }
+        }
+    };
+
+    bool fail() {
+        mappers.clear();
+        table.clear();
+        logical_width = physical_width;
+        logical_height = physical_height;
+        return false;
+    }
+    static std::string trim(const std::string& text) {
+        size_t first = text.find_first_not_of(" \t");
+        if (first == std::string::npos) return std::string();
+        return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+    }
+    static std::string lower(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    std::vector<Mapper> mappers;                                                    // In led-pixel-mapper order
+    std::vector<uint32_t> table;                                                    // Logical pixel -> panel x | y << 16
+    int physical_width = 0;
+    int physical_height = 0;
+    int logical_width = 0;
+    int logical_height = 0;
+};
+
+#endif // PIXEL_MAPPER_LUT_H
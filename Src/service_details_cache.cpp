@@ -0,0 +1,191 @@
+//
+//  service_details_cache.cpp
+//  Departure_Board
+//
+//  Two-tier fetching - see service_details_cache.h
+//
+
+#include <algorithm>
+#include <cctype>
+#include "service_details_cache.h"
+
+namespace {
+
+// Field access which tolerates missing, null or mistyped fields
+std::string stringField(const json& object, const char* key) {
+    auto it = object.find(key);
+    return (it != object.end() && it->is_string()) ? it->get<std::string>() : std::string();
+}
+
+bool boolField(const json& object, const char* key) {
+    auto it = object.find(key);
+    return it != object.end() && it->is_boolean() && it->get<bool>();
+}
+
+} // namespace
+
+ServiceDetailsCache::ServiceDetailsCache(size_t departures, int max_age_seconds) :
+detail_departures(departures),
+max_age(std::max(0, max_age_seconds)),
+summary_version(0)
+{
+}
+
+// Assemble the summary board and the service details for the next departures
+// Services which aren't shown are passed through without calling points (the parser treats them as having none).
+// Throws json::parse_error if the summary can't be parsed - a failed details request keeps the cached details.
+std::string ServiceDetailsCache::assemble(const std::string& summary_response, const DetailsFetcher& fetch_details) {
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration fetch_time(0);                                                          // Network time - not counted as parsing
+
+    json board = json::parse(summary_response);
+    summary_version++;
+    stats.summaries++;
+    stats.summary_bytes += summary_response.size();
+
+    auto services = board.find("trainServices");
+    if (services != board.end() && services->is_array()) {
+        for (size_t index : selectDepartures(*services)) {
+            json& service = (*services)[index];
+            auto rid_field = service.find("rid");
+            if (rid_field == service.end() || !rid_field->is_string()) continue;                               // Can't ask for the details without a RID
+            const std::string rid = rid_field->get<std::string>();
+
+            std::string current_signature = signature(service);
+            Entry& entry = entries[rid];
+            entry.last_seen = summary_version;
+
+            auto now = std::chrono::steady_clock::now();
+            bool stale = (entry.version == 0) ||                                                                // Never fetched
+                         (entry.signature != current_signature) ||                                              // Summary changed
+                         (max_age.count() > 0 && now - entry.fetched >= max_age);                               // Getting old
+
+            if (stale) {
+                DEBUG_PRINT("   [Details_Cache] Fetching details for RID " << rid << " (cached version " << entry.version << ")");
+                try {
+                    std::string details = fetch_details(rid);
+                    fetch_time += std::chrono::steady_clock::now() - now;
+                    stats.detail_requests++;
+                    stats.detail_bytes += details.size();
+                    if (storeDetails(entry, details)) {
+                        entry.signature = current_signature;
+                        entry.version = summary_version;
+                        entry.fetched = now;
+                    }
+                } catch (const std::exception& e) {
+                    fetch_time += std::chrono::steady_clock::now() - now;
+                    stats.detail_failures++;
+                    std::cerr << "[Details_Cache] Error fetching service details for RID " << rid << ": " << e.what() << std::endl;
+                }
+            } else {
+                stats.detail_cache_hits++;
+            }
+
+            if (entry.version != 0) {                                                                           // Attach the details we have
+                service["previousLocations"] = entry.previous_locations;
+                service["subsequentLocations"] = entry.subsequent_locations;
+                if (!entry.formation.is_null() && !service.contains("formation")) {
+                    service["formation"] = entry.formation;
+                }
+                if (!entry.length.is_null() && (!service.contains("length") || service["length"].is_null())) {
+                    service["length"] = entry.length;
+                }
+            }
+        }
+    }
+
+    for (auto it = entries.begin(); it != entries.end(); ) {                                                    // Forget services which are no longer shown
+        if (it->second.last_seen != summary_version) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::string assembled = board.dump();
+    stats.parse_ns += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start - fetch_time).count());
+    DEBUG_PRINT("[Details_Cache] Summary board " << summary_version << " assembled: " << summary_response.size() << " bytes in, " << assembled.size() << " bytes out. "
+                << entries.size() << " services cached.");
+    return assembled;
+}
+
+// The next departures - the same rules as the parser (services with a scheduled departure, ordered by estimated or scheduled time)
+// ISO 8601 times in the same time zone sort correctly as strings.
+std::vector<size_t> ServiceDetailsCache::selectDepartures(const json& services) const {
+    std::vector<std::pair<std::string, size_t>> departures;
+    departures.reserve(services.size());
+
+    for (size_t i = 0; i < services.size(); i++) {
+        const json& service = services[i];
+        if (!service.is_object() || !boolField(service, "stdSpecified")) continue;                              // Terminates here
+        if (!selected_platform.empty() && stringField(service, "platform") != selected_platform) continue;
+
+        std::string time = boolField(service, "etdSpecified") ? stringField(service, "etd") : "";
+        if (time.empty()) {
+            time = stringField(service, "std");
+        }
+        departures.emplace_back(time, i);
+    }
+    std::stable_sort(departures.begin(), departures.end(), [](const std::pair<std::string, size_t>& a, const std::pair<std::string, size_t>& b) {
+        return a.first < b.first;
+    });
+
+    std::vector<size_t> selected;
+    for (size_t i = 0; i < departures.size() && i < detail_departures; i++) {
+        selected.push_back(departures[i].second);
+    }
+    return selected;
+}
+
+std::string ServiceDetailsCache::signature(const json& service) {
+    static const char* const fields[] = {"std", "etd", "atd", "platform", "isCancelled", "departureType", "cancelReason", "delayReason"};
+    std::string result;
+    for (const char* field : fields) {
+        auto it = service.find(field);
+        if (it != service.end()) {
+            result += it->dump();
+        }
+        result += '|';
+    }
+    return result;
+}
+
+// Split the service's locations into the calling points before and after this station
+bool ServiceDetailsCache::storeDetails(Entry& entry, const std::string& details_response) const {
+    json details = json::parse(details_response, nullptr, false);                                               // No exceptions - a bad response is reported below
+    if (details.is_discarded() || !details.is_object()) {
+        std::cerr << "[Details_Cache] Service details response could not be parsed" << std::endl;
+        return false;
+    }
+
+    auto locations = details.find("locations");
+    if (locations == details.end() || !locations->is_array()) {
+        DEBUG_PRINT("   [Details_Cache] Service details have no locations");
+        return false;
+    }
+
+    auto sameStation = [this](const json& location) {
+        std::string crs = stringField(location, "crs");
+        return crs.size() == location_crs.size() &&
+               std::equal(crs.begin(), crs.end(), location_crs.begin(), [](char a, char b) { return std::toupper(static_cast<unsigned char>(a)) == std::toupper(static_cast<unsigned char>(b)); });
+    };
+    auto here = std::find_if(locations->begin(), locations->end(), [&](const json& location) {
+        return location.is_object() && sameStation(location);
+    });
+    if (here == locations->end()) {
+        DEBUG_PRINT("   [Details_Cache] Service details don't call at " << location_crs);
+        return false;
+    }
+
+    entry.previous_locations = json::array();
+    entry.subsequent_locations = json::array();
+    for (auto it = locations->begin(); it != here; ++it) {
+        entry.previous_locations.push_back(std::move(*it));
+    }
+    for (auto it = here + 1; it != locations->end(); ++it) {
+        entry.subsequent_locations.push_back(std::move(*it));
+    }
+    entry.formation = details.contains("formation") ? details["formation"] : json();
+    entry.length = details.contains("length") ? details["length"] : json();
+    return true;
+}
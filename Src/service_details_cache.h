@@ -0,0 +1,90 @@
+//
+//  service_details_cache.h
+//  Departure_Board
+//
+//  Two-tier fetching - a lightweight summary board plus service details for the trains that are shown.
+//
+//  GetArrDepBoardWithDetails returns the calling points and formation of every service on the board but
+//  only the first departure's calling points are displayed. In two-tier mode the board is polled with the
+//  summary call (no calling points) and service details are requested by RID for the next few departures -
+//  and only when their summary has changed (or the details are getting old).
+//
+//  Details are cached by RID. The summary board is assembled into the same shape as GetArrDepBoardWithDetails
+//  (previousLocations/subsequentLocations are split from the details' locations at this station) so the
+//  parser doesn't need to know which API call the data came from.
+//
+
+#ifndef SERVICE_DETAILS_CACHE_H
+#define SERVICE_DETAILS_CACHE_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+using json = nlohmann::json;
+
+// Forward declaration for the debug printing macro
+extern bool debug_mode;
+#define DEBUG_PRINT(x) if(debug_mode) { std::cerr << x << std::endl; }
+
+class ServiceDetailsCache {
+public:
+    using DetailsFetcher = std::function<std::string(const std::string& rid)>;      // Fetch the service details for a RID (APIClient::fetchServiceDetails)
+
+    struct Stats {
+        uint64_t summaries = 0;                                                     // Summary boards assembled
+        uint64_t summary_bytes = 0;                                                 // Bytes of summary board received
+        uint64_t detail_requests = 0;                                               // Service details requested
+        uint64_t detail_bytes = 0;                                                  // Bytes of service details received
+        uint64_t detail_cache_hits = 0;                                             // Shown services whose cached details were re-used
+        uint64_t detail_failures = 0;                                               // Service details requests which failed (cached details are kept)
+        uint64_t parse_ns = 0;                                                      // Time spent parsing and assembling
+    };
+
+    /**
+     * @param detail_departures Number of departures to fetch details for (usually max_departures)
+     * @param max_age_seconds Re-fetch details this old even if the summary hasn't changed (0 - never)
+     */
+    ServiceDetailsCache(size_t detail_departures, int max_age_seconds);
+
+    void setLocation(const std::string& crs) { location_crs = crs; }                // Station the board is for - splits the calling points
+    void setPlatform(const std::string& platform) { selected_platform = platform; } // Only fetch details for departures from this platform (empty - all)
+
+    // Assemble a summary board and the service details for the next departures into a GetArrDepBoardWithDetails-style response
+    std::string assemble(const std::string& summary_response, const DetailsFetcher& fetch_details);
+
+    const Stats& getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
+    size_t size() const { return entries.size(); }                                  // Number of cached services
+
+private:
+    struct Entry {
+        std::string signature;                                                      // Summary fields when the details were fetched
+        uint64_t version = 0;                                                       // Summary board the details were fetched for
+        uint64_t last_seen = 0;                                                     // Last summary board the service was on
+        std::chrono::steady_clock::time_point fetched;                              // When the details were fetched
+        json previous_locations = json::array();                                    // Calling points before this station
+        json subsequent_locations = json::array();                                  // Calling points after this station
+        json formation;                                                             // Formation (null if not given)
+        json length;                                                                // Number of coaches (null if not given)
+    };
+
+    size_t detail_departures;
+    std::chrono::seconds max_age;
+    std::string location_crs;
+    std::string selected_platform;
+    uint64_t summary_version;                                                       // Incremented for each summary board
+    std::unordered_map<std::string, Entry> entries;                                 // Cached details by RID
+    Stats stats;
+
+    std::vector<size_t> selectDepartures(const json& services) const;               // Indices of the next departures (in departure order)
+    static std::string signature(const json& service);                              // The summary fields which indicate the details may have changed
+    bool storeDetails(Entry& entry, const std::string& details_response) const;     // Split the details into previous/subsequent calling points
+};
+
+#endif // SERVICE_DETAILS_CACHE_H
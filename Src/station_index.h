@@ -0,0 +1,126 @@
+//
+//  station_index.h
+//  Departure_Board
+//
+//  Index of the stations the services call at - "next train calling at X" and filtering the board.
+//
+//  Stations are interned - each CRS code gets a small ID the first time it's seen and keeps it, so the
+//  index holds integers rather than strings. The index is a flat list of stops (station, service, time at
+//  the station) built once per refresh from every service's subsequent calling points and sorted by
+//  station then time. A query is a binary search for the station and the stops come out in the order the
+//  services get there - nothing is re-read from the JSON or the calling point strings.
+//
+//  Times are kept as a sort key (minutes, from the API's yyyy-mm-ddThh:mm text) and the HH:MM for display.
+//
+
+#ifndef STATION_INDEX_H
+#define STATION_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+using StationID = uint16_t;
+constexpr StationID NO_STATION = UINT16_MAX;
+
+// CRS code to station ID - an ID is kept once it's given out, so IDs in an old index stay valid
+class StationIDs {
+public:
+    StationID intern(const std::string& crs) {
+        auto it = station_ids.find(crs);
+        if (it != station_ids.end()) return it->second;
+        if (station_ids.size() >= NO_STATION) return NO_STATION;                    // Full - can't happen with real CRS codes
+        StationID id = static_cast<StationID>(station_ids.size());
+        station_ids.emplace(crs, id);
+        return id;
+    }
+
+    StationID find(const std::string& crs) const {                                  // NO_STATION if it's never been seen
+        auto it = station_ids.find(crs);
+        return it == station_ids.end() ? NO_STATION : it->second;
+    }
+
+    size_t size() const { return station_ids.size(); }
+
+private:
+    std::unordered_map<std::string, StationID> station_ids;
+};
+
+class StationIndex {
+public:
+    static constexpr int64_t NO_TIME = INT64_MAX;                                   // Sorts after every valid time
+
+    struct Stop {
+        StationID station;
+        uint16_t service;                                                           // Service index in the data the index was built from
+        int64_t time_key;                                                           // Minutes - for ordering only (NO_TIME if there's no time)
+        char time[5];                                                               // HH:MM (not null terminated)
+    };
+
+    // Building the index for a refresh - clear(), add() each stop then build()
+    void clear() { stops.clear(); }
+
+    void add(StationID station, size_t service, const std::string& time) {
+        if (station == NO_STATION) return;
+        Stop stop;
+        stop.station = station;
+        stop.service = static_cast<uint16_t>(std::min<size_t>(service, UINT16_MAX));
+        stop.time_key = timeKey(time);
+        if (stop.time_key == NO_TIME) {
+            std::fill(stop.time, stop.time + 5, ' ');
+        } else {
+            std::copy(time.begin() + 11, time.begin() + 16, stop.time);
+        }
+        stops.push_back(stop);
+    }
+
+    void build() {
+        std::sort(stops.begin(), stops.end(), [](const Stop& a, const Stop& b) {
+            return a.station != b.station ? a.station < b.station : a.time_key < b.time_key;
+        });
+    }
+
+    // The stops at a station in time order (an empty range if no service calls there)
+    std::pair<const Stop*, const Stop*> stopsAt(StationID station) const {
+        auto range = std::equal_range(stops.data(), stops.data() + stops.size(), station, StationOrder());
+        return {range.first, range.second};
+    }
+
+    size_t size() const { return stops.size(); }
+    void swap(StationIndex& other) { stops.swap(other.stops); }
+
+    // yyyy-mm-ddThh:mm... as minutes since 1970 (the date is needed for services after midnight). NO_TIME if it isn't a time.
+    static int64_t timeKey(const std::string& time) {
+        if (time.size() < 16 || time[4] != '-' || time[7] != '-' || time[10] != 'T' || time[13] != ':') return NO_TIME;
+        int fields[5];
+        static const int start[5] = {0, 5, 8, 11, 14};
+        static const int length[5] = {4, 2, 2, 2, 2};
+        for (int f = 0; f < 5; f++) {
+            int value = 0;
+            for (int c = start[f]; c < start[f] + length[f]; c++) {
+                if (time[c] < '0' || time[c] > '9') return NO_TIME;
+                value = value * 10 + (time[c] - '0');
+            }
+            fields[f] = value;
+        }
+        int year = fields[0] - (fields[1] <= 2);                                    // Days from the civil date (proleptic Gregorian)
+        int era = (year >= 0 ? year : year - 399) / 400;
+        int year_of_era = year - era * 400;
+        int day_of_year = (153 * (fields[1] + (fields[1] > 2 ? -3 : 9)) + 2) / 5 + fields[2] - 1;
+        int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+        int64_t days = static_cast<int64_t>(era) * 146097 + day_of_era - 719468;
+        return days * 1440 + fields[3] * 60 + fields[4];
+    }
+
+private:
+    struct StationOrder {
+        bool operator()(const Stop& stop, StationID station) const { return stop.station < station; }
+        bool operator()(StationID station, const Stop& stop) const { return station < stop.station; }
+    };
+
+    std::vector<Stop> stops;
+};
+
+#endif // STATION_INDEX_H
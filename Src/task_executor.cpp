@@ -0,0 +1,323 @@
+//
+//  task_executor.cpp
+//  Departure_Board
+//
+//  Worker pool with priority lanes and work stealing - see task_executor.h
+//
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+#include "task_executor.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Forward declaration for the debug printing macro
+extern bool debug_mode;
+#define DEBUG_PRINT(x) if(debug_mode) { std::cerr << x << std::endl; }
+
+namespace {
+
+constexpr int NO_RENDER_CORE = -2;
+
+void atomicMax(std::atomic<uint64_t>& value, uint64_t candidate) {
+    uint64_t current = value.load(std::memory_order_relaxed);
+    while (candidate > current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+} // namespace
+
+struct TaskExecutor::State {
+    struct Task {
+        std::function<void()> work;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    struct Worker {
+        std::mutex mutex;                                                           // Guards the queues
+        std::array<std::deque<Task>, LANES> queues;
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+
+    struct AtomicLaneMetrics {
+        std::atomic<uint64_t> submitted{0};
+        std::atomic<uint64_t> completed{0};
+        std::atomic<uint64_t> stolen{0};
+        std::atomic<uint64_t> queue_depth{0};
+        std::atomic<uint64_t> max_queue_depth{0};
+        std::atomic<uint64_t> total_wait_ns{0};
+        std::atomic<uint64_t> max_wait_ns{0};
+        std::atomic<uint64_t> total_run_ns{0};
+        std::atomic<uint64_t> max_run_ns{0};
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::array<AtomicLaneMetrics, LANES> metrics;
+    int render_core = NO_RENDER_CORE;
+
+    std::mutex wake_mutex;                                                          // Guards sleeping, waking and the running count
+    std::condition_variable wake;
+    std::condition_variable all_finished;
+    size_t running = 0;                                                             // Workers which haven't exited
+    std::atomic<size_t> pending{0};                                                 // Tasks queued on any worker
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> next_worker{0};                                             // Round robin for tasks submitted from outside the pool
+
+    void run(size_t self);
+    bool take(size_t self, Task& task, size_t& lane, bool& stolen);
+};
+
+namespace {
+thread_local const void* current_pool = nullptr;                                   // The pool (State) a worker thread belongs to
+thread_local size_t current_worker = 0;
+}
+
+TaskExecutor::TaskExecutor(int threads, int render_core) : state(std::make_shared<State>()) {
+    state->render_core = (render_core == -1) ? defaultRenderCore() : render_core;
+    if (state->render_core >= static_cast<int>(coreCount()) || coreCount() < 2) {
+        state->render_core = NO_RENDER_CORE;                                        // Nothing to keep clear
+    }
+    size_t workers = static_cast<size_t>(threads > 0 ? threads : defaultThreads(state->render_core));
+
+    for (size_t i = 0; i < workers; i++) {
+        state->workers.push_back(std::unique_ptr<State::Worker>(new State::Worker()));
+    }
+    state->running = workers;
+    for (size_t i = 0; i < workers; i++) {
+        std::shared_ptr<State> shared = state;
+        state->workers[i]->thread = std::thread([shared, i]() { shared->run(i); });
+
+#ifdef __linux__
+        if (state->render_core != NO_RENDER_CORE) {                                 // Any core but the render core
+            cpu_set_t cores;
+            CPU_ZERO(&cores);
+            for (unsigned core = 0; core < coreCount(); core++) {
+                if (static_cast<int>(core) != state->render_core) CPU_SET(core, &cores);
+            }
+            if (pthread_setaffinity_np(state->workers[i]->thread.native_handle(), sizeof(cores), &cores) != 0) {
+                DEBUG_PRINT("[Task_Executor] Couldn't keep worker " << i << " off core " << state->render_core);
+            }
+        }
+#endif
+    }
+    DEBUG_PRINT("[Task_Executor] " << workers << " workers on " << coreCount() << " cores"
+                << (state->render_core == NO_RENDER_CORE ? std::string() : " (clear of core " + std::to_string(state->render_core) + ")"));
+}
+
+TaskExecutor::~TaskExecutor() {
+    shutdown();
+}
+
+unsigned TaskExecutor::coreCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+int TaskExecutor::defaultRenderCore() {
+    unsigned cores = coreCount();
+    return cores >= 4 ? static_cast<int>(cores) - 1 : NO_RENDER_CORE;
+}
+
+int TaskExecutor::defaultThreads(int render_core) {
+    int cores = static_cast<int>(coreCount());
+    int reserved = 1 + (render_core >= 0 ? 1 : 0);                                  // The render loop and the panel refresh
+    return std::max(1, cores - reserved);
+}
+
+void TaskExecutor::post(Lane lane, std::function<void()> task) {
+    if (state->stopping.load()) {
+        return;                                                                     // Dropped - as if it was queued at shutdown
+    }
+    size_t lane_index = static_cast<size_t>(lane);
+    State::AtomicLaneMetrics& metrics = state->metrics[lane_index];                // Counted before it's queued - a worker may take it straight away
+    metrics.submitted++;
+    atomicMax(metrics.max_queue_depth, ++metrics.queue_depth);
+
+    {
+        std::lock_guard<std::mutex> lock(state->wake_mutex);                       // Under the lock so a worker about to sleep can't miss it
+        state->pending++;
+    }
+    size_t worker = (current_pool == state.get()) ? current_worker : state->next_worker.fetch_add(1) % state->workers.size();
+    {
+        std::lock_guard<std::mutex> lock(state->workers[worker]->mutex);
+        if (state->stopping.load()) {                                               // Shut down since - shutdown() may already have emptied this queue
+            state->pending--;
+            metrics.queue_depth--;
+            return;
+        }
+        state->workers[worker]->queues[lane_index].push_back({std::move(task), std::chrono::steady_clock::now()});
+    }
+    state->wake.notify_one();
+}
+
+// The next task for a worker - its own queue first (oldest first), then the newest from another worker, a lane at a time
+bool TaskExecutor::State::take(size_t self, Task& task, size_t& lane, bool& stolen) {
+    for (lane = 0; lane < LANES; lane++) {
+        for (size_t n = 0; n < workers.size(); n++) {
+            size_t victim = (self + n) % workers.size();
+            Worker& worker = *workers[victim];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            std::deque<Task>& queue = worker.queues[lane];
+            if (queue.empty()) continue;
+            if (victim == self) {
+                task = std::move(queue.front());
+                queue.pop_front();
+            } else {
+                task = std::move(queue.back());
+                queue.pop_back();
+            }
+            stolen = victim != self;
+            pending--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskExecutor::State::run(size_t self) {
+    current_pool = this;
+    current_worker = self;
+
+    while (!stopping.load()) {
+        Task task;
+        size_t lane;
+        bool stolen;
+        if (take(self, task, lane, stolen)) {
+            AtomicLaneMetrics& lane_metrics = metrics[lane];
+            lane_metrics.queue_depth--;
+            if (stolen) lane_metrics.stolen++;
+            uint64_t wait_ns = nanosecondsSince(task.submitted);
+            lane_metrics.total_wait_ns += wait_ns;
+            atomicMax(lane_metrics.max_wait_ns, wait_ns);
+
+            auto start = std::chrono::steady_clock::now();
+            try {
+                task.work();
+            } catch (const std::exception& e) {                                     // submit() tasks keep their exceptions in the future - this is a posted task
+                std::cerr << "[Task_Executor] Error in " << laneName(static_cast<Lane>(lane)) << " task: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "[Task_Executor] Unknown error in " << laneName(static_cast<Lane>(lane)) << " task" << std::endl;
+            }
+            uint64_t run_ns = nanosecondsSince(start);
+            lane_metrics.total_run_ns += run_ns;
+            atomicMax(lane_metrics.max_run_ns, run_ns);
+            lane_metrics.completed++;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake.wait(lock, [this]() { return stopping.load() || pending.load() > 0; });
+    }
+
+    workers[self]->finished.store(true);
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    if (--running == 0) {
+        all_finished.notify_all();
+    }
+}
+
+bool TaskExecutor::shutdown(std::chrono::milliseconds timeout) {
+    {
+        std::lock_guard<std::mutex> lock(state->wake_mutex);
+        state->stopping.store(true);
+    }
+    state->wake.notify_all();
+
+    bool finished = true;
+    {
+        std::unique_lock<std::mutex> lock(state->wake_mutex);
+        auto all_stopped = [this]() { return state->running == 0; };
+        if (timeout == std::chrono::milliseconds::max()) {
+            state->all_finished.wait(lock, all_stopped);
+        } else {
+            finished = state->all_finished.wait_for(lock, timeout, all_stopped);
+        }
+    }
+
+    for (size_t i = 0; i < state->workers.size(); i++) {
+        State::Worker& worker = *state->workers[i];
+        if (!worker.thread.joinable()) continue;
+        if (worker.finished.load()) {
+            worker.thread.join();
+        } else {
+            DEBUG_PRINT("[Task_Executor] Worker " << i << " didn't finish its task in time - leaving it to finish");
+            worker.thread.detach();                                                 // Keeps the state alive until it's done
+        }
+    }
+    
+    for (size_t lane = 0; lane < LANES; lane++) {                                   // Drop the tasks still queued - their futures get broken_promise rather than never being ready
+        for (auto& worker : state->workers) {
+            std::deque<State::Task> dropped;
+            {
+                std::lock_guard<std::mutex> lock(worker->mutex);
+                dropped.swap(worker->queues[lane]);
+            }
+            state->pending -= dropped.size();
+            state->metrics[lane].queue_depth -= dropped.size();
+            if (!dropped.empty()) {
+                DEBUG_PRINT("[Task_Executor] " << dropped.size() << " " << laneName(static_cast<Lane>(lane)) << " task(s) dropped at shutdown");
+            }
+        }                                                                           // Destroyed here, outside the lock
+    }
+    return finished;
+}
+
+size_t TaskExecutor::size() const {
+    return state->workers.size();
+}
+
+int TaskExecutor::renderCore() const {
+    return state->render_core;
+}
+
+TaskExecutor::Metrics TaskExecutor::getMetrics() const {
+    Metrics result;
+    for (size_t lane = 0; lane < LANES; lane++) {
+        const State::AtomicLaneMetrics& metrics = state->metrics[lane];
+        result[lane].submitted = metrics.submitted.load();
+        result[lane].completed = metrics.completed.load();
+        result[lane].stolen = metrics.stolen.load();
+        result[lane].queue_depth = metrics.queue_depth.load();
+        result[lane].max_queue_depth = metrics.max_queue_depth.load();
+        result[lane].total_wait_ns = metrics.total_wait_ns.load();
+        result[lane].max_wait_ns = metrics.max_wait_ns.load();
+        result[lane].total_run_ns = metrics.total_run_ns.load();
+        result[lane].max_run_ns = metrics.max_run_ns.load();
+    }
+    return result;
+}
+
+void TaskExecutor::resetMetrics() {
+    for (State::AtomicLaneMetrics& metrics : state->metrics) {
+        metrics.submitted = 0;
+        metrics.completed = 0;
+        metrics.stolen = 0;
+        metrics.max_queue_depth = metrics.queue_depth.load();
+        metrics.total_wait_ns = 0;
+        metrics.max_wait_ns = 0;
+        metrics.total_run_ns = 0;
+        metrics.max_run_ns = 0;
+    }
+}
+
+const char* TaskExecutor::laneName(Lane lane) {
+    switch (lane) {
+        case Lane::FRAME: return "frame";
+        case Lane::DATA: return "data";
+        case Lane::FETCH: return "fetch";
+    }
+    return "unknown";
+}
@@ -0,0 +1,89 @@
+//
+//  task_executor.h
+//  Departure_Board
+//
+//  A small fixed pool of worker threads for the background work - fetching, parsing and building the rows.
+//
+//  Work is submitted to a lane and the lanes are taken in priority order: FRAME (work the next frame is
+//  waiting for - calling points and row layout), DATA (parsing and hydrating a refresh) and FETCH (API calls
+//  which mostly wait on the network). Each worker has its own queues - a task submitted from a worker stays
+//  on that worker's queue, others are spread round the workers - and an idle worker steals from the others,
+//  highest lane first. A long fetch never holds up parsing while another worker is free.
+//
+//  The pool is sized from the core count. The matrix library refreshes the panel from its own thread pinned
+//  to the last core of a multi-core Pi - the workers are kept off that core (render_core) so background work
+//  can't disturb the panel refresh, and one core is left for the render loop.
+//
+//  Queue depth, time waiting in the queue and run time are recorded per lane (getMetrics).
+//
+
+#ifndef TASK_EXECUTOR_H
+#define TASK_EXECUTOR_H
+
+#include <array>
+#include <memory>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
+class TaskExecutor {
+public:
+    enum class Lane { FRAME, DATA, FETCH };                                         // Highest priority first
+    static constexpr size_t LANES = 3;
+
+    struct LaneMetrics {
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        uint64_t stolen = 0;                                                        // Run by a worker other than the one it was queued on
+        uint64_t queue_depth = 0;                                                   // Waiting to run now
+        uint64_t max_queue_depth = 0;
+        uint64_t total_wait_ns = 0;                                                 // Submitted to started
+        uint64_t max_wait_ns = 0;
+        uint64_t total_run_ns = 0;
+        uint64_t max_run_ns = 0;
+    };
+    using Metrics = std::array<LaneMetrics, LANES>;
+
+    /**
+     * @param threads Number of workers (0 - automatic, see defaultThreads)
+     * @param render_core Core the workers keep off (-1 - automatic: the last core of a board with four or more, -2 - none)
+     */
+    TaskExecutor(int threads, int render_core);
+    ~TaskExecutor();                                                                // shutdown() - waits for the running tasks
+
+    TaskExecutor(const TaskExecutor&) = delete;
+    TaskExecutor& operator=(const TaskExecutor&) = delete;
+
+    static unsigned coreCount();
+    static int defaultRenderCore();                                                 // Last core with four or more cores, otherwise none (-2)
+    static int defaultThreads(int render_core);                                     // The cores left after the render core and the render loop (at least one)
+
+    // Queue a task. Tasks still queued at shutdown, or posted after it, are dropped (a future's get() throws broken_promise).
+    void post(Lane lane, std::function<void()> task);
+
+    template<typename F, typename Result = decltype(std::declval<F&>()())> std::future<Result> submit(Lane lane, F&& work) {
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(work));
+        std::future<Result> result = task->get_future();
+        post(lane, [task]() { (*task)(); });
+        return result;
+    }
+
+    // Stop the workers - the running tasks are waited for up to the timeout, then the workers are left to finish on their own.
+    // The tasks still queued are dropped.
+    bool shutdown(std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
+
+    size_t size() const;                                                            // Number of workers
+    int renderCore() const;                                                         // -2 if none is kept clear
+
+    Metrics getMetrics() const;
+    void resetMetrics();                                                            // Counts and times (not the queue depth)
+    static const char* laneName(Lane lane);
+
+private:
+    struct State;
+    std::shared_ptr<State> state;                                                   // Shared with the workers - a worker left running at shutdown keeps it alive
+};
+
+#endif // TASK_EXECUTOR_H
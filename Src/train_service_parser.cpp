@@ -18,6 +18,7 @@ void TrainServiceParser::loadReasonCodes(const std::string& reasonJsonString){
     size_t code;
     //size_t new_index;
     std::vector<DelayCancelReason> new_delay_cancel_reasons;
+    std::unordered_map<std::string, size_t> new_reason_codes;
     DelayCancelReason new_reason;
     
     refdata = json::parse(reasonJsonString);
@@ -32,12 +33,13 @@ void TrainServiceParser::loadReasonCodes(const std::string& reasonJsonString){
         new_reason.delayReason = extractJSONvalue<std::string>(refdata[i], "lateReason", "No Reason");
         new_reason.cancelReason = extractJSONvalue<std::string>(refdata[i], "cancReason", "No Reason");
         
-        new_index = reason_codes.size();                                                                                                    // Store the code in the map
-        reason_codes[new_reason.code] = new_index;
+        new_index = new_delay_cancel_reasons.size();                                                                                        // Store the code in the map
+        new_reason_codes[new_reason.code] = new_index;
         new_delay_cancel_reasons.push_back(new_reason);                                                                                     // Add the code to the new delay/cancel reason vector
     }
     DEBUG_PRINT("[Parser] Delay/Cancellation codes loaded - " << num_reasons << " in the cache");
     delay_cancel_reasons.swap(new_delay_cancel_reasons);                                                                                    // Store the extracted reference data
+    reason_codes.swap(new_reason_codes);                                                                                                    // Indices match the new vector (safe to reload the codes)
     refdata_loaded = true;                                                                                                                  // Set the flag to indicate reference data has been loaded
     DEBUG_PRINT("[Parser] Creating null Basic/Additional Service items");
     CreateNullServiceInfo();
@@ -49,21 +51,25 @@ int64_t TrainServiceParser::getCacheAPIVersion(){
 }
 
 // Wrapper function to execute pre-fetch and hydrate the departure cache.
-void TrainServiceParser::updateCache(const std::string &jsonString, const int64_t &version){
+// Returns PARSE_ERROR (and the cache keeps the previous data) if the JSON is invalid.
+TrainServiceParser::Status TrainServiceParser::updateCache(const std::string &jsonString, const int64_t &version){
     
     DEBUG_PRINT("[Parser] Updating the cache - pre-fetch and hydration of departure cache");
-    prefetchCache(jsonString, version);
-    hydrateDepartureCache();
-    DEBUG_PRINT("[Parser] Cache updated");
+    Status status = beginUpdate(jsonString, version);
+    if (status == Status::IN_PROGRESS) {
+        status = continueUpdate(std::chrono::steady_clock::time_point::max());                                                                 // All the steps in one go
+    }
+    DEBUG_PRINT("[Parser] Cache " << (status == Status::OK ? "updated" : "not updated"));
+    return status;
 }
 
 // Wrapper function to load the reason codes, execute pre-fetch and hydrate the departure cache.
-void TrainServiceParser::createFromJSON(const std::string &datajsonString, const std::string &reasonJsonString, const int64_t &version){
+TrainServiceParser::Status TrainServiceParser::createFromJSON(const std::string &datajsonString, const std::string &reasonJsonString, const int64_t &version){
     
     if(!refdata_loaded){
         loadReasonCodes(reasonJsonString);
     }
-    updateCache(datajsonString, version);
+    return updateCache(datajsonString, version);
 }
 
 // Prefetch the cache and determine the order of departures
@@ -80,122 +86,294 @@ void TrainServiceParser::createFromJSON(const std::string &datajsonString, const
 // Additional service information - the AdditionalServiceInfo data structure
 // We need a copy of this so we can rebuild the vector stored in the class
 // This is required so the two vectors remain in sync.
+//
+// The pre-fetch is the first three steps of an update (see beginUpdate) - hydration is left to the caller.
 
-void TrainServiceParser::prefetchCache(const std::string& jsonString, const int64_t& api_version){
-        
-    std::vector<ServiceSequence> new_services_sequence(max_json_size);                                                                          // New Sequence of Services
-    new_services_sequence.reserve(max_json_size);
-    
-    std::vector<BasicServiceInfo> new_services_basic(max_json_size);                                                                            // New Basic Service Info
-    new_services_basic.reserve(max_json_size);
+TrainServiceParser::Status TrainServiceParser::prefetchCache(const std::string& jsonString, const int64_t& api_version){
     
-    std::vector<AdditionalServiceInfo> new_services_additions(max_json_size);                                                                   // New Additional Service Info
-    new_services_additions.reserve(max_json_size);
-    
-    std::vector<CallingPointsInfo> new_services_callingpoints(max_json_size);                                                                   // New Calling Point Info
-    new_services_callingpoints.reserve(max_json_size);
+    Status status = beginUpdate(jsonString, api_version);
+    while (status == Status::IN_PROGRESS && pending_update.step != PendingUpdate::HYDRATE) {
+        status = updateStep();
+    }
+    if (pending_update.step == PendingUpdate::HYDRATE) {
+        pending_update.step = PendingUpdate::IDLE;
+        status = Status::OK;
+    }
+    return status;
+}
+
+// Start an update of the cache
+// The work is done in steps by continueUpdate so it can be spread over several frames on a single-core board:
+// PARSE    - the JSON, a member or array element (i.e. a service) per step
+// SERVICES - the pre-fetch of std, etd, platform and TrainID, a service per step
+// COMMIT   - meta-data, swap the new data into the cache and order the departures
+// HYDRATE  - hydrate the departure cache for the next departures
+// Until the COMMIT step the cache holds the previous data. Starting a new update abandons one in progress.
+// Returns IN_PROGRESS, or NO_REFERENCE_DATA if the reason codes haven't been loaded.
+TrainServiceParser::Status TrainServiceParser::beginUpdate(const std::string& jsonString, const int64_t& api_version){
     
-    json new_data;                                                                                                                              // New JSON data - use this and update the stored JSON at the end of the method
+    DEBUG_PRINT("[Parser] Cache pre-fetch Started");
+    if(!refdata_loaded){
+        std::cerr << "[Parser] Reference Data not loaded - can't update the cache" << std::endl;
+        pending_update.step = PendingUpdate::IDLE;
+        return Status::NO_REFERENCE_DATA;
+    }
     
-    std::unordered_map<std::string, size_t> new_cached_trainIDs;                                                                                // List of found TrainIDs
-    size_t new_index;
+    PendingUpdate& update = pending_update;
+    update.version = api_version;
+    update.now = std::time(nullptr);                                                                                                            // Use current time as the default value
+    update.parser.begin(jsonString);
+    update.service = 0;
+    update.number_of_services = 0;
+    update.services_sequence.assign(max_json_size, ServiceSequence());                                                                          // New Sequence of Services
+    update.services_basic.assign(max_json_size, BasicServiceInfo());                                                                            // New Basic Service Info
+    update.services_additions.assign(max_json_size, AdditionalServiceInfo());                                                                   // New Additional Service Info
+    update.services_callingpoints.assign(max_json_size, CallingPointsInfo());                                                                   // New Calling Point Info
+    update.cached_trainIDs.clear();                                                                                                             // List of found TrainIDs
+    update.station_index.clear();                                                                                                               // Stops at each station
+    update.observations.clear();                                                                                                                // For the history log
+    update.step = PendingUpdate::PARSE;
+    return Status::IN_PROGRESS;
+}
+
+// Work on the update until the deadline - at least one step is done each call so the update always makes progress
+// Returns IN_PROGRESS until the update is finished - then OK, or PARSE_ERROR if it was abandoned.
+TrainServiceParser::Status TrainServiceParser::continueUpdate(std::chrono::steady_clock::time_point deadline){
     
-    std::time_t now = std::time(nullptr);                                                                                                       // Use current time as the default value
+    Status status;
+    while ((status = updateStep()) == Status::IN_PROGRESS) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+    }
+    return status;
+}
+
+// Do the next step of the pending update. Returns IN_PROGRESS until there's no more to do.
+// Invalid JSON abandons the update (the cache keeps the previous data) and is counted.
+TrainServiceParser::Status TrainServiceParser::updateStep(){
     
+    PendingUpdate& update = pending_update;
     try {
-        DEBUG_PRINT("[Parser] Cache pre-fetch Started");
-        if(!refdata_loaded){
-            throw std::out_of_range("Reference Data not loaded - fatal error!");
-        }
-        
-        new_data = json::parse(jsonString);
-        
-        // Extract metadata
-        prefetchMetaData(new_data);
-        
-        // Extract std, etd, platform and TrainID from the JSON
-        // Check if the service is already cached - re-use if it is or create new Basic and Additional objects if it isn't.
-        // Note: number_of_services is calculated in the prefetchMetaData method
-        for (i=0; i< number_of_services; i++){
-            new_services_sequence[i].std_specified = extractJSONvalue<bool>(new_data["trainServices"][i], "stdSpecified", false);
-            if (new_services_sequence[i].std_specified) {                                                                                       // Valid Scheduled Departure Time means it's a departure!
-                new_services_sequence[i].std = extractJSONTime(new_data["trainServices"][i], "std", now);
-                
-                new_services_sequence[i].etd_specified = extractJSONvalue<bool>(new_data["trainServices"][i], "etdSpecified", false);           // Is there an Estimated Departure Time?
-                if (new_services_sequence[i].etd_specified) {                                                                                   // If there is then extract and store
-                    new_services_sequence[i].etd = extractJSONTime(new_data["trainServices"][i], "etd", now);
-                    new_services_sequence[i].departure_time = new_services_sequence[i].etd;                                                     // Departure Time is then the ETD
-                } else {
-                    new_services_sequence[i].departure_time = new_services_sequence[i].std;                                                     // No Estimated Departure Time, so Departure Time is then STD
+        switch (update.step) {
+            case PendingUpdate::PARSE:
+                if (update.parser.step()) {
+                    if (update.parser.failed()) {
+                        DEBUG_PRINT("[Parser] Failed to parse JSON in cache pre-fetch - keeping the previous data");
+                        error_counters.parse_errors++;
+                        update.step = PendingUpdate::IDLE;
+                        update.parser.clear();
+                        return Status::PARSE_ERROR;
+                    }
+                    json& new_data = update.parser.document();
+                    auto new_services = new_data.is_object() ? new_data.find("trainServices") : new_data.end();
+                    if (!new_data.is_object() || (new_services != new_data.end() && !new_services->is_null() && !new_services->is_array())) {
+                        DEBUG_PRINT("[Parser] Departure data isn't an object with a trainServices array - keeping the previous data");
+                        error_counters.parse_errors++;
+                        update.step = PendingUpdate::IDLE;
+                        update.parser.clear();
+                        return Status::PARSE_ERROR;
+                    }
+                    update.number_of_services = (new_services == new_data.end() || new_services->is_null()) ? 0 : std::min(new_services->size(), max_json_size);   // As prefetchMetaData counts them
+                    std::fill(previous_to_new_index.begin(), previous_to_new_index.end(), DepartureOrder::NOT_FOUND);
+                    update.step = PendingUpdate::SERVICES;
                 }
+                break;
                 
-            } else {                                                                                                                            // No valid Schdeuled Departure Time means the service terminates here.
-                new_services_sequence[i].std = INVALID_TIME;
-                new_services_sequence[i].std_specified = false;
-                new_services_sequence[i].etd = INVALID_TIME;
-                new_services_sequence[i].etd_specified = false;
-                new_services_sequence[i].departure_time = INVALID_TIME;
-            }
-            
-            new_services_sequence[i].platform = extractJSONvalue<std::string>(new_data["trainServices"][i], "platform", "");
-            new_services_sequence[i].trainid = extractJSONvalue<std::string>(new_data["trainServices"][i], "trainid", "");
-            new_services_sequence[i].api_version = api_version;
-                              
-            // Check if we already have this service in the cache - if we do then re-use the existing Basic and Additiona Info structs.
-            auto it = cached_trainIDs.find(new_services_sequence[i].trainid);
-            
-            if (it != cached_trainIDs.end()) {                                                                                                  // Service Information is cached
-                extract = it->second;
-                DEBUG_PRINT("   [Parser] Service " << it->first << " in the JSON is cached at index " << extract << ". Moving to new index: " << i << " and setting callingpoint/location data as stale. (valid service: " << new_services_sequence[extract].std_specified <<")." );
-                new_services_basic[i] = services_basic[extract];                                                                                // Pull in the basic service information we have cached.
+            case PendingUpdate::SERVICES:
+                if (update.service < update.number_of_services) {
+                    prefetchServiceInternal(update.parser.document()["trainServices"][update.service], update.service);
+                    update.service++;
+                }
+                if (update.service >= update.number_of_services) {
+                    update.step = PendingUpdate::COMMIT;
+                }
+                break;
                 
-                                                                                                                                                // As this service is cached, the additional service information and calling point information also needs to be kept
-                new_services_additions[i] = services_additions[extract];                                                                        // Store the additional information at the new position
-                new_services_callingpoints[i] = services_callingpoints[extract];                                                                // Store the calling point information at the new position
-                new_services_callingpoints[i].callingPointsCached = false;                                                                      // Flag calling point data as stale
-                new_services_callingpoints[i].service_location_cached = false;                                                                  // Flag service-location data as stale
+            case PendingUpdate::COMMIT:
+                commitUpdate();
+                update.step = PendingUpdate::HYDRATE;
+                break;
                 
-            } else {                                                                                                                            // No Service Information is cached. These are new, unpopulated objects
-                DEBUG_PRINT("   [Parser] Service at position " << i << " (trainID " << new_services_sequence[i].trainid << ") in the JSON is not cached. Flagging all Basic and Additional static data as stale");
-                new_services_additions[i].static_data_available = false;                                                                        // New items don't have the static data stored.
-                new_services_basic[i].static_data_available = false;
-                new_services_callingpoints[i].callingPointsCached = false;
-                new_services_callingpoints[i].service_location_cached = false;
+            case PendingUpdate::HYDRATE:
+                hydrateDepartureCache();
+                update.step = PendingUpdate::IDLE;
+                break;
                 
-                new_services_additions[i].trainid = new_services_sequence[i].trainid;                                                           // Store the TrainID - a useful identifying to check things are in sync
-                new_services_basic[i].trainid = new_services_sequence[i].trainid;
-                new_services_callingpoints[i].trainid = new_services_sequence[i].trainid;
-            }
+            case PendingUpdate::IDLE:
+                break;
+        }
+    } catch (...) {                                                                                                                             // Not the data (out of memory...) - abandon and pass it on
+        update.step = PendingUpdate::IDLE;
+        update.parser.clear();
+        throw;
+    }
+    return update.step == PendingUpdate::IDLE ? Status::OK : Status::IN_PROGRESS;
+}
+
+// Extract std, etd, platform and TrainID for a service in the new JSON
+// Check if the service is already cached - re-use if it is or create new Basic and Additional objects if it isn't.
+void TrainServiceParser::prefetchServiceInternal(const json& new_service, size_t service_index){
+    
+    PendingUpdate& update = pending_update;
+    ServiceSequence& sequence = update.services_sequence[service_index];
+    
+    sequence.std_specified = extractJSONvalue<bool>(new_service, "stdSpecified", false);
+    if (sequence.std_specified) {                                                                                                               // Valid Scheduled Departure Time means it's a departure!
+        sequence.std = extractJSONTime(new_service, "std", update.now);
+        
+        sequence.etd_specified = extractJSONvalue<bool>(new_service, "etdSpecified", false);                                                    // Is there an Estimated Departure Time?
+        if (sequence.etd_specified) {                                                                                                           // If there is then extract and store
+            sequence.etd = extractJSONTime(new_service, "etd", update.now);
+            sequence.departure_time = sequence.etd;                                                                                             // Departure Time is then the ETD
+        } else {
+            sequence.departure_time = sequence.std;                                                                                             // No Estimated Departure Time, so Departure Time is then STD
+        }
         
-            // Add the trainID to the unordered map
-            new_index = new_cached_trainIDs.size();
-            new_cached_trainIDs[new_services_sequence[i].trainid] = new_index;
+    } else {                                                                                                                                    // No valid Schdeuled Departure Time means the service terminates here.
+        sequence.std = INVALID_TIME;
+        sequence.std_specified = false;
+        sequence.etd = INVALID_TIME;
+        sequence.etd_specified = false;
+        sequence.departure_time = INVALID_TIME;
+    }
+    
+    sequence.platform = extractJSONvalue<std::string>(new_service, "platform", "");
+    sequence.trainid = extractJSONvalue<std::string>(new_service, "trainid", "");
+    sequence.api_version = update.version;
+    
+    if (history && sequence.std_specified) {                                                                                                    // Noted for the history log - written when the update commits
+        DepartureHistory::Observation observation;
+        observation.rid = extractJSONvalue<std::string>(new_service, "rid", "");
+        observation.trainid = sequence.trainid;
+        auto destination = new_service.find("destination");
+        if (destination != new_service.end() && destination->is_array() && !destination->empty()) {
+            observation.destination = extractJSONvalue<std::string>(destination->front(), "locationName", "");
         }
+        observation.platform = sequence.platform;
+        observation.std = sequence.std;
+        observation.etd = sequence.etd_specified ? sequence.etd : 0;
+        observation.cancelled = extractJSONvalue<bool>(new_service, "isCancelled", false);
+        auto reason = new_service.find(observation.cancelled ? "cancelReason" : "delayReason");
+        if (reason != new_service.end()) {
+            observation.reason = static_cast<uint16_t>(extractJSONvalue<size_t>(*reason, "Value", 0));
+        }
+        update.observations.push_back(std::move(observation));
+    }
+    
+    // Check if we already have this service in the cache - if we do then re-use the existing Basic and Additiona Info structs.
+    auto it = cached_trainIDs.find(sequence.trainid);
+    
+    if (it != cached_trainIDs.end()) {                                                                                                          // Service Information is cached
+        extract = it->second;
+        DEBUG_PRINT("   [Parser] Service " << it->first << " in the JSON is cached at index " << extract << ". Moving to new index: " << service_index << " and setting callingpoint/location data as stale. (valid service: " << services_sequence[extract].std_specified <<")." );
+        update.services_basic[service_index] = services_basic[extract];                                                                         // Pull in the basic service information we have cached.
         
-        {   // Store the newly parsed data in the private data structures and update the TrainID to index mapping
-            std::lock_guard<std::mutex> lock(dataMutex);
-            data = std::move(new_data);
-            services_basic.swap(new_services_basic);
-            services_additions.swap(new_services_additions);
-            services_callingpoints.swap(new_services_callingpoints);
-            services_sequence.swap(new_services_sequence);
-            cached_trainIDs.swap(new_cached_trainIDs);
-            api_data_version = api_version;
-            
-            if(debug_mode) {
-                std::cout << "[Parser] ----- Prefetch: Cached Services and Indices -----" << std::endl;
-                debugPrintTrainIDIndices();
+                                                                                                                                                // As this service is cached, the additional service information and calling point information also needs to be kept
+        update.services_additions[service_index] = services_additions[extract];                                                                 // Store the additional information at the new position
+        update.services_callingpoints[service_index] = services_callingpoints[extract];                                                         // Store the calling point information at the new position
+        update.services_callingpoints[service_index].callingPointsCached = false;                                                               // Flag calling point data as stale
+        update.services_callingpoints[service_index].service_location_cached = false;                                                           // Flag service-location data as stale
+        if (extract < previous_to_new_index.size()) {
+            previous_to_new_index[extract] = service_index;                                                                                     // So the departure order can be carried forward
+        }
+        
+    } else {                                                                                                                                    // No Service Information is cached. These are new, unpopulated objects
+        DEBUG_PRINT("   [Parser] Service at position " << service_index << " (trainID " << sequence.trainid << ") in the JSON is not cached. Flagging all Basic and Additional static data as stale");
+        update.services_additions[service_index].static_data_available = false;                                                                // New items don't have the static data stored.
+        update.services_basic[service_index].static_data_available = false;
+        update.services_callingpoints[service_index].callingPointsCached = false;
+        update.services_callingpoints[service_index].service_location_cached = false;
+        
+        update.services_additions[service_index].trainid = sequence.trainid;                                                                    // Store the TrainID - a useful identifying to check things are in sync
+        update.services_basic[service_index].trainid = sequence.trainid;
+        update.services_callingpoints[service_index].trainid = sequence.trainid;
+    }
+    
+    // Add the trainID to the unordered map
+    new_index = update.cached_trainIDs.size();
+    update.cached_trainIDs[sequence.trainid] = new_index;
+    
+    indexCallingPointsInternal(new_service, service_index);
+}
+
+// Add each station the service calls at (after here) to the pending station index
+// Passing points and cancelled stops aren't calls. The time is the departure from the stop - actual, estimated or scheduled
+// as the calling points show it - or the arrival for the last stop.
+void TrainServiceParser::indexCallingPointsInternal(const json& new_service, size_t service_index){
+    
+    static const char* const time_keys[][2] = {{"atdSpecified", "atd"}, {"etdSpecified", "etd"}, {"stdSpecified", "std"},
+                                               {"ataSpecified", "ata"}, {"etaSpecified", "eta"}, {"staSpecified", "sta"}};
+    auto locations = new_service.find("subsequentLocations");                                                                                  // end() if the service isn't an object
+    if (locations == new_service.end() || !locations->is_array()) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(dataMutex);                                                                                                // Station IDs are shared with the queries
+    for (const json& location : *locations) {
+        if (extractJSONvalue<bool>(location, "isPass", false) || extractJSONvalue<bool>(location, "isCancelled", false)) {
+            continue;
+        }
+        std::string crs = extractJSONvalue<std::string>(location, "crs", "");
+        if (crs.empty()) {
+            continue;
+        }
+        std::string time;
+        for (const auto& time_key : time_keys) {
+            if (extractJSONvalue<bool>(location, time_key[0], false)) {
+                time = extractJSONvalue<std::string>(location, time_key[1], "");
+                break;
             }
-            
         }
-        // Create the list of ordered departures
-        orderTheDepartureList();
-        // Void the existing service_list (of the next departures).
-        std::fill(service_List.begin(), service_List.end(), 999);
-        DEBUG_PRINT("[Parser] Cache pre-fetch Completed");
-    } catch (const json::parse_error& e) {
-        throw std::runtime_error("[Parser] Failed to parse JSON in cache pre-fetch " + std::string(e.what()));
+        pending_update.station_index.add(station_ids.intern(crs), service_index, time);
+    }
+}
+
+// Store the newly parsed data in the private data structures and update the TrainID to index mapping
+// Everything the display reads changes here, in one step.
+void TrainServiceParser::commitUpdate(){
+    
+    PendingUpdate& update = pending_update;
+    
+    // Extract metadata
+    prefetchMetaData(update.parser.document());
+    update.station_index.build();
+    
+    {
+        std::lock_guard<std::mutex> lock(dataMutex);
+        data = std::move(update.parser.document());
+        data_generation++;                                                                                                                      // Field pointers into the old JSON are no longer valid
+        services_basic.swap(update.services_basic);
+        services_additions.swap(update.services_additions);
+        services_callingpoints.swap(update.services_callingpoints);
+        services_sequence.swap(update.services_sequence);
+        cached_trainIDs.swap(update.cached_trainIDs);
+        station_index.swap(update.station_index);
+        api_data_version = update.version;
+        
+        if(debug_mode) {
+            std::cout << "[Parser] ----- Prefetch: Cached Services and Indices -----" << std::endl;
+            debugPrintTrainIDIndices();
+        }
+        
+    }
+    // Create the list of ordered departures
+    orderTheDepartureList();
+    // Void the existing service_list (of the next departures).
+    std::fill(service_List.begin(), service_List.end(), 999);
+    
+    update.parser.clear();                                                                                                                      // The previous data - the vectors keep their capacity for the next update
+    update.services_basic.clear();
+    update.services_additions.clear();
+    update.services_callingpoints.clear();
+    update.services_sequence.clear();
+    update.cached_trainIDs.clear();
+    update.station_index.clear();
+    if (history) {
+        history->record(update.now, std::move(update.observations));                                                                            // Compared and appended on the history's writer thread
     }
+    update.observations.clear();
+    DEBUG_PRINT("[Parser] Cache pre-fetch Completed (" << station_index.size() << " calls at " << station_ids.size() << " stations indexed)");
 }
 
 // Extract the meta-data from the JSON
@@ -222,13 +400,7 @@ void TrainServiceParser::prefetchMetaData(const json& new_data){
     
     // Cache the meta data which applies to all services
     if (location_name.empty()){                                                                                                             // Location - only need to populate this once.
-        if (new_data.find("locationName") != new_data.end() &&
-            !new_data["locationName"].is_null() &&
-            !new_data["locationName"].empty()) {
-            location_name = new_data["locationName"];
-        } else {
-            location_name = "";
-        }
+        location_name = extractJSONvalue<std::string>(new_data, "locationName", "");
     }
     
     DEBUG_PRINT("   [Parser] Caching NRCC Messages");
@@ -244,8 +416,8 @@ void TrainServiceParser::prefetchMetaData(const json& new_data){
             if (i > 0) combined_message += " | ";
             
             const auto& messageObj = new_data["nrccMessages"][i];
-            if (messageObj.contains("xhtmlMessage") && !messageObj["xhtmlMessage"].is_null()) {
-                std::string message = messageObj["xhtmlMessage"].get<std::string>();
+            std::string message = extractJSONvalue<std::string>(messageObj, "xhtmlMessage", "");
+            if (!message.empty()) {
                 
                 // Use in-place processing for better performance
                 html_processor_.processHtmlTagsInPlace(message);
@@ -282,89 +454,52 @@ void TrainServiceParser::prefetchMetaData(const json& new_data){
 // Use Scheduled (std) or Estimated (etd) time
 // Note that 'departure time' in the pre-fetch data is std or etd (if an Estimated Time is specified)
 // Note that if the destination is the same as the location then the service terminates here and must be excluded from ordered departures.
+// The order is kept between refreshes and repaired (see departure_order.h) rather than sorted from scratch.
 
 void TrainServiceParser::orderTheDepartureList() {
-    //std::array<std::time_t, MAX_JSON_SIZE> time_list;
-    std::vector<std::time_t> time_list(max_json_size);
-    time_list.reserve(max_json_size);
     
-    try {
-        DEBUG_PRINT("[Parser] Ordering departure times Starting");
-        // Get current time to use for date information
-        std::time_t now = std::time(nullptr);
-        std::tm *now_tm = std::localtime(&now);
-        
-        // Pre-allocate a single tm structure for reuse
-        std::tm departure_time = {};
-        departure_time.tm_year = now_tm->tm_year;
-        departure_time.tm_mon = now_tm->tm_mon;
-        departure_time.tm_mday = now_tm->tm_mday;
-        departure_time.tm_sec = 0;
-        
-        // Process each service
+    DEBUG_PRINT("[Parser] Ordering departure times Starting");
+    
+    if (debug_mode) {
+        DEBUG_PRINT("   [Parser] Unsorted Departures");
         for (size_t i = 0; i < number_of_services; i++) {
-            time_list[i] = services_sequence[i].departure_time;
-            }
-        
-        if (debug_mode) {
-            DEBUG_PRINT("   [Parser] Unsorted Departures");
-            for (size_t i = 0; i < number_of_services; i++) {
-                DEBUG_PRINT("   Index " << i << " of time_list array: TrainID: " << services_sequence[i].trainid
-                            << " Platform " << services_sequence[i].platform
-                            << " Departure time " << timeToHHMM(time_list[i]) << " derived from"
-                            << " std specified:" << services_sequence[i].std_specified << " std: " << timeToHHMM(services_sequence[i].std)
-                            << " etd specified:" << services_sequence[i].etd_specified << " etd: " << timeToHHMM(services_sequence[i].etd)
-                            << " departure time cached:" << timeToHHMM(services_sequence[i].departure_time));
-            }
-            if (number_of_services == 0) {
-                DEBUG_PRINT("   [Parser] No train services available");
-            }
+            DEBUG_PRINT("   Index " << i << " of services: TrainID: " << services_sequence[i].trainid
+                        << " Platform " << services_sequence[i].platform
+                        << " Departure time " << timeToHHMM(services_sequence[i].departure_time) << " derived from"
+                        << " std specified:" << services_sequence[i].std_specified << " std: " << timeToHHMM(services_sequence[i].std)
+                        << " etd specified:" << services_sequence[i].etd_specified << " etd: " << timeToHHMM(services_sequence[i].etd)
+                        << " departure time cached:" << timeToHHMM(services_sequence[i].departure_time));
+        }
+        if (number_of_services == 0) {
+            DEBUG_PRINT("   [Parser] No train services available");
         }
+    }
 
-        // Initialize ETDOrderedList with actual service count
-        std::fill(ETDOrderedList.begin(), ETDOrderedList.end(), 999);
+    // Repair the order from the last refresh (keyed by trainid). Invalid times go to the end
+    std::fill(ETDOrderedList.begin(), ETDOrderedList.end(), 999);
+    departure_order.update(number_of_services,
+                           [this](size_t previous_index) { return previous_to_new_index[previous_index]; },
+                           [this](size_t i) { return services_sequence[i].departure_time; },
+                           INVALID_TIME, ETDOrderedList);
+    
+    DEBUG_PRINT("   [Parser] Order repaired: " << departure_order.getStats().carried_forward << " carried forward, "
+                << departure_order.getStats().added << " added, " << departure_order.getStats().invalid << " with invalid times, "
+                << departure_order.getStats().shifts << " moves" << (departure_order.getStats().full_sort ? " (full sort)" : ""));
+    
+    // Debug output
+    if (debug_mode) {
+        DEBUG_PRINT("   [Parser] Departures in time order (Invalid times are at the end) ---");
         for (size_t i = 0; i < number_of_services; i++) {
-            ETDOrderedList[i] = i;
+            size_t idx = ETDOrderedList[i];
+            DEBUG_PRINT("   Position: " << i << " Index: " << idx << " TrainID: " << services_sequence[idx].trainid
+                        << " Platform: " << services_sequence[idx].platform
+                        << " Departure time: " << timeToHHMM(services_sequence[idx].departure_time)  << " derived from"
+                        << " std specified:" << services_sequence[idx].std_specified << " std: " << timeToHHMM(services_sequence[idx].std)
+                        << " etd specified:" << services_sequence[idx].etd_specified << " etd: " << timeToHHMM(services_sequence[idx].etd)
+                        << " departure time cached:" << timeToHHMM(services_sequence[idx].departure_time));
         }
-        
-        std::sort(ETDOrderedList.begin(), ETDOrderedList.begin() + number_of_services, [&time_list](size_t a, size_t b)
-        {
-            time_t time_a = time_list[a];
-            time_t time_b = time_list[b];
-            
-            // Invalid times go to the end
-            if (time_a == INVALID_TIME && time_b == INVALID_TIME) {
-                return a < b;  // Stable sort by original index
-            }
-            if (time_a == INVALID_TIME) return false;  // a after b
-            if (time_b == INVALID_TIME) return true;   // a before b
-            
-            // Both valid, sort by time
-            return time_a < time_b;
-        });
-        
-        // Debug output
-        if (debug_mode) {
-            DEBUG_PRINT("   [Parser] Departures in time order (Invalid times are at the end) ---");
-            for (size_t i = 0; i < number_of_services; i++) {
-                size_t idx = ETDOrderedList[i];
-                std::tm* tm_time = std::localtime(&time_list[idx]);
-                
-                char buffer[10];
-                std::strftime(buffer, sizeof(buffer), "%H:%M", tm_time);
-                
-                DEBUG_PRINT("   Position: " << i << " Index: " << idx << " TrainID: " << services_sequence[idx].trainid
-                            << " Platform: " << services_sequence[idx].platform
-                            << " Departure time: " << timeToHHMM(time_list[idx])  << " derived from"
-                            << " std specified:" << services_sequence[idx].std_specified << " std: " << timeToHHMM(services_sequence[idx].std)
-                            << " etd specified:" << services_sequence[idx].etd_specified << " etd: " << timeToHHMM(services_sequence[idx].etd)
-                            << " departure time cached:" << timeToHHMM(services_sequence[idx].departure_time));
-            }
-        }
-        DEBUG_PRINT("[Parser] Ordering departure times Completed");
-    } catch (const json::exception& e) {
-        throw std::runtime_error("[Parser] Error creating ordered list of departure times: " + std::string(e.what()));
     }
+    DEBUG_PRINT("[Parser] Ordering departure times Completed");
 }
 
 
@@ -394,98 +529,266 @@ void TrainServiceParser::clearSelectedPlatform(){
     DEBUG_PRINT("[Parser] selectPlatform flag set to " << selectPlatform);
 }
 
+// Set the stored calling-at station
+void TrainServiceParser::setCallingAt(std::string crs) {
+    std::lock_guard<std::mutex> lock(dataMutex);
+    calling_at_crs = std::move(crs);
+    selectCallingAt = true;
+    DEBUG_PRINT("[Parser] Calling-at station (" << calling_at_crs << ") stored and selectCallingAt flag set to " << selectCallingAt);
+}
+
+// Clear the stored calling-at station
+void TrainServiceParser::clearCallingAt(){
+    std::lock_guard<std::mutex> lock(dataMutex);
+    selectCallingAt = false;
+    DEBUG_PRINT("[Parser] selectCallingAt flag set to " << selectCallingAt);
+}
+
+// Calling-at queries
+// The stops at a station are found with a binary search of the station index and come in the order the services get there.
+// Only departures from here are returned (the platform selection doesn't apply).
+
+// The next departure from here which calls at the station
+TrainServiceParser::CallingAtService TrainServiceParser::getNextCallingAt(const std::string& crs) {
+    std::lock_guard<std::mutex> lock(dataMutex);
+    
+    CallingAtService next = {999, ""};
+    auto stops = station_index.stopsAt(station_ids.find(crs));
+    for (const StationIndex::Stop* stop = stops.first; stop != stops.second; ++stop) {
+        if (!isDepartureInternal(stop->service)) continue;
+        if (next.service_index == 999 || services_sequence[stop->service].departure_time < services_sequence[next.service_index].departure_time) {
+            next = {stop->service, std::string(stop->time, 5)};
+        }
+    }
+    return next;
+}
+
+// The departure which gets to the station first
+TrainServiceParser::CallingAtService TrainServiceParser::getFastestTo(const std::string& crs) {
+    std::lock_guard<std::mutex> lock(dataMutex);
+    
+    auto stops = station_index.stopsAt(station_ids.find(crs));
+    for (const StationIndex::Stop* stop = stops.first; stop != stops.second; ++stop) {
+        if (isDepartureInternal(stop->service)) {
+            return {stop->service, std::string(stop->time, 5)};
+        }
+    }
+    return {999, ""};
+}
+
+// Every departure calling at the station, in the order they get there
+size_t TrainServiceParser::getServicesCallingAt(const std::string& crs, std::vector<CallingAtService>& services) {
+    std::lock_guard<std::mutex> lock(dataMutex);
+    
+    services.clear();
+    auto stops = station_index.stopsAt(station_ids.find(crs));
+    for (const StationIndex::Stop* stop = stops.first; stop != stops.second; ++stop) {
+        if (isDepartureInternal(stop->service)) {
+            services.push_back({stop->service, std::string(stop->time, 5)});
+        }
+    }
+    return services.size();
+}
+
 void TrainServiceParser::hydrateDepartureCache(){
     //size_t i;
     //size_t index;
     std::lock_guard<std::mutex> lock(dataMutex);
     
-    try {
-        DEBUG_PRINT("[Parser] Hydrating Departure Cache] for platform: " << selected_platform << "(Platform select flag: " << selectPlatform << ")");
-        
-        
-        if (number_of_services == 0) {                                                                                          // Check if train services exist in the data
-            DEBUG_PRINT("   [Parser] No train services found in the data");
-            return;
+    DEBUG_PRINT("[Parser] Hydrating Departure Cache] for platform: " << selected_platform << "(Platform select flag: " << selectPlatform << ")");
+    
+    
+    if (number_of_services == 0) {                                                                                          // Check if train services exist in the data
+        DEBUG_PRINT("   [Parser] No train services found in the data");
+        return;
+    }
+    
+    if (selectCallingAt) {                                                                                                  // Mark the services calling at the selected station - from the index
+        calls_at_selected.assign(number_of_services, 0);
+        auto stops = station_index.stopsAt(station_ids.find(calling_at_crs));
+        for (const StationIndex::Stop* stop = stops.first; stop != stops.second; ++stop) {
+            if (stop->service < number_of_services) calls_at_selected[stop->service] = 1;
         }
+    }
+    
+    if (selectPlatform || selectCallingAt) {                                                                                // Find departures for the selected platform and/or calling at the selected station
         
-        if (selectPlatform) {                                                                                                   // Find departures for the selected platform
-            
-            size_t serviceCount = 0;
-            DEBUG_PRINT("   [Parser] Searching for services at platform " << selected_platform);
+        size_t serviceCount = 0;
+        DEBUG_PRINT("   [Parser] Searching for services at platform " << (selectPlatform ? selected_platform : "(any)") << " calling at " << (selectCallingAt ? calling_at_crs : "(any)"));
+        
+        for (i = 0; i < number_of_services && serviceCount < service_List.size(); ++i) {                                    // Iterate through all train services in the pre-fetch cache
+            index = ETDOrderedList[i];
+            if (index >= number_of_services) continue;
             
-            for (i = 0; i < number_of_services && serviceCount < service_List.size(); ++i) {                                    // Iterate through all train services in the pre-fetch cache
-                index = ETDOrderedList[i];
+            if ((!selectPlatform || services_sequence[index].platform == selected_platform) &&                             // Check if the platform matches the selected platform
+                (!selectCallingAt || calls_at_selected[index])) {                                                           // and the service calls at the selected station
                 
-                if (services_sequence[index].platform == selected_platform) {                                                   // Check if the platform matches the selected platform
-                    
-                    DEBUG_PRINT("   [Parser] Found service for platform " << selected_platform << " at service_index " << index);    // Found a service for the selected platform
-                    if(services_sequence[index].std == INVALID_TIME) {
-                        service_List[serviceCount] = 999;                                                                       // Service is an arrival - add 999 to the array (the sort function puts all of these at the end, so there will be no subsequent valid departures)
-                        DEBUG_PRINT("   [Parser] Position " << i << " in the ordered departure list: Invalid departure at index " << index <<" (service terminates here - no subsequent valid departures.");
-                    } else {
-                        service_List[serviceCount] = index;                                                                     // Add its index to the array
-                        DEBUG_PRINT("   [Parser] Position " << i << " in the ordered departure list: Valid departure at index " << index);
-                    }
-                    ++serviceCount;                                                                                             // Increment the count of services found
-                }
-            }
-        } else {
-            DEBUG_PRINT("   [Parser] Searching for services at all platforms ");
-            for (i = 0; i < number_of_departures; i++) {                                                                        // Find the first NUM_OF_DEPARTURES departures
-                if (i < number_of_services) {
-                    if (ETDOrderedList[i] == 999) continue;                                                                     // Skip invalid services
-                    if (services_sequence[ETDOrderedList[i] ].std == INVALID_TIME) continue;                                    // Skip arrivals at a terminus
-                    service_List[i] = ETDOrderedList[i];
-                    DEBUG_PRINT("   [Parser] Found service at position " << i << " in the ordered departure list.");            // Found a valid service
+                DEBUG_PRINT("   [Parser] Found service for platform " << selected_platform << " at service_index " << index);    // Found a service for the selected platform
+                if(services_sequence[index].std == INVALID_TIME) {
+                    service_List[serviceCount] = 999;                                                                       // Service is an arrival - add 999 to the array (the sort function puts all of these at the end, so there will be no subsequent valid departures)
+                    DEBUG_PRINT("   [Parser] Position " << i << " in the ordered departure list: Invalid departure at index " << index <<" (service terminates here - no subsequent valid departures.");
+                } else {
+                    service_List[serviceCount] = index;                                                                     // Add its index to the array
+                    DEBUG_PRINT("   [Parser] Position " << i << " in the ordered departure list: Valid departure at index " << index);
                 }
+                ++serviceCount;                                                                                             // Increment the count of services found
             }
         }
-        
-        DEBUG_PRINT("  [Parser] Hydrating Basic Data Cache for the next " << number_of_departures << " departures");
-        for (i=0; i< number_of_departures; i++) {
-            index = service_List[i];
-            DEBUG_PRINT("  [Parser] Departure: " << i << ". Initiating BasicData hydration for Service Index: " << index);
-            if(index != 999) {                                                                                                  // Hydrate the basic cache for valid services
-                hydrateBasicDataCacheInternal(index);
+    } else {
+        DEBUG_PRINT("   [Parser] Searching for services at all platforms ");
+        for (i = 0; i < number_of_departures; i++) {                                                                        // Find the first NUM_OF_DEPARTURES departures
+            if (i < number_of_services) {
+                if (ETDOrderedList[i] == 999) continue;                                                                     // Skip invalid services
+                if (services_sequence[ETDOrderedList[i] ].std == INVALID_TIME) continue;                                    // Skip arrivals at a terminus
+                service_List[i] = ETDOrderedList[i];
+                DEBUG_PRINT("   [Parser] Found service at position " << i << " in the ordered departure list.");            // Found a valid service
             }
         }
+    }
     
-        
-        if (debug_mode) {                                                                                                       // Debug information about the found service
-            DEBUG_PRINT("   [Parser] --- Departure Cache Hydration Results ---");
-            if (selectPlatform) {
-                DEBUG_PRINT("   [Parser] Finding the first " << number_of_departures << " departures for platform " << selected_platform);
+    DEBUG_PRINT("  [Parser] Hydrating Basic Data Cache for the next " << number_of_departures << " departures");
+    hydrateDeparturesInternal(service_List);
+
+    
+    if (debug_mode) {                                                                                                       // Debug information about the found service
+        DEBUG_PRINT("   [Parser] --- Departure Cache Hydration Results ---");
+        if (selectPlatform) {
+            DEBUG_PRINT("   [Parser] Finding the first " << number_of_departures << " departures for platform " << selected_platform);
+        } else {
+            DEBUG_PRINT("   [Parser] Finding the first " << number_of_departures << " departures from all platforms ");
+        }
+        for (i=0; i < number_of_departures; i++) {
+            index = service_List[i];
+            if ( service_List[i] == 999) {
+                DEBUG_PRINT("   [Parser] Position " << i << " - Service Index: " << index <<". No valid service found (no departure or an arrival)");
             } else {
-                DEBUG_PRINT("   [Parser] Finding the first " << number_of_departures << " departures from all platforms ");
-            }
-            for (i=0; i < number_of_departures; i++) {
-                index = service_List[i];
-                if ( service_List[i] == 999) {
-                    DEBUG_PRINT("   [Parser] Position " << i << " - Service Index: " << index <<". No valid service found (no departure or an arrival)");
-                } else {
-                    DEBUG_PRINT("   [Parser] Position " << i << " - Service Index: " << index << " Platform " << services_sequence[index].platform
-                                << ": Sequence TrainID: " << services_sequence[index].trainid
-                                << ": BasicInfo TrainID: " << services_basic[index].trainid
-                                << ". Destination: " << services_basic[index].destination
-                                << ". Scheduled departure: " << services_basic[index].scheduledDepartureTime
-                                << " - Estimated departure: " << services_basic[index].estimatedDepartureTime
-                                << " - Sequence Departure time:" << timeToHHMM(services_sequence[index].departure_time)
-                                << ". Static Data available: " << services_basic[index].static_data_available);
-                }
+                DEBUG_PRINT("   [Parser] Position " << i << " - Service Index: " << index << " Platform " << services_sequence[index].platform
+                            << ": Sequence TrainID: " << services_sequence[index].trainid
+                            << ": BasicInfo TrainID: " << services_basic[index].trainid
+                            << ". Destination: " << services_basic[index].destination
+                            << ". Scheduled departure: " << services_basic[index].scheduledDepartureTime
+                            << " - Estimated departure: " << services_basic[index].estimatedDepartureTime
+                            << " - Sequence Departure time:" << timeToHHMM(services_sequence[index].departure_time)
+                            << ". Static Data available: " << services_basic[index].static_data_available);
             }
-            DEBUG_PRINT("   [Parser] End of Departure Cache Hydration Results ---");
-            debugPrintServiceSequence();
-            debugPrintTrainIDIndices();
-            DEBUG_PRINT("[Parser] Hydrating Departure Cache Complete for platform: " << selected_platform << " (Plaform select flag: " << selectPlatform <<")");
         }
-    } catch (const json::exception& e) {
-        DEBUG_PRINT("[Parser] Error finding services: " << e.what());
+        DEBUG_PRINT("   [Parser] End of Departure Cache Hydration Results ---");
+        debugPrintServiceSequence();
+        debugPrintTrainIDIndices();
+        DEBUG_PRINT("[Parser] Hydrating Departure Cache Complete for platform: " << selected_platform << " (Plaform select flag: " << selectPlatform <<")");
     }
 }
 
 
 
 
+// Find the fields of a service in the JSON
+// The service object is visited once and a pointer kept to each field we use. Basic, additional and calling-point extraction
+// then read the fields directly instead of looking each one up (and re-checking the TrainID) every time.
+// The index is kept until the JSON is replaced in the next pre-fetch. Assumes the lock is held.
+TrainServiceParser::Status TrainServiceParser::indexServiceFieldsInternal(size_t service_index, const ServiceFields*& indexed_fields) {
+    
+    indexed_fields = nullptr;
+    if (service_index >= max_json_size || service_index >= number_of_services) {
+        error_counters.index_out_of_range++;
+        DEBUG_PRINT("  [Parser] Service index " << service_index << " is out of range (" << number_of_services << " services)");
+        return Status::INDEX_OUT_OF_RANGE;
+    }
+    
+    ID = services_sequence[service_index].trainid;
+    
+    ServiceFields& fields = services_fields[service_index];
+    if (fields.generation == data_generation) {                                                                                                    // Already indexed (and checked) for this JSON
+        trainid = ID;
+        indexed_fields = &fields;
+        return Status::OK;
+    }
+    
+    fields = ServiceFields();
+    auto services = data.find("trainServices");
+    if (services == data.end() || !services->is_array() || service_index >= services->size()) {
+        error_counters.no_service++;
+        DEBUG_PRINT("  [Parser] No service in the JSON at index " << service_index);
+        return Status::NO_SERVICE;
+    }
+    const json& service = (*services)[service_index];
+    if (service.is_object()) {
+        for (auto it = service.begin(); it != service.end(); ++it) {
+            const std::string& key = it.key();
+            const json* value = &it.value();
+            switch (key.empty() ? '\0' : key[0]) {                                                                                                // Switch on the first letter - then at most three comparisons
+                case 'a':
+                    if (key == "adhocAlerts") fields.adhocAlerts = value;
+                    break;
+                case 'c':
+                    if (key == "cancelReason") fields.cancelReason = value;
+                    break;
+                case 'd':
+                    if (key == "destination") fields.destination = value;
+                    else if (key == "delayReason") fields.delayReason = value;
+                    else if (key == "departureType") fields.departureType = value;
+                    break;
+                case 'e':
+                    if (key == "etd") fields.etd = value;
+                    break;
+                case 'f':
+                    if (key == "formation") fields.formation = value;
+                    break;
+                case 'i':
+                    if (key == "isCancelled") fields.isCancelled = value;
+                    else if (key == "isPassengerService") fields.isPassengerService = value;
+                    break;
+                case 'l':
+                    if (key == "length") fields.length = value;
+                    break;
+                case 'o':
+                    if (key == "operator") fields.operator_name = value;
+                    else if (key == "origin") fields.origin = value;
+                    break;
+                case 'p':
+                    if (key == "platformIsHidden") fields.platformIsHidden = value;
+                    else if (key == "previousLocations") fields.previousLocations = value;
+                    break;
+                case 's':
+                    if (key == "std") fields.std = value;
+                    else if (key == "serviceIsSupressed") fields.serviceIsSupressed = value;
+                    else if (key == "subsequentLocations") fields.subsequentLocations = value;
+                    break;
+                case 't':
+                    if (key == "trainid") fields.trainid = value;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    
+    // Use TrainID to check this is the expected Service
+    trainid = fieldValue<std::string>(fields.trainid, "");
+    DEBUG_PRINT("  [Parser] Indexed fields: Expected Service " << ID << " and got Service " << trainid)
+    if(trainid != ID){
+        error_counters.service_mismatch++;
+        return Status::SERVICE_MISMATCH;
+    }
+    
+    fields.generation = data_generation;
+    indexed_fields = &fields;
+    return Status::OK;
+}
+
+// Hydrate the Basic Service Information for a batch of services - e.g. the next departures
+// Each service costs one pass over its JSON (indexServiceFieldsInternal). Assumes the lock is held.
+void TrainServiceParser::hydrateDeparturesInternal(const std::vector<size_t>& service_indices) {
+    for (size_t departure = 0; departure < service_indices.size(); departure++) {
+        index = service_indices[departure];
+        DEBUG_PRINT("  [Parser] Departure: " << departure << ". Initiating BasicData hydration for Service Index: " << index);
+        if(index != 999) {                                                                                                                          // Hydrate the basic cache for valid services
+            hydrateBasicDataCacheInternal(index);
+        }
+    }
+}
+
+
 // Update the cache of basic service information
 /* BasicServiceInfo data structure
    -------------------------
@@ -511,116 +814,105 @@ void TrainServiceParser::hydrateDepartureCache(){
 */
 
 // Public version - thread-safe interface
-void TrainServiceParser::hydrateBasicDataCache(size_t service_index) {
+TrainServiceParser::Status TrainServiceParser::hydrateBasicDataCache(size_t service_index) {
     std::lock_guard<std::mutex> lock(dataMutex);
-    hydrateBasicDataCacheInternal(service_index);
+    return hydrateBasicDataCacheInternal(service_index);
 }
 
 // Internal version which assumes the caller already has a lock
-void TrainServiceParser::hydrateBasicDataCacheInternal(size_t service_index) {
-    BasicServiceInfo new_basic_item;
+// Returns the error (and leaves the cache alone) if the service index or TrainID is wrong
+TrainServiceParser::Status TrainServiceParser::hydrateBasicDataCacheInternal(size_t service_index) {
+    BasicServiceInfo new_basic_item{};                                                      // Value-initialised - a new item must not inherit a stale apiDataVersion
     
-    ID = services_sequence[service_index].trainid;
+    DEBUG_PRINT("[Parser] Basic Data cache hydration Starting for Service at Index " << service_index << ".");
     
-    try {
-        DEBUG_PRINT("[Parser] Basic Data cache hydration Starting for Service at Index " << service_index << ".");
-        
-        // Use TrainID to check this is the expected Service
-        new_basic_item.trainid = extractJSONvalue<std::string>(data["trainServices"][service_index], "trainid", "");
-        DEBUG_PRINT("  [Parser] Basic Data: Expected Service " << ID << " and got Service " << new_basic_item.trainid)
-        if(new_basic_item.trainid != ID){
-            throw std::out_of_range("Unexpected Service ID");
+    const ServiceFields* indexed_fields;
+    Status status = indexServiceFieldsInternal(service_index, indexed_fields);                                                                     // Checks the index and the TrainID
+    if (status != Status::OK) {
+        return status;
+    }
+    const ServiceFields& fields = *indexed_fields;
+    new_basic_item.trainid = services_sequence[service_index].trainid;
+    
+    if(services_basic[service_index].static_data_available){                                                                                        // Basic Service Information is cached. Use the cached static data.Populate static data as it's new to the cache
+        DEBUG_PRINT("  [Parser] Basic Data: Static data cached - re-using")
+        new_basic_item = services_basic[service_index];
+    } else {                                                                                                                                        // Basic Service Information is NOT cached. Populate static data as it's new to the cache
+        DEBUG_PRINT("  [Parser] Basic Data: Static data not cached - hydrating");
+        services_additions[service_index].static_data_available = false;                                                                            // If the Basic Service Information isn't cached, then any Additional Service Information is going to be stale.
+        
+        // Scheduled Time of Departure as a string
+        new_basic_item.scheduledDepartureTime = fieldTimeString(fields.std, "");
+        
+        // Destination
+        new_basic_item.destination = fieldValue<std::string>(childField(firstElement(fields.destination), "locationName"), "");
+        
+        // Operator
+        new_basic_item.operator_name = fieldValue<std::string>(fields.operator_name, "");
+        
+        // Coaches
+        extract = fieldValue<size_t>(fields.length, 0);
+        if (extract !=0) {
+            new_basic_item.coaches = std::to_string(extract);
+        } else {
+            new_basic_item.coaches = "";
         }
         
-        if (service_index >= max_json_size) {
-            throw std::out_of_range("Service index exceeds maximum size");
-        }
+        new_basic_item.static_data_available = true;
+    }
+    
+    // Update dynamic data if the cached dynamic data is from the latest API version
+    
+    if(new_basic_item.apiDataVersion != api_data_version){
+        // Cancellation Status
+        new_basic_item.isCancelled = fieldValue<bool>(fields.isCancelled, false);
         
-        if (service_index >= number_of_services) {
-            throw std::out_of_range("Service index exceeds current service count");
-        }
+        // cancelReason
+        extract = fieldValue<size_t>(childField(fields.cancelReason, "Value"), 0);
+        new_basic_item.cancelReason = decodeCancelCode(extract);
         
-        if(services_basic[service_index].static_data_available){                                                                                        // Basic Service Information is cached. Use the cached static data.Populate static data as it's new to the cache
-            DEBUG_PRINT("  [Parser] Basic Data: Static data cached - re-using")
-            new_basic_item = services_basic[service_index];
-        } else {                                                                                                                                        // Basic Service Information is NOT cached. Populate static data as it's new to the cache
-            DEBUG_PRINT("  [Parser] Basic Data: Static data not cached - hydrating");
-            services_additions[service_index].static_data_available = false;                                                                            // If the Basic Service Information isn't cached, then any Additional Service Information is going to be stale.
-            
-            // Scheduled Time of Departure as a string
-            new_basic_item.scheduledDepartureTime = extractJSONTimeString(data["trainServices"][service_index], "std", "");
-            
-            // Destination
-            new_basic_item.destination = extractNestedJSONvalue<std::string>(data["trainServices"][service_index], "destination", 0, "locationName", "");
-            
-            // Operator
-            new_basic_item.operator_name = extractJSONvalue<std::string>(data["trainServices"][service_index], "operator", "");
-            
-            // Coaches
-            extract = extractJSONvalue<size_t>(data["trainServices"][service_index], "length", 0);
-            if (extract !=0) {
-                new_basic_item.coaches = std::to_string(extract);
-            } else {
-                new_basic_item.coaches = "";
-            }
-            
-            new_basic_item.static_data_available = true;
-        }
+        // delayReason
+        extract = fieldValue<size_t>(childField(fields.delayReason, "Value"), 0);
+        new_basic_item.delayReason = decodeDelayCode(extract);
         
-        // Update dynamic data if the cached dynamic data is from the latest API version
+        // adhocAlerts
+        new_basic_item.adhocAlerts = fieldValue<std::string>(fields.adhocAlerts, "");
         
-        if(new_basic_item.apiDataVersion != api_data_version){
-            // Cancellation Status
-            new_basic_item.isCancelled = extractJSONvalue<bool>(data["trainServices"][service_index], "isCancelled", false);
-            
-            // cancelReason
-            extract = extractJSONvalue<size_t>(data["trainServices"][service_index]["cancelReason"], "Value", 0);
-            new_basic_item.cancelReason = decodeCancelCode(extract);
-            
-            // delayReason
-            extract = extractJSONvalue<size_t>(data["trainServices"][service_index]["delayReason"], "Value", 0);
-            new_basic_item.delayReason = decodeDelayCode(extract);
-            
-            // adhocAlerts
-            new_basic_item.adhocAlerts = extractJSONvalue<std::string>(data["trainServices"][service_index], "adhocAlerts", "");
-            
-            // EstimatedDepartureTime if an ETD is available
-            //
-            // We can obtain delay status from departureType.
-            
-            if(services_sequence[service_index].etd_specified) {                                                                                        // If an estimated time of departure is available...
-                new_basic_item.estimatedDepartureTime = extractJSONTimeString(data["trainServices"][service_index], "etd", "");                         // ... then display that
-                if (new_basic_item.estimatedDepartureTime == new_basic_item.scheduledDepartureTime) {                                                   // Catch situations where a service etd is set and the service is on time
-                    new_basic_item.estimatedDepartureTime = "On Time";
-                }
-                DEBUG_PRINT("  [Parser] ETD found - storing " << new_basic_item.estimatedDepartureTime);
-            } else {                                                                                                                                    // otherwise
-                new_basic_item.estimatedDepartureTime = (new_basic_item.isCancelled) ? "Cancelled" : "On Time";                                         // Display 'On Time' or 'Cancelled'
-                DEBUG_PRINT("  [Parser] No ETD found - storing " << new_basic_item.estimatedDepartureTime);
-            }
-            
-            if(extractJSONvalue<std::string>(data["trainServices"][service_index], "departureType", "") == "Delayed" ) {                                // If a departure is marked as 'Delayed'
-                DEBUG_PRINT("  [Parser] Service Departure Type is 'Delayed'. Setting the 'isDelayed' flag to true");
-                new_basic_item.isDelayed = true;                                                                                                        // Set the delay flag
-                if(!services_sequence[service_index].etd_specified) {                                                                                   // If no estimated time of departure is available then display 'Delayed' (otherwise leave the estimated departure time to be displayed)
-                    new_basic_item.estimatedDepartureTime = "Delayed";
-                    DEBUG_PRINT("  [Parser] Delayed and no ETD found - storing " << new_basic_item.estimatedDepartureTime);
-                }
-            } else {                                                                                                                                    // Otherwise it's not delayed
-                new_basic_item.isDelayed = false;
-                DEBUG_PRINT("  [Parser] Service Departure Type is not 'Delayed'. Setting the 'isDelayed' flag to false");
+        // EstimatedDepartureTime if an ETD is available
+        //
+        // We can obtain delay status from departureType.
+        
+        if(services_sequence[service_index].etd_specified) {                                                                                        // If an estimated time of departure is available...
+            new_basic_item.estimatedDepartureTime = fieldTimeString(fields.etd, "");                                                                 // ... then display that
+            if (new_basic_item.estimatedDepartureTime == new_basic_item.scheduledDepartureTime) {                                                   // Catch situations where a service etd is set and the service is on time
+                new_basic_item.estimatedDepartureTime = "On Time";
             }
-     
-            new_basic_item.apiDataVersion = api_data_version;                                                                                           // Store the new API Data version
-            DEBUG_PRINT("  [Parser] New basic item API version: " << new_basic_item.apiDataVersion <<" from api_data_version: " << api_data_version);
+            DEBUG_PRINT("  [Parser] ETD found - storing " << new_basic_item.estimatedDepartureTime);
+        } else {                                                                                                                                    // otherwise
+            new_basic_item.estimatedDepartureTime = (new_basic_item.isCancelled) ? "Cancelled" : "On Time";                                         // Display 'On Time' or 'Cancelled'
+            DEBUG_PRINT("  [Parser] No ETD found - storing " << new_basic_item.estimatedDepartureTime);
         }
-        // Store the service data
-        services_basic[service_index] = new_basic_item;
-        DEBUG_PRINT("[Parser] Basic Data cache hydration completed for Service at Index " << service_index << ".");
         
-    } catch (const json::parse_error& e) {
-        throw std::runtime_error("[Parse] Failed to parse JSON to hydrate basic data: " + std::string(e.what()));
+        if(fieldValue<std::string>(fields.departureType, "") == "Delayed" ) {                                // If a departure is marked as 'Delayed'
+            DEBUG_PRINT("  [Parser] Service Departure Type is 'Delayed'. Setting the 'isDelayed' flag to true");
+            new_basic_item.isDelayed = true;                                                                                                        // Set the delay flag
+            if(!services_sequence[service_index].etd_specified) {                                                                                   // If no estimated time of departure is available then display 'Delayed' (otherwise leave the estimated departure time to be displayed)
+                new_basic_item.estimatedDepartureTime = "Delayed";
+                DEBUG_PRINT("  [Parser] Delayed and no ETD found - storing " << new_basic_item.estimatedDepartureTime);
+            }
+        } else {                                                                                                                                    // Otherwise it's not delayed
+            new_basic_item.isDelayed = false;
+            DEBUG_PRINT("  [Parser] Service Departure Type is not 'Delayed'. Setting the 'isDelayed' flag to false");
+        }
+ 
+        new_basic_item.apiDataVersion = api_data_version;                                                                                           // Store the new API Data version
+        DEBUG_PRINT("  [Parser] New basic item API version: " << new_basic_item.apiDataVersion <<" from api_data_version: " << api_data_version);
     }
+    // Store the service data
+    services_basic[service_index] = new_basic_item;
+    DEBUG_PRINT("[Parser] Basic Data cache hydration completed for Service at Index " << service_index << ".");
+    return Status::OK;
+    
 }
 
 
@@ -645,84 +937,71 @@ void TrainServiceParser::hydrateBasicDataCacheInternal(size_t service_index) {
    */
 
 // Public version - thread-safe interface
-void TrainServiceParser::hydrateAdditionalDataCache(size_t service_index) {
+TrainServiceParser::Status TrainServiceParser::hydrateAdditionalDataCache(size_t service_index) {
     std::lock_guard<std::mutex> lock(dataMutex);
-    hydrateAdditionalDataCacheInternal(service_index);
+    return hydrateAdditionalDataCacheInternal(service_index);
 }
 
 // Internal version - assumes caller already has lock
-void TrainServiceParser::hydrateAdditionalDataCacheInternal(size_t service_index){
-    AdditionalServiceInfo new_additional_item;
-    //std::string ID = services_sequence[service_index].trainid;
-    ID = services_sequence[service_index].trainid;
+TrainServiceParser::Status TrainServiceParser::hydrateAdditionalDataCacheInternal(size_t service_index){
+    AdditionalServiceInfo new_additional_item{};
     
-    try {
-        DEBUG_PRINT("[Parser] Additional Data cache hydration for service " << service_index <<".");
+    DEBUG_PRINT("[Parser] Additional Data cache hydration for service " << service_index <<".");
+    
+    const ServiceFields* indexed_fields;
+    Status status = indexServiceFieldsInternal(service_index, indexed_fields);              // Checks the index and the TrainID (shared with the basic data hydration)
+    if (status != Status::OK) {
+        return status;
+    }
+    const ServiceFields& fields = *indexed_fields;
+    new_additional_item.trainid = services_sequence[service_index].trainid;
+    
+    if( services_additions[service_index].static_data_available){                            // If the version of the additional data matches the basic service data then the cache is valid
+        DEBUG_PRINT("   [Parser] Additional service data at index " << service_index <<" is cached. Updating dynamic data (retaining any calling points)");
+        new_additional_item = services_additions[service_index];                             // pull in cached additional info - only dynamic data needs to be updated
         
-        // Use TrainID to check this is the expected Service
-        new_additional_item.trainid = extractJSONvalue<std::string>(data["trainServices"][service_index], "trainid", "");
-        DEBUG_PRINT("   [Parser] Additional Data: Expected Service " << ID << " and got Service " << new_additional_item.trainid)
-        if(new_additional_item.trainid != ID){
-            throw std::out_of_range("Unexpected Service ID");
-        }
+    } else {                                                                                // populate the static data.
+        DEBUG_PRINT("   [Parser] Additional service data at index " << service_index <<" is new. Updating static and dynamic data (no calling points stored)");
+        new_additional_item.static_data_available = true;                                   // flag that the static data is good
         
-        if (service_index >= max_json_size) {
-            throw std::out_of_range("Service index exceeds maximum size");
-        }
+        // Origin
+        new_additional_item.origin = fieldValue<std::string>(childField(firstElement(fields.origin), "locationName"), "");
         
-        if (service_index >= number_of_services) {
-            throw std::out_of_range("Service index exceeds current service count");
-        }
+        // Loading Category and Percentage
+        const json* loading = childField(childField(fields.formation, "serviceLoading"), "loadingPercentage");
+        new_additional_item.loading_type = fieldValue<std::string>(childField(loading, "type"), "");
+        new_additional_item.loadingPercentage = fieldValue<size_t>(childField(loading, "value"), 0);
         
-        if( services_additions[service_index].static_data_available){                            // If the version of the additional data matches the basic service data then the cache is valid
-            DEBUG_PRINT("   [Parser] Additional service data at index " << service_index <<" is cached. Updating dynamic data (retaining any calling points)");
-            new_additional_item = services_additions[service_index];                             // pull in cached additional info - only dynamic data needs to be updated
-            
-        } else {                                                                                // populate the static data.
-            DEBUG_PRINT("   [Parser] Additional service data at index " << service_index <<" is new. Updating static and dynamic data (no calling points stored)");
-            new_additional_item.static_data_available = true;                                   // flag that the static data is good
-            
-            // Origin
-            new_additional_item.origin = extractNestedJSONvalue<std::string>(data["trainServices"][service_index], "origin", 0, "locationName", "");
-            
-            // Loading Category
-            new_additional_item.loading_type = extractJSONvalue<std::string>(data["trainServices"][service_index]["formation"]["serviceLoading"]["loadingPercentage"], "type", "");
-            
-            // Loading Percentage
-            new_additional_item.loadingPercentage = extractJSONvalue<size_t>(data["trainServices"][service_index]["formation"]["serviceLoading"]["loadingPercentage"], "value", 0);
-            
-            // Service is Suppressed
-            new_additional_item.serviceIsSupressed = extractJSONvalue<bool>(data["trainServices"][service_index], "serviceIsSupressed", false);
-            
-            // Is a Passenger Service
-            new_additional_item.isPassengerService = extractJSONvalue<bool>(data["trainServices"][service_index], "isPassengerService", false);
-            
-            // Populate std::vector<CoachInfo>
-            
-            services_additions[service_index].static_data_available = true;
-        }
+        // Service is Suppressed
+        new_additional_item.serviceIsSupressed = fieldValue<bool>(fields.serviceIsSupressed, false);
         
-        // Following data is dynamic.
-        if(new_additional_item.apiDataVersion != api_data_version){
-           
-            // Platform is hidden
-            new_additional_item.platformIsHidden = extractJSONvalue<bool>(data["trainServices"][service_index], "platformIsHidden", false);
-            
-            new_additional_item.apiDataVersion = api_data_version;
-        }
-        {   // Store the newly parsed data in the private data structures
-            services_additions[service_index] = new_additional_item;
-            
-            if(debug_mode) {
-                std::cout << "[Parser] ----- Hydrate additional info: Cached Services and Indices -----" << std::endl;
-                debugPrintTrainIDIndices();
-            }
-        }
-        DEBUG_PRINT("[Parser] Additional Data cache hydration complete for service " << service_index <<".");
+        // Is a Passenger Service
+        new_additional_item.isPassengerService = fieldValue<bool>(fields.isPassengerService, false);
         
-    } catch (const json::parse_error& e) {
-        throw std::runtime_error("[Parser] Failed to parse JSON for additional data: " + std::string(e.what()));
+        // Populate std::vector<CoachInfo>
+        
+        services_additions[service_index].static_data_available = true;
     }
+    
+    // Following data is dynamic.
+    if(new_additional_item.apiDataVersion != api_data_version){
+       
+        // Platform is hidden
+        new_additional_item.platformIsHidden = fieldValue<bool>(fields.platformIsHidden, false);
+        
+        new_additional_item.apiDataVersion = api_data_version;
+    }
+    {   // Store the newly parsed data in the private data structures
+        services_additions[service_index] = new_additional_item;
+        
+        if(debug_mode) {
+            std::cout << "[Parser] ----- Hydrate additional info: Cached Services and Indices -----" << std::endl;
+            debugPrintTrainIDIndices();
+        }
+    }
+    DEBUG_PRINT("[Parser] Additional Data cache hydration complete for service " << service_index <<".");
+    return Status::OK;
+    
 }
 
  
@@ -737,10 +1016,11 @@ void TrainServiceParser::hydrateAdditionalDataCacheInternal(size_t service_index
    E* std::string trainid;
    E* uint64_t apiDataVersion;
    E* bool callingPointsCached;
-   E* std::string callingPoints;
-   E* std::string callingPoints_with_ETD;
+   E* CallingPointText callingPoints;
+   E* CallingPointText callingPoints_with_ETD;
    *  std::vector<LocationInfo> PreviousCallingPoints;
-   *  std::vector<LocationInfo> SubsequentCallingPoints;
+   *  std::vector<CompactCallingPoint> SubsequentCallingPoints;
+   *  std::string subsequent_names;
    *  size_t num_previous_calling_points;
    *  size_t num_subsequent_calling_points;
    E* bool bool service_location_cached;
@@ -760,14 +1040,17 @@ void TrainServiceParser::hydrateAdditionalDataCacheInternal(size_t service_index
    *  std::string ArrivalTime;
    *  std::string ArrivalType;
    *  std::string DepartureTime;
+ 
+   Subsequent calling points are stored as CompactCallingPoint (name, isPass, isCancelled and DepartureTime)
+   with the names held back-to-back in subsequent_names.
  */
 
 
-void TrainServiceParser::ExtractCallingPoints(size_t service_index, CallingPointDirection direction) {
+TrainServiceParser::Status TrainServiceParser::ExtractCallingPoints(size_t service_index, CallingPointDirection direction) {
     
     // Method to populate:
     //  std::vector<LocationInfo> PreviousCallingPoints;
-    //  std::vector<LocationInfo> SubsequentCallingPoints
+    //  std::vector<CompactCallingPoint> SubsequentCallingPoints (and subsequent_names)
     // depending on the 'direction' parameter
     //
     // Output is stored in the CallingPointsInfo for the specified service 'service_index'
@@ -775,192 +1058,240 @@ void TrainServiceParser::ExtractCallingPoints(size_t service_index, CallingPoint
     
     std::vector<LocationInfo> new_list_of_calling_points;
     LocationInfo new_location;
+    std::vector<CompactCallingPoint> new_compact_calling_points;
+    std::string new_names;
+    CompactCallingPoint new_compact_location;
+    std::string departure_time;
     
-    //std::string ID;
-    //std::string trainid;
-    
-    json callingPoints;
+    static const json no_calling_points = json::array();
+    const json* location_list;
 
     size_t number_of_calling_points;
-    //size_t i;
     
-    try {
-        DEBUG_PRINT("[Parser] Extracting calling-points for service at index " << service_index);
-        
-        // Use TrainID to check this is the expected Service
-        ID = services_sequence[service_index].trainid;
-        trainid = extractJSONvalue<std::string>(data["trainServices"][service_index], "trainid", "");
-        DEBUG_PRINT("   [Parser] Extract calling-points: Expected Service " << ID << " and got Service " << trainid)
-        if(trainid != ID){
-            throw std::out_of_range("Unexpected TrainID");
-        }
+    DEBUG_PRINT("[Parser] Extracting calling-points for service at index " << service_index);
+    
+    const ServiceFields* indexed_fields;
+    Status status = indexServiceFieldsInternal(service_index, indexed_fields);                            // Checks the index and the TrainID
+    if (status != Status::OK) {
+        return status;
+    }
+    const ServiceFields& fields = *indexed_fields;
+    
+    if(direction == SUBSEQUENT) {
+        location_list = fields.subsequentLocations;
+        DEBUG_PRINT("   [Parser] Extracting Subsequent calling points");
+    } else {
+        location_list = fields.previousLocations;
+        DEBUG_PRINT("   [Parser] Extracting Previous calling points");
+    }
+    const json& callingPoints = (location_list != nullptr && location_list->is_array()) ? *location_list : no_calling_points;    // Read in place - no copy of the locations
+    
+    number_of_calling_points = callingPoints.size();
+    if(direction == SUBSEQUENT) {
+        new_compact_calling_points.reserve(number_of_calling_points);
+        new_names.reserve(number_of_calling_points * 16);                                                   // Typical station name length
+    } else {
+        new_list_of_calling_points.reserve(number_of_calling_points);
+    }
+    
+    // Calling points are a vector of LocationInfo objects.
+    // This loop extracts each calling point from the JSON data and stores it in a vector (new_list_of_calling_points)
+    // Once complete this the vector is stored in the calling-points information object (services_callingpoints)
+    // number_of_calling_points is the number of calling points in the JSON (some of which may be passed)
+ 
+    for (i = 0; i < number_of_calling_points; ++i) {
+        // std::string locationName;
+        //*  bool isPass;
+        //*  bool isCancelled;
+        //*  std::string ArrivalTime;
+        //*  std::string DepartureTime;
         
-        if (service_index >= number_of_services) {
-            throw std::out_of_range("Service index out of range");
-        }
+        // If locationName exists, is not null, and isn't empty, store it
+        new_location.locationName = extractJSONvalue<std::string>(callingPoints[i], "locationName", "");
         
-        if(direction == SUBSEQUENT) {
-            callingPoints = data["trainServices"][service_index]["subsequentLocations"];
-            DEBUG_PRINT("   [Parser] Extracting Subsequent calling points");
-        } else {
-            callingPoints = data["trainServices"][service_index]["previousLocations"];
-            DEBUG_PRINT("   [Parser] Extracting Previous calling points");
-        }
+        // If isPass exists and is not null, store it
+        new_location.isPass = extractJSONvalue<bool>(callingPoints[i], "isPass", false);
         
-        number_of_calling_points = callingPoints.size();
-        new_list_of_calling_points.reserve(number_of_calling_points);
+        // If isCancelled exists and is not null, store it
+        new_location.isCancelled = extractJSONvalue<bool>(callingPoints[i], "isCancelled", false);
         
-        // Calling points are a vector of LocationInfo objects.
-        // This loop extracts each calling point from the JSON data and stores it in a vector (new_list_of_calling_points)
-        // Once complete this the vector is stored in the calling-points information object (services_callingpoints)
-        // number_of_calling_points is the number of calling points in the JSON (some of which may be passed)
- 
-        for (i = 0; i < number_of_calling_points; ++i) {
-            // std::string locationName;
-            //*  bool isPass;
-            //*  bool isCancelled;
-            //*  std::string ArrivalTime;
-            //*  std::string DepartureTime;
-            
-            // If locationName exists, is not null, and isn't empty, store it
-            new_location.locationName = extractJSONvalue<std::string>(callingPoints[i], "locationName", "");
-            
-            // If isPass exists and is not null, store it
-            new_location.isPass = extractJSONvalue<bool>(callingPoints[i], "isPass", false);
-            
-            // If isCancelled exists and is not null, store it
-            new_location.isCancelled = extractJSONvalue<bool>(callingPoints[i], "isCancelled", false);
-            
-            if(direction == SUBSEQUENT) {
-                if(extractJSONvalue<bool>(callingPoints[i], "atdSpecified", false)){
-                    new_location.DepartureTime = extractJSONTimeString(callingPoints[i], "atd", "");
+        if(direction == SUBSEQUENT) {
+            departure_time.clear();
+            if(extractJSONvalue<bool>(callingPoints[i], "atdSpecified", false)){
+                departure_time = extractJSONTimeString(callingPoints[i], "atd", "");
+            } else {
+                if(extractJSONvalue<bool>(callingPoints[i], "etdSpecified", false)){
+                    departure_time = extractJSONTimeString(callingPoints[i], "etd", "");
                 } else {
-                    if(extractJSONvalue<bool>(callingPoints[i], "etdSpecified", false)){
-                        new_location.DepartureTime = extractJSONTimeString(callingPoints[i], "etd", "");
-                    } else {
-                        if(extractJSONvalue<bool>(callingPoints[i], "stdSpecified", false)){
-                            new_location.DepartureTime = extractJSONTimeString(callingPoints[i], "std", "");
-                        }
+                    if(extractJSONvalue<bool>(callingPoints[i], "stdSpecified", false)){
+                        departure_time = extractJSONTimeString(callingPoints[i], "std", "");
                     }
                 }
+            }
+            
+            // Store the compact version - name goes in the pool
+            new_compact_location.name_offset = static_cast<uint32_t>(new_names.size());
+            new_compact_location.name_length = static_cast<uint16_t>(std::min<size_t>(new_location.locationName.size(), UINT16_MAX));
+            new_names.append(new_location.locationName, 0, new_compact_location.name_length);
+            new_compact_location.isPass = new_location.isPass;
+            new_compact_location.isCancelled = new_location.isCancelled;
+            new_compact_location.departure_time_length = static_cast<uint8_t>(std::min<size_t>(departure_time.size(), sizeof(new_compact_location.DepartureTime)));
+            std::memcpy(new_compact_location.DepartureTime, departure_time.data(), new_compact_location.departure_time_length);
+            new_compact_calling_points.push_back(new_compact_location);
+            continue;
+        } else {
+            new_location.ArrivalType = extractJSONvalue<std::string>(callingPoints[i], "arrivalType", "");
+            if(extractJSONvalue<bool>(callingPoints[i], "ataSpecified", false)){
+                new_location.ArrivalTime = extractJSONTimeString(callingPoints[i], "ata", "");
             } else {
-                new_location.ArrivalType = extractJSONvalue<std::string>(callingPoints[i], "arrivalType", "");
-                if(extractJSONvalue<bool>(callingPoints[i], "ataSpecified", false)){
-                    new_location.ArrivalTime = extractJSONTimeString(callingPoints[i], "ata", "");
+                if(extractJSONvalue<bool>(callingPoints[i], "etaSpecified", false)){
+                    new_location.ArrivalTime = extractJSONTimeString(callingPoints[i], "eta", "");
                 } else {
-                    if(extractJSONvalue<bool>(callingPoints[i], "etaSpecified", false)){
-                        new_location.ArrivalTime = extractJSONTimeString(callingPoints[i], "eta", "");
-                    } else {
-                        if(extractJSONvalue<bool>(callingPoints[i], "staSpecified", false)){
-                            new_location.ArrivalTime = extractJSONTimeString(callingPoints[i], "sta", "");
-                        }
+                    if(extractJSONvalue<bool>(callingPoints[i], "staSpecified", false)){
+                        new_location.ArrivalTime = extractJSONTimeString(callingPoints[i], "sta", "");
                     }
                 }
             }
-            // Add the new location object to the new list of calling points
-            new_list_of_calling_points.push_back(new_location);
         }
-        DEBUG_PRINT("   [Parser] " <<number_of_calling_points << " calling points found and stored (not all of these are used for departure boards).");
-        
-        if (direction == SUBSEQUENT) {
-            services_callingpoints[service_index].num_subsequent_calling_points = number_of_calling_points;
-            services_callingpoints[service_index].SubsequentCallingPoints.swap(new_list_of_calling_points);
-        } else {
-            services_callingpoints[service_index].num_previous_calling_points = number_of_calling_points;
-            services_callingpoints[service_index].PreviousCallingPoints.swap(new_list_of_calling_points);
-        }
-        DEBUG_PRINT("[Parser] Extracting calling-points complete for service at index " << service_index);
-    } catch (const json::exception& e) {
-        throw std::runtime_error("[Parser] Error extracting Calling Points: " + std::string(e.what()));
+        // Add the new location object to the new list of calling points
+        new_list_of_calling_points.push_back(new_location);
+    }
+    DEBUG_PRINT("   [Parser] " <<number_of_calling_points << " calling points found and stored (not all of these are used for departure boards).");
+    
+    if (direction == SUBSEQUENT) {
+        services_callingpoints[service_index].num_subsequent_calling_points = number_of_calling_points;
+        services_callingpoints[service_index].SubsequentCallingPoints.swap(new_compact_calling_points);
+        services_callingpoints[service_index].subsequent_names.swap(new_names);
+    } else {
+        services_callingpoints[service_index].num_previous_calling_points = number_of_calling_points;
+        services_callingpoints[service_index].PreviousCallingPoints.swap(new_list_of_calling_points);
     }
+    DEBUG_PRINT("[Parser] Extracting calling-points complete for service at index " << service_index);
+    return Status::OK;
 }
 
 
+// Return the calling points for the selected service as a string
+// Wrapper for appendCallingPointsInternal - use formatCallingPoints to write directly into the display text
 std::string TrainServiceParser::getCallingPoints(size_t service_index, CallingPointETD show_ETD) {
     std::lock_guard<std::mutex> lock(dataMutex);
     
     std::string result;
-    std::string result_with_etd;
-    size_t estimated_size = services_callingpoints[service_index].num_subsequent_calling_points * 25;
+    appendCallingPointsInternal(service_index, show_ETD, result, nullptr);
+    return result;
+}
+
+// Batched calling points - append the calling points for each line's service to the caller's storage.
+// All lines are produced under a single lock and only the requested variant (with/without ETD) is built.
+// If character widths are given (FontCache::getCharWidths) the pixel width is calculated as the text is written.
+void TrainServiceParser::formatCallingPoints(CallingPointLine* lines, size_t num_lines, CallingPointETD show_ETD, const std::array<int, 256>* char_widths) {
+    std::lock_guard<std::mutex> lock(dataMutex);
     
-    result.reserve(estimated_size);
-    result_with_etd.reserve(estimated_size * 2);
+    DEBUG_PRINT("[Parser] Formatting calling points for " << num_lines << " services (show the ETD: " << show_ETD << " )");
+    for (size_t line = 0; line < num_lines; line++) {
+        lines[line].width = 0;
+        if (lines[line].service_index == 999 || lines[line].text == nullptr) {
+            continue;
+        }
+        lines[line].width = appendCallingPointsInternal(lines[line].service_index, show_ETD, *lines[line].text, char_widths);
+    }
+}
+
+// Append one variant of the calling point string to output and return its pixel width.
+// The variant is built from the compact calling points the first time it's needed for this version of the data.
+// Assumes the lock is held
+int TrainServiceParser::appendCallingPointsInternal(size_t service_index, CallingPointETD show_ETD, std::string& output, const std::array<int, 256>* char_widths) {
     
-    try {
-        DEBUG_PRINT("[Parser] Creating the Calling Point string for service " << service_index << " (show the ETD: "<< show_ETD <<" )");
-        // Use TrainID to check this is the expected Service
-        ID = services_sequence[service_index].trainid;
-        trainid = extractJSONvalue<std::string>(data["trainServices"][service_index], "trainid", "");
-        DEBUG_PRINT("   [Parser] Calling Points: Expected Service " << ID << " and got Service " << trainid
-                    << ". Calling Points cached flag: " << services_callingpoints[service_index].callingPointsCached
-                    << ". Data version for cached calling points: " << services_callingpoints[service_index].apiDataVersion);
-        if(trainid != ID){
-            throw std::out_of_range("Unexpected TrainID");
+    DEBUG_PRINT("[Parser] Creating the Calling Point string for service " << service_index << " (show the ETD: "<< show_ETD <<" )");
+    
+    const ServiceFields* fields;
+    if (indexServiceFieldsInternal(service_index, fields) != Status::OK) {                                      // Check the index and use TrainID to check this is the expected Service
+        return 0;                                                                                               // Nothing to show (the error is counted)
+    }
+    
+    CallingPointsInfo& calling_points = services_callingpoints[service_index];
+    DEBUG_PRINT("   [Parser] Calling Points: Expected Service " << ID << " and got Service " << trainid
+                << ". Calling Points cached flag: " << calling_points.callingPointsCached
+                << ". Data version for cached calling points: " << calling_points.apiDataVersion);
+    
+    // Refresh the subsequent calling points if they're stale - both string variants are then stale too
+    if (!calling_points.callingPointsCached || (calling_points.apiDataVersion != api_data_version)) {
+        ExtractCallingPoints(service_index, SUBSEQUENT);                                                        // Can't fail - the service has been checked
+        calling_points.callingPoints.cached = false;
+        calling_points.callingPoints_with_ETD.cached = false;
+        calling_points.callingPointsCached = true;
+        calling_points.apiDataVersion = api_data_version;
+        calling_points.trainid = services_sequence[service_index].trainid;
+    }
+    
+    CallingPointText& variant = (show_ETD == NOETD) ? calling_points.callingPoints : calling_points.callingPoints_with_ETD;
+    
+    // If this is cached then append the stored string
+    if (variant.cached) {
+        DEBUG_PRINT("   [Parser] Calling Points " << ((show_ETD == NOETD) ? "without" : "with") << " ETD already cached.");
+        if (char_widths != nullptr && variant.measured_with != char_widths) {
+            variant.width = 0;
+            for (const char c : variant.text) {
+                variant.width += (*char_widths)[static_cast<unsigned char>(c)];
+            }
+            variant.measured_with = char_widths;
         }
-        
-        if (service_index >= number_of_services) {
-            throw std::out_of_range("Service index out of range");
+        output += variant.text;
+        return (char_widths != nullptr) ? variant.width : 0;
+    }
+    
+    DEBUG_PRINT("   [Parser] Creating calling-point string as not cached")
+    
+    // Write straight into the output, measuring as we go
+    const size_t start = output.size();
+    const std::string& names = calling_points.subsequent_names;
+    int width = 0;
+    
+    auto append = [&](const char* text, size_t length) {
+        output.append(text, length);
+        if (char_widths != nullptr) {
+            for (size_t k = 0; k < length; k++) {
+                width += (*char_widths)[static_cast<unsigned char>(text[k])];
+            }
+        }
+    };
+    
+    // Names plus separators - and " (HH:MM)" for each calling point with the ETD
+    output.reserve(start + names.size() + calling_points.SubsequentCallingPoints.size() * ((show_ETD == NOETD) ? 2 : 9));
+    
+    bool first = true;
+    for (const auto& location : calling_points.SubsequentCallingPoints) {
+        if (location.isPass) {
+            continue;
         }
-        
-        // if this is cached then return the stored strings
         if (show_ETD == NOETD) {
-            if (services_callingpoints[service_index].callingPointsCached && (services_callingpoints[service_index].apiDataVersion == api_data_version)){
-                DEBUG_PRINT("   [Parser] Calling Points without ETD already cached.");
-                return services_callingpoints[service_index].callingPoints;
+            if (!first) {
+                append(", ", 2);
             }
+            append(names.data() + location.name_offset, location.name_length);
         } else {
-            if (services_callingpoints[service_index].callingPointsCached && (services_callingpoints[service_index].apiDataVersion == api_data_version)){
-                DEBUG_PRINT("   [Parser] Calling Points with ETD already cached");
-                return services_callingpoints[service_index].callingPoints_with_ETD;
+            if (!first) {
+                append(" ", 1);
             }
-        }
-
-        // calling points aren't in the cache - so build and store the data
-        
-        // Refresh the subsequent calling point cache
-        ExtractCallingPoints(service_index, SUBSEQUENT);
-            
-        DEBUG_PRINT("   [Parser] Creating calling-point string as not cached")
-        
-        bool first = true;
-        for (size_t i = 0; i < services_callingpoints[service_index].num_subsequent_calling_points; i++) {
-            if (!services_callingpoints[service_index].SubsequentCallingPoints[i].isPass) {
-                if (!first) {
-                    result += ", ";
-                    result_with_etd += " ";
-                }
-                
-                const auto& location = services_callingpoints[service_index].SubsequentCallingPoints[i];
-                result += location.locationName;
-                
-                if(!location.DepartureTime.empty()){
-                    result_with_etd += location.locationName;
-                    result_with_etd += " (";
-                    result_with_etd += location.DepartureTime;
-                    result_with_etd += ")";
-                }
-                
-                first = false;
+            if (location.departure_time_length > 0) {
+                append(names.data() + location.name_offset, location.name_length);
+                append(" (", 2);
+                append(location.DepartureTime, location.departure_time_length);
+                append(")", 1);
             }
         }
-            
-        // Store both versions
-        services_callingpoints[service_index].callingPoints = result;
-        services_callingpoints[service_index].callingPoints_with_ETD = result_with_etd;
-        
-        services_callingpoints[service_index].callingPointsCached = true;
-        services_callingpoints[service_index].apiDataVersion = api_data_version;
-        services_callingpoints[service_index].trainid = services_sequence[service_index].trainid;
-        
-        DEBUG_PRINT("[Parser] Creating the Calling Point string complete for service " << service_index << " (show the ETD: "<< show_ETD <<" )");
-        return (show_ETD == NOETD) ? result : result_with_etd;
-        
-    } catch (const json::exception& e) {
-        DEBUG_PRINT(data);
-        throw std::runtime_error("[Parser] Error creating calling points: " + std::string(e.what()));
-        // Return an empty string
-        return "";
+        first = false;
     }
+    
+    // Store the variant - assign re-uses the cached string's buffer
+    variant.text.assign(output, start, std::string::npos);
+    variant.width = width;
+    variant.measured_with = char_widths;
+    variant.cached = true;
+    
+    DEBUG_PRINT("[Parser] Creating the Calling Point string complete for service " << service_index << " (show the ETD: "<< show_ETD <<" )");
+    return width;
+    
 }
 
 // Lazy load the Service Location.
@@ -974,10 +1305,11 @@ std::string TrainServiceParser::getCallingPoints(size_t service_index, CallingPo
    S* std::string trainid;
    E* uint64_t apiDataVersion;
    E* bool callingPointsCached;
-   E* std::string callingPoints;
-   E* std::string callingPoints_with_ETD;
+   E* CallingPointText callingPoints;
+   E* CallingPointText callingPoints_with_ETD;
    E* std::vector<LocationInfo> PreviousCallingPoints;
-   E* std::vector<LocationInfo> SubsequentCallingPoints;
+   E* std::vector<CompactCallingPoint> SubsequentCallingPoints;
+   E* std::string subsequent_names;
    E* size_t num_previous_calling_points;
    E* size_t num_subsequent_calling_points;
    *  bool bool service_location_cached;
@@ -995,80 +1327,68 @@ std::string TrainServiceParser::getServiceLocation(size_t service_index) {
     size_t current_stop = 0;
     size_t next_stop = 0;
     
-    try {
-        DEBUG_PRINT("[Parser] Finding location of Service Starting] for service at index: " << service_index);
-        if (service_index == 999){
-            DEBUG_PRINT("   [Parser] WARNING - requested Service location for service_index 999 - returning an empty string");
-            return "";
-        }
-        
-        if (service_index >= number_of_services) {
-            throw std::out_of_range("Service index out of range");
-        }
-        
-        ID = services_sequence[service_index].trainid;                                                                                                       // Use TrainID to check this is the expected Service
-        trainid = extractJSONvalue<std::string>(data["trainServices"][service_index], "trainid", "");
-        DEBUG_PRINT("   [Parser] Expected Service " << ID << " and got Service " << trainid
-                    << ". Location cached flag: " << services_callingpoints[service_index].service_location_cached
-                    << ". Data version for cached location: " << services_callingpoints[service_index].apiDataVersion);
-        if(trainid != ID){
-            throw std::out_of_range("Unexpected TrainID");
-        }
-        
-        if(services_callingpoints[service_index].service_location_cached && services_callingpoints[service_index].apiDataVersion == api_data_version) {     // If we have this cached then use that data.
-            DEBUG_PRINT("   [Parser] Service location cached for index " << service_index << ". Using that data");
-            return services_callingpoints[service_index].service_location;
-        }
-        
-        DEBUG_PRINT("   [Parser] Service location not cached - calculating!");
-        
-        // Refresh the previoous calling point cache
-        ExtractCallingPoints(service_index, PREVIOUS);
-        
-        num_calling_points = services_callingpoints[service_index].num_previous_calling_points;
-        if(num_calling_points == 0) {                                                                                                                       // If there are no calling points, then the location is the origin of the Service
-            DEBUG_PRINT("   [Parser] No previous calling points - the service starts here. Finding location completed for service at index: " << service_index);
-            return "";
-        }
-        
-        for (i=0; i < num_calling_points ; i++) {
-            if (!services_callingpoints[service_index].PreviousCallingPoints[i].isPass) {
-                if (next_stop == 0) {
-                    if (services_callingpoints[service_index].PreviousCallingPoints[i].ArrivalType != "Actual") {                                         // This was originally 'Forecast' - setting to 'not Actual' (as we have both 'Forecast' and 'Delayed' to handle)
-                        next_stop = i;
-                    } else {
-                        current_stop = i;
-                    }
+    DEBUG_PRINT("[Parser] Finding location of Service Starting] for service at index: " << service_index);
+    if (service_index == 999){
+        DEBUG_PRINT("   [Parser] WARNING - requested Service location for service_index 999 - returning an empty string");
+        return "";
+    }
+    
+    const ServiceFields* fields;
+    if (indexServiceFieldsInternal(service_index, fields) != Status::OK) {                                                                              // Check the index and use TrainID to check this is the expected Service
+        return "";
+    }
+    DEBUG_PRINT("   [Parser] Expected Service " << ID << " and got Service " << trainid
+                << ". Location cached flag: " << services_callingpoints[service_index].service_location_cached
+                << ". Data version for cached location: " << services_callingpoints[service_index].apiDataVersion);
+    
+    if(services_callingpoints[service_index].service_location_cached && services_callingpoints[service_index].apiDataVersion == api_data_version) {     // If we have this cached then use that data.
+        DEBUG_PRINT("   [Parser] Service location cached for index " << service_index << ". Using that data");
+        return services_callingpoints[service_index].service_location;
+    }
+    
+    DEBUG_PRINT("   [Parser] Service location not cached - calculating!");
+    
+    // Refresh the previoous calling point cache
+    ExtractCallingPoints(service_index, PREVIOUS);                                                                                                      // Can't fail - the service has been checked
+    
+    num_calling_points = services_callingpoints[service_index].num_previous_calling_points;
+    if(num_calling_points == 0) {                                                                                                                       // If there are no calling points, then the location is the origin of the Service
+        DEBUG_PRINT("   [Parser] No previous calling points - the service starts here. Finding location completed for service at index: " << service_index);
+        return "";
+    }
+    
+    for (i=0; i < num_calling_points ; i++) {
+        if (!services_callingpoints[service_index].PreviousCallingPoints[i].isPass) {
+            if (next_stop == 0) {
+                if (services_callingpoints[service_index].PreviousCallingPoints[i].ArrivalType != "Actual") {                                         // This was originally 'Forecast' - setting to 'not Actual' (as we have both 'Forecast' and 'Delayed' to handle)
+                    next_stop = i;
+                } else {
+                    current_stop = i;
                 }
-                DEBUG_PRINT("   [Parser] current: " << current_stop << ". next: " << next_stop << ".  position: " << i << ". Location: "
-                            << services_callingpoints[service_index].PreviousCallingPoints[i].locationName << ". Arrival: "
-                            << services_callingpoints[service_index].PreviousCallingPoints[i].ArrivalTime << ". Arrival Type: "
-                            << services_callingpoints[service_index].PreviousCallingPoints[i].ArrivalType <<".");
             }
+            DEBUG_PRINT("   [Parser] current: " << current_stop << ". next: " << next_stop << ".  position: " << i << ". Location: "
+                        << services_callingpoints[service_index].PreviousCallingPoints[i].locationName << ". Arrival: "
+                        << services_callingpoints[service_index].PreviousCallingPoints[i].ArrivalTime << ". Arrival Type: "
+                        << services_callingpoints[service_index].PreviousCallingPoints[i].ArrivalType <<".");
         }
-        
-        ss.str("");
-        
-        if (next_stop == 0) {
-            ss << "This service is between " << services_callingpoints[service_index].PreviousCallingPoints[current_stop].locationName << " and " << location_name;
-        } else {
-            ss << "This service is between " << services_callingpoints[service_index].PreviousCallingPoints[current_stop].locationName << " and " << services_callingpoints[service_index].PreviousCallingPoints[next_stop].locationName;
-        }
-        
-        DEBUG_PRINT("   [Parser] Storing API version, location-cached-flag and service location ====> " << ss.str());
-        services_callingpoints[service_index].service_location = ss.str();
-        services_callingpoints[service_index].service_location_cached = true;
-        services_callingpoints[service_index].apiDataVersion = api_data_version;
-        
-        DEBUG_PRINT("[Parser] Finding location of Service Completed for service at index: " << service_index);
-        return services_callingpoints[service_index].service_location;
-    }  catch (const json::exception& e) {
-        throw std::runtime_error("[Parser] Error finding service location: " + std::string(e.what()));
-        // Return an empty string
-        return "";
-        
     }
     
+    ss.str("");
+    
+    if (next_stop == 0) {
+        ss << "This service is between " << services_callingpoints[service_index].PreviousCallingPoints[current_stop].locationName << " and " << location_name;
+    } else {
+        ss << "This service is between " << services_callingpoints[service_index].PreviousCallingPoints[current_stop].locationName << " and " << services_callingpoints[service_index].PreviousCallingPoints[next_stop].locationName;
+    }
+    
+    DEBUG_PRINT("   [Parser] Storing API version, location-cached-flag and service location ====> " << ss.str());
+    services_callingpoints[service_index].service_location = ss.str();
+    services_callingpoints[service_index].service_location_cached = true;
+    services_callingpoints[service_index].apiDataVersion = api_data_version;
+    
+    DEBUG_PRINT("[Parser] Finding location of Service Completed for service at index: " << service_index);
+    return services_callingpoints[service_index].service_location;
+    
 }
 
 // Return the text stored in the cached reference data for the specified delay code
@@ -1106,69 +1426,62 @@ std::string TrainServiceParser::decodeCancelCode(size_t delay_code){
 
 TrainServiceParser::BasicServiceInfo TrainServiceParser::getBasicServiceInfo(size_t service_index) {
     std::lock_guard<std::mutex> lock(dataMutex);
-    try {
-        if (service_index == 999){
-            DEBUG_PRINT("[Parser] WARNING - requested Basic Service info for service_index 999 - returning the null structure");
+    if (service_index == 999){
+        DEBUG_PRINT("[Parser] WARNING - requested Basic Service info for service_index 999 - returning the null structure");
+        return null_basic_service;
+    }
+    
+    if (service_index >= number_of_services) {
+        error_counters.index_out_of_range++;
+        DEBUG_PRINT("[Parser] WARNING - requested Basic Service info for service_index " << service_index << " which is out of range - returning the null structure");
+        return null_basic_service;
+    }
+    
+    if (services_basic[service_index].apiDataVersion != api_data_version || services_basic[service_index].static_data_available == false ){
+        DEBUG_PRINT("[Parser] Requested Basic Service info for service_index " << service_index
+                    << ". Stored API version (" << services_basic[service_index].apiDataVersion << ") vs current data version ( " << api_data_version << ") or static data available flag (" << services_basic[service_index].static_data_available
+                    << ") initiates hydration of Basic Data cache.");
+        if (hydrateBasicDataCacheInternal(service_index) != Status::OK) {
             return null_basic_service;
         }
-        
-        if (service_index >= number_of_services) {
-            throw std::out_of_range("Service index out of range");
-        }
-        
-        if (services_basic[service_index].apiDataVersion != api_data_version || services_basic[service_index].static_data_available == false ){
-            DEBUG_PRINT("[Parser] Requested Basic Service info for service_index " << service_index
-                        << ". Stored API version (" << services_basic[service_index].apiDataVersion << ") vs current data version ( " << api_data_version << ") or static data available flag (" << services_basic[service_index].static_data_available
-                        << ") initiates hydration of Basic Data cache.");
-            hydrateBasicDataCacheInternal(service_index);
-        }
-        
-        return services_basic[service_index];
-    } catch (const json::exception& e) {
-        throw std::out_of_range("[Parser] Error getting service data-structure: " + std::string(e.what()));
     }
+    
+    return services_basic[service_index];
 }
 
 TrainServiceParser::AdditionalServiceInfo TrainServiceParser::getAdditionalServiceInfo(size_t service_index) {
     std::lock_guard<std::mutex> lock(dataMutex);
-    try {
-        if (service_index == 999){
-            DEBUG_PRINT("   [Parser] WARNING - requested Additional Service Information for service_index 999 - returning the null structure");
+    if (service_index == 999){
+        DEBUG_PRINT("   [Parser] WARNING - requested Additional Service Information for service_index 999 - returning the null structure");
+        return null_additional_service;
+    }
+    
+    if (service_index >= number_of_services) {
+        error_counters.index_out_of_range++;
+        DEBUG_PRINT("[Parser] WARNING - requested Additional Service info for service_index " << service_index << " which is out of range - returning the null structure");
+        return null_additional_service;
+    }
+    
+    if (services_additions[service_index].apiDataVersion != api_data_version){
+        DEBUG_PRINT("[Parser] Requested Additional Service info for service_index " << service_index
+                    << ". Stored API version (" << services_additions[service_index].apiDataVersion << ") vs current data version ( " << api_data_version << ") or static data available flag (" << services_additions[service_index].static_data_available
+                    << ") initiates hydration of Additional Data cache.");
+        if (hydrateAdditionalDataCacheInternal(service_index) != Status::OK) {
             return null_additional_service;
         }
-        
-        if (service_index >= number_of_services) {
-            throw std::out_of_range("Service index out of range");
-        }
-        
-        if (services_additions[service_index].apiDataVersion != api_data_version){
-            DEBUG_PRINT("[Parser] Requested Additional Service info for service_index " << service_index
-                        << ". Stored API version (" << services_additions[service_index].apiDataVersion << ") vs current data version ( " << api_data_version << ") or static data available flag (" << services_additions[service_index].static_data_available
-                        << ") initiates hydration of Additional Data cache.");
-            hydrateAdditionalDataCacheInternal(service_index);
-        }
-        
-        return services_additions[service_index];
-    } catch (const json::exception& e) {
-        throw std::out_of_range("[Parser] Error getting service data-structure: " + std::string(e.what()));
     }
+    
+    return services_additions[service_index];
 }
 
 size_t TrainServiceParser::getOrdinalDeparture(size_t service_number) {
-    try {
-        if (service_number == 0 || service_number > number_of_departures) {  //Check against departures
-            throw std::out_of_range("Ordinal service number out of range");
-        }
-        
-        if (service_number - 1 >= service_List.size()) {  // Additional safety check
-            throw std::out_of_range("Service list index out of range");
-        }
-        
-        //return service_List[service_number - 1];
-        return safe_at(service_List, service_number - 1, static_cast<size_t>(999));
-    } catch (const json::exception& e) {
-        throw std::out_of_range("[Parser] Error getting service data-structure: " + std::string(e.what()));
+    if (service_number == 0 || service_number > number_of_departures) {  //Check against departures
+        error_counters.index_out_of_range++;
+        return 999;                                                         // No such departure
     }
+    
+    //return service_List[service_number - 1];
+    return safe_at(service_List, service_number - 1, static_cast<size_t>(999));
 }
 
 std::string TrainServiceParser::getPlatform(size_t service_index){
@@ -1381,10 +1694,11 @@ void TrainServiceParser::debugPrintAdditionalServiceInfo(size_t service_index) {
 /*  std::string trainid;
     uint64_t apiDataVersion;
     bool callingPointsCached;
-    std::string callingPoints;
-    std::string callingPoints_with_ETD;
+    CallingPointText callingPoints;
+    CallingPointText callingPoints_with_ETD;
     std::vector<LocationInfo> PreviousCallingPoints;
-    std::vector<LocationInfo> SubsequentCallingPoints;
+    std::vector<CompactCallingPoint> SubsequentCallingPoints;
+    std::string subsequent_names;
     size_t num_previous_calling_points;
     size_t num_subsequent_calling_points;
     bool service_location_cached;
@@ -1400,8 +1714,8 @@ void TrainServiceParser::debugPrintCallingPointsInfo(size_t service_index){
         std::cout <<  "apiDataVersion: " << services_callingpoints[service_index].apiDataVersion << std::endl;
         
         std::cout <<  "callingPointsCached: " << services_callingpoints[service_index].callingPointsCached << std::endl;
-        std::cout <<  "callingPoints: " << services_callingpoints[service_index].callingPoints << std::endl;
-        std::cout <<  "callingPoints_with_ETD: " << services_callingpoints[service_index].callingPoints_with_ETD << std::endl;
+        std::cout <<  "callingPoints (cached " << services_callingpoints[service_index].callingPoints.cached << "): " << services_callingpoints[service_index].callingPoints.text << std::endl;
+        std::cout <<  "callingPoints_with_ETD (cached " << services_callingpoints[service_index].callingPoints_with_ETD.cached << "): " << services_callingpoints[service_index].callingPoints_with_ETD.text << std::endl;
         
         std::cout <<  "num_previous_calling_points: " << services_callingpoints[service_index].num_previous_calling_points << std::endl;
         std::cout <<  "num_subsequent_calling_points: " << services_callingpoints[service_index].num_subsequent_calling_points << std::endl;
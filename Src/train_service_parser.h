@@ -25,6 +25,10 @@
 #include <algorithm>
 #include <vector>
 #include "HTML_processor.h"
+#include "departure_order.h"
+#include "incremental_json.h"
+#include "station_index.h"
+#include "departure_history.h"
 
 using json = nlohmann::json;
 
@@ -43,12 +47,16 @@ public:
     refdata_loaded(false),
     location_name(""),
     selected_platform(),
+    selectCallingAt(false),
+    calling_at_crs(),
     NRCC_message(),
     api_data_version(0),
     services_sequence(max_services),
     services_basic(max_services),
     services_additions(max_services),
     services_callingpoints(max_services),
+    services_fields(max_services),
+    data_generation(0),
     dataMutex()
     {
         service_List.resize(number_of_departures, 999);
@@ -56,6 +64,8 @@ public:
         
         ETDOrderedList.resize(max_json_size, 999);
         ETDOrderedList.reserve(max_json_size);
+        
+        previous_to_new_index.resize(max_json_size, DepartureOrder::NOT_FOUND);
     }
     
     
@@ -168,14 +178,34 @@ public:
          */
     };
     
+    // Subsequent calling point - compact as only the name, time and isPass are used for display
+    // The name is stored in the subsequent_names pool of the CallingPointsInfo
+    struct CompactCallingPoint {
+        uint32_t name_offset;                                                       // Start of the location name in subsequent_names
+        uint16_t name_length;                                                       // Length of the location name
+        bool isPass;
+        bool isCancelled;
+        uint8_t departure_time_length;                                              // 0 if there's no departure time
+        char DepartureTime[5];                                                      // HH:MM (not null terminated)
+    };
+    
+    // A formatted calling point string - each variant is built only when it's asked for
+    struct CallingPointText {
+        bool cached = false;
+        std::string text;
+        int width = 0;                                                              // Pixel width
+        const std::array<int, 256>* measured_with = nullptr;                        // Character widths used to calculate the width (nullptr - not measured)
+    };
+    
     struct CallingPointsInfo {
         std::string trainid;
         uint64_t apiDataVersion;
         bool callingPointsCached;
-        std::string callingPoints;
-        std::string callingPoints_with_ETD;
+        CallingPointText callingPoints;
+        CallingPointText callingPoints_with_ETD;
         std::vector<LocationInfo> PreviousCallingPoints;
-        std::vector<LocationInfo> SubsequentCallingPoints;
+        std::vector<CompactCallingPoint> SubsequentCallingPoints;
+        std::string subsequent_names;                                               // Location names for the SubsequentCallingPoints
         size_t num_previous_calling_points;
         size_t num_subsequent_calling_points;
         bool service_location_cached;
@@ -185,14 +215,48 @@ public:
     enum CallingPointDirection {SUBSEQUENT , PREVIOUS};
     enum CallingPointETD {SHOWETD, NOETD};
     
+    // A line of calling points for the batched formatter (formatCallingPoints)
+    struct CallingPointLine {
+        size_t service_index;                                                       // Service to format - 999 writes nothing
+        std::string* text;                                                          // Caller's storage (e.g. DisplayText.text) - the calling points are appended
+        int width;                                                                  // Set to the pixel width of the appended text (0 if no character widths are given)
+    };
+    
     // Public Functions
     
+    // Errors in the data - counted rather than thrown. A service with an error is shown with defaults (or not at all).
+    enum class Status {
+        OK,
+        IN_PROGRESS,                                                                // Time-sliced update not finished yet
+        PARSE_ERROR,                                                                // Invalid JSON - the update is abandoned and the cache keeps the previous data
+        NO_REFERENCE_DATA,                                                          // Reason codes not loaded before the update
+        INDEX_OUT_OF_RANGE,                                                         // Service index past the services in the data
+        SERVICE_MISMATCH,                                                           // TrainID in the JSON doesn't match the pre-fetch
+        NO_SERVICE                                                                  // No service object in the JSON at the index
+    };
+    struct ErrorCounters {
+        uint64_t parse_errors = 0;
+        uint64_t index_out_of_range = 0;
+        uint64_t service_mismatch = 0;
+        uint64_t no_service = 0;
+        uint64_t field_type_errors = 0;                                             // Fields with the wrong JSON type (the default is used)
+        uint64_t bad_times = 0;                                                     // Times which couldn't be read (the default is used)
+        uint64_t total() const { return parse_errors + index_out_of_range + service_mismatch + no_service + field_type_errors + bad_times; }
+    };
+    ErrorCounters getErrorCounters() const { return error_counters; }              // Errors since the last reset
+    void resetErrorCounters() { error_counters = ErrorCounters(); }
+    
     // Cache hydration/update
     void loadReasonCodes(const std::string& reasonJsonString);                      // Load the JSON reference data for delay and cancellation reasons
-    void prefetchCache(const std::string& jsonString, const int64_t& version);      // Minimally populate the Basic Data and created ordered list of departures
+    Status prefetchCache(const std::string& jsonString, const int64_t& version);    // Minimally populate the Basic Data and created ordered list of departures
     void hydrateDepartureCache();                                                   // Hydrate the cache for the next NUM_OF_DEPARTURES departures from the selected platorm (or all platforms if none selected)
-    void updateCache(const std::string& jsonString, const int64_t& version);        // Execute the pre-fetch and hydrate the departure cache - users don't have to remember to hydrate the departure cache after each pre-fetch
-    void createFromJSON(const std::string& datajsonString, const std::string& reasonJsonString, const int64_t& version); // Combines updateCache and loadReasonCodes
+    Status updateCache(const std::string& jsonString, const int64_t& version);      // Execute the pre-fetch and hydrate the departure cache - users don't have to remember to hydrate the departure cache after each pre-fetch
+    Status createFromJSON(const std::string& datajsonString, const std::string& reasonJsonString, const int64_t& version); // Combines updateCache and loadReasonCodes
+    
+    // Time-sliced cache update - the same work as updateCache in steps which can be spread over several frames (single-core boards)
+    Status beginUpdate(const std::string& jsonString, const int64_t& version);      // Start an update. The cache isn't changed until the update commits
+    Status continueUpdate(std::chrono::steady_clock::time_point deadline);          // Work on the update until the deadline (at least one step). IN_PROGRESS until it's finished
+    bool updateInProgress() const { return pending_update.step != PendingUpdate::IDLE; }
     int64_t getCacheAPIVersion();                                                   // Return the version of the API data stored in the cache
     
     // Platform selection
@@ -201,6 +265,19 @@ public:
     void clearSelectedPlatform();                                                   // Clear the stored selected platform
     std::string getPlatform(size_t service_index);                                  // Return the Platform for a specific service
     
+    // Calling-at selection and queries - answered from an index of every service's subsequent calling points (built once per refresh)
+    struct CallingAtService {
+        size_t service_index;                                                       // 999 if no departure calls at the station
+        std::string time;                                                           // HH:MM departure from the station (actual, estimated or scheduled)
+    };
+    void setHtmlNeonThreshold(size_t threshold) { html_processor_.setNEONThreshold(threshold); }     // NRCC messages at least this long use NEON (html_neon_threshold)
+    void setHistory(DepartureHistory* departure_history) { history = departure_history; }           // Log each refresh's services (history_dir) - nullptr to stop
+    void setCallingAt(std::string crs);                                             // Show only departures which call at the station (CRS code) - with the platform if one is selected
+    void clearCallingAt();                                                          // Clear the calling-at selection
+    CallingAtService getNextCallingAt(const std::string& crs);                      // The next departure from here which calls at the station
+    CallingAtService getFastestTo(const std::string& crs);                          // The departure which gets to the station first
+    size_t getServicesCallingAt(const std::string& crs, std::vector<CallingAtService>& services); // Every departure calling at the station in the order they get there - returns the number found
+    
     // Extract specified service from the cache
     BasicServiceInfo getBasicServiceInfo(size_t serviceIndex);                      // Get the train service data structure for a specific service
     AdditionalServiceInfo getAdditionalServiceInfo(size_t serviceIndex);            // Get the train service data structure for a specific service
@@ -218,6 +295,7 @@ public:
     
     // Calling points for departures
     std::string getCallingPoints(size_t serviceIndex, CallingPointETD show_ETD=NOETD); // Return the calling points for the selected service - option to show the Estimated Time of Departure from calling points
+    void formatCallingPoints(CallingPointLine* lines, size_t num_lines, CallingPointETD show_ETD=NOETD, const std::array<int, 256>* char_widths = nullptr); // Append the calling points for several services in one go, measuring the width as they're written
     
     // Where is the next arrival
     std::string getServiceLocation(size_t serviceIndex);                            // Calculates location of specified service using Previous Calling Points
@@ -243,6 +321,13 @@ private:
     bool selectPlatform;                                                            // Flag to indicate whether departures for a specific platform are selected
     std::string selected_platform;                                                  // Store the selected platform
     
+    // Calling-at selection and index
+    bool selectCallingAt;                                                           // Flag to indicate whether departures calling at a station are selected
+    std::string calling_at_crs;                                                     // Store the selected station (CRS code)
+    StationIDs station_ids;                                                         // CRS codes seen in the calling points and their IDs
+    StationIndex station_index;                                                     // Stops at each station for the services in the cache
+    std::vector<char> calls_at_selected;                                            // Services which call at the selected station (hydrateDepartureCache)
+    
     // Reference Data
     json refdata;                                                                   // Raw JSON Reference data (for cancellation and delay reasons)
     bool refdata_loaded;                                                            // Flag to indicate if Reference Data is available
@@ -281,6 +366,31 @@ private:
     std::vector<AdditionalServiceInfo> services_additions;                          // Additional service information
     std::vector<CallingPointsInfo> services_callingpoints;                          // Calling point information
     
+    // Fields of a service in the JSON - found in one pass over the service object and shared by the basic, additional and calling-point extraction
+    struct ServiceFields {
+        uint64_t generation = 0;                                                    // JSON generation these pointers are for (0 - not indexed)
+        const json* trainid = nullptr;
+        const json* std = nullptr;
+        const json* etd = nullptr;
+        const json* destination = nullptr;
+        const json* origin = nullptr;
+        const json* operator_name = nullptr;
+        const json* length = nullptr;
+        const json* isCancelled = nullptr;
+        const json* cancelReason = nullptr;
+        const json* delayReason = nullptr;
+        const json* adhocAlerts = nullptr;
+        const json* departureType = nullptr;
+        const json* formation = nullptr;
+        const json* serviceIsSupressed = nullptr;
+        const json* isPassengerService = nullptr;
+        const json* platformIsHidden = nullptr;
+        const json* subsequentLocations = nullptr;
+        const json* previousLocations = nullptr;
+    };
+    std::vector<ServiceFields> services_fields;                                     // Indexed fields for each service in 'data'
+    uint64_t data_generation;                                                       // Incremented each time 'data' is replaced - invalidates services_fields
+    
     BasicServiceInfo null_basic_service;                                            // A 'null' Basic Service to return if the service index is 999
     AdditionalServiceInfo null_additional_service;                                  // A 'null' Additional Service to return if the service index is 999
        
@@ -290,6 +400,30 @@ private:
     std::array<size_t, MAX_JSON_SIZE> ETDOrderedList;                               // Array of Service Indices in ETD order */
     std::vector<size_t> service_List;                                               // Array for the primary departures
     std::vector<size_t> ETDOrderedList;                                             // Array of Service Indices in ETD order
+    DepartureOrder departure_order;                                                 // Order of departures kept between refreshes
+    std::vector<size_t> previous_to_new_index;                                      // New index of each service from the last refresh (matched by TrainID in the pre-fetch)
+    
+    // Update in progress (time-sliced) - built up here and swapped into the cache in the COMMIT step
+    struct PendingUpdate {
+        enum Step { IDLE, PARSE, SERVICES, COMMIT, HYDRATE };
+        Step step = IDLE;
+        int64_t version = 0;
+        std::time_t now = 0;                                                        // Default for missing times
+        IncrementalJSON parser;                                                     // The JSON, a piece per step
+        size_t service = 0;                                                         // Next service to pre-fetch
+        size_t number_of_services = 0;
+        std::vector<ServiceSequence> services_sequence;
+        std::vector<BasicServiceInfo> services_basic;
+        std::vector<AdditionalServiceInfo> services_additions;
+        std::vector<CallingPointsInfo> services_callingpoints;
+        std::unordered_map<std::string, size_t> cached_trainIDs;
+        StationIndex station_index;
+        std::vector<DepartureHistory::Observation> observations;                    // For the history log (history_dir)
+    };
+    PendingUpdate pending_update;
+    DepartureHistory* history = nullptr;                                            // Owned by the board
+    
+    mutable ErrorCounters error_counters;                                           // Counted by the (const) field extractors too
     
     // Process Management
     std::mutex dataMutex;                                                          // Process control
@@ -320,19 +454,32 @@ private:
     
     // Cache prefetch
     void prefetchMetaData(const json& new_data);                                        // Cache the meta-data for all Services. Location, NRCC messages, Number of Services, etd/std and Departure Times
+    Status updateStep();                                                                // Do the next step of the pending update - IN_PROGRESS until it's complete
+    void prefetchServiceInternal(const json& new_service, size_t service_index);        // Pre-fetch one service into the pending update (re-using cached services)
+    void indexCallingPointsInternal(const json& new_service, size_t service_index);     // Add the service's subsequent calling points to the pending station index
+    void commitUpdate();                                                                // Swap the pending update into the cache and order the departures
     
     // Cache hydration
-    void hydrateBasicDataCache(size_t serviceIndex);                                    // Populate/refresh Basic Service Information cache for selected service.
-    void hydrateBasicDataCacheInternal(size_t service_index);
+    Status indexServiceFieldsInternal(size_t service_index, const ServiceFields*& fields); // Find the fields of a service in one pass over its JSON (once per refresh). Checks the index and the TrainID.
+    void hydrateDeparturesInternal(const std::vector<size_t>& service_indices);         // Hydrate the Basic Service Information for a batch of services (999 entries are skipped)
+    
+    Status hydrateBasicDataCache(size_t serviceIndex);                                  // Populate/refresh Basic Service Information cache for selected service.
+    Status hydrateBasicDataCacheInternal(size_t service_index);
     
-    void hydrateAdditionalDataCache(size_t serviceIndex);                               // Populate/refresh Additional Service Information cache for selected service
-    void hydrateAdditionalDataCacheInternal(size_t service_index);
+    Status hydrateAdditionalDataCache(size_t serviceIndex);                             // Populate/refresh Additional Service Information cache for selected service
+    Status hydrateAdditionalDataCacheInternal(size_t service_index);
     
     // Ordering and sorting departures for display
     void orderTheDepartureList();                                                       // Create an array of indices in order of departure time (STD and ETD - whichever is later)
     
+    // Calling-at queries
+    bool isDepartureInternal(size_t service_index) const {                              // A departure from here (not an arrival at a terminus). Assumes the lock is held
+        return service_index < number_of_services && services_sequence[service_index].std != INVALID_TIME;
+    }
+    
     // Calling point extraction
-    void ExtractCallingPoints(size_t serviceIndex, CallingPointDirection direction);    // Extract the SubsequentCallingPoints and PreviousCallingPoints vectors for the AdditionalServiceInfo data structure
+    Status ExtractCallingPoints(size_t serviceIndex, CallingPointDirection direction);  // Extract the SubsequentCallingPoints and PreviousCallingPoints vectors for the AdditionalServiceInfo data structure
+    int appendCallingPointsInternal(size_t service_index, CallingPointETD show_ETD, std::string& output, const std::array<int, 256>* char_widths); // Append one variant of the calling points to output and return its width. Assumes the lock is held
     
     // Create null Basic and Additional Service data structures
     void CreateNullServiceInfo();                                                       // Create 'null' Basic and Additional Service Info to return if the service index is 999
@@ -359,98 +506,147 @@ private:
     }
     
     // JSON extractor functions
+    // Fields are type-checked before they're read - a field of the wrong type gives the default and is counted (no exceptions)
+    
+    // Does the JSON value hold something get<T>() can read?
+    template<typename T> static bool holdsType(const json& value) noexcept {
+        if constexpr (std::is_same_v<T, std::string>) {
+            return value.is_string();
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return value.is_boolean();
+        } else {
+            static_assert(std::is_arithmetic_v<T>, "JSON extraction is for strings, bools and numbers");
+            return value.is_number() || value.is_boolean();                                         // As nlohmann converts them
+        }
+    }
     
     // Return a value of selected type
     template<typename T> T extractJSONvalue(const json& source, const std::string& key, const T& default_value = T()) noexcept {
-        try {
-            auto it = source.find(key);
-            if (it != source.end() && !it->is_null()) {
-                if constexpr (std::is_same_v<T, std::string>) {
-                    std::string value = it->get<std::string>();
-                    return value.empty() ? default_value : value;
-                } else {
-                    return it->get<T>();
-                }
-            }
-        } catch (...) {
-            DEBUG_PRINT("Error extracting JSON value for key '" << key << "'");
+        auto it = source.find(key);                                                                 // end() if the source isn't an object
+        if (it == source.end() || it->is_null()) {
+            return default_value;
+        }
+        if (!holdsType<T>(*it)) {
+            error_counters.field_type_errors++;
+            DEBUG_PRINT("Error extracting JSON value for key '" << key << "' - unexpected type " << it->type_name());
+            return default_value;
+        }
+        if constexpr (std::is_same_v<T, std::string>) {
+            const std::string& value = it->get_ref<const std::string&>();
+            return value.empty() ? default_value : value;
+        } else {
+            return it->get<T>();
         }
-        return default_value;
     }
     
     // Return time value as a string
-    std::string extractJSONTimeString(const json& source, const std::string& key, std::string default_value) {  // Handle repetative JSON extraction of time into a string
-        try {
-            if (source.contains(key) && !source[key].is_null()) {
-                std::string value = source[key].get<std::string>();
-                // Special handling for strings to check if they're empty
-                if constexpr (std::is_same_v<std::string, std::string>) {
-                    if (value.empty()) {
-                        return default_value;
-                    }
-                }
-                return value.substr(11,5);
-            }
-        } catch (const json::exception& e) {
-            DEBUG_PRINT("Error extracting JSON value for key '" << key << "': " << e.what());
+    std::string extractJSONTimeString(const json& source, const std::string& key, std::string default_value) noexcept {  // Handle repetative JSON extraction of time into a string
+        auto it = source.find(key);
+        if (it == source.end() || it->is_null()) {
+            return default_value;
+        }
+        if (!it->is_string()) {
+            error_counters.field_type_errors++;
+            DEBUG_PRINT("Error extracting JSON value for key '" << key << "' - unexpected type " << it->type_name());
+            return default_value;
+        }
+        const std::string& value = it->get_ref<const std::string&>();
+        if (value.empty()) {
+            return default_value;
+        }
+        if (value.size() < 16) {                                                                    // Not yyyy-mm-ddThh:mm
+            error_counters.bad_times++;
+            DEBUG_PRINT("Error extracting JSON time for key '" << key << "': " << value);
+            return default_value;
+        }
+        return value.substr(11,5);
+    }
+    
+    // Indexed field extractors - as above, for a field found by indexServiceFieldsInternal (nullptr if it's not in the JSON)
+    
+    // Return a value of selected type
+    template<typename T> T fieldValue(const json* field, const T& default_value = T()) const noexcept {
+        if (field == nullptr || field->is_null()) {
+            return default_value;
+        }
+        if (!holdsType<T>(*field)) {
+            error_counters.field_type_errors++;
+            DEBUG_PRINT("Error extracting indexed JSON value - unexpected type " << field->type_name());
+            return default_value;
+        }
+        if constexpr (std::is_same_v<T, std::string>) {
+            const std::string& value = field->get_ref<const std::string&>();
+            return value.empty() ? default_value : value;
+        } else {
+            return field->get<T>();
         }
-        return default_value;
+    }
+    
+    // Return time value as a string (HH:MM)
+    std::string fieldTimeString(const json* field, const std::string& default_value) const noexcept {
+        if (field == nullptr || field->is_null()) {
+            return default_value;
+        }
+        if (!field->is_string() || field->get_ref<const std::string&>().size() < 16) {
+            error_counters.bad_times++;
+            DEBUG_PRINT("Error extracting indexed JSON time");
+            return default_value;
+        }
+        return field->get_ref<const std::string&>().substr(11,5);
+    }
+    
+    // Return a member of an object (nullptr if it's not there)
+    static const json* childField(const json* parent, const char* key) noexcept {
+        if (parent == nullptr || !parent->is_object()) return nullptr;
+        auto it = parent->find(key);
+        return (it == parent->end()) ? nullptr : &(*it);
+    }
+    
+    // Return the first element of an array (nullptr if it's empty or not an array)
+    static const json* firstElement(const json* parent) noexcept {
+        if (parent == nullptr || !parent->is_array() || parent->empty()) return nullptr;
+        return &(*parent)[0];
     }
     
     // Return time value as a time_t
     time_t extractJSONTime(const json& source, const std::string& key, const time_t& default_time) {
-        try {
-            auto it = source.find(key);
-            if (it == source.end() || it->is_null()) {
-                return default_time;
-            }
-            
-            std::string time_str = it->get<std::string>();
-            if (time_str.empty()) {
-                return default_time;
-            }
-            
-            std::tm tm = {};
-            std::istringstream ss(time_str);
-            ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%S");
-            
-            if (ss.fail()) {
-                DEBUG_PRINT("Failed to parse time: " << time_str);
-                return default_time;
-            }
-            
-            // Use timegm for UTC or consider timezone handling
-            return std::mktime(&tm);
-            
-        } catch (const std::exception& e) {
-            DEBUG_PRINT("Time extraction error: " << e.what());
+        auto it = source.find(key);
+        if (it == source.end() || it->is_null()) {
             return default_time;
         }
+        if (!it->is_string()) {
+            error_counters.field_type_errors++;
+            DEBUG_PRINT("Time extraction error: unexpected type " << it->type_name() << " for '" << key << "'");
+            return default_time;
+        }
+        
+        const std::string& time_str = it->get_ref<const std::string&>();
+        if (time_str.empty()) {
+            return default_time;
+        }
+        
+        std::tm tm = {};
+        std::istringstream ss(time_str);                                                            // Stream exceptions are off - failure is a flag
+        ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%S");
+        
+        if (ss.fail()) {
+            error_counters.bad_times++;
+            DEBUG_PRINT("Failed to parse time: " << time_str);
+            return default_time;
+        }
+        
+        // Use timegm for UTC or consider timezone handling
+        return std::mktime(&tm);
     }
    
     // Extract value of selected type from nested JSON structure
     template<typename T>
-    T extractNestedJSONvalue(const json& source, const std::string& key1, size_t index, const std::string& key2, const T& default_value = T()) {
-        try {
-            if (source.contains(key1) && source[key1].is_array() &&
-                source[key1].size() > index &&
-                source[key1][index].contains(key2) &&
-                !source[key1][index][key2].is_null()) {
-                
-                T value = source[key1][index][key2].get<T>();
-                
-                // Special handling for strings to check if they're empty
-                if constexpr (std::is_same_v<T, std::string>) {
-                    if (value.empty()) {
-                        return default_value;
-                    }
-                }
-                return value;
-            }
-        } catch (const json::exception& e) {
-            DEBUG_PRINT("Error extracting nested JSON value: " << e.what());
+    T extractNestedJSONvalue(const json& source, const std::string& key1, size_t index, const std::string& key2, const T& default_value = T()) noexcept {
+        auto list = source.find(key1);
+        if (list == source.end() || !list->is_array() || list->size() <= index) {
+            return default_value;
         }
-        return default_value;
+        return extractJSONvalue<T>((*list)[index], key2, default_value);
     }
 };
 
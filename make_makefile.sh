@@ -152,22 +152,57 @@ CXXFLAGS = $FINAL_CXXFLAGS
 LDFLAGS = -L/home/display/rpi-rgb-led-matrix/lib
 LDLIBS = -lrgbmatrix -lcurl -lpthread
 
-# Target executable
+# Target executables
 TARGET = departureboard
+BENCH_TARGET = departureboard_bench
+GENERATOR_TARGET = departureboard_generator
+RECEIVER_TARGET = departureboard_receiver
+HISTORY_TARGET = departureboard_history
 
-# Source files (in Src directory)
-SOURCES = \$(SRCDIR)/API_client.cpp \\
+# Source files shared by the departure board and the benchmark (in Src directory)
+COMMON_SOURCES = \$(SRCDIR)/API_client.cpp \\
           \$(SRCDIR)/config.cpp \\
           \$(SRCDIR)/departure_board.cpp \\
-          \$(SRCDIR)/departureboard.cpp \\
+          \$(SRCDIR)/departure_history.cpp \\
+          \$(SRCDIR)/device_calibration.cpp \\
           \$(SRCDIR)/display_text.cpp \\
+          \$(SRCDIR)/frame_presenter.cpp \\
+          \$(SRCDIR)/frame_stream.cpp \\
           \$(SRCDIR)/HTML_processor.cpp \\
+          \$(SRCDIR)/service_details_cache.cpp \\
+          \$(SRCDIR)/task_executor.cpp \\
           \$(SRCDIR)/time_utls.cpp \\
           \$(SRCDIR)/train_service_parser.cpp \\
           \$(SRCDIR)/matrix_driver.cpp 
 
+SOURCES = \$(COMMON_SOURCES) \$(SRCDIR)/departureboard.cpp
+BENCH_SOURCES = \$(COMMON_SOURCES) \$(SRCDIR)/benchmark.cpp
+# Remote display node - only the matrix and the frame stream (no API client, parser or font)
+RECEIVER_SOURCES = \$(SRCDIR)/config.cpp \$(SRCDIR)/display_text.cpp \$(SRCDIR)/frame_presenter.cpp \$(SRCDIR)/frame_stream.cpp \$(SRCDIR)/matrix_driver.cpp \$(SRCDIR)/frame_receiver.cpp
+# Departure history query tool - only the config and the history log
+HISTORY_SOURCES = \$(SRCDIR)/config.cpp \$(SRCDIR)/departure_history.cpp \$(SRCDIR)/history_query.cpp
+
 # Object files (maintained in separate directory)
 OBJECTS = \$(patsubst \$(SRCDIR)/%.cpp,\$(OBJDIR)/%.o,\$(SOURCES))
+BENCH_OBJECTS = \$(patsubst \$(SRCDIR)/%.cpp,\$(OBJDIR)/%.o,\$(BENCH_SOURCES))
+GENERATOR_OBJECTS = \$(OBJDIR)/payload_generator.o
+RECEIVER_OBJECTS = \$(patsubst \$(SRCDIR)/%.cpp,\$(OBJDIR)/%.o,\$(RECEIVER_SOURCES))
+HISTORY_OBJECTS = \$(patsubst \$(SRCDIR)/%.cpp,\$(OBJDIR)/%.o,\$(HISTORY_SOURCES))
+
+# Benchmark and profile-guided optimisation (PGO) settings
+# The replay scenario lists recorded API responses (written to debug_log_dir when debug_mode=true) and frames to render
+REPLAY_SCENARIO = Replay/scenario.txt
+BENCH_CONFIG = config.txt
+BENCH_ITERATIONS = 20
+PGO_OBJDIR = Obj_pgo
+# The training run is multithreaded (the workers and the stream receiver) - atomic profile counters where the target has them
+PGO_GENERATE_FLAGS = -fprofile-generate -fprofile-update=prefer-atomic
+PGO_USE_FLAGS = -fprofile-use -fprofile-partial-training -fprofile-correction -Wno-missing-profile -flto=auto
+
+# Stress benchmark - synthetic responses larger than any recorded board (see '\$(GENERATOR_TARGET) --help')
+STRESS_DIR = Replay/Generated
+STRESS_OPTIONS = --services 400 --calling-points 10-60 --coaches 12 --messages 4 --message-bytes 2000 --entity-density 0.2 --churn 0.05 --refreshes 20
+STRESS_ITERATIONS = 3
 
 # Ensure obj directory exists
 \$(shell mkdir -p \$(OBJDIR))
@@ -196,6 +231,22 @@ all: \$(TARGET)
 	@echo "🔨 Compiling \$<..."
 	\$(CXX) \$(CXXFLAGS) -c \$< -o \$@
 
+\$(BENCH_TARGET): \$(BENCH_OBJECTS)
+	@echo "🔗 Linking \$@..."
+	\$(CXX) \$(LDFLAGS) -o \$@ \$^ \$(LDLIBS)
+
+\$(GENERATOR_TARGET): \$(GENERATOR_OBJECTS)
+	@echo "🔗 Linking \$@..."
+	\$(CXX) -o \$@ \$^
+
+\$(RECEIVER_TARGET): \$(RECEIVER_OBJECTS)
+	@echo "🔗 Linking \$@..."
+	\$(CXX) \$(LDFLAGS) -o \$@ \$^ \$(LDLIBS)
+
+\$(HISTORY_TARGET): \$(HISTORY_OBJECTS)
+	@echo "🔗 Linking \$@..."
+	\$(CXX) -o \$@ \$^ -lpthread
+
 # Development targets
 debug: CXXFLAGS += -g -DDEBUG -O1
 debug: clean \$(TARGET)
@@ -204,15 +255,50 @@ profile: CXXFLAGS += -pg -g
 profile: LDFLAGS += -pg
 profile: clean \$(TARGET)
 
-# Performance testing target
-benchmark: \$(TARGET)
-	@echo "🏃 Running basic performance test..."
-	@time ./\$(TARGET) --test-mode 2>/dev/null || echo "Performance test requires implementation"
+# Performance testing targets
+bench: \$(BENCH_TARGET)
+
+benchmark: \$(BENCH_TARGET)
+	@echo "🏃 Replaying \$(REPLAY_SCENARIO) (\$(BENCH_ITERATIONS) iterations)..."
+	./\$(BENCH_TARGET) -f \$(BENCH_CONFIG) -s \$(REPLAY_SCENARIO) -i \$(BENCH_ITERATIONS)
+
+generator: \$(GENERATOR_TARGET)
+
+receiver: \$(RECEIVER_TARGET)
+
+history: \$(HISTORY_TARGET)
+
+stress: \$(BENCH_TARGET) \$(GENERATOR_TARGET)
+	@echo "🏗️  Generating synthetic responses in \$(STRESS_DIR)..."
+	./\$(GENERATOR_TARGET) -o \$(STRESS_DIR) \$(STRESS_OPTIONS)
+	@echo "🏃 Replaying \$(STRESS_DIR)/scenario.txt (\$(STRESS_ITERATIONS) iterations)..."
+	./\$(BENCH_TARGET) -f \$(BENCH_CONFIG) -s \$(STRESS_DIR)/scenario.txt -i \$(STRESS_ITERATIONS)
+
+# Profile-guided + link-time optimised build
+# 1. Benchmark the plain build  2. Build instrumented  3. Train on the replay scenario  4. Rebuild with the profile and LTO
+pgo:
+	rm -rf \$(PGO_OBJDIR)
+	mkdir -p \$(PGO_OBJDIR)
+	@echo "📊 Step 1/4: Benchmarking the plain build..."
+	\$(MAKE) \$(BENCH_TARGET)
+	./\$(BENCH_TARGET) -f \$(BENCH_CONFIG) -s \$(REPLAY_SCENARIO) -i \$(BENCH_ITERATIONS) | tee \$(PGO_OBJDIR)/bench_plain.txt
+	@echo "🔬 Step 2/4: Building the instrumented binary..."
+	\$(MAKE) OBJDIR=\$(PGO_OBJDIR) BENCH_TARGET=\$(BENCH_TARGET)_instrumented CXXFLAGS="\$(CXXFLAGS) \$(PGO_GENERATE_FLAGS)" LDFLAGS="\$(LDFLAGS) -fprofile-generate" \$(BENCH_TARGET)_instrumented
+	@echo "🏋️  Step 3/4: Training run over the replay scenario..."
+	./\$(BENCH_TARGET)_instrumented -f \$(BENCH_CONFIG) -s \$(REPLAY_SCENARIO) -i \$(BENCH_ITERATIONS) > /dev/null
+	@echo "🚀 Step 4/4: Rebuilding with the profile and LTO..."
+	rm -f \$(PGO_OBJDIR)/*.o \$(TARGET) \$(BENCH_TARGET) \$(BENCH_TARGET)_instrumented
+	\$(MAKE) OBJDIR=\$(PGO_OBJDIR) CXXFLAGS="\$(CXXFLAGS) \$(PGO_USE_FLAGS)" LDFLAGS="\$(LDFLAGS) \$(CXXFLAGS) \$(PGO_USE_FLAGS)" \$(TARGET) \$(BENCH_TARGET)
+	./\$(BENCH_TARGET) -f \$(BENCH_CONFIG) -s \$(REPLAY_SCENARIO) -i \$(BENCH_ITERATIONS) | tee \$(PGO_OBJDIR)/bench_pgo.txt
+	@plain=\$\$(awk '/^BENCH_TOTAL_NS/ {print \$\$2}' \$(PGO_OBJDIR)/bench_plain.txt); \\
+	pgo=\$\$(awk '/^BENCH_TOTAL_NS/ {print \$\$2}' \$(PGO_OBJDIR)/bench_pgo.txt); \\
+	awk -v plain=\$\$plain -v pgo=\$\$pgo 'BEGIN { printf "✅ Plain: %.2f ms   PGO+LTO: %.2f ms   Speedup: %.2fx\\n", plain / 1e6, pgo / 1e6, (pgo > 0 ? plain / pgo : 0) }'
 
 # Clean rule
 clean:
 	@echo "🧹 Cleaning build artifacts..."
-	rm -f \$(TARGET) parser_test \$(OBJDIR)/*.o
+	rm -f \$(TARGET) \$(BENCH_TARGET) \$(BENCH_TARGET)_instrumented \$(GENERATOR_TARGET) \$(RECEIVER_TARGET) \$(HISTORY_TARGET) parser_test \$(OBJDIR)/*.o
+	rm -rf \$(PGO_OBJDIR)
 	rmdir \$(OBJDIR) 2>/dev/null || true
 	@echo "✅ Clean complete!"
 
@@ -233,7 +319,7 @@ opt-report:
 	@objdump -f \$(TARGET) 2>/dev/null | grep "file format" || echo "Build target first with 'make'"
 
 # Phony targets
-.PHONY: all clean debug profile arch-info benchmark install-deps opt-report
+.PHONY: all clean debug profile arch-info bench benchmark generator receiver history stress pgo install-deps opt-report
 
 # Help target
 help:
@@ -246,7 +332,13 @@ help:
 	@echo "  profile      - Build with profiling support"
 	@echo "  clean        - Remove build artifacts"
 	@echo "  arch-info    - Show architecture and compiler info"
-	@echo "  benchmark    - Run basic performance test"
+	@echo "  bench        - Build the replay/benchmark harness"
+	@echo "  benchmark    - Replay the recorded scenario and report timings"
+	@echo "  generator    - Build the synthetic response generator"
+	@echo "  stress       - Generate large boards (STRESS_OPTIONS) and benchmark them"
+	@echo "  receiver     - Build the remote display node (shows frames streamed by a board)"
+	@echo "  history      - Build the departure history query tool (delays from history_dir logs)"
+	@echo "  pgo          - Profile-guided + LTO build trained on the replay scenario"
 	@echo "  install-deps - Install required dependencies"
 	@echo "  opt-report   - Show optimization details"
 	@echo "  help         - Show this help"